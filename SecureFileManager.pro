@@ -4,17 +4,18 @@ TARGET = SecureFileManager
 CONFIG += console c++17
 CONFIG -= app_bundle
 
-# 启用Qt GUI模块
-QT += core gui widgets
+# 启用Qt GUI模块（concurrent用于后台校准密钥派生）
+QT += core gui widgets concurrent
 
 # ==================== 源文件配置 ====================
-SOURCES += src/crypto_engine.cpp \
-           src/file_processor.cpp \
+# 核心代码见sfmcore.pri
+include(sfmcore.pri)
+
+SOURCES += src/worker_thread.cpp \
            src/mainwindow.cpp \
            src/main.cpp  # GUI主入口
 
-HEADERS += include/crypto_engine.h \
-           include/file_processor.h \
+HEADERS += include/worker_thread.h \
            include/mainwindow.h
 
 FORMS += ui/mainwindow.ui
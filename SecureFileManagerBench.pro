@@ -0,0 +1,47 @@
+# ==================== 基础配置 ====================
+# 无界面的批处理基准测试：生成合成文件集，通过WorkerThread执行加密、解密、哈希和擦除
+TEMPLATE = app
+TARGET = SecureFileManagerBench
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+# 只需要Qt Core
+QT = core
+
+# ==================== 源文件配置 ====================
+# 核心代码见sfmcore.pri
+include(sfmcore.pri)
+
+SOURCES += src/corpus_generator.cpp \
+           src/worker_thread.cpp \
+           src/bench_main.cpp  # 基准测试入口
+
+HEADERS += include/corpus_generator.h \
+           include/worker_thread.h
+
+# ==================== Crypto++ 配置 ====================
+INCLUDEPATH += "D:/_SecureFileManager/cryptopp/include"
+LIBS += -L"D:/_SecureFileManager/cryptopp/lib" -lcryptopp
+
+win32 {
+    CONFIG += static
+    QMAKE_CXXFLAGS += -static
+    QMAKE_LFLAGS += -static
+    # GetProcessMemoryInfo
+    LIBS += -lpsapi -lstdc++fs
+}
+
+unix {
+    LIBS += -lcryptopp -lstdc++fs
+}
+
+# ==================== 编译器标志 ====================
+QMAKE_CXXFLAGS += -Wall -Wextra -pedantic
+QMAKE_CXXFLAGS += -Wno-deprecated-declarations
+
+# 基准测试始终按发布版优化
+CONFIG -= debug
+CONFIG += release
+QMAKE_CXXFLAGS_RELEASE = -O2
+
+DEFINES += QT_DEPRECATED_WARNINGS
@@ -0,0 +1,41 @@
+# ==================== 基础配置 ====================
+# 不依赖Qt的核心库：供其他程序嵌入内存加解密（CryptoEngine::encrypt/decrypt、
+# Encryptor/Decryptor）和文件处理接口。默认编译静态库，
+# qmake CONFIG+=sfmcore_shared 时编译动态库
+TEMPLATE = lib
+TARGET = sfmcore
+CONFIG += c++17
+CONFIG -= app_bundle qt
+
+sfmcore_shared {
+    CONFIG += shared
+} else {
+    CONFIG += staticlib
+}
+
+QT =
+
+include(sfmcore.pri)
+
+# ==================== Crypto++ 配置 ====================
+INCLUDEPATH += "D:/_SecureFileManager/cryptopp/include"
+LIBS += -L"D:/_SecureFileManager/cryptopp/lib" -lcryptopp
+
+win32 {
+    LIBS += -lstdc++fs
+}
+
+unix {
+    LIBS += -lcryptopp -lstdc++fs
+}
+
+# ==================== 编译器标志 ====================
+QMAKE_CXXFLAGS += -Wall -Wextra -pedantic
+QMAKE_CXXFLAGS += -Wno-deprecated-declarations
+
+CONFIG(release, debug|release) {
+    QMAKE_CXXFLAGS_RELEASE = -O2
+}
+CONFIG(debug, debug|release) {
+    QMAKE_CXXFLAGS_DEBUG = -g
+}
@@ -0,0 +1,63 @@
+#ifndef ASYNC_ENGINE_H
+#define ASYNC_ENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include "../include/crypto_engine.h"
+#include "../include/key_envelope.h"
+#include "../include/multi_hasher.h"
+#include "../include/wipe_scheduler.h"
+
+// 异步接口：加密、解密、哈希、擦除提交到进程内共用的执行器后立即返回std::future，
+// 调用方（如事件循环线程）可同时提交成千上万个操作，而只占用执行器的固定线程数；
+// 排队中的操作不占线程，按提交顺序执行。
+// 结果或异常通过future取得，可用wait_for(0)轮询。
+// progress在执行器线程中调用；cancel由调用方持有，须在future就绪前保持有效，
+// 置位后排队的操作直接失败，执行中的加解密和哈希在下次进度回报时中止并删除不完整的输出，
+// 擦除在开始覆盖后不中断。取消时future中的异常为"操作已取消"
+class AsyncEngine {
+public:
+    using ProgressCallback = std::function<void(int)>;
+
+    // 执行器线程数，0为硬件线程数；已启动的线程在各自当前操作完成后按新设置增减
+    static void setThreads(unsigned threads);
+    static unsigned threads();
+    // 已提交但尚未完成的操作数
+    static size_t pending();
+
+    // 结果为输出文件大小，其余语义与CryptoEngine::encryptFile/decryptFile相同
+    static std::future<uint64_t> encryptFileAsync(const std::string& inputPath,
+                                                  const std::string& outputPath,
+                                                  const std::string& password,
+                                                  ProgressCallback progress = nullptr,
+                                                  const std::atomic<bool>* cancel = nullptr);
+    // 同一批文件共用已派生的KEK（按值保存到操作完成）
+    static std::future<uint64_t> encryptFileAsync(const std::string& inputPath,
+                                                  const std::string& outputPath,
+                                                  const KeyEnvelope::Kek& kek,
+                                                  ProgressCallback progress = nullptr,
+                                                  const std::atomic<bool>* cancel = nullptr);
+    static std::future<uint64_t> decryptFileAsync(const std::string& inputPath,
+                                                  const std::string& outputPath,
+                                                  const std::string& password,
+                                                  ProgressCallback progress = nullptr,
+                                                  const std::atomic<bool>* cancel = nullptr);
+
+    // 结果与MultiHasher::hashFile相同
+    static std::future<MultiHasher::Digests> hashAsync(const std::string& path,
+                                                       unsigned algorithmMask = MultiHasher::SHA256,
+                                                       ProgressCallback progress = nullptr,
+                                                       const std::atomic<bool>* cancel = nullptr);
+
+    // 覆盖并删除单个文件（块设备只覆盖），失败时future中为异常；options.ioDepth不起作用
+    static std::future<void> wipeAsync(const std::string& path,
+                                       const WipeScheduler::Options& options = WipeScheduler::Options(),
+                                       ProgressCallback progress = nullptr,
+                                       const std::atomic<bool>* cancel = nullptr);
+};
+
+#endif // ASYNC_ENGINE_H
@@ -0,0 +1,57 @@
+#ifndef CORPUS_GENERATOR_H
+#define CORPUS_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 基准测试用的合成文件集：内容只由种子、文件序号和偏移决定，
+// 相同参数在任何机器上生成的文件逐字节相同，可以并行生成
+class CorpusGenerator {
+public:
+    enum Content {
+        Random,       // 随机数据（不可压缩）
+        Compressible, // 重复度高的文本数据
+        Mixed         // 按64KB分段随机选择上面两种
+    };
+
+    // 稀疏文件每个区间开头写入的数据量，其余部分为空洞
+    static constexpr uint64_t SPARSE_EXTENT = 1024 * 1024;
+    // 每个子目录最多容纳的文件数
+    static constexpr uint64_t FILES_PER_DIR = 1000;
+
+    struct Spec {
+        std::string name;        // 子目录名，也用作文件名前缀
+        uint64_t fileCount = 0;
+        uint64_t fileSize = 0;
+        uint64_t sparseStride = 0; // 非0时为稀疏文件：每隔该长度写入SPARSE_EXTENT字节
+        Content content = Mixed;
+    };
+
+    struct Options {
+        uint64_t seed = 1;
+        unsigned threads = 0;    // 0为硬件线程数
+    };
+
+    struct Stats {
+        uint64_t files = 0;
+        uint64_t logicalBytes = 0; // 文件大小之和
+        uint64_t writtenBytes = 0; // 实际写入的字节数（不含空洞）
+    };
+
+    // 预设规模：small(1M×4KB)、large(10k×10MB)、sparse(4×50GB稀疏)或all（三者合并）；
+    // scale缩放文件数，稀疏文件只有4个，缩放的是文件大小
+    static std::vector<Spec> profile(const std::string& name, double scale = 1.0);
+    static Content parseContent(const std::string& name);
+
+    // 在root下生成全部文件（root/<name>/<序号/1000>/<name>_<序号>.bin），失败时抛出异常
+    static Stats generate(const std::string& root, const std::vector<Spec>& specs,
+                          const Options& options);
+
+    // 生成指定文件从offset开始的len字节内容
+    static void fill(uint8_t* buffer, size_t len, uint64_t seed, uint64_t fileIndex,
+                     uint64_t offset, Content content);
+};
+
+#endif // CORPUS_GENERATOR_H
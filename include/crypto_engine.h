@@ -1,6 +1,8 @@
 #ifndef CRYPTO_ENGINE_H
 #define CRYPTO_ENGINE_H
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <cryptopp/aes.h>
 #include <cryptopp/modes.h>
@@ -8,29 +10,238 @@
 #include <cryptopp/osrng.h>
 #include <cryptopp/pwdbased.h>
 #include <cryptopp/sha.h>
+#include "../include/key_envelope.h"
+
+class NativeFile;
 
 class CryptoEngine {
 public:
     using ProgressCallback = std::function<void(int)>;
 
+    // 文件大小未知（需要自行获取）
+    static constexpr uint64_t UNKNOWN_SIZE = UINT64_MAX;
+    // 小于该大小的文件走快速路径：一次读入内存、变换后一次写出
+    static constexpr uint64_t SMALL_FILE_THRESHOLD = 256 * 1024;
+    // 加密文件最小大小 = 旧格式salt(16) + IV(16) + 最小加密块(16)
+    static constexpr uint64_t MIN_ENCRYPTED_SIZE = 16 + 2 * CryptoPP::AES::BLOCKSIZE;
+    // 空洞总量不少于该值的大文件按稀疏格式加密：只读取数据区，空洞记为零段，解密时还原为空洞
+    static constexpr uint64_t SPARSE_MIN_HOLES = 1024 * 1024;
+
+    // knownSize: 调用方已知的输入文件大小（如目录枚举时获得），仅用于跳过明显不适用的快速路径；
+    //            实际处理的大小一律取自打开后的句柄，枚举后文件变化不会导致截断
+    // outputSize: 返回输出文件大小，避免调用方再次stat
+    // plainDigest: 返回明文SHA-256（十六进制），与加密共用同一次读取
+    // 新文件在密文中附带加密的明文摘要，解密时边解密边计算并比对
     static bool encryptFile(const std::string& inputPath, 
                            const std::string& outputPath, 
                            const std::string& password,
-                           ProgressCallback callback = nullptr);
+                           ProgressCallback callback = nullptr,
+                           uint64_t knownSize = UNKNOWN_SIZE,
+                           uint64_t* outputSize = nullptr,
+                           std::string* plainDigest = nullptr);
     
+    // 使用已派生的KEK加密：同一批文件只派生一次，每个文件仍有独立的随机数据密钥
+    static bool encryptFile(const std::string& inputPath,
+                           const std::string& outputPath,
+                           const KeyEnvelope::Kek& kek,
+                           ProgressCallback callback = nullptr,
+                           uint64_t knownSize = UNKNOWN_SIZE,
+                           uint64_t* outputSize = nullptr,
+                           std::string* plainDigest = nullptr);
+    
+    // 文件带有明文摘要时校验解密结果，不符则删除输出并抛出异常
     static bool decryptFile(const std::string& inputPath, 
                            const std::string& outputPath, 
                            const std::string& password,
-                           ProgressCallback callback = nullptr);
+                           ProgressCallback callback = nullptr,
+                           uint64_t knownSize = UNKNOWN_SIZE,
+                           uint64_t* outputSize = nullptr,
+                           std::string* plainDigest = nullptr);
+    
+    // 校验加密文件能否用该密码解密，不写出任何明文
+    // 失败时抛出异常，badOffset返回密文中首个出错位置（无法定位时为UNKNOWN_SIZE）
+    // kek: 已派生的KEK，与文件头的盐和迭代次数一致时跳过密钥派生
+    static bool verifyFile(const std::string& inputPath,
+                           const std::string& password,
+                           ProgressCallback callback = nullptr,
+                           uint64_t knownSize = UNKNOWN_SIZE,
+                           uint64_t* badOffset = nullptr,
+                           const KeyEnvelope::Kek* kek = nullptr);
+    
+    // 更换密码：用旧密码解包v2文件头中的数据密钥，再用newKek重新包装
+    // 只改写文件头，密文不变；同一批文件共用newKek，只需派生一次
+    static bool rekeyFile(const std::string& path,
+                          const std::string& oldPassword,
+                          const KeyEnvelope::Kek& newKek);
     
+    // 原地加密/解密：在文件自身范围内逐块变换，不生成副本
+    // 通过撤销日志保证崩溃安全，存在未完成日志时自动续做；续做的密码须与日志一致
+    static bool encryptFileInPlace(const std::string& path,
+                                   const std::string& password,
+                                   ProgressCallback callback = nullptr);
+
+    static bool decryptFileInPlace(const std::string& path,
+                                   const std::string& password,
+                                   ProgressCallback callback = nullptr);
+
+    // 原地处理完成后的文件名（加密追加.enc，解密去掉.enc）
+    static std::string inPlaceTargetPath(const std::string& path, bool encrypt);
+    static std::string inPlaceJournalPath(const std::string& path);
+
+    // 新文件使用的PBKDF2迭代次数（写入v2文件头，默认10000，可由KdfCalibrator校准，
+    // 低于KdfCalibrator::MIN_ITERATIONS时按下限设置）
+    static void setKdfIterations(uint32_t iterations);
+    static uint32_t kdfIterations();
+
     static int passwordStrength(const std::string& password);
 
     static bool isEncryptedFile(const std::string& path);
 
+    // ==================== 内存接口 ====================
+    // 与文件接口产生相同格式的密文，供通过IPC收发数据块的调用方直接使用，无需临时文件。
+    // 缓冲区以（指针, 长度）传递，输入与输出不能重叠；输出缓冲区不足时抛出异常
+
+    // update()写出的字节数不超过输入长度加STREAM_OVERHEAD，final()不超过STREAM_OVERHEAD
+    static constexpr size_t STREAM_OVERHEAD = 160;
+
+    // 增量加密：依次update()，最后final()写出明文摘要和填充。
+    // 首次输出以文件头开头，因此可直接拼接成完整的加密文件
+    class Encryptor {
+    public:
+        explicit Encryptor(const KeyEnvelope::Kek& kek);
+        explicit Encryptor(const std::string& password);
+        ~Encryptor();
+
+        Encryptor(const Encryptor&) = delete;
+        Encryptor& operator=(const Encryptor&) = delete;
+
+        // 返回写入out的字节数（不足一个块的数据留到下次）
+        size_t update(const CryptoPP::byte* in, size_t inSize,
+                      CryptoPP::byte* out, size_t outSize);
+        // plainDigest: 返回明文SHA-256（十六进制）
+        size_t final(CryptoPP::byte* out, size_t outSize, std::string* plainDigest = nullptr);
+
+    private:
+        friend class CryptoEngine;
+        // 稀疏格式由文件接口使用：明文摘要由调用方按逻辑内容计算后在finish()中传入
+        Encryptor(const KeyEnvelope::Kek& kek, uint32_t flags);
+        void init(const KeyEnvelope::Kek& kek, uint32_t flags);
+        size_t put(const CryptoPP::byte* in, size_t inSize, CryptoPP::byte* out, size_t outSize);
+        size_t finish(const CryptoPP::byte* digest, CryptoPP::byte* out, size_t outSize);
+
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption m_cipher;
+        CryptoPP::SHA256 m_hash;
+        CryptoPP::byte m_header[KeyEnvelope::HEADER_SIZE];
+        CryptoPP::byte m_pending[CryptoPP::AES::BLOCKSIZE];
+        size_t m_pendingLen = 0;
+        bool m_headerPending = true;
+        bool m_hashInput = true;
+        bool m_finished = false;
+    };
+
+    // 增量解密：支持v2和旧格式，带明文摘要时在final()中比对。
+    // 末尾的填充和摘要在final()之前一直扣留，update()只输出确定属于明文的部分；
+    // 密码错误、数据损坏或摘要不符时抛出异常。稀疏格式的密文只能解密到文件
+    class Decryptor {
+    public:
+        // kek: 已派生的KEK，与密文头的盐和迭代次数一致时跳过密钥派生
+        explicit Decryptor(const std::string& password, const KeyEnvelope::Kek* kek = nullptr);
+        ~Decryptor();
+
+        Decryptor(const Decryptor&) = delete;
+        Decryptor& operator=(const Decryptor&) = delete;
+
+        size_t update(const CryptoPP::byte* in, size_t inSize,
+                      CryptoPP::byte* out, size_t outSize);
+        size_t final(CryptoPP::byte* out, size_t outSize, std::string* plainDigest = nullptr);
+
+    private:
+        friend class CryptoEngine;
+        static constexpr size_t MAX_HOLD = 3 * CryptoPP::AES::BLOCKSIZE;
+
+        // 文件接口使用：允许稀疏格式，此时输出记录流，摘要由调用方按逻辑内容比对
+        Decryptor(const std::string& password, const KeyEnvelope::Kek* kek, bool allowSparse);
+        size_t readHeader(const CryptoPP::byte* in, size_t inSize);
+        size_t headerSize() const { return m_headerSize; }
+        bool sparse() const { return (m_flags & KeyEnvelope::FLAG_SPARSE) != 0; }
+        const CryptoPP::byte* storedDigest() const { return m_digest; }
+
+        std::string m_password;              // 解析文件头后清除
+        const KeyEnvelope::Kek* m_kek;
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption m_cipher;
+        CryptoPP::SHA256 m_hash;
+        CryptoPP::byte m_header[KeyEnvelope::HEADER_SIZE];
+        size_t m_headerLen = 0;
+        size_t m_headerSize = 0;             // 0表示文件头尚未完整
+        uint32_t m_flags = 0;
+        CryptoPP::byte m_pending[CryptoPP::AES::BLOCKSIZE];
+        size_t m_pendingLen = 0;
+        CryptoPP::byte m_held[MAX_HOLD];     // 扣留的明文尾部（摘要和填充块）
+        size_t m_heldLen = 0;
+        size_t m_hold = 0;
+        CryptoPP::byte m_digest[CryptoPP::SHA256::DIGESTSIZE];
+        bool m_allowSparse;
+        bool m_hashOutput = true;
+        bool m_finished = false;
+    };
+
+    // 加密后的长度：文件头 + 明文 + 明文摘要 + PKCS填充
+    static uint64_t encryptedSize(uint64_t plainSize);
+
+    // 一次性加密：out至少encryptedSize(inSize)字节，返回密文长度
+    static size_t encrypt(const CryptoPP::byte* in, size_t inSize,
+                          CryptoPP::byte* out, size_t outSize,
+                          const KeyEnvelope::Kek& kek,
+                          std::string* plainDigest = nullptr);
+    static size_t encrypt(const CryptoPP::byte* in, size_t inSize,
+                          CryptoPP::byte* out, size_t outSize,
+                          const std::string& password,
+                          std::string* plainDigest = nullptr);
+
+    // 一次性解密：out至少inSize字节，返回明文长度；失败时抛出异常且out中不留明文
+    static size_t decrypt(const CryptoPP::byte* in, size_t inSize,
+                          CryptoPP::byte* out, size_t outSize,
+                          const std::string& password,
+                          std::string* plainDigest = nullptr);
+
 private:
-    static void deriveKey(const std::string& password, 
-                         CryptoPP::byte* key, size_t keySize, 
-                         CryptoPP::byte* salt, size_t saltSize);
+    static void deriveKeyFromSalt(const std::string& password,
+                                  CryptoPP::byte* key, size_t keySize,
+                                  const CryptoPP::byte* salt, size_t saltSize);
+
+    // 生成v2文件头，返回文件头长度以及数据密钥和IV
+    static size_t createHeader(const KeyEnvelope::Kek& kek, CryptoPP::byte* header,
+                               CryptoPP::byte* key, CryptoPP::byte* iv, uint32_t flags);
+    // 解析v2或旧格式文件头，返回文件头长度以及数据密钥、IV和标志位（旧格式为0）
+    static size_t openHeader(const std::string& password, const CryptoPP::byte* data,
+                             size_t len, CryptoPP::byte* key, CryptoPP::byte* iv,
+                             uint32_t* flags = nullptr,
+                             const KeyEnvelope::Kek* knownKek = nullptr);
+    
+    // 小文件快速路径（输入文件已打开，大小已知）
+    static void encryptSmallFile(NativeFile& inFile, uint64_t fileSize,
+                                 const std::string& outputPath,
+                                 const KeyEnvelope::Kek& kek,
+                                 uint64_t* outputSize,
+                                 std::string* plainDigest);
+
+    // 稀疏文件路径（输入文件已打开，大小已知）
+    static void encryptSparseFile(NativeFile& inFile, uint64_t fileSize,
+                                  const std::string& outputPath,
+                                  const KeyEnvelope::Kek& kek,
+                                  ProgressCallback& callback,
+                                  uint64_t* outputSize,
+                                  std::string* plainDigest);
+
+    static void decryptSmallFile(NativeFile& inFile, uint64_t fileSize,
+                                 const std::string& outputPath,
+                                 const std::string& password,
+                                 uint64_t* outputSize,
+                                 std::string* plainDigest);
+    
+    static bool finalPaddingValid(const NativeFile& file, uint64_t fileSize,
+                                  size_t headerSize, const CryptoPP::byte* iv,
+                                  const CryptoPP::byte* key, size_t keySize);
     
     static void secureWipe(void* ptr, size_t size);
 };
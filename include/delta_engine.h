@@ -0,0 +1,50 @@
+#ifndef DELTA_ENGINE_H
+#define DELTA_ENGINE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// 分块增量加密：密文按固定大小分块，每块使用独立随机nonce的AES-GCM加密，
+// 旁路索引文件(<输出>.sfmidx)记录每块明文的带密钥摘要。
+// 再次加密同一文件时只重写摘要发生变化的块。
+class DeltaEngine {
+public:
+    using ProgressCallback = std::function<void(int)>;
+
+    static constexpr uint32_t CHUNK_SIZE = 1024 * 1024;
+
+    struct Stats {
+        uint64_t totalChunks = 0;
+        uint64_t rewrittenChunks = 0;
+        uint64_t bytesWritten = 0;
+    };
+
+    // 加密或增量更新outputPath处的分块密文
+    // plainDigest: 返回明文SHA-256（小写十六进制），与分块摘要共用同一次读取
+    static bool encryptFile(const std::string& inputPath,
+                            const std::string& outputPath,
+                            const std::string& password,
+                            ProgressCallback callback = nullptr,
+                            Stats* stats = nullptr,
+                            std::string* plainDigest = nullptr);
+
+    static bool decryptFile(const std::string& inputPath,
+                            const std::string& outputPath,
+                            const std::string& password,
+                            ProgressCallback callback = nullptr);
+
+    // 校验所有数据块的认证标签，不写出明文
+    // 失败时抛出异常，badOffset返回首个损坏记录在密文中的偏移
+    static bool verifyFile(const std::string& inputPath,
+                           const std::string& password,
+                           ProgressCallback callback = nullptr,
+                           uint64_t* badOffset = nullptr);
+
+    // 根据文件头魔数判断是否为分块密文
+    static bool isDeltaFile(const std::string& path);
+
+    static std::string indexPath(const std::string& outputPath);
+};
+
+#endif // DELTA_ENGINE_H
@@ -0,0 +1,100 @@
+#ifndef ENCRYPTED_CATALOG_H
+#define ENCRYPTED_CATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "../include/key_envelope.h"
+#include "../include/native_file.h"
+
+// 目录条目：源文件 -> 输出根目录中的密文文件
+struct CatalogEntry {
+    std::string sourcePath;   // 源文件绝对路径
+    std::string outputName;   // 相对输出根目录的密文文件名
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;      // 源文件修改时间（纳秒）
+    std::string plainDigest;  // 明文SHA-256（十六进制），未知时为空
+};
+
+// 加密目录：每个输出根目录一份，记录其中每个密文对应的源文件信息。
+// 条目按源路径排序后分页，每页使用AES-GCM单独加密；页索引（每页的首个路径）
+// 和按输出名查找用的带密钥哈希索引随文件一起保存。打开时只派生一次密钥并解密页索引，
+// 文件以内存映射方式访问，查找只解密一页，列出前缀只解密相关的页。
+// 保存时沿用数据密钥，没有修改的页原样复制，只有涉及修改的页重新加密。
+//
+// 布局: 头(64) KeyEnvelope头(96) 页记录... 页索引记录 输出名索引
+//   头: magic(8) version(4) pageCount(4) entryCount(8) indexOffset(8) indexLength(8)
+//       outputOffset(8) reserved(16)
+//   记录: nonce(12) 密文 tag(16)，附加认证数据为页编号（页索引为0xFFFFFFFF）；
+//         页编号记在页索引中，复制到新位置的页保留原编号（v1的页编号即页号）
+//   输出名索引: 每个条目16字节 tag(8) 页号(4) 页内序号(4)，按tag排序
+class EncryptedCatalog {
+public:
+    static const char* const FILE_NAME;
+
+    using EntryCallback = std::function<bool(const CatalogEntry&)>; // 返回false时停止
+
+    EncryptedCatalog() = default;
+    ~EncryptedCatalog();
+    EncryptedCatalog(const EncryptedCatalog&) = delete;
+    EncryptedCatalog& operator=(const EncryptedCatalog&) = delete;
+
+    // 打开输出目录中的目录文件，不存在时为空目录（save()时创建）
+    // 密码错误或文件损坏时抛出异常
+    void open(const std::string& outputDir, const std::string& password);
+    static bool exists(const std::string& outputDir);
+
+    size_t size() const { return static_cast<size_t>(m_entryCount); }
+
+    // 查询只反映已保存的内容
+    bool find(const std::string& sourcePath, CatalogEntry& entry) const;
+    bool findOutput(const std::string& outputName, CatalogEntry& entry) const;
+    // 按源路径顺序列出以prefix开头的条目（prefix为空时为全部条目）
+    void list(const std::string& prefix, const EntryCallback& callback) const;
+    // 已保存的同一源路径条目与entry完全相同（重复加密未变化的文件时不必修改）
+    bool contains(const CatalogEntry& entry) const;
+
+    // 修改在save()时合并：同一源路径或同一输出名的旧条目被替换
+    void add(const CatalogEntry& entry);
+    void remove(const std::string& sourcePath);
+    bool hasChanges() const { return !m_added.empty() || !m_removed.empty(); }
+    // 合并修改并原子写回，之后的查询反映新内容
+    void save();
+
+private:
+    struct PageInfo {
+        uint64_t offset = 0;
+        uint32_t length = 0;
+        uint32_t count = 0;
+        uint32_t id = 0;          // 附加认证数据中的页编号
+        std::string firstPath;
+    };
+
+    void load();
+    void decryptPage(uint32_t page, std::vector<CatalogEntry>& entries) const;
+    uint64_t outputTag(const std::string& outputName) const;
+
+    std::string m_outputDir;
+    KeyEnvelope::Kek m_kek;
+    bool m_open = false;
+
+    NativeFile m_file;
+    MappedFile m_map;
+    CryptoPP::byte m_dataKey[KeyEnvelope::DATA_KEY_SIZE] = {};
+    CryptoPP::byte m_indexKey[32] = {};
+    uint64_t m_entryCount = 0;
+    uint64_t m_outputOffset = 0;
+    uint32_t m_version = 0;
+    uint32_t m_nextPageId = 0;   // 新页使用的编号
+    std::vector<PageInfo> m_pages;
+
+    std::map<std::string, CatalogEntry> m_added;        // 源路径 -> 新条目
+    std::map<std::string, std::string> m_addedOutputs;  // 输出名 -> 源路径
+    std::set<std::string> m_removed;
+};
+
+#endif // ENCRYPTED_CATALOG_H
@@ -0,0 +1,67 @@
+#ifndef ENCRYPTION_MANIFEST_H
+#define ENCRYPTION_MANIFEST_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// 源文件元数据快照
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;   // 修改时间（纳秒）
+    uint64_t inode = 0;    // Windows上为0
+};
+
+// 清单条目：源文件 -> 输出文件
+struct ManifestEntry {
+    FileStamp stamp;
+    std::string digest;     // 内容摘要（以清单密钥对明文SHA-256计算的HMAC，十六进制）
+    std::string outputName; // 输出目录中的文件名
+};
+
+// 增量加密清单：每个输出目录一份，记录已加密的源文件及其输出
+// 内容摘要使用由密码派生的密钥计算，清单本身不泄露明文哈希
+class EncryptionManifest {
+public:
+    static const char* const FILE_NAME;
+
+    // 读取输出目录中的清单并根据密码派生摘要密钥
+    // 密码与清单不匹配时清单视为空（所有文件重新加密）
+    // 返回false表示清单因密码变化被丢弃
+    bool load(const std::string& outputDir, const std::string& password);
+    // 原子写回清单
+    void save() const;
+
+    static bool stamp(const std::string& path, FileStamp& out);
+
+    const ManifestEntry* find(const std::string& sourcePath) const;
+    // 元数据一致且输出文件仍存在时认为未变化
+    bool isUnchanged(const std::string& sourcePath, const FileStamp& stamp) const;
+    // 读取源文件计算内容摘要
+    std::string contentDigest(const std::string& sourcePath) const;
+    // 由加密时一并算出的明文SHA-256（十六进制）得到内容摘要，
+    // 摘要与写入密文的数据来自同一次读取，无需再读一遍源文件
+    std::string keyedDigest(const std::string& plainDigest) const;
+
+    void update(const std::string& sourcePath, const ManifestEntry& entry);
+    void markSeen(const std::string& sourcePath);
+
+    // 清理本次未出现且源文件已不存在的条目（仅限roots之下），返回被删除的输出文件
+    std::vector<std::string> pruneMissing(const std::vector<std::string>& roots);
+
+    size_t size() const { return m_entries.size(); }
+
+private:
+    std::string outputPath(const ManifestEntry& entry) const;
+
+    std::string m_outputDir;
+    std::string m_saltHex;
+    std::string m_keyCheck;
+    std::vector<unsigned char> m_key;
+    std::map<std::string, ManifestEntry> m_entries;
+    std::set<std::string> m_seen;
+};
+
+#endif // ENCRYPTION_MANIFEST_H
@@ -0,0 +1,60 @@
+#ifndef FOLDER_WATCHER_H
+#define FOLDER_WATCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// 投递目录监视：通过inotify订阅CLOSE_WRITE和MOVED_TO事件（不轮询），
+// 文件在最后一次事件后静默debounceMs才视为就绪，就绪的文件成批交给回调。
+// 子目录自动加入监视；以"."开头的文件（上传工具的临时文件）被忽略。
+// 仅Linux支持，其他平台调用addPath时抛出异常
+class FolderWatcher {
+public:
+    struct Options {
+        int debounceMs = 2000;        // 文件静默多久后视为写完
+        size_t maxBatch = 256;        // 每批最多交给回调的文件数
+        bool includeExisting = false; // 把开始监视时已存在的文件也当作新文件
+    };
+
+    // 回调在调用run()的线程中执行，执行期间到达的事件在内核中排队，不会丢失
+    using BatchCallback = std::function<void(const std::vector<std::string>& paths)>;
+
+    FolderWatcher();
+    explicit FolderWatcher(const Options& options);
+    ~FolderWatcher();
+
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+    // 递归监视目录，失败时抛出异常
+    void addPath(const std::string& dirPath);
+    // 处理事件直到stop()被调用
+    void run(BatchCallback callback);
+    // 可在其他线程或信号处理函数中调用
+    void stop();
+
+private:
+    // 等待就绪的文件；到期时大小或修改时间仍在变化则继续等待
+    struct Pending {
+        uint64_t readyNs = 0;
+        uint64_t size = 0;
+        int64_t mtimeNs = 0;
+    };
+
+    void watchTree(const std::string& dirPath, bool existingAreNew);
+    void readEvents();
+    void touch(const std::string& path);
+    std::vector<std::string> takeReady();
+
+    Options m_options;
+    int m_inotifyFd = -1;
+    int m_wakeFd = -1;                        // stop()写入以唤醒poll
+    std::map<int, std::string> m_dirs;        // 监视描述符 -> 目录
+    std::map<std::string, Pending> m_pending;
+};
+
+#endif // FOLDER_WATCHER_H
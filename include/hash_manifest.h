@@ -0,0 +1,70 @@
+#ifndef HASH_MANIFEST_H
+#define HASH_MANIFEST_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 哈希清单条目
+struct HashEntry {
+    std::string path;            // 相对清单所在目录的路径，'/'分隔
+    std::string sha256;          // 小写十六进制
+    uint64_t size = UINT64_MAX;  // sha256sum格式中没有大小，为UINT64_MAX
+    int64_t mtimeNs = 0;
+};
+
+// 哈希清单：导出为sha256sum兼容格式（可直接用 sha256sum -c 校验）
+// 或带大小和修改时间的JSON格式；扩展名为.json时使用JSON格式。
+// 校验时小文件按批分给线程池并行读取，大文件逐个顺序读取，避免多个大文件交错读盘
+class HashManifest {
+public:
+    enum Status {
+        Ok,
+        Changed,
+        Missing,
+        Failed
+    };
+
+    struct CheckResult {
+        std::string path;   // 实际文件路径
+        Status status;
+        std::string detail;
+    };
+
+    struct CheckSummary {
+        size_t ok = 0;
+        size_t changed = 0;
+        size_t missing = 0;
+        size_t failed = 0;
+        std::vector<CheckResult> problems; // 按路径排序的非Ok条目
+    };
+
+    using ProgressCallback = std::function<void(size_t done, size_t total)>;
+
+    // 超过该大小的文件单独顺序校验
+    static constexpr uint64_t LARGE_FILE_THRESHOLD = 64ull * 1024 * 1024;
+    // 小文件每批的文件数和总字节数上限
+    static constexpr size_t BATCH_FILES = 64;
+    static constexpr uint64_t BATCH_BYTES = 64ull * 1024 * 1024;
+
+    static bool isJsonPath(const std::string& manifestPath);
+
+    // 由文件路径和摘要生成条目，路径转换为相对manifestDir的形式
+    static HashEntry makeEntry(const std::string& filePath, const std::string& sha256Hex,
+                               const std::string& manifestDir);
+
+    // 按扩展名选择格式，原子写入清单
+    static void save(const std::string& manifestPath, const std::vector<HashEntry>& entries);
+    // 自动识别格式读取清单，格式错误时抛出异常
+    static std::vector<HashEntry> load(const std::string& manifestPath);
+
+    // 校验清单中的所有文件；threads为0时使用硬件线程数
+    static CheckSummary check(const std::string& manifestPath, unsigned threads = 0,
+                              ProgressCallback callback = nullptr,
+                              const std::atomic<bool>* cancel = nullptr);
+};
+
+#endif // HASH_MANIFEST_H
@@ -0,0 +1,93 @@
+#ifndef IO_THROTTLE_H
+#define IO_THROTTLE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// I/O节流：按读带宽、写带宽和IOPS三个令牌桶限速，并按优先级调整线程的系统调度。
+// 限额和优先级可在处理过程中随时修改，下一次读写即生效。
+// 数据读写完成后调用charge()记账，令牌不足时阻塞当前线程（未设置节流时只多一次指针读取）
+class IoThrottle {
+public:
+    enum Priority : uint8_t {
+        Interactive = 0,  // 优先调度，Linux上使用最高的尽力而为I/O级别
+        Normal = 1,
+        Background = 2    // 其他任务空闲时才调度，Linux上使用空闲I/O类
+    };
+
+    enum Direction { Read, Write };
+
+    struct Limits {
+        uint64_t readBytesPerSec = 0;   // 0为不限
+        uint64_t writeBytesPerSec = 0;
+        uint64_t iops = 0;              // 读写调用次数
+    };
+
+    IoThrottle();
+
+    IoThrottle(const IoThrottle&) = delete;
+    IoThrottle& operator=(const IoThrottle&) = delete;
+
+    void setLimits(const Limits& limits);
+    Limits limits() const;
+    void setPriority(Priority priority);
+    Priority priority() const { return m_priority.load(std::memory_order_relaxed); }
+    // 每次修改限额或优先级后递增，用于检测变化
+    uint64_t generation() const { return m_generation.load(std::memory_order_relaxed); }
+
+    // 扣除一次读写的令牌，不足时等待
+    void acquire(Direction direction, uint64_t bytes);
+
+    // 在当前线程的节流器（没有时为进程默认节流器）上记账
+    static void charge(Direction direction, uint64_t bytes);
+
+    // 作用域：把节流器绑定到当前线程（可同时设为进程默认，之后新建的工作线程也受限），
+    // 析构时恢复之前的绑定和线程的系统优先级
+    class Scope {
+    public:
+        explicit Scope(IoThrottle* throttle, bool processDefault = false);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        IoThrottle* m_previous;
+        IoThrottle* m_previousDefault;
+        bool m_processDefault;
+    };
+
+    // 后台优先级是否同时提高nice值（默认只调整I/O优先级）。
+    // 普通用户提高nice后无法恢复，之后在该线程上运行的任务也保持较低的CPU优先级
+    static void setAdjustNice(bool enabled);
+
+    // "interactive"/"normal"/"background"
+    static bool parsePriority(const std::string& name, Priority& priority);
+    static const char* priorityName(Priority priority);
+
+private:
+    // 令牌以每秒rate的速度补充，允许一次读写透支，透支还清前其他读写等待
+    struct Bucket {
+        double rate = 0;        // 0为不限
+        double tokens = 0;
+        uint64_t lastNs = 0;
+
+        void refill(uint64_t now);
+        double waitSeconds() const;
+        void take(double amount);
+    };
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    Bucket m_read;
+    Bucket m_write;
+    Bucket m_ops;
+    std::atomic<Priority> m_priority;
+    std::atomic<uint64_t> m_generation;
+    std::atomic<bool> m_limited;
+};
+
+#endif // IO_THROTTLE_H
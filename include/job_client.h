@@ -0,0 +1,28 @@
+#ifndef JOB_CLIENT_H
+#define JOB_CLIENT_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include "../include/job_protocol.h"
+
+// 后台服务的客户端：提交一个任务并等待其完成，每个文件的结果通过回调推送
+class JobClient {
+public:
+    using FileCallback = std::function<void(const JobProtocol::FileResult&)>;
+
+    // cancel被置位时向服务发送取消请求，处理中的文件完成后返回。
+    // throttle的优先级或限额变化时同步给服务。
+    // 请求被拒绝或连接断开时抛出异常
+    static JobProtocol::JobResult run(const std::string& socketPath,
+                                      const JobProtocol::JobRequest& request,
+                                      FileCallback onFile = nullptr,
+                                      const std::atomic<bool>* cancel = nullptr,
+                                      const IoThrottle* throttle = nullptr);
+
+    // 修改运行中任务的优先级和限额，返回修改的任务数
+    static uint32_t updateThrottle(const std::string& socketPath,
+                                   const JobProtocol::ThrottleUpdate& update);
+};
+
+#endif // JOB_CLIENT_H
@@ -0,0 +1,127 @@
+#ifndef JOB_PROTOCOL_H
+#define JOB_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../include/io_throttle.h"
+
+// 后台服务与客户端之间的二进制协议（本机Unix套接字）。
+// 每帧: 长度(u32, 小端, 不含自身) 类型(u8) 负载；
+// 负载中整数均为小端，字符串为 长度(u32) + 字节
+class JobProtocol {
+public:
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+    enum MessageType : uint8_t {
+        // 客户端 -> 服务
+        Submit = 1,      // JobRequest
+        Cancel = 2,      // jobId
+        SetLimits = 3,   // ThrottleUpdate，jobId为0时作用于所有任务
+        // 服务 -> 客户端
+        Accepted = 16,   // jobId, 文件总数
+        FileDone = 17,   // FileResult
+        Completed = 18,  // JobResult
+        Error = 19,      // 错误信息（请求无法受理）
+        Updated = 20     // 修改了限额的任务数
+    };
+
+    enum Operation : uint8_t {
+        Encrypt = 0,
+        Decrypt = 1,
+        Verify = 2,
+        Hash = 3,
+        Wipe = 4
+    };
+
+    struct JobRequest {
+        Operation op = Encrypt;
+        std::string password;
+        std::string outputDir;         // 加密/解密的输出目录，目录中的文件按相对路径输出
+        uint32_t hashAlgorithms = 0;   // MultiHasher::Algorithm按位组合，0为SHA-256
+        std::vector<std::string> paths; // 文件或目录（递归）
+        IoThrottle::Priority priority = IoThrottle::Normal;
+        IoThrottle::Limits limits;
+    };
+
+    // 运行中修改任务的优先级和限额
+    struct ThrottleUpdate {
+        uint32_t jobId = 0;
+        IoThrottle::Priority priority = IoThrottle::Normal;
+        IoThrottle::Limits limits;
+    };
+
+    struct FileResult {
+        uint32_t jobId = 0;
+        uint32_t done = 0;             // 本任务已完成的文件数（含本文件）
+        uint32_t total = 0;
+        bool success = false;
+        std::string path;
+        std::string detail;            // 成功时为输出路径或摘要，失败时为错误信息
+    };
+
+    struct JobResult {
+        uint32_t jobId = 0;
+        uint32_t succeeded = 0;
+        uint32_t failed = 0;
+        bool cancelled = false;
+        std::string message;
+    };
+
+    // 顺序写入负载
+    class Writer {
+    public:
+        void u8(uint8_t value) { m_data.push_back(static_cast<char>(value)); }
+        void u32(uint32_t value);
+        void u64(uint64_t value);
+        void str(const std::string& value);
+        const std::string& data() const { return m_data; }
+
+    private:
+        std::string m_data;
+    };
+
+    // 顺序读取负载，数据不足时抛出异常
+    class Reader {
+    public:
+        explicit Reader(const std::string& data) : m_data(data) {}
+        uint8_t u8();
+        uint32_t u32();
+        uint64_t u64();
+        std::string str();
+
+    private:
+        void need(size_t len) const;
+
+        const std::string& m_data;
+        size_t m_pos = 0;
+    };
+
+    static std::string encode(const JobRequest& request);
+    static std::string encode(const FileResult& result);
+    static std::string encode(const JobResult& result);
+    static std::string encode(const ThrottleUpdate& update);
+    static JobRequest decodeRequest(const std::string& payload);
+    static FileResult decodeFileResult(const std::string& payload);
+    static JobResult decodeJobResult(const std::string& payload);
+    static ThrottleUpdate decodeThrottleUpdate(const std::string& payload);
+
+    // 阻塞发送/接收一帧；发送失败抛出异常，对端关闭时recvFrame返回false
+    static void sendFrame(int fd, uint8_t type, const std::string& payload);
+    static bool recvFrame(int fd, uint8_t& type, std::string& payload);
+
+    // 默认套接字路径：$XDG_RUNTIME_DIR/securefilemanager.sock，
+    // 否则为当前用户私有目录中的/tmp/securefilemanager-<uid>/service.sock
+    static std::string defaultSocketPath();
+    // 服务监听前检查套接字所在目录：默认的私有目录不存在时以0700创建，已存在时必须属于当前用户且
+    // 其他用户无权访问；其他目录必须属于当前用户或root，可被他人写入时须设置粘滞位。不满足时抛出异常
+    static void prepareSocketDirectory(const std::string& socketPath);
+    // 对端进程是否属于当前用户（Linux为SO_PEERCRED，BSD/macOS为getpeereid，其他系统一律视为否）
+    static bool peerIsCurrentUser(int fd);
+    // 连接服务，失败或服务进程不属于当前用户时抛出异常
+    static int connectTo(const std::string& socketPath);
+};
+
+#endif // JOB_PROTOCOL_H
@@ -0,0 +1,70 @@
+#ifndef JOB_SERVER_H
+#define JOB_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/job_protocol.h"
+
+// 常驻后台服务：在本机Unix套接字上接受任务（加密/解密/校验/哈希/擦除），
+// 所有客户端的任务共用一个工作线程池，按优先级（交互、普通、后台）和文件轮流调度，
+// 同一优先级的任务公平分享磁盘；每个任务有自己的读写带宽和IOPS限额，可在运行中修改；
+// 每个文件完成后立即把结果推送给提交任务的客户端。
+// 套接字权限为0600，所在目录须不可被其他用户修改；双方都检查对端uid（Linux、BSD、macOS）。仅Unix系统支持
+class JobServer {
+public:
+    struct Options {
+        std::string socketPath;   // 为空时使用JobProtocol::defaultSocketPath()
+        unsigned threads = 0;     // 工作线程数，0为硬件线程数
+    };
+
+    explicit JobServer(const Options& options);
+    ~JobServer();
+
+    JobServer(const JobServer&) = delete;
+    JobServer& operator=(const JobServer&) = delete;
+
+    // 监听并处理请求直到stop()被调用，启动失败时抛出异常
+    void run();
+    // 可在其他线程或信号处理函数中调用
+    void stop();
+
+private:
+    struct Client;
+    struct Job;
+
+    void serveClient(std::shared_ptr<Client> client);
+    void submit(const std::shared_ptr<Client>& client, const std::string& payload);
+    void cancelJobs(const std::shared_ptr<Client>& client, uint32_t jobId, bool all);
+    uint32_t updateThrottle(const JobProtocol::ThrottleUpdate& update);
+    void workerLoop();
+    std::shared_ptr<Job> nextTask(size_t& index);
+    bool takeFinishedLocked(const std::shared_ptr<Job>& job);
+    void processFile(Job& job, size_t index, JobProtocol::FileResult& result);
+    void finishJob(const std::shared_ptr<Job>& job);
+    std::string updateCatalog(Job& job, const std::vector<std::string>& publishFailed);
+
+    Options m_options;
+    int m_listenFd = -1;
+    int m_wakePipe[2] = {-1, -1};       // stop()写入以唤醒accept循环
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<std::shared_ptr<Job>> m_jobs; // 仍有文件待处理或处理中的任务
+    size_t m_nextJob = 0;                     // 轮转调度位置
+    uint32_t m_nextJobId = 1;
+    bool m_stopping = false;
+
+    std::mutex m_catalogMutex;                // 串行更新各输出目录的加密目录
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::shared_ptr<Client>> m_clients; // 只由run()所在线程访问
+};
+
+#endif // JOB_SERVER_H
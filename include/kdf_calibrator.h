@@ -0,0 +1,27 @@
+#ifndef KDF_CALIBRATOR_H
+#define KDF_CALIBRATOR_H
+
+#include <cstdint>
+
+// PBKDF2成本校准：测量本机派生速度，选出使单次派生耗时接近目标的迭代次数
+// 选出的迭代次数写入每个文件的文件头，解密时按文件头中的参数派生
+class KdfCalibrator {
+public:
+    // 迭代次数上下限（低端设备也不低于下限，下限与旧格式固定的10000次一致）
+    static constexpr uint32_t MIN_ITERATIONS = 10000;
+    static constexpr uint32_t MAX_ITERATIONS = 50000000;
+    static constexpr int DEFAULT_TARGET_MS = 100;
+
+    struct Result {
+        uint32_t iterations = 0;      // 选定的迭代次数
+        double iterationsPerMs = 0;   // 本机测得的派生速度
+        double targetMs = 0;          // 目标耗时
+        double expectedMs = 0;        // 选定迭代次数的预计耗时
+    };
+
+    static Result calibrate(double targetMs);
+    // 测量一次派生（指定迭代次数）的耗时，单位毫秒
+    static double measure(uint32_t iterations);
+};
+
+#endif // KDF_CALIBRATOR_H
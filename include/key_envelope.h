@@ -0,0 +1,63 @@
+#ifndef KEY_ENVELOPE_H
+#define KEY_ENVELOPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <cryptopp/config.h>
+
+// v2文件头：每个文件使用随机数据密钥加密，数据密钥由密码派生的
+// 密钥加密密钥(KEK)以AES-GCM包装后存放在文件头中。
+// 更换密码只需重新包装数据密钥，改写文件头而不触及密文。
+//
+// 布局(96字节):
+//   magic(8) flags(4) iterations(4) salt(16) iv(16)
+//   nonce(12) wrappedKey(16) tag(16) reserved(4)
+// 前48字节作为GCM附加认证数据，篡改参数会导致解包失败
+class KeyEnvelope {
+public:
+    static constexpr size_t HEADER_SIZE = 96;
+    static constexpr size_t DATA_KEY_SIZE = 16;
+    static constexpr size_t IV_SIZE = 16;
+    static constexpr size_t SALT_SIZE = 16;
+    static constexpr uint32_t DEFAULT_ITERATIONS = 10000;
+
+    // 标志位：明文末尾附加明文SHA-256后一并加密，解密时校验
+    static constexpr uint32_t FLAG_PLAIN_DIGEST = 1u << 0;
+    // 标志位：明文为稀疏记录流（空洞只记录长度），总与FLAG_PLAIN_DIGEST一起使用
+    static constexpr uint32_t FLAG_SPARSE = 1u << 1;
+
+    // 密钥加密密钥及其派生参数
+    struct Kek {
+        CryptoPP::byte salt[SALT_SIZE];
+        uint32_t iterations = 0;
+        CryptoPP::byte key[32];
+
+        ~Kek();
+    };
+
+    // 使用指定参数派生KEK
+    static void deriveKek(const std::string& password, const CryptoPP::byte* salt,
+                          uint32_t iterations, Kek& kek);
+    // 生成随机盐并派生KEK
+    static void newKek(const std::string& password, uint32_t iterations, Kek& kek);
+
+    static bool isEnvelope(const CryptoPP::byte* data, size_t len);
+
+    static uint32_t flags(const CryptoPP::byte* header);
+    static uint32_t iterations(const CryptoPP::byte* header);
+    static const CryptoPP::byte* salt(const CryptoPP::byte* header);
+    static const CryptoPP::byte* iv(const CryptoPP::byte* header);
+    // 判断文件头是否由该KEK（相同盐和迭代次数）包装
+    static bool matches(const CryptoPP::byte* header, const Kek& kek);
+
+    // 生成新文件头：随机数据密钥和IV，用KEK包装
+    static void create(const Kek& kek, uint32_t flags,
+                       CryptoPP::byte* header, CryptoPP::byte* dataKey);
+    // 解包数据密钥；密码错误或文件头被篡改时返回false
+    static bool unwrap(const CryptoPP::byte* header, const Kek& kek, CryptoPP::byte* dataKey);
+    // 用新的KEK重新包装数据密钥（IV和密文不变）
+    static void rewrap(CryptoPP::byte* header, const CryptoPP::byte* dataKey, const Kek& kek);
+};
+
+#endif // KEY_ENVELOPE_H
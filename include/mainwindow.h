@@ -4,21 +4,20 @@
 #include <QMainWindow>
 #include <QList>
 #include <QProgressBar>
-#include <QThread>
 #include <QDragEnterEvent>
 #include <QDropEvent>
 #include <QTreeWidget>
 #include <QFileInfo>
 #include <QDir>
-#include "../include/crypto_engine.h"
-#include "../include/file_processor.h"
+#include <QTimer>
+#include <QFutureWatcher>
+#include "../include/kdf_calibrator.h"
+#include "../include/worker_thread.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
-class WorkerThread;
-
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -41,11 +40,26 @@ private slots:
     // 主要功能
     void on_encryptButton_clicked();
     void on_decryptButton_clicked();
+    void on_verifyButton_clicked();
+    void on_rekeyButton_clicked();
     void on_wipeButton_clicked();
     
     // 工具功能
     void on_calculateHashButton_clicked();
+    void on_checkManifestButton_clicked();
     void on_showPasswordCheckBox_stateChanged(int state);
+    void on_kdfTargetSpinBox_valueChanged(int value);
+    void on_keyCacheTtlSpinBox_valueChanged(int value);
+    void on_keyCacheSizeSpinBox_valueChanged(int value);
+    void on_lockKeysButton_clicked();
+    void on_statsExportCheckBox_toggled(bool checked);
+    void on_traceCheckBox_toggled(bool checked);
+    void on_serviceCheckBox_toggled(bool checked);
+    void on_ioPriorityComboBox_currentIndexChanged(int index);
+    void on_readLimitSpinBox_valueChanged(int value);
+    void on_writeLimitSpinBox_valueChanged(int value);
+    void on_iopsLimitSpinBox_valueChanged(int value);
+    void on_memLimitSpinBox_valueChanged(int value);
     
     // 取消按钮
     void on_cancelButton_clicked();
@@ -61,50 +75,20 @@ private slots:
 private:
     Ui::MainWindow *ui;
     WorkerThread *workerThread;
+    QTimer *keyCacheTimer;
+    QTimer *kdfCalibrationTimer;                            // 修改目标耗时后延迟校准
+    QFutureWatcher<KdfCalibrator::Result> *kdfCalibration;  // 后台校准，完成后在界面线程应用
     QString lastOutputDir;
     
     void updateControlsState(bool enabled);
+    void calibrateKdf();
+    void applyKdfCalibration();
+    void configureKeyCache();
+    void applyIoLimits();
+    bool confirmInPlace(const QString &action, int fileCount);
     void loadDirectory(const QString &path, QTreeWidgetItem *parent);
     void collectFilesFromItem(QTreeWidgetItem *item, QList<QString> &files);
     QList<QString> collectSelectedFiles();
 };
 
-class WorkerThread : public QThread
-{
-    Q_OBJECT
-public:
-    enum Operation { 
-        Encrypt, 
-        Decrypt, 
-        Wipe,
-        CalculateHash
-    };
-    
-    explicit WorkerThread(QObject *parent = nullptr);
-    void processFiles(Operation op, const QList<QString> &files, 
-                     const QString &password, const QString &outputDir = "");
-    
-    Operation currentOperation() const { return currentOp; }
-    void cancel() { m_cancel = true; }
-
-signals:
-    void progressChanged(int value, const QString &message);
-    void operationCompleted(bool success, const QString &message);
-    void fileProcessed(const QString &filename);
-    void logMessageRequested(const QString &message, bool isError = false);
-    
-protected:
-    void run() override;
-    
-private:
-    Operation currentOp;
-    QList<QString> fileList;
-    QString password;
-    QString outputDirectory;
-    std::atomic<bool> m_cancel;
-    
-    bool processDirectory(Operation op, const QString &dirPath);
-    bool processSingleFile(Operation op, const QString &filePath);
-};
-
 #endif // MAINWINDOW_H
\ No newline at end of file
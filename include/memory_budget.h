@@ -0,0 +1,69 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <cryptopp/secblock.h>
+
+// 进程级内存预算：加解密、哈希、擦除等路径的大块缓冲区都先向这里申请额度，
+// 已用额度加上本次申请超过上限时阻塞，直到其他线程归还，
+// 线程再多、文件再大，这些缓冲区的总量也不超过上限。
+// 没有其他占用时总是批准，单个超过上限的申请不会死锁；
+// 已持有额度的线程再申请时直接批准（可短暂超出上限），不会等待自己持有的额度。
+// 每个线程处理一个文件时应一次申请所需的全部额度，尽量不要嵌套申请。默认不限制
+class MemoryBudget {
+public:
+    struct Stats {
+        uint64_t limit = 0;   // 0为不限制
+        uint64_t inUse = 0;
+        uint64_t peak = 0;    // 自上次resetPeak以来的最高占用
+        uint64_t waits = 0;   // 因额度不足而等待的次数
+        uint64_t waitNs = 0;
+    };
+
+    // 额度租约：构造时申请（可能阻塞），析构或release()时归还；须在申请的线程中归还
+    class Lease {
+    public:
+        Lease() = default;
+        explicit Lease(size_t bytes);
+        ~Lease() { release(); }
+
+        Lease(Lease&& other) noexcept : m_bytes(other.m_bytes) { other.m_bytes = 0; }
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        size_t bytes() const { return m_bytes; }
+        void release();
+
+    private:
+        size_t m_bytes = 0;
+    };
+
+    // 计入预算的对齐缓冲区，析构时清零并归还额度
+    class Buffer {
+    public:
+        explicit Buffer(size_t size) : m_lease(size), m_block(size) {}
+
+        CryptoPP::byte* data() { return m_block.data(); }
+        const CryptoPP::byte* data() const { return m_block.data(); }
+        size_t size() const { return m_block.size(); }
+
+    private:
+        Lease m_lease;
+        CryptoPP::AlignedSecByteBlock m_block;
+    };
+
+    // 设置上限（字节），0为不限制；调低后已有占用不受影响，新申请等待归还
+    static void setLimit(uint64_t bytes);
+    static uint64_t limit();
+    static Stats stats();
+    // 开始新一轮统计时把峰值重置为当前占用
+    static void resetPeak();
+
+    // 解析"512M"、"2G"、"65536"等写法（K/M/G按1024进位），格式错误时抛出异常
+    static uint64_t parseSize(const std::string& text);
+};
+
+#endif // MEMORY_BUDGET_H
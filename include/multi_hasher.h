@@ -0,0 +1,42 @@
+#ifndef MULTI_HASHER_H
+#define MULTI_HASHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 单次读取计算多种摘要：文件只读一遍，同一批缓冲区依次送入每种算法。
+// 大文件时每种算法各用一个线程，与读取线程流水并行
+class MultiHasher {
+public:
+    using ProgressCallback = std::function<void(int)>;
+
+    enum Algorithm : unsigned {
+        SHA256 = 1u << 0,
+        SHA1 = 1u << 1,
+        BLAKE2b = 1u << 2,
+        CRC32C = 1u << 3
+    };
+    static constexpr unsigned ALL_ALGORITHMS = SHA256 | SHA1 | BLAKE2b | CRC32C;
+
+    static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+    // 超过该大小时启用多线程流水
+    static constexpr uint64_t PARALLEL_THRESHOLD = 16ull * 1024 * 1024;
+
+    // (算法, 十六进制摘要)，按算法位从低到高排列
+    using Digests = std::vector<std::pair<Algorithm, std::string>>;
+
+    // 计算algorithmMask中所有算法的摘要，失败时抛出异常
+    static Digests hashFile(const std::string& path, unsigned algorithmMask,
+                            ProgressCallback callback = nullptr);
+
+    static const char* algorithmName(Algorithm algorithm);
+    // 解析逗号分隔的算法名（不区分大小写，如"sha256,blake2b"），未知名称抛出异常
+    static unsigned parseAlgorithms(const std::string& list);
+    static std::vector<Algorithm> algorithms(unsigned mask);
+};
+
+#endif // MULTI_HASHER_H
@@ -0,0 +1,89 @@
+#ifndef NATIVE_FILE_H
+#define NATIVE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 基于系统句柄的文件封装，支持按偏移读写与刷盘
+class NativeFile {
+public:
+    enum OpenMode {
+        ReadOnly,       // 只读打开已有文件
+        ReadWrite,      // 读写打开已有文件
+        CreateTruncate  // 创建或清空后读写；Unix上权限为仅所有者可读写
+    };
+
+    NativeFile() = default;
+    ~NativeFile();
+
+    NativeFile(const NativeFile&) = delete;
+    NativeFile& operator=(const NativeFile&) = delete;
+    NativeFile(NativeFile&& other) noexcept;
+    NativeFile& operator=(NativeFile&& other) noexcept;
+
+    bool open(const std::string& path, OpenMode mode);
+    void close();
+    bool isOpen() const;
+
+    uint64_t size() const;
+    // 实际占用的磁盘空间；块设备、不支持查询时返回size()
+    uint64_t allocatedSize() const;
+    // 查找offset处或之后的第一个数据区[start, end)，其余为空洞（读出为零）。
+    // 之后没有数据时返回false；系统或文件系统不支持时把剩余部分视为一个数据区
+    bool nextData(uint64_t offset, uint64_t& start, uint64_t& end) const;
+
+    // 从指定偏移读取，返回实际读取的字节数（遇到文件末尾时可能小于len）
+    size_t readAt(void* buffer, size_t len, uint64_t offset) const;
+    // 向指定偏移写入全部数据，失败时抛出异常
+    void writeAt(const void* buffer, size_t len, uint64_t offset);
+
+    void truncate(uint64_t newSize);
+    // 标记为稀疏文件，之后跳过未写的区间和截断扩展的部分成为空洞。
+    // Windows需对句柄设置FSCTL_SET_SPARSE（NTFS、ReFS），否则按零填充分配；
+    // Unix文件系统默认支持空洞，直接返回true。不支持时返回false，内容不受影响
+    bool setSparse();
+    // 通知存储释放指定区间的数据块：普通文件打洞（保持文件大小），块设备BLKDISCARD
+    // 仅Linux支持；文件系统或设备不支持时返回false
+    bool discard(uint64_t offset, uint64_t len);
+    // 将文件数据刷写到磁盘
+    void sync();
+
+    // 刷写目录项（使重命名、删除持久化）
+    static void syncDirectory(const std::string& dirPath);
+
+private:
+    friend class MappedFile;
+
+#ifdef _WIN32
+    void* m_handle = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
+
+// 只读内存映射：映射已打开文件的全部内容，解除映射前文件可以关闭
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // 空文件或映射失败时返回false
+    bool map(const NativeFile& file);
+    void unmap();
+
+    const unsigned char* data() const { return m_data; }
+    uint64_t size() const { return m_size; }
+
+private:
+    const unsigned char* m_data = nullptr;
+    uint64_t m_size = 0;
+#ifdef _WIN32
+    void* m_mapping = nullptr;
+#endif
+};
+
+#endif // NATIVE_FILE_H
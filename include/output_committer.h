@@ -0,0 +1,47 @@
+#ifndef OUTPUT_COMMITTER_H
+#define OUTPUT_COMMITTER_H
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 输出文件发布器：输出先写入同目录下的临时文件，
+// 成批刷盘（组提交）后再原子重命名为最终文件名，崩溃时不会留下看似有效的残缺文件
+class OutputCommitter {
+public:
+    explicit OutputCommitter(size_t batchSize = 64);
+    ~OutputCommitter();
+
+    OutputCommitter(const OutputCommitter&) = delete;
+    OutputCommitter& operator=(const OutputCommitter&) = delete;
+
+    // 返回最终路径对应的临时文件路径
+    static std::string stagingPath(const std::string& finalPath);
+
+    // 登记一个已写完的临时文件；达到批大小时自动提交
+    // 返回自动提交中发布失败的最终路径，published返回已重命名发布的最终路径
+    std::vector<std::string> complete(const std::string& tempPath, const std::string& finalPath,
+                                      std::vector<std::string>* published = nullptr);
+    // 放弃临时文件（处理失败时调用）
+    static void discard(const std::string& tempPath);
+    // 就地更新的输出（如分块密文）：以最终文件的副本作为临时文件，支持时使用reflink共享数据块
+    // 最终文件不存在时返回false，复制失败时抛出异常
+    static bool stageExisting(const std::string& finalPath, const std::string& tempPath);
+    // 只尝试reflink克隆（Linux FICLONE，如Btrfs、XFS）；最终文件不存在或文件系统不支持时返回false，
+    // 调用方可据此改为直接更新最终文件，避免整份复制
+    static bool cloneExisting(const std::string& finalPath, const std::string& tempPath);
+
+    // 刷盘并发布所有已完成的文件，返回发布失败的最终路径
+    std::vector<std::string> commit(std::vector<std::string>* published = nullptr);
+
+private:
+    std::vector<std::string> commitLocked(std::vector<std::string>* published);
+
+    size_t m_batchSize;
+    std::vector<std::pair<std::string, std::string>> m_pending; // (临时路径, 最终路径)
+    std::mutex m_mutex;
+};
+
+#endif // OUTPUT_COMMITTER_H
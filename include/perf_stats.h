@@ -0,0 +1,92 @@
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 分阶段性能计数：打开/stat、读、密钥派生、加解密、哈希、写、刷盘、排队等待和内存等待。
+// 每个线程只写自己的计数块（无锁、无共享缓存行），读取时合并所有线程；
+// 每次记录只有两次时钟读取和几次线程内加法，可以常开
+class PerfStats {
+public:
+    enum Stage {
+        OpenStat,
+        Read,
+        Kdf,
+        Cipher,
+        Hash,
+        Write,
+        Fsync,
+        QueueWait,
+        MemWait,
+        STAGE_COUNT
+    };
+
+    // 延迟直方图：第i个桶的上界为2^i微秒，最后一个桶不设上界
+    static constexpr size_t BUCKET_COUNT = 24;
+
+    struct StageStats {
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t bytes = 0;
+        uint64_t buckets[BUCKET_COUNT] = {};
+
+        // 由直方图估算分位数（取所在桶的上界），单位纳秒
+        uint64_t percentileNs(double q) const;
+    };
+
+    struct Snapshot {
+        StageStats stages[STAGE_COUNT];
+        uint64_t wallNs = 0; // 自上次reset以来经过的时间
+        // 内存预算（见MemoryBudget）：上限（0为不限制）和本轮峰值占用
+        uint64_t memoryLimit = 0;
+        uint64_t memoryPeak = 0;
+    };
+
+    // 作用域计时：析构时记录一次耗时
+    class Timer {
+    public:
+        explicit Timer(Stage stage, uint64_t bytes = 0)
+            : m_stage(stage), m_bytes(bytes), m_start(nowNs()) {}
+        ~Timer() { record(m_stage, nowNs() - m_start, m_bytes); }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        void setBytes(uint64_t bytes) { m_bytes = bytes; }
+
+    private:
+        Stage m_stage;
+        uint64_t m_bytes;
+        uint64_t m_start;
+    };
+
+    static uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static void record(Stage stage, uint64_t ns, uint64_t bytes = 0);
+
+    // 合并所有线程的计数，减去reset时的基线
+    static Snapshot snapshot();
+    // 开始新一轮统计（记录基线，不清零其他线程的计数块）
+    static void reset();
+
+    // 导出用的英文名（如"open_stat"）和界面显示用的中文名
+    static const char* stageName(Stage stage);
+    static const char* stageLabel(Stage stage);
+
+    // node_exporter textfile收集器格式
+    static std::string toPrometheus(const Snapshot& snapshot);
+    static std::string toJson(const Snapshot& snapshot);
+    // 先写临时文件再重命名，收集器不会读到写了一半的文件
+    static void writePrometheus(const std::string& path, const Snapshot& snapshot);
+    static void writeJson(const std::string& path, const Snapshot& snapshot);
+    // 在目录中写出securefilemanager.prom和securefilemanager_stats.json
+    static void exportTo(const std::string& dir, const Snapshot& snapshot);
+};
+
+#endif // PERF_STATS_H
@@ -0,0 +1,42 @@
+#ifndef SESSION_KEY_CACHE_H
+#define SESSION_KEY_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <cryptopp/config.h>
+
+// 会话密钥缓存：记住 (密码指纹, 盐, KDF参数) -> 派生出的密钥，
+// 同一会话中再次处理同一批文件（如先哈希后解密、重复解密）时跳过PBKDF2。
+// 条目存放在锁定的内存页中（mlock/VirtualLock，Linux上排除在核心转储之外），
+// 不保存密码和盐：查找键是以进程随机密钥对密码、盐和参数计算的HMAC。
+// 条目在TTL到期、被淘汰或clear()（锁定）时清零。默认关闭，由configure()启用
+class SessionKeyCache {
+public:
+    static constexpr size_t MAX_KEY_SIZE = 64;
+    static constexpr size_t DEFAULT_MAX_ENTRIES = 1024;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entries = 0;
+    };
+
+    // ttlSeconds或maxEntries为0时关闭缓存；修改设置会清空已有条目
+    // 无法锁定内存时不启用缓存并返回false
+    static bool configure(unsigned ttlSeconds, size_t maxEntries = DEFAULT_MAX_ENTRIES);
+    static bool enabled();
+
+    // PBKDF2-HMAC-SHA256派生密钥；缓存启用时先查缓存，未命中时派生后存入
+    static void derive(const std::string& password, const CryptoPP::byte* salt, size_t saltSize,
+                       uint32_t iterations, CryptoPP::byte* key, size_t keySize);
+
+    // 清零到期的条目
+    static void purgeExpired();
+    // 锁定：清零全部条目
+    static void clear();
+
+    static Stats stats();
+};
+
+#endif // SESSION_KEY_CACHE_H
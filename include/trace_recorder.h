@@ -0,0 +1,54 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 时间线记录：按线程记录每个文件和每个分块阶段的起止时间，
+// 结束后导出为Chrome/Perfetto可打开的trace.json。
+// 每个线程写自己的缓冲区（无锁），未开启时每个记录点只多一次原子读取
+class TraceRecorder {
+public:
+    // 每个线程最多记录的事件数，超出后丢弃并计数
+    static constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    static bool enabled() {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // 清空之前的记录并开始记录；需在没有操作进行时调用
+    static void start();
+    static void stop();
+
+    // 记录一个已结束的区间（时间为PerfStats::nowNs()的纳秒值）
+    static void complete(const char* name, uint64_t startNs, uint64_t endNs,
+                         uint64_t bytes = 0, const std::string& detail = std::string());
+
+    // 写出Chrome trace事件格式的JSON；需在stop()且各线程结束记录后调用
+    static void write(const std::string& path);
+    // 已记录和已丢弃的事件数
+    static size_t eventCount();
+    static size_t droppedCount();
+
+    // 作用域区间：开启记录时析构时记录一个区间
+    class Span {
+    public:
+        Span(const char* name, const std::string& detail = std::string());
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* m_name;
+        std::string m_detail;
+        uint64_t m_start;
+    };
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+#endif // TRACE_RECORDER_H
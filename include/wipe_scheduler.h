@@ -0,0 +1,69 @@
+#ifndef WIPE_SCHEDULER_H
+#define WIPE_SCHEDULER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// 批量安全擦除调度器：多个文件并发覆盖（并发数即I/O深度），
+// 覆盖使用固定大小的缓冲区分块写入，每遍覆盖后刷盘。
+// 覆盖完成的文件按目录成批删除，每个目录只打开一次并刷写一次目录项。
+// 可选在覆盖后释放数据块（打洞/BLKDISCARD），删除完成后对涉及的文件系统执行FITRIM
+class WipeScheduler {
+public:
+    static constexpr unsigned DEFAULT_IO_DEPTH = 4;
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+    struct Options {
+        unsigned ioDepth = DEFAULT_IO_DEPTH; // 同时覆盖的文件数
+        int passes = 3;                      // 覆盖遍数，最后一遍为随机数据
+        bool discard = false;                // 覆盖后释放文件占用的数据块
+        bool trim = false;                   // 全部删除后对文件系统执行FITRIM（需要管理员权限）
+        size_t unlinkBatch = 64;             // 每批删除的文件数
+    };
+
+    struct Stats {
+        uint64_t files = 0;            // 成功擦除的文件数
+        uint64_t failed = 0;
+        uint64_t bytesOverwritten = 0; // 被覆盖的文件字节数（不乘遍数）
+        uint64_t bytesDiscarded = 0;   // 打洞/BLKDISCARD释放的字节数
+        uint64_t bytesTrimmed = 0;     // FITRIM报告回收的字节数
+    };
+
+    // 每个文件结束时回调，可能在工作线程中调用
+    using FileCallback = std::function<void(const std::string& path, bool success,
+                                            const std::string& error)>;
+
+    WipeScheduler();
+    explicit WipeScheduler(const Options& options);
+
+    // 覆盖并删除全部文件；cancel置位后不再开始新的文件，已覆盖的文件仍会删除
+    // 块设备只覆盖和释放，不删除设备节点
+    Stats run(const std::vector<std::string>& paths, FileCallback callback = nullptr,
+              const std::atomic<bool>* cancel = nullptr);
+
+    // 覆盖单个文件（不删除），返回被覆盖和被释放的字节数，失败时抛出异常
+    static void overwrite(const std::string& path, const Options& options,
+                          uint64_t& bytesOverwritten, uint64_t& bytesDiscarded);
+
+private:
+    void queueUnlink(const std::string& path);
+    void flushUnlinks();
+    void report(const std::string& path, bool success, const std::string& error);
+
+    Options m_options;
+    FileCallback m_callback;
+    std::vector<std::string> m_pending; // 已覆盖、待删除的文件
+    std::set<std::string> m_dirs;       // 涉及的目录（用于FITRIM）
+    std::mutex m_mutex;
+    std::mutex m_unlinkMutex;           // 同一时刻只有一个线程执行删除
+    std::atomic<uint64_t> m_files;
+    std::atomic<uint64_t> m_failed;
+};
+
+#endif // WIPE_SCHEDULER_H
@@ -0,0 +1,143 @@
+#ifndef WORKER_THREAD_H
+#define WORKER_THREAD_H
+
+#include <QList>
+#include <QThread>
+#include <QFileInfo>
+#include <QDir>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include "../include/crypto_engine.h"
+#include "../include/file_processor.h"
+#include "../include/output_committer.h"
+#include "../include/encryption_manifest.h"
+#include "../include/delta_engine.h"
+#include "../include/encrypted_catalog.h"
+#include "../include/key_envelope.h"
+#include "../include/hash_manifest.h"
+#include "../include/io_throttle.h"
+#include "../include/multi_hasher.h"
+#include "../include/perf_stats.h"
+#include "../include/trace_recorder.h"
+#include "../include/wipe_scheduler.h"
+
+// 后台批处理线程：只依赖QtCore，界面和无界面的基准测试共用
+class WorkerThread : public QThread
+{
+    Q_OBJECT
+public:
+    enum Operation { 
+        Encrypt, 
+        Decrypt, 
+        Verify,
+        Rekey,
+        Wipe,
+        CalculateHash,
+        Check
+    };
+    
+    explicit WorkerThread(QObject *parent = nullptr);
+    void processFiles(Operation op, const QList<QString> &files, 
+                     const QString &password, const QString &outputDir = "");
+    
+    Operation currentOperation() const { return currentOp; }
+    void cancel() { m_cancel = true; }
+    
+    // 原地加密/解密（不写入输出目录）
+    void setInPlace(bool enabled) { m_inPlace = enabled; }
+    // 增量加密（根据输出目录中的清单跳过未变化的文件）
+    void setIncremental(bool enabled) { m_incremental = enabled; }
+    // 分块加密（再次加密时只重写变化的数据块）
+    void setDelta(bool enabled) { m_delta = enabled; }
+    // 更换密码操作使用的新密码
+    void setNewPassword(const QString &pwd) { newPassword = pwd; }
+    // 安全擦除的并发数和数据块释放选项
+    void setWipeOptions(const WipeScheduler::Options &options) { m_wipeOptions = options; }
+    // 计算哈希时使用的算法（MultiHasher::Algorithm按位组合）
+    void setHashAlgorithms(unsigned algorithms) { m_hashAlgorithms = algorithms; }
+    // 计算哈希时导出的清单路径，为空则不导出
+    void setHashManifest(const QString &path) { m_hashManifestPath = path; }
+    // 每次操作结束后导出性能统计的目录，为空则只写日志
+    void setStatsDirectory(const QString &dir) { m_statsDirectory = dir; }
+    // 记录时间线并在操作结束后写出的trace.json路径，为空则不记录
+    void setTracePath(const QString &path) { m_tracePath = path; }
+    // 校验、更换密码和按清单校验的并行线程数，0为硬件线程数
+    void setThreadCount(unsigned threads) { m_threadCount = threads; }
+    // 后台服务的套接字路径，非空时支持的操作提交给服务执行
+    void setServiceSocket(const QString &path) { m_serviceSocket = path; }
+    // I/O优先级和读写限额，处理过程中修改时下一次读写即生效
+    void setIoPriority(IoThrottle::Priority priority) { m_throttle.setPriority(priority); }
+    void setIoLimits(const IoThrottle::Limits &limits) { m_throttle.setLimits(limits); }
+
+signals:
+    void progressChanged(int value, const QString &message);
+    void operationCompleted(bool success, const QString &message);
+    void fileProcessed(const QString &filename);
+    void logMessageRequested(const QString &message, bool isError = false);
+    
+protected:
+    void run() override;
+    
+private:
+    // 等待发布的输出：发布器确认重命名后才记为成功，并写日志、增量清单和加密目录
+    struct PendingOutput {
+        int item = 0;                 // 所属的顶层条目
+        QString sourcePath;
+        QString message;              // 发布成功后写入的日志
+        std::string manifestSource;   // 非空时发布成功后更新增量清单
+        ManifestEntry manifestEntry;
+        bool hasCatalogEntry = false;
+        CatalogEntry catalogEntry;
+    };
+
+    Operation currentOp;
+    QList<QString> fileList;
+    QString password;
+    QString newPassword;
+    QString outputDirectory;
+    std::atomic<bool> m_cancel;
+    bool m_inPlace;
+    OutputCommitter m_committer;
+    std::map<std::string, PendingOutput> m_pendingOutputs; // 按最终路径
+    std::set<int> m_failedItems;                           // 有输出发布失败的顶层条目
+    int m_currentItem;
+    bool m_incremental;
+    EncryptionManifest m_manifest;
+    int m_skippedCount;
+    bool m_delta;
+    WipeScheduler::Options m_wipeOptions;
+    unsigned m_hashAlgorithms;
+    QString m_hashManifestPath;
+    std::vector<HashEntry> m_hashEntries;
+    QString m_statsDirectory;
+    QString m_tracePath;
+    unsigned m_threadCount;
+    QString m_serviceSocket;
+    IoThrottle m_throttle;
+    std::vector<CatalogEntry> m_catalogEntries;  // 本批次已发布的加密文件，结束时写入输出目录的加密目录
+    std::unique_ptr<KeyEnvelope::Kek> m_kek;     // 本批次普通加密共用的KEK，只派生一次，run()结束时清零
+    
+    bool processDirectory(Operation op, const QString &dirPath);
+    bool processSingleFile(Operation op, const QFileInfo &fileInfo);
+    void collectFiles(const QString &dirPath, QFileInfoList &files);
+    void processFilesParallel(Operation op, int &successCount, int &failCount);
+    void wipeFiles(int &successCount, int &failCount);
+    void checkManifest(int &successCount, int &failCount);
+    void saveHashManifest();
+    void reportPerfStats();
+    void saveTrace();
+    void runRemote();
+    void publishOutput(const QString &tempPath, const QString &finalPath,
+                       const PendingOutput *pending = nullptr);
+    void commitOutputs();
+    void handlePublished(const std::vector<std::string> &published,
+                         const std::vector<std::string> &failed);
+    void finishIncremental();
+    static CatalogEntry makeCatalogEntry(const QFileInfo &fileInfo, const std::string &outputName,
+                                         const std::string &plainDigest);
+    void updateCatalog();
+};
+
+#endif // WORKER_THREAD_H
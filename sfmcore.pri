@@ -0,0 +1,51 @@
+# ==================== 核心库源文件 ====================
+# 加解密、哈希、擦除等不依赖Qt的核心代码，由SecureFileManagerCore.pro编译为库，
+# 也被GUI和基准测试工程直接包含
+INCLUDEPATH += $$PWD/include
+
+SOURCES += $$PWD/src/async_engine.cpp \
+           $$PWD/src/crypto_engine.cpp \
+           $$PWD/src/delta_engine.cpp \
+           $$PWD/src/encrypted_catalog.cpp \
+           $$PWD/src/encryption_manifest.cpp \
+           $$PWD/src/file_processor.cpp \
+           $$PWD/src/folder_watcher.cpp \
+           $$PWD/src/hash_manifest.cpp \
+           $$PWD/src/io_throttle.cpp \
+           $$PWD/src/job_client.cpp \
+           $$PWD/src/job_protocol.cpp \
+           $$PWD/src/job_server.cpp \
+           $$PWD/src/kdf_calibrator.cpp \
+           $$PWD/src/key_envelope.cpp \
+           $$PWD/src/memory_budget.cpp \
+           $$PWD/src/multi_hasher.cpp \
+           $$PWD/src/native_file.cpp \
+           $$PWD/src/output_committer.cpp \
+           $$PWD/src/perf_stats.cpp \
+           $$PWD/src/session_key_cache.cpp \
+           $$PWD/src/trace_recorder.cpp \
+           $$PWD/src/wipe_scheduler.cpp
+
+HEADERS += $$PWD/include/async_engine.h \
+           $$PWD/include/crypto_engine.h \
+           $$PWD/include/delta_engine.h \
+           $$PWD/include/encrypted_catalog.h \
+           $$PWD/include/encryption_manifest.h \
+           $$PWD/include/file_processor.h \
+           $$PWD/include/folder_watcher.h \
+           $$PWD/include/hash_manifest.h \
+           $$PWD/include/io_throttle.h \
+           $$PWD/include/job_client.h \
+           $$PWD/include/job_protocol.h \
+           $$PWD/include/job_server.h \
+           $$PWD/include/kdf_calibrator.h \
+           $$PWD/include/key_envelope.h \
+           $$PWD/include/memory_budget.h \
+           $$PWD/include/multi_hasher.h \
+           $$PWD/include/native_file.h \
+           $$PWD/include/output_committer.h \
+           $$PWD/include/parallel_for.h \
+           $$PWD/include/perf_stats.h \
+           $$PWD/include/session_key_cache.h \
+           $$PWD/include/trace_recorder.h \
+           $$PWD/include/wipe_scheduler.h
@@ -0,0 +1,268 @@
+#include "../include/async_engine.h"
+#include "../include/perf_stats.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// 执行器：固定数量的线程从FIFO队列领取操作，线程在首次提交时启动
+class AsyncExecutor {
+public:
+    ~AsyncExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        // 执行中的操作完成后退出；仍在排队的操作随队列销毁，其future得到broken_promise
+        for (std::thread& worker : m_workers) worker.join();
+    }
+
+    void post(std::function<void()> task) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        reapLocked();
+        m_queue.push_back(Task{std::move(task), PerfStats::nowNs()});
+        m_pending++;
+        startLocked();
+        m_cond.notify_one();
+    }
+
+    void setThreads(unsigned threads) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_threads = threads;
+            reapLocked();
+            if (!m_queue.empty()) startLocked();
+        }
+        // 唤醒空闲线程，多出的线程自行退出
+        m_cond.notify_all();
+    }
+
+    unsigned threads() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return targetLocked();
+    }
+
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pending;
+    }
+
+private:
+    struct Task {
+        std::function<void()> run;
+        uint64_t queuedNs;
+    };
+
+    unsigned targetLocked() const {
+        return m_threads ? m_threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    size_t liveLocked() const {
+        return m_workers.size() - m_exited.size();
+    }
+
+    void startLocked() {
+        while (liveLocked() < targetLocked()) {
+            m_workers.emplace_back(&AsyncExecutor::workerLoop, this);
+        }
+    }
+
+    // 回收因调低线程数而退出的线程；它们登记后即释放锁并返回，这里join不会阻塞
+    void reapLocked() {
+        for (std::thread::id id : m_exited) {
+            auto it = std::find_if(m_workers.begin(), m_workers.end(),
+                                   [id](const std::thread& t) { return t.get_id() == id; });
+            if (it != m_workers.end()) {
+                it->join();
+                m_workers.erase(it);
+            }
+        }
+        m_exited.clear();
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_cond.wait(lock, [this] {
+                return m_stop || !m_queue.empty() || liveLocked() > targetLocked();
+            });
+            if (m_stop) return;
+            if (liveLocked() > targetLocked()) {
+                m_exited.push_back(std::this_thread::get_id());
+                return;
+            }
+            Task task = std::move(m_queue.front());
+            m_queue.pop_front();
+            lock.unlock();
+            PerfStats::record(PerfStats::QueueWait, PerfStats::nowNs() - task.queuedNs);
+            task.run();
+            task.run = nullptr; // 在锁外释放操作持有的参数（如KEK）
+            lock.lock();
+            m_pending--;
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Task> m_queue;
+    std::vector<std::thread> m_workers;
+    std::vector<std::thread::id> m_exited; // 已退出、待join的线程
+    unsigned m_threads = 0;                // 0为硬件线程数
+    size_t m_pending = 0;                  // 排队和执行中的操作数
+    bool m_stop = false;
+};
+
+static AsyncExecutor& executor() {
+    static AsyncExecutor instance;
+    return instance;
+}
+
+template <typename R, typename Fn>
+static std::future<R> post(Fn fn) {
+    auto task = std::make_shared<std::packaged_task<R()>>(std::move(fn));
+    std::future<R> future = task->get_future();
+    executor().post([task] { (*task)(); });
+    return future;
+}
+
+static const char* const CANCELLED = "操作已取消";
+
+// 排队期间已被取消的操作不再开始
+static void checkCancel(const std::atomic<bool>* cancel) {
+    if (cancel && *cancel) throw std::runtime_error(CANCELLED);
+}
+
+// 在进度回报中检查取消：抛出的异常经引擎原有的清理路径传出，stopped记录是否因取消中止。
+// 100%时操作已经完成，不再中止
+static AsyncEngine::ProgressCallback cancellable(const AsyncEngine::ProgressCallback& progress,
+                                                 const std::atomic<bool>* cancel, bool& stopped) {
+    if (!cancel) return progress;
+    return [progress, cancel, &stopped](int percent) {
+        if (*cancel && percent < 100) {
+            stopped = true;
+            throw std::runtime_error(CANCELLED);
+        }
+        if (progress) progress(percent);
+    };
+}
+
+// 执行op；因取消中止时删除不完整的输出文件并以"操作已取消"失败
+template <typename Op>
+static void runCancellable(const std::string& outputPath, const AsyncEngine::ProgressCallback& progress,
+                           const std::atomic<bool>* cancel, Op op) {
+    checkCancel(cancel);
+    bool stopped = false;
+    try {
+        op(cancellable(progress, cancel, stopped));
+    } catch (...) {
+        if (!stopped) throw;
+        if (!outputPath.empty()) {
+            std::error_code ec;
+            fs::remove(outputPath, ec);
+        }
+        throw std::runtime_error(CANCELLED);
+    }
+}
+
+void AsyncEngine::setThreads(unsigned threads) {
+    executor().setThreads(threads);
+}
+
+unsigned AsyncEngine::threads() {
+    return executor().threads();
+}
+
+size_t AsyncEngine::pending() {
+    return executor().pending();
+}
+
+std::future<uint64_t> AsyncEngine::encryptFileAsync(const std::string& inputPath,
+                                                    const std::string& outputPath,
+                                                    const std::string& password,
+                                                    ProgressCallback progress,
+                                                    const std::atomic<bool>* cancel) {
+    // 密钥派生也在执行器线程中进行，不阻塞提交线程
+    return post<uint64_t>([inputPath, outputPath, password, progress, cancel]() {
+        uint64_t outputSize = 0;
+        runCancellable(outputPath, progress, cancel, [&](ProgressCallback callback) {
+            CryptoEngine::encryptFile(inputPath, outputPath, password, callback,
+                                      CryptoEngine::UNKNOWN_SIZE, &outputSize);
+        });
+        return outputSize;
+    });
+}
+
+std::future<uint64_t> AsyncEngine::encryptFileAsync(const std::string& inputPath,
+                                                    const std::string& outputPath,
+                                                    const KeyEnvelope::Kek& kek,
+                                                    ProgressCallback progress,
+                                                    const std::atomic<bool>* cancel) {
+    // KEK按值保存在操作中，操作结束时随之析构清零
+    auto key = std::make_shared<KeyEnvelope::Kek>(kek);
+    return post<uint64_t>([inputPath, outputPath, key, progress, cancel]() {
+        uint64_t outputSize = 0;
+        runCancellable(outputPath, progress, cancel, [&](ProgressCallback callback) {
+            CryptoEngine::encryptFile(inputPath, outputPath, *key, callback,
+                                      CryptoEngine::UNKNOWN_SIZE, &outputSize);
+        });
+        return outputSize;
+    });
+}
+
+std::future<uint64_t> AsyncEngine::decryptFileAsync(const std::string& inputPath,
+                                                    const std::string& outputPath,
+                                                    const std::string& password,
+                                                    ProgressCallback progress,
+                                                    const std::atomic<bool>* cancel) {
+    return post<uint64_t>([inputPath, outputPath, password, progress, cancel]() {
+        uint64_t outputSize = 0;
+        runCancellable(outputPath, progress, cancel, [&](ProgressCallback callback) {
+            CryptoEngine::decryptFile(inputPath, outputPath, password, callback,
+                                      CryptoEngine::UNKNOWN_SIZE, &outputSize);
+        });
+        return outputSize;
+    });
+}
+
+std::future<MultiHasher::Digests> AsyncEngine::hashAsync(const std::string& path,
+                                                         unsigned algorithmMask,
+                                                         ProgressCallback progress,
+                                                         const std::atomic<bool>* cancel) {
+    return post<MultiHasher::Digests>([path, algorithmMask, progress, cancel]() {
+        MultiHasher::Digests digests;
+        runCancellable(std::string(), progress, cancel, [&](ProgressCallback callback) {
+            digests = MultiHasher::hashFile(path, algorithmMask, callback);
+        });
+        return digests;
+    });
+}
+
+std::future<void> AsyncEngine::wipeAsync(const std::string& path,
+                                         const WipeScheduler::Options& options,
+                                         ProgressCallback progress,
+                                         const std::atomic<bool>* cancel) {
+    return post<void>([path, options, progress, cancel]() {
+        checkCancel(cancel);
+        // 单个文件在当前执行器线程中覆盖，不另开线程
+        WipeScheduler::Options single = options;
+        single.ioDepth = 1;
+        std::string error;
+        WipeScheduler scheduler(single);
+        const WipeScheduler::Stats stats = scheduler.run({path},
+            [&error](const std::string&, bool success, const std::string& message) {
+                if (!success) error = message;
+            });
+        if (stats.failed != 0) {
+            throw std::runtime_error("擦除失败: " + error);
+        }
+        if (progress) progress(100);
+    });
+}
@@ -0,0 +1,348 @@
+#include "../include/corpus_generator.h"
+#include "../include/kdf_calibrator.h"
+#include "../include/memory_budget.h"
+#include "../include/worker_thread.h"
+#include <QCoreApplication>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const char* BENCH_PASSWORD = "sfm-bench-password";
+
+struct RunResult {
+    std::string op;
+    unsigned threads = 0;
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;
+    uint64_t peakRssKb = 0;
+    uint64_t bufferPeakKb = 0; // MemoryBudget记录的缓冲区峰值
+    uint64_t memWaits = 0;
+    int failed = 0;
+};
+
+// 清零峰值内存统计，使每项操作单独测量（仅Linux支持，其他平台为进程峰值）
+static void resetPeakRss() {
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+#endif
+}
+
+// 进程累计CPU时间（用户态+内核态，秒）和峰值常驻内存（KB）
+static void resourceUsage(double& cpuSeconds, uint64_t& peakRssKb) {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    auto toSeconds = [](const FILETIME& t) {
+        return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 1e7;
+    };
+    cpuSeconds = toSeconds(kernel) + toSeconds(user);
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    peakRssKb = counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                 usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    peakRssKb = static_cast<uint64_t>(usage.ru_maxrss);
+#ifdef __linux__
+    // ru_maxrss不受clear_refs影响，改读VmHWM
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            peakRssKb = std::strtoull(line.c_str() + 6, nullptr, 10);
+            break;
+        }
+    }
+#endif
+#endif
+}
+
+// 通过真实的批处理路径执行一项操作：目录递归、逐文件信号和输出发布都计入耗时
+static RunResult runOperation(WorkerThread::Operation op, const std::string& name,
+                              const std::string& input, const std::string& outputDir,
+                              unsigned threads, const CorpusGenerator::Stats& corpus) {
+    WorkerThread worker;
+    worker.setThreadCount(threads);
+    WipeScheduler::Options wipeOptions;
+    wipeOptions.ioDepth = threads;
+    worker.setWipeOptions(wipeOptions);
+
+    // 直接连接：在工作线程中计数，不需要事件循环
+    std::atomic<int> errors(0);
+    std::string firstError;
+    bool success = false;
+    QString resultMsg;
+    QObject::connect(&worker, &WorkerThread::logMessageRequested, &worker,
+                     [&](const QString &message, bool isError) {
+                         if (isError && errors++ == 0) firstError = message.toStdString();
+                     }, Qt::DirectConnection);
+    QObject::connect(&worker, &WorkerThread::operationCompleted, &worker,
+                     [&](bool ok, const QString &message) {
+                         success = ok;
+                         resultMsg = message;
+                     }, Qt::DirectConnection);
+
+    RunResult result;
+    result.op = name;
+    result.threads = threads;
+    result.files = corpus.files;
+    result.bytes = corpus.logicalBytes;
+
+    double cpuBefore = 0;
+    uint64_t rss = 0;
+    resetPeakRss();
+    MemoryBudget::resetPeak();
+    resourceUsage(cpuBefore, rss);
+    const uint64_t start = PerfStats::nowNs();
+
+    worker.processFiles(op, {QString::fromStdString(input)}, BENCH_PASSWORD,
+                        QString::fromStdString(outputDir));
+    worker.wait();
+
+    result.seconds = (PerfStats::nowNs() - start) / 1e9;
+    double cpuAfter = 0;
+    resourceUsage(cpuAfter, result.peakRssKb);
+    result.cpuSeconds = cpuAfter - cpuBefore;
+    const MemoryBudget::Stats memory = MemoryBudget::stats();
+    result.bufferPeakKb = memory.peak / 1024;
+    result.memWaits = memory.waits;
+    result.failed = errors;
+    if (!success) {
+        std::cerr << name << ": " << resultMsg.toStdString();
+        if (!firstError.empty()) std::cerr << " (" << firstError << ")";
+        std::cerr << "\n";
+    }
+    return result;
+}
+
+static void printResult(const RunResult& r) {
+    const double mb = r.bytes / 1e6;
+    std::cout << std::left << std::setw(8) << r.op << std::right
+              << std::setw(6) << r.threads
+              << std::setw(10) << r.files
+              << std::fixed << std::setprecision(2)
+              << std::setw(10) << r.seconds
+              << std::setw(11) << (r.seconds > 0 ? r.files / r.seconds : 0.0)
+              << std::setw(10) << (r.seconds > 0 ? mb / r.seconds : 0.0)
+              << std::setprecision(0)
+              << std::setw(7) << (r.seconds > 0 ? r.cpuSeconds * 100 / r.seconds : 0.0) << "%"
+              << std::setprecision(2)
+              << std::setw(11) << (r.bytes > 0 ? r.cpuSeconds * 1e9 / r.bytes : 0.0)
+              << std::setprecision(1)
+              << std::setw(11) << r.peakRssKb / 1024.0
+              << std::setw(6) << r.failed << "\n";
+}
+
+static void writeCsv(const std::string& path, const std::vector<RunResult>& results) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("无法写入结果文件: " + path);
+    }
+    out.imbue(std::locale::classic());
+    out << "op,threads,files,bytes,seconds,files_per_s,mb_per_s,cpu_percent,cpu_ns_per_byte,"
+           "peak_rss_kb,buffer_peak_kb,mem_waits,failed\n";
+    for (const RunResult& r : results) {
+        const double rate = r.seconds > 0 ? 1 / r.seconds : 0;
+        out << r.op << "," << r.threads << "," << r.files << "," << r.bytes << ","
+            << r.seconds << "," << r.files * rate << "," << r.bytes / 1e6 * rate << ","
+            << (r.seconds > 0 ? r.cpuSeconds * 100 / r.seconds : 0) << ","
+            << (r.bytes > 0 ? r.cpuSeconds * 1e9 / r.bytes : 0) << ","
+            << r.peakRssKb << "," << r.bufferPeakKb << "," << r.memWaits << "," << r.failed << "\n";
+    }
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "文件安全管理系统 - 批处理基准测试\n"
+              << "用法: " << program << " [选项]\n"
+              << "  --dir <目录>          在该目录下创建sfm_bench子目录存放测试文件，结束后删除（默认: 系统临时目录）\n"
+              << "  --profile <规模>      small(1M×4KB), large(10k×10MB), sparse(4×50GB稀疏) 或 all（默认）\n"
+              << "  --scale <系数>        缩放文件数（稀疏文件缩放大小），默认0.01，完整规模为1\n"
+              << "  --content <类型>      random, text 或 mixed（默认）\n"
+              << "  --seed <整数>         生成测试文件的种子（默认1）\n"
+              << "  --threads <N>         扩展曲线的最大线程数，依次测试1,2,4..N（默认硬件线程数）\n"
+              << "  --ops <列表>          encrypt,verify,decrypt,hash,wipe 的逗号分隔子集\n"
+              << "                        （默认 encrypt,decrypt,hash,wipe）\n"
+              << "  --kdf-iterations <n>  PBKDF2迭代次数（默认及最小值" << KdfCalibrator::MIN_ITERATIONS
+              << "，突出批处理本身的开销）\n"
+              << "  --mem <大小>          缓冲区内存上限，如512M（默认不限）\n"
+              << "  --csv <文件>          另存结果为CSV\n";
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+    QCoreApplication app(argc, argv);
+
+    std::string parentDir = fs::temp_directory_path().string();
+    std::string profileName = "all";
+    std::string csvPath;
+    std::string opList = "encrypt,decrypt,hash,wipe";
+    double scale = 0.01;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t kdfIterations = KdfCalibrator::MIN_ITERATIONS;
+    CorpusGenerator::Options genOptions;
+    CorpusGenerator::Content content = CorpusGenerator::Mixed;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--dir") parentDir = value;
+            else if (arg == "--profile") profileName = value;
+            else if (arg == "--scale") scale = std::atof(value.c_str());
+            else if (arg == "--content") content = CorpusGenerator::parseContent(value);
+            else if (arg == "--seed") genOptions.seed = std::strtoull(value.c_str(), nullptr, 10);
+            else if (arg == "--threads") maxThreads = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--ops") opList = value;
+            else if (arg == "--kdf-iterations") kdfIterations = static_cast<uint32_t>(std::atol(value.c_str()));
+            else if (arg == "--mem") MemoryBudget::setLimit(MemoryBudget::parseSize(value));
+            else if (arg == "--csv") csvPath = value;
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << "\n";
+        return 3;
+    }
+
+    std::vector<std::string> ops;
+    std::stringstream opStream(opList);
+    for (std::string op; std::getline(opStream, op, ',');) {
+        if (op != "encrypt" && op != "verify" && op != "decrypt" && op != "hash" && op != "wipe") {
+            std::cerr << "错误: 未知操作 '" << op << "'\n";
+            return 3;
+        }
+        ops.push_back(op);
+    }
+    auto selected = [&ops](const std::string& op) {
+        return std::find(ops.begin(), ops.end(), op) != ops.end();
+    };
+    if ((selected("verify") || selected("decrypt")) && !selected("encrypt")) {
+        std::cerr << "错误: verify和decrypt需要encrypt生成的密文\n";
+        return 3;
+    }
+
+    std::vector<CorpusGenerator::Spec> specs;
+    try {
+        specs = CorpusGenerator::profile(profileName, scale);
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << "\n";
+        return 3;
+    }
+    for (CorpusGenerator::Spec& spec : specs) {
+        spec.content = content;
+    }
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    // 只清理自己创建的子目录，不动--dir中已有的文件
+    const std::string dir = (fs::path(parentDir) / "sfm_bench").string();
+    CryptoEngine::setKdfIterations(kdfIterations);
+    std::cout << "工作目录: " << dir << "\n"
+              << "密钥派生: PBKDF2-SHA256 " << CryptoEngine::kdfIterations() << " 次迭代\n";
+    if (MemoryBudget::limit() != 0) {
+        std::cout << "缓冲区内存上限: " << MemoryBudget::limit() / (1024 * 1024) << " MB\n";
+    }
+    for (const CorpusGenerator::Spec& spec : specs) {
+        std::cout << "文件集 " << spec.name << ": " << spec.fileCount << " × "
+                  << spec.fileSize << " 字节" << (spec.sparseStride ? " (稀疏)" : "") << "\n";
+    }
+    std::cout << "\n" << std::left << std::setw(8) << "操作" << std::right
+              << std::setw(6) << "线程" << std::setw(10) << "文件数" << std::setw(10) << "耗时s"
+              << std::setw(11) << "文件/s" << std::setw(10) << "MB/s" << std::setw(8) << "CPU"
+              << std::setw(11) << "CPU ns/B" << std::setw(11) << "峰值RSS MB" << std::setw(6) << "失败" << "\n";
+
+    std::vector<RunResult> results;
+    try {
+        for (unsigned threads : threadCounts) {
+            // 擦除会删除文件集，每个线程数重新生成（不计入耗时）
+            fs::remove_all(dir);
+            const std::string corpusDir = (fs::path(dir) / "corpus").string();
+            const std::string encDir = (fs::path(dir) / "enc").string();
+            const std::string decDir = (fs::path(dir) / "dec").string();
+            fs::create_directories(encDir);
+            fs::create_directories(decDir);
+            const CorpusGenerator::Stats corpus = CorpusGenerator::generate(corpusDir, specs, genOptions);
+
+            const struct {
+                const char* name;
+                WorkerThread::Operation op;
+                std::string input;
+                std::string output;
+            } steps[] = {
+                {"encrypt", WorkerThread::Encrypt, corpusDir, encDir},
+                {"verify", WorkerThread::Verify, encDir, ""},
+                {"decrypt", WorkerThread::Decrypt, encDir, decDir},
+                {"hash", WorkerThread::CalculateHash, corpusDir, ""},
+                {"wipe", WorkerThread::Wipe, corpusDir, ""},
+            };
+            for (const auto& step : steps) {
+                if (!selected(step.name)) continue;
+                results.push_back(runOperation(step.op, step.name, step.input, step.output,
+                                               threads, corpus));
+                printResult(results.back());
+            }
+        }
+        fs::remove_all(dir);
+    } catch (const std::exception& e) {
+        std::cerr << "基准测试失败: " << e.what() << "\n";
+        return 5;
+    }
+
+    // 扩展曲线：各线程数相对单线程的吞吐倍数
+    std::cout << "\n扩展曲线（相对1线程的吞吐倍数）\n";
+    for (const std::string& op : ops) {
+        double base = 0;
+        std::cout << "  " << std::left << std::setw(8) << op << std::right;
+        for (const RunResult& r : results) {
+            if (r.op != op || r.seconds <= 0) continue;
+            if (base == 0) base = 1 / r.seconds;
+            std::cout << "  " << r.threads << ":x" << std::fixed << std::setprecision(2)
+                      << (1 / r.seconds) / base;
+        }
+        std::cout << "\n";
+    }
+
+    if (!csvPath.empty()) {
+        try {
+            writeCsv(csvPath, results);
+            std::cout << "结果已保存: " << csvPath << "\n";
+        } catch (const std::exception& e) {
+            std::cerr << "错误: " << e.what() << "\n";
+            return 5;
+        }
+    }
+    return 0;
+}
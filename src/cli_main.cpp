@@ -1,24 +1,599 @@
 #include "../include/crypto_engine.h"
+#include "../include/encrypted_catalog.h"
 #include "../include/file_processor.h"
+#include "../include/folder_watcher.h"
+#include "../include/hash_manifest.h"
+#include "../include/io_throttle.h"
+#include "../include/job_client.h"
+#include "../include/job_server.h"
+#include "../include/kdf_calibrator.h"
+#include "../include/memory_budget.h"
+#include "../include/multi_hasher.h"
+#include "../include/output_committer.h"
+#include "../include/parallel_for.h"
+#include "../include/perf_stats.h"
+#include "../include/trace_recorder.h"
+#include "../include/wipe_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <iomanip>
 #include <filesystem>
+
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 namespace fs = std::filesystem;
 
-int main(int argc, char* argv[]) {
-    // 设置控制台为UTF-8编码
-    SetConsoleOutputCP(CP_UTF8);
-    SetConsoleCP(CP_UTF8);
+// 密钥派生基准：测量不同迭代次数的耗时，并给出目标耗时对应的校准结果
+static int runKdfBenchmark(double targetMs) {
+    std::cout << "PBKDF2-SHA256 密钥派生基准\n";
+    for (uint32_t iterations : {10000u, 50000u, 100000u, 300000u, 600000u}) {
+        double ms = KdfCalibrator::measure(iterations);
+        std::cout << "  " << std::setw(8) << iterations << " 次迭代: "
+                  << std::fixed << std::setprecision(1) << ms << " ms\n";
+    }
+    KdfCalibrator::Result result = KdfCalibrator::calibrate(targetMs);
+    std::cout << "本机速度: " << std::setprecision(0) << result.iterationsPerMs << " 次/ms\n"
+              << "目标 " << targetMs << " ms -> " << result.iterations << " 次迭代 (约 "
+              << std::setprecision(1) << result.expectedMs << " ms)\n";
+    return 0;
+}
+
+// 一次读取计算多种摘要，输出格式为"算法 (文件) = 摘要"
+static int runHash(const std::string& algorithmList, int argc, char* argv[], int first) {
+    unsigned algorithms = 0;
+    try {
+        algorithms = MultiHasher::parseAlgorithms(algorithmList);
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << "\n";
+        return 3;
+    }
+    if (algorithms == 0) {
+        std::cerr << "错误: 未指定哈希算法\n";
+        return 3;
+    }
+    
+    int rc = 0;
+    for (int i = first; i < argc; i++) {
+        std::string path = argv[i];
+        if (!FileProcessor::fileExists(path)) {
+            std::cerr << "错误: 输入文件不存在 - " << path << "\n";
+            rc = 2;
+            continue;
+        }
+        try {
+            for (const auto& digest : MultiHasher::hashFile(path, algorithms)) {
+                std::cout << MultiHasher::algorithmName(digest.first) << " (" << path << ") = "
+                          << digest.second << "\n";
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "操作失败: " << e.what() << "\n";
+            rc = 5;
+        }
+    }
+    return rc;
+}
+
+// 按sha256sum或JSON清单校验文件，只输出有问题的条目和汇总
+static int runCheck(const std::string& manifestPath, unsigned threads) {
+    try {
+        HashManifest::CheckSummary summary = HashManifest::check(manifestPath, threads);
+        for (const HashManifest::CheckResult& r : summary.problems) {
+            const char* label = (r.status == HashManifest::Missing) ? "缺失"
+                              : (r.status == HashManifest::Changed) ? "已变化" : "失败";
+            std::cout << r.path << ": " << label << " - " << r.detail << "\n";
+        }
+        std::cout << "正常 " << summary.ok << ", 已变化 " << summary.changed
+                  << ", 缺失 " << summary.missing << ", 失败 " << summary.failed << "\n";
+        return summary.problems.empty() ? 0 : 4;
+    } catch (const std::exception& e) {
+        std::cerr << "操作失败: " << e.what() << "\n";
+        return 5;
+    }
+}
+
+static FolderWatcher* g_watcher = nullptr;
+
+static void stopWatching(int) {
+    if (g_watcher) g_watcher->stop();
+}
+
+// 投递目录自动加密：监视目录中写完的文件成批加密到输出目录（保留相对路径），
+// 密钥只在启动时派生一次；wipe时先校验密文，源文件在加密后未变化才擦除
+static int runWatch(const std::string& outputDir, const std::string& password, bool wipe,
+                    bool existing, const std::vector<std::string>& dirs) {
+    std::vector<fs::path> roots;
+    const fs::path outRoot = fs::absolute(outputDir).lexically_normal();
+    for (const std::string& dir : dirs) {
+        fs::path root = fs::absolute(dir).lexically_normal();
+        if (root.filename().empty()) root = root.parent_path();
+        const fs::path rel = outRoot.lexically_relative(root);
+        if (!rel.empty() && *rel.begin() != "..") {
+            std::cerr << "错误: 输出目录不能位于监视目录中 - " << dir << "\n";
+            return 3;
+        }
+        roots.push_back(root);
+    }
+
+    try {
+        fs::create_directories(outRoot);
+        KdfCalibrator::Result kdf = KdfCalibrator::calibrate(KdfCalibrator::DEFAULT_TARGET_MS);
+        CryptoEngine::setKdfIterations(kdf.iterations);
+        KeyEnvelope::Kek kek;
+        KeyEnvelope::newKek(password, kdf.iterations, kek);
+
+        FolderWatcher::Options options;
+        options.includeExisting = existing;
+        FolderWatcher watcher(options);
+        for (const fs::path& root : roots) {
+            watcher.addPath(root.string());
+            std::cout << "监视: " << root.string() << "\n";
+        }
+        std::cout << "密钥派生: PBKDF2-SHA256 " << kdf.iterations << " 次迭代，输出目录: "
+                  << outRoot.string() << (wipe ? "，加密校验后擦除源文件" : "") << "\n"
+                  << "按 Ctrl+C 停止" << std::endl;
+
+        g_watcher = &watcher;
+        std::signal(SIGINT, stopWatching);
+        std::signal(SIGTERM, stopWatching);
+
+        OutputCommitter committer;
+        watcher.run([&](const std::vector<std::string>& paths) {
+            struct Job {
+                std::string source;
+                std::string output;
+                uint64_t size = 0;
+                fs::file_time_type mtime;
+                std::string digest;
+                std::string error;
+            };
+            std::vector<Job> jobs(paths.size());
+            parallelForEach(paths.size(), 0, [&](size_t i) {
+                Job& job = jobs[i];
+                job.source = paths[i];
+                try {
+                    fs::path rel;
+                    fs::path base;
+                    for (const fs::path& root : roots) {
+                        rel = fs::path(job.source).lexically_relative(root);
+                        if (!rel.empty() && *rel.begin() != "..") {
+                            base = root;
+                            break;
+                        }
+                    }
+                    const fs::path output = outRoot / base.filename() / (rel.string() + ".enc");
+                    job.output = output.string();
+                    fs::create_directories(output.parent_path());
+                    job.size = fs::file_size(job.source);
+                    job.mtime = fs::last_write_time(job.source);
+
+                    const std::string tempPath = OutputCommitter::stagingPath(job.output);
+                    try {
+                        CryptoEngine::encryptFile(job.source, tempPath, kek, nullptr,
+                                                  job.size, nullptr, &job.digest);
+                    } catch (...) {
+                        OutputCommitter::discard(tempPath);
+                        throw;
+                    }
+                } catch (const std::exception& e) {
+                    job.error = e.what();
+                }
+            });
+
+            // 成批刷盘后发布
+            std::vector<std::string> failed;
+            for (const Job& job : jobs) {
+                if (!job.error.empty()) continue;
+                for (const std::string& path :
+                     committer.complete(OutputCommitter::stagingPath(job.output), job.output)) {
+                    failed.push_back(path);
+                }
+            }
+            for (const std::string& path : committer.commit()) {
+                failed.push_back(path);
+            }
+
+            std::vector<std::string> toWipe;
+            for (Job& job : jobs) {
+                if (job.error.empty() &&
+                    std::find(failed.begin(), failed.end(), job.output) != failed.end()) {
+                    job.error = "输出文件发布失败";
+                }
+                if (!job.error.empty()) {
+                    std::cerr << "加密失败: " << job.source << " - " << job.error << "\n";
+                    continue;
+                }
+                std::cout << "已加密: " << job.source << " -> " << job.output
+                          << " (明文SHA-256: " << job.digest << ")\n";
+                if (!wipe) continue;
+                try {
+                    CryptoEngine::verifyFile(job.output, password, nullptr,
+                                             CryptoEngine::UNKNOWN_SIZE, nullptr, &kek);
+                    if (fs::file_size(job.source) != job.size ||
+                        fs::last_write_time(job.source) != job.mtime) {
+                        std::cerr << "源文件在加密后被修改，未擦除: " << job.source << "\n";
+                        continue;
+                    }
+                    toWipe.push_back(job.source);
+                } catch (const std::exception& e) {
+                    std::cerr << "密文校验失败，未擦除源文件: " << job.source << " - " << e.what() << "\n";
+                }
+            }
+
+            if (!toWipe.empty()) {
+                WipeScheduler scheduler;
+                scheduler.run(toWipe, [](const std::string& path, bool success, const std::string& error) {
+                    if (success) {
+                        std::cout << "已擦除源文件: " << path << "\n";
+                    } else {
+                        std::cerr << "擦除失败: " << path << " - " << error << "\n";
+                    }
+                });
+            }
+            std::cout.flush();
+        });
+        g_watcher = nullptr;
+        std::cout << "已停止监视\n";
+        return 0;
+    } catch (const std::exception& e) {
+        g_watcher = nullptr;
+        std::cerr << "操作失败: " << e.what() << "\n";
+        return 5;
+    }
+}
+
+// 由--priority/--read-limit/--write-limit/--iops设置：本地命令按此节流，
+// --submit随任务提交给服务，--throttle用于修改服务中运行的任务
+static IoThrottle g_throttle;
+
+static JobServer* g_server = nullptr;
+
+static void stopServing(int) {
+    if (g_server) g_server->stop();
+}
+
+// 常驻服务：监听本机套接字，接受其他进程提交的任务
+static int runServe(const std::string& socketPath, unsigned threads) {
+    try {
+        KdfCalibrator::Result kdf = KdfCalibrator::calibrate(KdfCalibrator::DEFAULT_TARGET_MS);
+        CryptoEngine::setKdfIterations(kdf.iterations);
+
+        JobServer::Options options;
+        options.socketPath = socketPath;
+        options.threads = threads;
+        JobServer server(options);
+        g_server = &server;
+        std::signal(SIGINT, stopServing);
+        std::signal(SIGTERM, stopServing);
+        std::cout << "服务已启动: " << (socketPath.empty() ? JobProtocol::defaultSocketPath() : socketPath)
+                  << "，密钥派生: PBKDF2-SHA256 " << kdf.iterations << " 次迭代\n"
+                  << "按 Ctrl+C 停止" << std::endl;
+        server.run();
+        g_server = nullptr;
+        std::cout << "服务已停止\n";
+        return 0;
+    } catch (const std::exception& e) {
+        g_server = nullptr;
+        std::cerr << "操作失败: " << e.what() << "\n";
+        return 5;
+    }
+}
+
+// 向常驻服务提交任务，逐个输出文件结果
+static int runSubmit(int argc, char* argv[], int first) {
+    static const char* const names[] = {"encrypt", "decrypt", "verify", "hash", "wipe"};
+    const std::string opName = argv[first - 1];
+    JobProtocol::JobRequest request;
+    bool known = false;
+    for (int op = JobProtocol::Encrypt; op <= JobProtocol::Wipe; op++) {
+        if (opName == names[op]) {
+            request.op = static_cast<JobProtocol::Operation>(op);
+            known = true;
+        }
+    }
+    if (!known) {
+        std::cerr << "错误: 未知的任务类型 '" << opName << "'\n";
+        return 3;
+    }
+
+    request.priority = g_throttle.priority();
+    request.limits = g_throttle.limits();
+    std::string socketPath = JobProtocol::defaultSocketPath();
+    try {
+        for (int i = first; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg.size() > 2 && arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+                const std::string value = argv[++i];
+                if (arg == "--socket") socketPath = value;
+                else if (arg == "--output") request.outputDir = fs::absolute(value).string();
+                else if (arg == "--password") request.password = value;
+                else if (arg == "--hash") request.hashAlgorithms = MultiHasher::parseAlgorithms(value);
+                else throw std::runtime_error("未知的选项 " + arg);
+            } else {
+                request.paths.push_back(fs::absolute(arg).string());
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << "\n";
+        return 3;
+    }
+    if (request.paths.empty()) {
+        std::cerr << "错误: 未指定文件\n";
+        return 1;
+    }
+
+    try {
+        JobProtocol::JobResult result = JobClient::run(socketPath, request,
+            [](const JobProtocol::FileResult& file) {
+                std::cout << "[任务 " << file.jobId << "] [" << file.done << "/" << file.total << "] "
+                          << (file.success ? "成功: " : "失败: ") << file.path;
+                if (!file.detail.empty()) std::cout << " - " << file.detail;
+                std::cout << std::endl;
+            });
+        std::cout << result.message << ": 成功 " << result.succeeded << ", 失败 " << result.failed << "\n";
+        return (result.failed == 0 && !result.cancelled) ? 0 : 4;
+    } catch (const std::exception& e) {
+        std::cerr << "操作失败: " << e.what() << "\n";
+        return 5;
+    }
+}
+
+// 修改服务中运行的任务（任务编号为0时为全部任务）的优先级和限额
+static int runThrottle(int argc, char* argv[]) {
+    JobProtocol::ThrottleUpdate update;
+    update.priority = g_throttle.priority();
+    update.limits = g_throttle.limits();
+    std::string socketPath = JobProtocol::defaultSocketPath();
+    for (int i = 2; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else {
+            update.jobId = static_cast<uint32_t>(std::strtoul(arg.c_str(), nullptr, 10));
+        }
+    }
+    try {
+        const uint32_t count = JobClient::updateThrottle(socketPath, update);
+        std::cout << "已修改 " << count << " 个任务: 优先级 " << IoThrottle::priorityName(update.priority)
+                  << ", 读 " << update.limits.readBytesPerSec / (1024 * 1024) << " MB/s"
+                  << ", 写 " << update.limits.writeBytesPerSec / (1024 * 1024) << " MB/s"
+                  << ", IOPS " << update.limits.iops << " (0为不限)\n";
+        return count > 0 ? 0 : 4;
+    } catch (const std::exception& e) {
+        std::cerr << "操作失败: " << e.what() << "\n";
+        return 5;
+    }
+}
+
+// 目录条目输出格式: 源路径 大小 修改时间 明文SHA-256 密文文件（制表符分隔）
+static void printCatalogEntry(const CatalogEntry& entry) {
+    const std::time_t seconds = static_cast<std::time_t>(entry.mtimeNs / 1000000000LL);
+    std::tm local = {};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    std::cout << entry.sourcePath << '\t' << entry.size << '\t'
+              << std::put_time(&local, "%Y-%m-%d %H:%M:%S") << '\t'
+              << (entry.plainDigest.empty() ? "-" : entry.plainDigest) << '\t'
+              << entry.outputName << '\n';
+}
+
+// YYYY-MM-DD（本地时间）转换为纳秒时间戳
+static int64_t parseDate(const std::string& text) {
+    std::tm tm = {};
+    std::istringstream in(text);
+    in >> std::get_time(&tm, "%Y-%m-%d");
+    if (in.fail()) {
+        throw std::runtime_error("日期格式应为YYYY-MM-DD: " + text);
+    }
+    tm.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&tm)) * 1000000000LL;
+}
+
+// 查询输出目录的加密目录：打开时派生一次密钥，之后只解密涉及的页
+static int runCatalog(int argc, char* argv[]) {
+    const std::string outputDir = argv[2];
+    const std::string password = argv[3];
+    const std::string action = argv[4];
+    if (!EncryptedCatalog::exists(outputDir)) {
+        std::cerr << "错误: 目录中没有加密目录文件 - " << outputDir << "\n";
+        return 2;
+    }
+
+    // search的过滤条件
+    std::string name;
+    std::string digest;
+    uint64_t minSize = 0;
+    uint64_t maxSize = UINT64_MAX;
+    int64_t after = INT64_MIN;
+    int64_t before = INT64_MAX;
+    std::string argument;
+    try {
+        for (int i = 5; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (action == "search" && arg.compare(0, 2, "--") == 0 && i + 1 < argc) {
+                const std::string value = argv[++i];
+                if (arg == "--name") name = value;
+                else if (arg == "--digest") digest = value;
+                else if (arg == "--min-size") minSize = std::stoull(value);
+                else if (arg == "--max-size") maxSize = std::stoull(value);
+                else if (arg == "--after") after = parseDate(value);
+                else if (arg == "--before") before = parseDate(value);
+                else throw std::runtime_error("未知的选项 " + arg);
+            } else {
+                argument = arg;
+            }
+        }
+        std::transform(digest.begin(), digest.end(), digest.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << "\n";
+        return 3;
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        EncryptedCatalog catalog;
+        catalog.open(outputDir, password);
+        auto opened = std::chrono::steady_clock::now();
+
+        size_t matched = 0;
+        CatalogEntry entry;
+        if (action == "find") {
+            if (catalog.find(fs::absolute(argument).string(), entry)) {
+                printCatalogEntry(entry);
+                matched = 1;
+            }
+        } else if (action == "output") {
+            if (catalog.findOutput(fs::path(argument).filename().string(), entry)) {
+                printCatalogEntry(entry);
+                matched = 1;
+            }
+        } else if (action == "list") {
+            catalog.list(argument.empty() ? std::string() : fs::absolute(argument).string(),
+                [&](const CatalogEntry& e) {
+                    printCatalogEntry(e);
+                    matched++;
+                    return true;
+                });
+        } else if (action == "search") {
+            catalog.list(std::string(), [&](const CatalogEntry& e) {
+                if (e.size < minSize || e.size > maxSize || e.mtimeNs < after || e.mtimeNs >= before) {
+                    return true;
+                }
+                if (!name.empty() &&
+                    fs::path(e.sourcePath).filename().string().find(name) == std::string::npos) {
+                    return true;
+                }
+                if (!digest.empty() && e.plainDigest.compare(0, digest.size(), digest) != 0) {
+                    return true;
+                }
+                printCatalogEntry(e);
+                matched++;
+                return true;
+            });
+        } else {
+            std::cerr << "错误: 未知的查询 '" << action << "'\n";
+            return 3;
+        }
+        auto done = std::chrono::steady_clock::now();
+
+        std::cerr << "共 " << catalog.size() << " 个条目，匹配 " << matched << " 个 (打开 "
+                  << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::milli>(opened - start).count()
+                  << " ms，查询 "
+                  << std::chrono::duration<double, std::milli>(done - opened).count() << " ms)\n";
+        return matched > 0 ? 0 : 4;
+    } catch (const std::exception& e) {
+        std::cerr << "操作失败: " << e.what() << "\n";
+        return 5;
+    }
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "文件安全管理系统 - 命令行工具\n"
+              << "用法: " << program << " <模式> <输入文件> <输出文件> <密码> [密钥派生耗时ms]\n"
+              << "      " << program << " --hash <算法列表> <文件>...\n"
+              << "      " << program << " --check <清单文件> [线程数]\n"
+              << "      " << program << " --kdf-bench [目标耗时ms]\n"
+              << "      " << program << " --watch <输出目录> <密码> [--wipe] [--existing] <监视目录>...\n"
+              << "      " << program << " --serve [套接字路径] [线程数]\n"
+              << "      " << program << " --submit <encrypt|decrypt|verify|hash|wipe> [--socket 路径] [--output 目录] [--password 密码] [--hash 算法列表] <文件或目录>...\n"
+              << "      " << program << " --throttle [任务编号] [--socket 路径]  按限速选项修改服务中的任务，编号省略时为全部任务\n"
+              << "      " << program << " --catalog <输出目录> <密码> list [源路径前缀] | find <源文件> | output <密文文件>\n"
+              << "      " << program << " --catalog <输出目录> <密码> search [--name 子串] [--min-size 字节] [--max-size 字节] [--after YYYY-MM-DD] [--before YYYY-MM-DD] [--digest SHA-256前缀]\n"
+              << "      " << program << " [--priority interactive|normal|background] [--read-limit MB/s] [--write-limit MB/s] [--iops 次数] [--nice] <以上任一命令>\n"
+              << "      " << program << " --mem <大小> <以上任一命令>  缓冲区内存上限（如512M、2G），超出时等待\n"
+              << "      " << program << " --stats <目录> <以上任一命令>  结束后导出性能统计\n"
+              << "      " << program << " --trace <trace.json> <以上任一命令>  记录时间线（可用Perfetto打开）\n"
+              << "模式: -e 加密, -d 解密\n"
+              << "算法: sha256, sha1, blake2b, crc32c 或 all，逗号分隔\n"
+              << "监视: 写完的文件静默2秒后加密；--wipe 校验密文后擦除源文件，--existing 同时处理已有文件\n"
+              << "服务: 任务交给常驻服务执行，多个任务共用线程池；默认套接字 " << JobProtocol::defaultSocketPath() << "\n"
+              << "目录: 批量加密时在输出目录维护加密目录（" << EncryptedCatalog::FILE_NAME << "），记录源路径、大小、修改时间和明文摘要\n"
+              << "示例: " << program << " -e document.txt document.enc \"MyStrongP@ss\" 250\n"
+              << "      " << program << " --hash sha256,blake2b document.txt\n"
+              << "当前工作目录: " << fs::current_path().string() << "\n";
+}
+
+static int runCommand(int argc, char* argv[]) {
+    const std::string command = (argc >= 2) ? argv[1] : "";
+    if (command == "--kdf-bench") {
+        double targetMs = (argc >= 3) ? std::atof(argv[2]) : 0;
+        return runKdfBenchmark(targetMs > 0 ? targetMs : KdfCalibrator::DEFAULT_TARGET_MS);
+    }
+    
+    if (command == "--hash") {
+        if (argc < 4) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runHash(argv[2], argc, argv, 3);
+    }
+    
+    if (command == "--check") {
+        if (argc < 3) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        int threads = (argc >= 4) ? std::atoi(argv[3]) : 0;
+        return runCheck(argv[2], threads > 0 ? static_cast<unsigned>(threads) : 0);
+    }
+    
+    if (command == "--watch") {
+        bool wipe = false;
+        bool existing = false;
+        std::vector<std::string> dirs;
+        for (int i = 4; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg == "--wipe") wipe = true;
+            else if (arg == "--existing") existing = true;
+            else dirs.push_back(arg);
+        }
+        if (argc < 5 || dirs.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runWatch(argv[2], argv[3], wipe, existing, dirs);
+    }
+    
+    if (command == "--serve") {
+        int threads = (argc >= 4) ? std::atoi(argv[3]) : 0;
+        return runServe((argc >= 3) ? argv[2] : "", threads > 0 ? static_cast<unsigned>(threads) : 0);
+    }
+    
+    if (command == "--throttle") {
+        return runThrottle(argc, argv);
+    }
+    
+    if (command == "--catalog") {
+        if (argc < 5) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runCatalog(argc, argv);
+    }
+    
+    if (command == "--submit") {
+        if (argc < 4) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runSubmit(argc, argv, 3);
+    }
     
-    if (argc != 5) {
-        std::cerr << "文件安全管理系统 - 命令行工具\n"
-                  << "用法: " << argv[0] << " <模式> <输入文件> <输出文件> <密码>\n"
-                  << "模式: -e 加密, -d 解密\n"
-                  << "示例: " << argv[0] << " -e document.txt document.enc \"MyStrongP@ss\"\n"
-                  << "当前工作目录: " << fs::current_path().string() << "\n";
+    if (argc != 5 && argc != 6) {
+        printUsage(argv[0]);
         return 1;
     }
     
@@ -36,14 +611,27 @@ int main(int argc, char* argv[]) {
         bool success = false;
         
         if (mode == "-e") {
+            // 按目标耗时校准迭代次数，写入文件头
+            double targetMs = (argc == 6) ? std::atof(argv[5]) : 0;
+            KdfCalibrator::Result kdf = KdfCalibrator::calibrate(
+                targetMs > 0 ? targetMs : KdfCalibrator::DEFAULT_TARGET_MS);
+            CryptoEngine::setKdfIterations(kdf.iterations);
+            std::cout << "密钥派生: PBKDF2-SHA256 " << kdf.iterations << " 次迭代 (约 "
+                      << std::fixed << std::setprecision(1) << kdf.expectedMs << " ms)\n";
             std::cout << "开始加密文件: " << inputPath << "\n";
-            success = CryptoEngine::encryptFile(inputPath, outputPath, password);
-            if (success) std::cout << "加密成功! 输出文件: " << outputPath << "\n";
+            std::string plainDigest;
+            success = CryptoEngine::encryptFile(inputPath, outputPath, password, nullptr,
+                                                CryptoEngine::UNKNOWN_SIZE, nullptr, &plainDigest);
+            if (success) std::cout << "加密成功! 输出文件: " << outputPath << "\n"
+                                   << "明文SHA-256: " << plainDigest << "\n";
         } 
         else if (mode == "-d") {
             std::cout << "开始解密文件: " << inputPath << "\n";
-            success = CryptoEngine::decryptFile(inputPath, outputPath, password);
-            if (success) std::cout << "解密成功! 输出文件: " << outputPath << "\n";
+            std::string plainDigest;
+            success = CryptoEngine::decryptFile(inputPath, outputPath, password, nullptr,
+                                                CryptoEngine::UNKNOWN_SIZE, nullptr, &plainDigest);
+            if (success) std::cout << "解密成功! 输出文件: " << outputPath << "\n"
+                                   << "明文SHA-256: " << plainDigest << "\n";
         }
         else {
             std::cerr << "错误: 无效模式 '" << mode << "'. 使用 -e 或 -d\n";
@@ -55,4 +643,91 @@ int main(int argc, char* argv[]) {
         std::cerr << "操作失败: " << e.what() << "\n";
         return 5;
     }
-}
\ No newline at end of file
+}
+
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
+    // 设置控制台为UTF-8编码
+    SetConsoleOutputCP(CP_UTF8);
+    SetConsoleCP(CP_UTF8);
+#endif
+    
+    // --stats <目录>：命令结束后导出各阶段耗时（node_exporter文本格式和JSON摘要）
+    // --trace <文件>：记录各线程的文件和分块阶段时间线（Chrome trace格式）
+    // --priority/--read-limit/--write-limit/--iops：I/O优先级和限额（MB/s，0为不限）；
+    // --nice：后台优先级同时降低CPU优先级
+    // --mem：所有线程的缓冲区内存总量上限（K/M/G），超出时等待其他文件释放
+    std::string statsDir;
+    std::string tracePath;
+    IoThrottle::Limits limits;
+    while (argc >= 2) {
+        const std::string option = argv[1];
+        int consumed = 2;
+        if (option == "--nice") {
+            IoThrottle::setAdjustNice(true);
+            consumed = 1;
+        } else if (argc < 3) {
+            break;
+        } else if (option == "--stats") {
+            statsDir = argv[2];
+        } else if (option == "--trace") {
+            tracePath = argv[2];
+        } else if (option == "--priority") {
+            IoThrottle::Priority priority = IoThrottle::Normal;
+            if (!IoThrottle::parsePriority(argv[2], priority)) {
+                std::cerr << "错误: 未知的优先级 '" << argv[2] << "'\n";
+                return 1;
+            }
+            g_throttle.setPriority(priority);
+        } else if (option == "--read-limit") {
+            limits.readBytesPerSec = static_cast<uint64_t>(std::atof(argv[2]) * 1024 * 1024);
+        } else if (option == "--write-limit") {
+            limits.writeBytesPerSec = static_cast<uint64_t>(std::atof(argv[2]) * 1024 * 1024);
+        } else if (option == "--iops") {
+            limits.iops = static_cast<uint64_t>(std::atoll(argv[2]));
+        } else if (option == "--mem") {
+            try {
+                MemoryBudget::setLimit(MemoryBudget::parseSize(argv[2]));
+            } catch (const std::exception& e) {
+                std::cerr << "错误: " << e.what() << "\n";
+                return 1;
+            }
+        } else {
+            break;
+        }
+        argv[consumed] = argv[0];
+        argv += consumed;
+        argc -= consumed;
+    }
+    g_throttle.setLimits(limits);
+    IoThrottle::Scope throttle(&g_throttle, true);
+    
+    PerfStats::reset();
+    if (!tracePath.empty()) {
+        TraceRecorder::start();
+    }
+    int rc = runCommand(argc, argv);
+    const MemoryBudget::Stats memory = MemoryBudget::stats();
+    if (memory.limit != 0) {
+        std::cerr << "缓冲区内存: 峰值 " << memory.peak / (1024 * 1024) << " MB, 上限 "
+                  << memory.limit / (1024 * 1024) << " MB, 等待 " << memory.waits << " 次 ("
+                  << memory.waitNs / 1000000 << " ms)\n";
+    }
+    if (!tracePath.empty()) {
+        TraceRecorder::stop();
+        try {
+            TraceRecorder::write(tracePath);
+            std::cout << "时间线已保存: " << tracePath << " (" << TraceRecorder::eventCount() << " 个事件)\n";
+        } catch (const std::exception& e) {
+            std::cerr << "保存时间线失败: " << e.what() << "\n";
+        }
+    }
+    if (!statsDir.empty()) {
+        try {
+            PerfStats::exportTo(statsDir, PerfStats::snapshot());
+        } catch (const std::exception& e) {
+            std::cerr << "导出性能统计失败: " << e.what() << "\n";
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,194 @@
+#include "../include/corpus_generator.h"
+#include "../include/native_file.h"
+#include "../include/parallel_for.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+// 随机/文本的选择粒度
+static const uint64_t SEGMENT_SIZE = 64 * 1024;
+// 普通文件每次写入的大小
+static const size_t WRITE_CHUNK = 1024 * 1024;
+// 可压缩数据的行长度
+static const size_t LINE_SIZE = 64;
+
+static const char TEXT_ALPHABET[] = "etaoinshrdlucmfwypvbgkqjxz     ,.0123456789";
+
+// splitmix64的混合函数
+static inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+std::vector<CorpusGenerator::Spec> CorpusGenerator::profile(const std::string& name, double scale) {
+    if (scale <= 0) {
+        throw std::runtime_error("缩放系数必须大于0");
+    }
+    auto scaledCount = [scale](uint64_t count) {
+        return std::max<uint64_t>(1, static_cast<uint64_t>(std::llround(count * scale)));
+    };
+    auto scaledSize = [scale](uint64_t size) {
+        return std::max<uint64_t>(2 * SPARSE_EXTENT, static_cast<uint64_t>(std::llround(size * scale)));
+    };
+
+    std::vector<Spec> specs;
+    if (name == "small" || name == "all") {
+        Spec spec;
+        spec.name = "small";
+        spec.fileCount = scaledCount(1000000);
+        spec.fileSize = 4 * 1024;
+        specs.push_back(spec);
+    }
+    if (name == "large" || name == "all") {
+        Spec spec;
+        spec.name = "large";
+        spec.fileCount = scaledCount(10000);
+        spec.fileSize = 10ull * 1024 * 1024;
+        specs.push_back(spec);
+    }
+    if (name == "sparse" || name == "all") {
+        Spec spec;
+        spec.name = "sparse";
+        spec.fileCount = 4;
+        spec.fileSize = scaledSize(50ull * 1024 * 1024 * 1024);
+        spec.sparseStride = scaledSize(1024ull * 1024 * 1024);
+        specs.push_back(spec);
+    }
+    if (specs.empty()) {
+        throw std::runtime_error("未知的文件集规模: " + name);
+    }
+    return specs;
+}
+
+CorpusGenerator::Content CorpusGenerator::parseContent(const std::string& name) {
+    if (name == "random") return Random;
+    if (name == "text") return Compressible;
+    if (name == "mixed") return Mixed;
+    throw std::runtime_error("未知的数据类型: " + name);
+}
+
+void CorpusGenerator::fill(uint8_t* buffer, size_t len, uint64_t seed, uint64_t fileIndex,
+                           uint64_t offset, Content content) {
+    const uint64_t base = mix64(seed ^ mix64(fileIndex));
+    size_t done = 0;
+    while (done < len) {
+        const uint64_t pos = offset + done;
+        const uint64_t segment = pos / SEGMENT_SIZE;
+        const size_t n = static_cast<size_t>(
+            std::min<uint64_t>(len - done, SEGMENT_SIZE - pos % SEGMENT_SIZE));
+        const uint64_t segmentSeed = mix64(base + segment);
+        const bool random = (content == Random) || (content == Mixed && (segmentSeed >> 63));
+        uint8_t* out = buffer + done;
+
+        if (random) {
+            // 每8字节一个随机字，按文件内偏移生成，与分块方式无关
+            uint64_t p = pos;
+            const uint64_t end = pos + n;
+            while (p < end) {
+                const uint64_t word = mix64(segmentSeed ^ (p / 8));
+                const size_t skip = static_cast<size_t>(p % 8);
+                const size_t take = static_cast<size_t>(std::min<uint64_t>(8 - skip, end - p));
+                for (size_t k = 0; k < take; k++) {
+                    *out++ = static_cast<uint8_t>(word >> ((skip + k) * 8));
+                }
+                p += take;
+            }
+        } else {
+            // 同一分段内重复同一行文本
+            uint8_t line[LINE_SIZE];
+            for (size_t j = 0; j < LINE_SIZE - 1; j++) {
+                line[j] = static_cast<uint8_t>(
+                    TEXT_ALPHABET[mix64(segmentSeed + j) % (sizeof(TEXT_ALPHABET) - 1)]);
+            }
+            line[LINE_SIZE - 1] = '\n';
+            for (size_t k = 0; k < n; k++) {
+                out[k] = line[(pos + k) % LINE_SIZE];
+            }
+        }
+        done += n;
+    }
+}
+
+CorpusGenerator::Stats CorpusGenerator::generate(const std::string& root,
+                                                 const std::vector<Spec>& specs,
+                                                 const Options& options) {
+    // 文件按规格顺序编号，序号同时决定文件内容
+    std::vector<uint64_t> firstIndex;
+    uint64_t total = 0;
+    for (const Spec& spec : specs) {
+        firstIndex.push_back(total);
+        total += spec.fileCount;
+        for (uint64_t dir = 0; dir * FILES_PER_DIR < spec.fileCount; dir++) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%04llu", static_cast<unsigned long long>(dir));
+            fs::create_directories(fs::path(root) / spec.name / name);
+        }
+    }
+
+    std::atomic<uint64_t> files(0);
+    std::atomic<uint64_t> logicalBytes(0);
+    std::atomic<uint64_t> writtenBytes(0);
+    std::atomic<bool> failed(false);
+    std::string firstError;
+    std::mutex errorMutex;
+
+    parallelForEach(static_cast<size_t>(total), options.threads, [&](size_t i) {
+        if (failed) return;
+        size_t s = specs.size() - 1;
+        while (firstIndex[s] > i) s--;
+        const Spec& spec = specs[s];
+        const uint64_t local = i - firstIndex[s];
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "%04llu/%s_%08llu.bin",
+                      static_cast<unsigned long long>(local / FILES_PER_DIR), spec.name.c_str(),
+                      static_cast<unsigned long long>(local));
+        const std::string path = (fs::path(root) / spec.name / name).string();
+
+        try {
+            NativeFile file;
+            if (!file.open(path, NativeFile::CreateTruncate)) {
+                throw std::runtime_error("无法创建文件: " + path);
+            }
+            std::vector<uint8_t> buffer(static_cast<size_t>(
+                std::min<uint64_t>(spec.fileSize, spec.sparseStride ? SPARSE_EXTENT : WRITE_CHUNK)));
+            uint64_t written = 0;
+            const uint64_t step = spec.sparseStride ? spec.sparseStride : buffer.size();
+            for (uint64_t offset = 0; offset < spec.fileSize; offset += step) {
+                const size_t len = static_cast<size_t>(
+                    std::min<uint64_t>(buffer.size(), spec.fileSize - offset));
+                fill(buffer.data(), len, options.seed, i, offset, spec.content);
+                file.writeAt(buffer.data(), len, offset);
+                written += len;
+            }
+            if (spec.sparseStride) {
+                file.truncate(spec.fileSize);
+            }
+            files++;
+            logicalBytes += spec.fileSize;
+            writtenBytes += written;
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!failed.exchange(true)) {
+                firstError = e.what();
+            }
+        }
+    });
+
+    if (failed) {
+        throw std::runtime_error("生成测试文件失败: " + firstError);
+    }
+    Stats stats;
+    stats.files = files;
+    stats.logicalBytes = logicalBytes;
+    stats.writtenBytes = writtenBytes;
+    return stats;
+}
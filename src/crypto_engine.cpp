@@ -5,126 +5,933 @@
 #include <cctype>
 #include <filesystem>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
 #include <cryptopp/filters.h>
-#include <cryptopp/files.h>
+#include <cryptopp/hex.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/misc.h>
 #include <cryptopp/osrng.h>
-#include <cryptopp/pwdbased.h>
 #include <cryptopp/sha.h>
 #include <cryptopp/modes.h>
 #include <cryptopp/aes.h>
+#include "../include/file_processor.h"
+#include "../include/io_throttle.h"
+#include "../include/kdf_calibrator.h"
+#include "../include/key_envelope.h"
+#include "../include/memory_budget.h"
+#include "../include/native_file.h"
+#include "../include/perf_stats.h"
+#include "../include/session_key_cache.h"
 
 namespace fs = std::filesystem;
 
-// 密钥派生实现
-void CryptoEngine::deriveKey(const std::string& password, 
-                           CryptoPP::byte* key, size_t keySize, 
-                           CryptoPP::byte* salt, size_t saltSize) {
-    CryptoPP::AutoSeededRandomPool rng;
-    rng.GenerateBlock(salt, saltSize);
-    
-    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf;
-    pbkdf.DeriveKey(key, keySize, 0, 
-                   reinterpret_cast<const CryptoPP::byte*>(password.data()), 
-                   password.size(),
-                   salt, saltSize, 10000);
+// 旧格式文件头：16字节salt + 16字节IV
+static const size_t SALT_SIZE = 16;
+static const size_t LEGACY_HEADER_SIZE = SALT_SIZE + CryptoPP::AES::BLOCKSIZE;
+// 新文件使用v2信封文件头
+static const size_t HEADER_SIZE = KeyEnvelope::HEADER_SIZE;
+// 读取文件头时需要的最大长度
+static const size_t MAX_HEADER_SIZE = std::max(LEGACY_HEADER_SIZE, KeyEnvelope::HEADER_SIZE);
+// 原地处理每一步变换的数据量（同时也是撤销日志的大小上限）
+static const size_t IN_PLACE_CHUNK_SIZE = 4 * 1024 * 1024;
+// 原地处理一次申请的内存额度：当前块、预读块、日志中的数据块副本和日志写缓冲区
+static const size_t IN_PLACE_MEMORY = 4 * IN_PLACE_CHUNK_SIZE;
+// 附加在明文末尾的明文摘要长度
+static const size_t PLAIN_DIGEST_SIZE = CryptoPP::SHA256::DIGESTSIZE;
+
+// 新文件的KDF迭代次数
+static std::atomic<uint32_t> g_kdfIterations(KeyEnvelope::DEFAULT_ITERATIONS);
+
+void CryptoEngine::setKdfIterations(uint32_t iterations) {
+    g_kdfIterations = std::max(iterations, KdfCalibrator::MIN_ITERATIONS);
+}
+
+uint32_t CryptoEngine::kdfIterations() {
+    return g_kdfIterations;
+}
+
+// 使用已有盐值派生密钥（旧格式，迭代次数固定为10000）
+void CryptoEngine::deriveKeyFromSalt(const std::string& password,
+                                     CryptoPP::byte* key, size_t keySize,
+                                     const CryptoPP::byte* salt, size_t saltSize) {
+    SessionKeyCache::derive(password, salt, saltSize, 10000, key, keySize);
+}
+
+// 生成v2文件头：随机数据密钥由密码派生的KEK包装
+size_t CryptoEngine::createHeader(const KeyEnvelope::Kek& kek, CryptoPP::byte* header,
+                                  CryptoPP::byte* key, CryptoPP::byte* iv, uint32_t flags) {
+    KeyEnvelope::create(kek, flags, header, key);
+    std::memcpy(iv, KeyEnvelope::iv(header), CryptoPP::AES::BLOCKSIZE);
+    return KeyEnvelope::HEADER_SIZE;
+}
+
+// 解析文件头（v2信封或旧格式），取得数据密钥和IV，返回文件头长度
+// 标志位位于信封的认证数据中，篡改后无法解开数据密钥
+// knownKek的盐和迭代次数与文件头一致时直接使用，不再派生
+size_t CryptoEngine::openHeader(const std::string& password, const CryptoPP::byte* data,
+                                size_t len, CryptoPP::byte* key, CryptoPP::byte* iv,
+                                uint32_t* flags, const KeyEnvelope::Kek* knownKek) {
+    if (flags) *flags = 0;
+    if (KeyEnvelope::isEnvelope(data, len)) {
+        if (len < KeyEnvelope::HEADER_SIZE) {
+            throw std::runtime_error("加密文件头不完整");
+        }
+        KeyEnvelope::Kek derived;
+        const KeyEnvelope::Kek* kek = knownKek;
+        if (!kek || !KeyEnvelope::matches(data, *kek)) {
+            KeyEnvelope::deriveKek(password, KeyEnvelope::salt(data),
+                                   KeyEnvelope::iterations(data), derived);
+            kek = &derived;
+        }
+        if (!KeyEnvelope::unwrap(data, *kek, key)) {
+            throw std::runtime_error("密码错误或文件已损坏");
+        }
+        std::memcpy(iv, KeyEnvelope::iv(data), CryptoPP::AES::BLOCKSIZE);
+        if (flags) *flags = KeyEnvelope::flags(data);
+        return KeyEnvelope::HEADER_SIZE;
+    }
+
+    if (len < LEGACY_HEADER_SIZE) {
+        throw std::runtime_error("加密文件头不完整");
+    }
+    deriveKeyFromSalt(password, key, CryptoPP::AES::DEFAULT_KEYLENGTH, data, SALT_SIZE);
+    std::memcpy(iv, data + SALT_SIZE, CryptoPP::AES::BLOCKSIZE);
+    return LEGACY_HEADER_SIZE;
+}
+
+static std::string digestHex(const CryptoPP::byte* digest) {
+    std::string hex;
+    CryptoPP::StringSource(digest, PLAIN_DIGEST_SIZE, true,
+        new CryptoPP::HexEncoder(new CryptoPP::StringSink(hex), false));
+    return hex;
+}
+
+// 解密时计算明文摘要：始终扣留最后keep字节（加密的摘要尾部），
+// 其余字节计算哈希后交给sink输出；keep为0时全部输出
+class PlainDigestTracker {
+public:
+    PlainDigestTracker(size_t keep, bool enabled)
+        : m_keep(keep), m_enabled(enabled), m_tail(keep), m_tailLen(0) {}
+
+    template <typename Sink>
+    void update(const CryptoPP::byte* data, size_t len, Sink sink) {
+        if (m_keep == 0) {
+            emit(data, len, sink);
+            return;
+        }
+        if (m_tailLen + len <= m_keep) {
+            std::memcpy(m_tail.data() + m_tailLen, data, len);
+            m_tailLen += len;
+            return;
+        }
+        // 先放出扣留区中较早的字节，再放出新数据中不属于尾部的部分
+        const size_t release = m_tailLen + len - m_keep;
+        const size_t fromTail = std::min(release, m_tailLen);
+        emit(m_tail.data(), fromTail, sink);
+        emit(data, release - fromTail, sink);
+        std::memmove(m_tail.data(), m_tail.data() + fromTail, m_tailLen - fromTail);
+        m_tailLen -= fromTail;
+        std::memcpy(m_tail.data() + m_tailLen, data + (release - fromTail), len - (release - fromTail));
+        m_tailLen = m_keep;
+    }
+
+    // 数据结束：返回扣留的尾部与计算出的摘要是否一致（keep为0时总为true）
+    bool finish(std::string* hex) {
+        CryptoPP::byte digest[PLAIN_DIGEST_SIZE];
+        if (!m_enabled) return true;
+        m_hash.Final(digest);
+        if (hex) *hex = digestHex(digest);
+        return m_keep == 0 ||
+            (m_tailLen == m_keep && std::memcmp(digest, m_tail.data(), m_keep) == 0);
+    }
+
+    // 扣留的尾部是否等于digest（摘要由调用方另行计算时使用）
+    bool tailMatches(const CryptoPP::byte* digest) const {
+        return m_tailLen == m_keep && std::memcmp(digest, m_tail.data(), m_keep) == 0;
+    }
+
+private:
+    template <typename Sink>
+    void emit(const CryptoPP::byte* data, size_t len, Sink& sink) {
+        if (len == 0) return;
+        if (m_enabled) {
+            PerfStats::Timer timer(PerfStats::Hash, len);
+            m_hash.Update(data, len);
+        }
+        sink(data, len);
+    }
+
+    size_t m_keep;
+    bool m_enabled;
+    CryptoPP::SHA256 m_hash;
+    CryptoPP::SecByteBlock m_tail; // 析构时清零
+    size_t m_tailLen;
+};
+
+static void reportProgress(CryptoEngine::ProgressCallback& callback, int& lastProgress,
+                           uint64_t done, uint64_t total) {
+    if (!callback || total == 0) return;
+    int newProgress = static_cast<int>((done * 100) / total);
+    if (newProgress != lastProgress) {
+        callback(newProgress);
+        lastProgress = newProgress;
+    }
 }
 
-// 文件加密实现
+// 流式处理每段的数据量
+static const size_t CIPHER_CHUNK_SIZE = 1 * 1024 * 1024;
+
+// 校验末块的PKCS填充，有效时通过pad返回填充长度
+static bool pkcsPadding(const CryptoPP::byte* data, size_t len, size_t& pad) {
+    pad = data[len - 1];
+    bool padOk = pad >= 1 && pad <= CryptoPP::AES::BLOCKSIZE && pad <= len;
+    for (size_t i = 0; padOk && i < pad; i++) {
+        padOk = data[len - 1 - i] == pad;
+    }
+    return padOk;
+}
+
+// 文件接口的密文输出：明文读入input()（CIPHER_CHUNK_SIZE字节）后交给Encryptor，
+// 密文在输出区攒满一段再按偏移写出，不经过过滤器链。输入区和输出区共用一份内存额度
+class CipherOutput {
+public:
+    static const size_t OUTPUT_SIZE = CIPHER_CHUNK_SIZE + CryptoEngine::STREAM_OVERHEAD;
+
+    explicit CipherOutput(NativeFile& out)
+        : m_out(out), m_offset(0), m_buffer(CIPHER_CHUNK_SIZE + OUTPUT_SIZE), m_fill(0) {}
+
+    CryptoPP::byte* input() { return m_buffer.data(); }
+
+    // 保证输出区至少还有len字节空闲，返回写入位置
+    CryptoPP::byte* reserve(size_t len) {
+        if (m_fill + len > OUTPUT_SIZE) flush();
+        return output() + m_fill;
+    }
+    size_t room() const { return OUTPUT_SIZE - m_fill; }
+    void commit(size_t len) { m_fill += len; }
+
+    // 写出输出区中的密文，返回已写出的总长度
+    uint64_t flush() {
+        if (m_fill > 0) {
+            m_out.writeAt(output(), m_fill, m_offset);
+            m_offset += m_fill;
+            m_fill = 0;
+        }
+        return m_offset;
+    }
+
+private:
+    CryptoPP::byte* output() { return m_buffer.data() + CIPHER_CHUNK_SIZE; }
+
+    NativeFile& m_out;
+    uint64_t m_offset;
+    MemoryBudget::Buffer m_buffer; // 计入内存预算，析构时清零
+    size_t m_fill;
+};
+
+// 稀疏格式：明文流由若干记录组成，每条记录为 零段长度(u64) 数据长度(u64)（小端），
+// 其后是数据本身，以(0, 0)记录结束；明文摘要按逻辑内容（零段展开为零）计算
+static const size_t SPARSE_RECORD_SIZE = 16;
+// 逻辑大小上限，防止损坏的记录导致长时间计算零段摘要
+static const uint64_t SPARSE_MAX_SIZE = 1ull << 50;
+// 零段送入哈希时使用的全零缓冲区
+static const CryptoPP::byte ZERO_BLOCK[64 * 1024] = {};
+
+static void putU64(CryptoPP::byte* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<CryptoPP::byte>(value >> (8 * i));
+    }
+}
+
+static uint64_t getU64(const CryptoPP::byte* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+// 零段不读盘，直接把等长的零送入哈希
+static void hashZeros(CryptoPP::HashTransformation& hash, uint64_t len) {
+    PerfStats::Timer timer(PerfStats::Hash, len);
+    while (len > 0) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(len, sizeof(ZERO_BLOCK)));
+        hash.Update(ZERO_BLOCK, n);
+        len -= n;
+    }
+}
+
+// 解析稀疏格式的明文流：数据按逻辑偏移交给sink(offset, data, len)，
+// 零段只推进偏移（输出中留为空洞），同时计算逻辑明文的摘要
+class SparseDecoder {
+public:
+    template <typename Sink>
+    void update(const CryptoPP::byte* data, size_t len, Sink sink) {
+        while (len > 0) {
+            if (m_done) {
+                throw std::runtime_error("稀疏记录结束后存在多余数据");
+            }
+            if (m_dataLeft > 0) {
+                const size_t n = static_cast<size_t>(std::min<uint64_t>(len, m_dataLeft));
+                {
+                    PerfStats::Timer timer(PerfStats::Hash, n);
+                    m_hash.Update(data, n);
+                }
+                sink(m_offset, data, n);
+                m_offset += n;
+                m_dataLeft -= n;
+                data += n;
+                len -= n;
+                continue;
+            }
+            const size_t n = std::min(len, SPARSE_RECORD_SIZE - m_recordLen);
+            std::memcpy(m_record + m_recordLen, data, n);
+            m_recordLen += n;
+            data += n;
+            len -= n;
+            if (m_recordLen < SPARSE_RECORD_SIZE) continue;
+
+            m_recordLen = 0;
+            const uint64_t zeros = getU64(m_record);
+            const uint64_t dataLen = getU64(m_record + 8);
+            if (zeros == 0 && dataLen == 0) {
+                m_done = true;
+                continue;
+            }
+            if (zeros > SPARSE_MAX_SIZE || dataLen > SPARSE_MAX_SIZE ||
+                m_offset + zeros + dataLen > SPARSE_MAX_SIZE) {
+                throw std::runtime_error("稀疏记录无效，文件已损坏");
+            }
+            hashZeros(m_hash, zeros);
+            m_offset += zeros;
+            m_dataLeft = dataLen;
+        }
+    }
+
+    // 记录流完整且摘要与扣留的尾部一致时返回true
+    bool finish(const PlainDigestTracker& tracker, std::string* hex) {
+        CryptoPP::byte digest[PLAIN_DIGEST_SIZE];
+        return finalDigest(digest, hex) && tracker.tailMatches(digest);
+    }
+
+    // 记录流完整且摘要与stored一致时返回true
+    bool finish(const CryptoPP::byte* stored, std::string* hex) {
+        CryptoPP::byte digest[PLAIN_DIGEST_SIZE];
+        return finalDigest(digest, hex) && std::memcmp(digest, stored, PLAIN_DIGEST_SIZE) == 0;
+    }
+
+    // 逻辑明文大小（含末尾零段）
+    uint64_t size() const { return m_offset; }
+
+private:
+    bool finalDigest(CryptoPP::byte* digest, std::string* hex) {
+        if (!m_done) return false;
+        m_hash.Final(digest);
+        if (hex) *hex = digestHex(digest);
+        return true;
+    }
+
+    CryptoPP::byte m_record[SPARSE_RECORD_SIZE] = {};
+    size_t m_recordLen = 0;
+    uint64_t m_dataLeft = 0;
+    uint64_t m_offset = 0;
+    bool m_done = false;
+    CryptoPP::SHA256 m_hash;
+};
+
+// 小文件缓冲池：每个线程复用一块缓冲区（输入和输出各占一部分），避免每个文件重新分配。
+// 使用期间计入内存预算；设置了预算时用完即释放，空闲线程不占额度
+class SmallFileBuffer {
+public:
+    explicit SmallFileBuffer(size_t size) : m_lease(poolSize(size)) {
+        if (pool().size() < m_lease.bytes()) pool().resize(m_lease.bytes());
+    }
+    ~SmallFileBuffer() {
+        if (MemoryBudget::limit() != 0) std::vector<CryptoPP::byte>().swap(pool());
+    }
+
+    SmallFileBuffer(const SmallFileBuffer&) = delete;
+    SmallFileBuffer& operator=(const SmallFileBuffer&) = delete;
+
+    CryptoPP::byte* data() { return pool().data(); }
+
+private:
+    static std::vector<CryptoPP::byte>& pool() {
+        thread_local std::vector<CryptoPP::byte> buffer;
+        return buffer;
+    }
+    static size_t poolSize(size_t size) {
+        return std::max({pool().size(), size,
+                         static_cast<size_t>(2 * (CryptoEngine::SMALL_FILE_THRESHOLD + MAX_HEADER_SIZE) +
+                                             CryptoEngine::STREAM_OVERHEAD)});
+    }
+
+    MemoryBudget::Lease m_lease;
+};
+
+// 判断是否走小文件快速路径：knownSize只用于跳过明显不符的文件，
+// 大小一律取自打开后的句柄（枚举得到的大小可能已过时）；
+// 返回false时文件可能仍处于打开状态，调用方可直接复用
+static bool openSmallFile(const std::string& path, uint64_t knownSize,
+                          NativeFile& file, uint64_t& size) {
+    if (knownSize != CryptoEngine::UNKNOWN_SIZE &&
+        (knownSize == 0 || knownSize >= CryptoEngine::SMALL_FILE_THRESHOLD)) {
+        return false;
+    }
+    if (!file.open(path, NativeFile::ReadOnly)) return false;
+    size = file.size();
+    return size > 0 && size < CryptoEngine::SMALL_FILE_THRESHOLD;
+}
+
+// ==================== 内存接口 ====================
+
+static void requireOutput(size_t need, size_t outSize) {
+    if (outSize < need) {
+        throw std::runtime_error("输出缓冲区不足");
+    }
+}
+
+CryptoEngine::Encryptor::Encryptor(const KeyEnvelope::Kek& kek) {
+    init(kek, KeyEnvelope::FLAG_PLAIN_DIGEST);
+}
+
+CryptoEngine::Encryptor::Encryptor(const std::string& password) {
+    KeyEnvelope::Kek kek;
+    KeyEnvelope::newKek(password, kdfIterations(), kek);
+    init(kek, KeyEnvelope::FLAG_PLAIN_DIGEST);
+}
+
+CryptoEngine::Encryptor::Encryptor(const KeyEnvelope::Kek& kek, uint32_t flags) {
+    init(kek, flags);
+    m_hashInput = (flags & KeyEnvelope::FLAG_SPARSE) == 0;
+}
+
+CryptoEngine::Encryptor::~Encryptor() {
+    secureWipe(m_pending, sizeof(m_pending));
+}
+
+void CryptoEngine::Encryptor::init(const KeyEnvelope::Kek& kek, uint32_t flags) {
+    CryptoPP::byte key[CryptoPP::AES::DEFAULT_KEYLENGTH];
+    CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE];
+    createHeader(kek, m_header, key, iv, flags);
+    m_cipher.SetKeyWithIV(key, sizeof(key), iv);
+    secureWipe(key, sizeof(key));
+}
+
+size_t CryptoEngine::Encryptor::update(const CryptoPP::byte* in, size_t inSize,
+                                       CryptoPP::byte* out, size_t outSize) {
+    if (m_finished) {
+        throw std::runtime_error("加密已结束");
+    }
+    if (m_hashInput && inSize > 0) {
+        PerfStats::Timer timer(PerfStats::Hash, inSize);
+        m_hash.Update(in, inSize);
+    }
+    return put(in, inSize, out, outSize);
+}
+
+// 写出文件头（首次）和凑满的整块密文，不足一个块的数据暂存
+size_t CryptoEngine::Encryptor::put(const CryptoPP::byte* in, size_t inSize,
+                                    CryptoPP::byte* out, size_t outSize) {
+    const size_t blocks = (m_pendingLen + inSize) / CryptoPP::AES::BLOCKSIZE * CryptoPP::AES::BLOCKSIZE;
+    requireOutput((m_headerPending ? sizeof(m_header) : 0) + blocks, outSize);
+
+    size_t written = 0;
+    if (m_headerPending) {
+        std::memcpy(out, m_header, sizeof(m_header));
+        written = sizeof(m_header);
+        m_headerPending = false;
+    }
+    if (m_pendingLen > 0) {
+        const size_t take = std::min(inSize, CryptoPP::AES::BLOCKSIZE - m_pendingLen);
+        std::memcpy(m_pending + m_pendingLen, in, take);
+        m_pendingLen += take;
+        in += take;
+        inSize -= take;
+        if (m_pendingLen < CryptoPP::AES::BLOCKSIZE) return written;
+        m_cipher.ProcessData(out + written, m_pending, sizeof(m_pending));
+        written += sizeof(m_pending);
+        m_pendingLen = 0;
+    }
+    const size_t full = inSize / CryptoPP::AES::BLOCKSIZE * CryptoPP::AES::BLOCKSIZE;
+    if (full > 0) {
+        PerfStats::Timer timer(PerfStats::Cipher, full);
+        m_cipher.ProcessData(out + written, in, full);
+        written += full;
+    }
+    m_pendingLen = inSize - full;
+    std::memcpy(m_pending, in + full, m_pendingLen);
+    return written;
+}
+
+size_t CryptoEngine::Encryptor::final(CryptoPP::byte* out, size_t outSize, std::string* plainDigest) {
+    if (m_finished) {
+        throw std::runtime_error("加密已结束");
+    }
+    CryptoPP::byte digest[PLAIN_DIGEST_SIZE];
+    m_hash.Final(digest);
+    if (plainDigest) *plainDigest = digestHex(digest);
+    return finish(digest, out, outSize);
+}
+
+// 明文摘要附加在明文之后一并加密，最后补PKCS填充
+size_t CryptoEngine::Encryptor::finish(const CryptoPP::byte* digest,
+                                       CryptoPP::byte* out, size_t outSize) {
+    requireOutput((m_headerPending ? sizeof(m_header) : 0) +
+                  (m_pendingLen + PLAIN_DIGEST_SIZE) / CryptoPP::AES::BLOCKSIZE * CryptoPP::AES::BLOCKSIZE +
+                  CryptoPP::AES::BLOCKSIZE, outSize);
+    size_t written = put(digest, PLAIN_DIGEST_SIZE, out, outSize);
+    const size_t pad = CryptoPP::AES::BLOCKSIZE - m_pendingLen;
+    std::memset(m_pending + m_pendingLen, static_cast<int>(pad), pad);
+    m_cipher.ProcessData(out + written, m_pending, sizeof(m_pending));
+    written += sizeof(m_pending);
+    secureWipe(m_pending, sizeof(m_pending));
+    m_pendingLen = 0;
+    m_finished = true;
+    return written;
+}
+
+CryptoEngine::Decryptor::Decryptor(const std::string& password, const KeyEnvelope::Kek* kek)
+    : Decryptor(password, kek, false) {}
+
+CryptoEngine::Decryptor::Decryptor(const std::string& password, const KeyEnvelope::Kek* kek,
+                                   bool allowSparse)
+    : m_password(password), m_kek(kek), m_allowSparse(allowSparse) {}
+
+CryptoEngine::Decryptor::~Decryptor() {
+    secureWipe(&m_password[0], m_password.size());
+    secureWipe(m_pending, sizeof(m_pending));
+    secureWipe(m_held, sizeof(m_held));
+}
+
+// 收集文件头，凑齐后派生或解包数据密钥；返回消耗的输入字节数
+size_t CryptoEngine::Decryptor::readHeader(const CryptoPP::byte* in, size_t inSize) {
+    size_t consumed = 0;
+    while (m_headerSize == 0 && consumed < inSize) {
+        // 前8字节决定是v2信封还是旧格式
+        const size_t need = m_headerLen < 8 ? 8
+            : (KeyEnvelope::isEnvelope(m_header, m_headerLen) ? KeyEnvelope::HEADER_SIZE
+                                                              : LEGACY_HEADER_SIZE);
+        const size_t take = std::min(need - m_headerLen, inSize - consumed);
+        std::memcpy(m_header + m_headerLen, in + consumed, take);
+        m_headerLen += take;
+        consumed += take;
+        if (m_headerLen < need || need == 8) continue;
+
+        CryptoPP::byte key[CryptoPP::AES::DEFAULT_KEYLENGTH];
+        CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE];
+        m_headerSize = openHeader(m_password, m_header, m_headerLen, key, iv, &m_flags, m_kek);
+        secureWipe(&m_password[0], m_password.size());
+        m_password.clear();
+        m_cipher.SetKeyWithIV(key, sizeof(key), iv);
+        secureWipe(key, sizeof(key));
+
+        const bool hasDigest = (m_flags & KeyEnvelope::FLAG_PLAIN_DIGEST) != 0;
+        if (sparse()) {
+            if (!hasDigest) {
+                throw std::runtime_error("加密数据无效");
+            }
+            if (!m_allowSparse) {
+                throw std::runtime_error("稀疏格式的密文只能解密到文件");
+            }
+        }
+        // 扣留末尾的填充块，带摘要时再多扣留摘要长度
+        m_hold = CryptoPP::AES::BLOCKSIZE + (hasDigest ? PLAIN_DIGEST_SIZE : 0);
+        // 稀疏格式的摘要按逻辑内容计算，不对记录流求哈希
+        m_hashOutput = !sparse();
+    }
+    return consumed;
+}
+
+// out中依次放入上次扣留的明文和本次解密的整块，再把末尾m_hold字节收回扣留区
+size_t CryptoEngine::Decryptor::update(const CryptoPP::byte* in, size_t inSize,
+                                       CryptoPP::byte* out, size_t outSize) {
+    if (m_finished) {
+        throw std::runtime_error("解密已结束");
+    }
+    const size_t consumed = readHeader(in, inSize);
+    in += consumed;
+    inSize -= consumed;
+    if (m_headerSize == 0) return 0;
+
+    const size_t blocks = (m_pendingLen + inSize) / CryptoPP::AES::BLOCKSIZE * CryptoPP::AES::BLOCKSIZE;
+    if (blocks == 0) {
+        std::memcpy(m_pending + m_pendingLen, in, inSize);
+        m_pendingLen += inSize;
+        return 0;
+    }
+    requireOutput(m_heldLen + blocks, outSize);
+
+    std::memcpy(out, m_held, m_heldLen);
+    size_t pos = m_heldLen;
+    {
+        PerfStats::Timer timer(PerfStats::Cipher, blocks);
+        if (m_pendingLen > 0) {
+            const size_t take = CryptoPP::AES::BLOCKSIZE - m_pendingLen;
+            std::memcpy(m_pending + m_pendingLen, in, take);
+            in += take;
+            inSize -= take;
+            m_cipher.ProcessData(out + pos, m_pending, sizeof(m_pending));
+            pos += sizeof(m_pending);
+        }
+        const size_t full = inSize / CryptoPP::AES::BLOCKSIZE * CryptoPP::AES::BLOCKSIZE;
+        m_cipher.ProcessData(out + pos, in, full);
+        pos += full;
+        m_pendingLen = inSize - full;
+        std::memcpy(m_pending, in + full, m_pendingLen);
+    }
+
+    const size_t emit = pos > m_hold ? pos - m_hold : 0;
+    m_heldLen = pos - emit;
+    std::memcpy(m_held, out + emit, m_heldLen);
+    secureWipe(out + emit, m_heldLen);
+    if (m_hashOutput && emit > 0) {
+        PerfStats::Timer timer(PerfStats::Hash, emit);
+        m_hash.Update(out, emit);
+    }
+    return emit;
+}
+
+size_t CryptoEngine::Decryptor::final(CryptoPP::byte* out, size_t outSize, std::string* plainDigest) {
+    if (m_finished) {
+        throw std::runtime_error("解密已结束");
+    }
+    if (m_headerSize == 0 || m_pendingLen != 0 || m_heldLen < CryptoPP::AES::BLOCKSIZE) {
+        throw std::runtime_error("密文不完整或长度不是块大小的整数倍");
+    }
+    m_finished = true;
+
+    size_t pad = 0;
+    if (!pkcsPadding(m_held, m_heldLen, pad)) {
+        throw std::runtime_error("密码错误或数据已损坏");
+    }
+    size_t dataLen = m_heldLen - pad;
+    const bool hasDigest = (m_flags & KeyEnvelope::FLAG_PLAIN_DIGEST) != 0;
+    if (hasDigest) {
+        if (dataLen < PLAIN_DIGEST_SIZE) {
+            throw std::runtime_error("加密数据无效");
+        }
+        dataLen -= PLAIN_DIGEST_SIZE;
+        std::memcpy(m_digest, m_held + dataLen, PLAIN_DIGEST_SIZE);
+    }
+    requireOutput(dataLen, outSize);
+
+    if (m_hashOutput) {
+        CryptoPP::byte digest[PLAIN_DIGEST_SIZE];
+        {
+            PerfStats::Timer timer(PerfStats::Hash, dataLen);
+            m_hash.Update(m_held, dataLen);
+            m_hash.Final(digest);
+        }
+        if (hasDigest && std::memcmp(digest, m_digest, PLAIN_DIGEST_SIZE) != 0) {
+            throw std::runtime_error("明文摘要不符，数据已损坏或被篡改");
+        }
+        if (plainDigest) *plainDigest = digestHex(digest);
+    }
+    std::memcpy(out, m_held, dataLen);
+    secureWipe(m_held, sizeof(m_held));
+    m_heldLen = 0;
+    return dataLen;
+}
+
+uint64_t CryptoEngine::encryptedSize(uint64_t plainSize) {
+    return HEADER_SIZE +
+        ((plainSize + PLAIN_DIGEST_SIZE) / CryptoPP::AES::BLOCKSIZE + 1) * CryptoPP::AES::BLOCKSIZE;
+}
+
+size_t CryptoEngine::encrypt(const CryptoPP::byte* in, size_t inSize,
+                             CryptoPP::byte* out, size_t outSize,
+                             const KeyEnvelope::Kek& kek, std::string* plainDigest) {
+    requireOutput(static_cast<size_t>(encryptedSize(inSize)), outSize);
+    Encryptor encryptor(kek);
+    const size_t written = encryptor.update(in, inSize, out, outSize);
+    return written + encryptor.final(out + written, outSize - written, plainDigest);
+}
+
+size_t CryptoEngine::encrypt(const CryptoPP::byte* in, size_t inSize,
+                             CryptoPP::byte* out, size_t outSize,
+                             const std::string& password, std::string* plainDigest) {
+    KeyEnvelope::Kek kek;
+    KeyEnvelope::newKek(password, kdfIterations(), kek);
+    return encrypt(in, inSize, out, outSize, kek, plainDigest);
+}
+
+size_t CryptoEngine::decrypt(const CryptoPP::byte* in, size_t inSize,
+                             CryptoPP::byte* out, size_t outSize,
+                             const std::string& password, std::string* plainDigest) {
+    requireOutput(inSize, outSize);
+    Decryptor decryptor(password);
+    size_t written = 0;
+    try {
+        written = decryptor.update(in, inSize, out, outSize);
+        return written + decryptor.final(out + written, outSize - written, plainDigest);
+    } catch (...) {
+        // 校验失败时不留下未经确认的明文
+        secureWipe(out, written);
+        throw;
+    }
+}
+
+// 小文件加密：一次读入，经内存接口加密后一次写出
+void CryptoEngine::encryptSmallFile(NativeFile& inFile, uint64_t fileSize,
+                                    const std::string& outputPath,
+                                    const KeyEnvelope::Kek& kek,
+                                    uint64_t* outputSize,
+                                    std::string* plainDigest) {
+    const size_t plainSize = static_cast<size_t>(fileSize);
+    const size_t cipherSize = static_cast<size_t>(encryptedSize(fileSize));
+    SmallFileBuffer buffer(plainSize + cipherSize);
+    CryptoPP::byte* plain = buffer.data();
+    CryptoPP::byte* cipher = plain + plainSize;
+
+    // 离开作用域时清除缓冲区中的明文
+    struct BufferWiper {
+        CryptoPP::byte* data;
+        size_t size;
+        ~BufferWiper() { secureWipe(data, size); }
+    } wiper{plain, plainSize};
+
+    // 读到的长度与句柄大小不符或其后仍有数据都说明文件正被修改，不输出截断的密文
+    CryptoPP::byte probe;
+    if (inFile.readAt(plain, plainSize, 0) != plainSize ||
+        inFile.readAt(&probe, 1, plainSize) != 0) {
+        throw std::runtime_error("读取输入文件失败（文件大小已变化）");
+    }
+    inFile.close();
+
+    const size_t written = encrypt(plain, plainSize, cipher, cipherSize, kek, plainDigest);
+
+    NativeFile outFile;
+    if (!outFile.open(outputPath, NativeFile::CreateTruncate)) {
+        throw std::runtime_error("无法创建输出文件: " + outputPath);
+    }
+    outFile.writeAt(cipher, written, 0);
+    if (outputSize) *outputSize = written;
+}
+
+// 稀疏文件加密：只读取有数据的区段，空洞以零段记录表示，不读盘也不占用密文空间
+void CryptoEngine::encryptSparseFile(NativeFile& inFile, uint64_t fileSize,
+                                     const std::string& outputPath,
+                                     const KeyEnvelope::Kek& kek,
+                                     ProgressCallback& callback,
+                                     uint64_t* outputSize,
+                                     std::string* plainDigest) {
+    NativeFile outFile;
+    if (!outFile.open(outputPath, NativeFile::CreateTruncate)) {
+        throw std::runtime_error("无法创建输出文件: " + outputPath);
+    }
+
+    // 明文摘要按逻辑内容计算，不对记录流求哈希
+    Encryptor encryptor(kek, KeyEnvelope::FLAG_PLAIN_DIGEST | KeyEnvelope::FLAG_SPARSE);
+    CipherOutput output(outFile);
+    auto put = [&](const CryptoPP::byte* data, size_t len) {
+        CryptoPP::byte* out = output.reserve(len + STREAM_OVERHEAD);
+        output.commit(encryptor.update(data, len, out, output.room()));
+    };
+    auto putRecord = [&](uint64_t zeros, uint64_t dataLen) {
+        CryptoPP::byte record[SPARSE_RECORD_SIZE];
+        putU64(record, zeros);
+        putU64(record + 8, dataLen);
+        put(record, sizeof(record));
+    };
+
+    CryptoPP::SHA256 plainHash;
+    int lastProgress = -1;
+    uint64_t pos = 0;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    while (pos < fileSize && inFile.nextData(pos, start, end)) {
+        end = std::min(end, fileSize);
+        if (start >= end) break;
+        putRecord(start - pos, end - start);
+        hashZeros(plainHash, start - pos);
+        for (uint64_t offset = start; offset < end;) {
+            const size_t len = static_cast<size_t>(std::min<uint64_t>(CIPHER_CHUNK_SIZE, end - offset));
+            if (inFile.readAt(output.input(), len, offset) != len) {
+                throw std::runtime_error("读取输入文件失败（文件大小已变化）");
+            }
+            {
+                PerfStats::Timer timer(PerfStats::Hash, len);
+                plainHash.Update(output.input(), len);
+            }
+            put(output.input(), len);
+            offset += len;
+            reportProgress(callback, lastProgress, offset, fileSize);
+        }
+        pos = end;
+    }
+    // 文件以空洞结尾时用一条没有数据的零段补足大小
+    if (pos < fileSize) {
+        putRecord(fileSize - pos, 0);
+        hashZeros(plainHash, fileSize - pos);
+    }
+    putRecord(0, 0);
+
+    CryptoPP::byte digest[PLAIN_DIGEST_SIZE];
+    plainHash.Final(digest);
+    if (plainDigest) *plainDigest = digestHex(digest);
+    CryptoPP::byte* out = output.reserve(STREAM_OVERHEAD);
+    output.commit(encryptor.finish(digest, out, output.room()));
+    const uint64_t cipherEnd = output.flush();
+    if (outputSize) *outputSize = cipherEnd;
+}
+
+// 稀疏格式的解密输出在写入前标记为稀疏文件，零段才能还原为空洞；
+// 文件系统不支持时零段按零填充写出，内容不变
+static void markSparse(NativeFile& outFile, const std::string& outputPath) {
+    if (!outFile.setSparse()) {
+        std::cerr << "文件系统不支持稀疏文件，空洞将按零填充写出: " << outputPath << std::endl;
+    }
+}
+
+// 小文件解密：一次读入，经内存接口解密并校验填充和明文摘要后一次写出
+void CryptoEngine::decryptSmallFile(NativeFile& inFile, uint64_t fileSize,
+                                    const std::string& outputPath,
+                                    const std::string& password,
+                                    uint64_t* outputSize,
+                                    std::string* plainDigest) {
+    const size_t total = static_cast<size_t>(fileSize);
+    SmallFileBuffer buffer(2 * total);
+    CryptoPP::byte* cipher = buffer.data();
+    CryptoPP::byte* plain = cipher + total;
+
+    struct BufferWiper {
+        CryptoPP::byte* data;
+        size_t size;
+        ~BufferWiper() { secureWipe(data, size); }
+    } wiper{plain, total};
+
+    if (inFile.readAt(cipher, total, 0) != total) {
+        throw std::runtime_error("读取输入文件失败（文件大小已变化）");
+    }
+    inFile.close();
+
+    // 非稀疏格式在final()中比对明文摘要，不符时不产生输出
+    Decryptor decryptor(password, nullptr, true);
+    size_t plainSize = decryptor.update(cipher, total, plain, total);
+    plainSize += decryptor.final(plain + plainSize, total - plainSize,
+                                 decryptor.sparse() ? nullptr : plainDigest);
+
+    // 稀疏格式：先解析全部记录并比对摘要，再按偏移写出数据，零段留为空洞
+    if (decryptor.sparse()) {
+        struct Piece {
+            uint64_t offset;
+            const CryptoPP::byte* data;
+            size_t len;
+        };
+        std::vector<Piece> pieces;
+        SparseDecoder decoder;
+        decoder.update(plain, plainSize,
+            [&](uint64_t offset, const CryptoPP::byte* data, size_t len) {
+                pieces.push_back({offset, data, len});
+            });
+        if (!decoder.finish(decryptor.storedDigest(), plainDigest)) {
+            throw std::runtime_error("明文摘要不符，文件已损坏或被篡改");
+        }
+        NativeFile outFile;
+        if (!outFile.open(outputPath, NativeFile::CreateTruncate)) {
+            throw std::runtime_error("无法创建输出文件: " + outputPath);
+        }
+        markSparse(outFile, outputPath);
+        for (const Piece& piece : pieces) {
+            outFile.writeAt(piece.data, piece.len, piece.offset);
+        }
+        outFile.truncate(decoder.size());
+        if (outputSize) *outputSize = decoder.size();
+        return;
+    }
+
+    NativeFile outFile;
+    if (!outFile.open(outputPath, NativeFile::CreateTruncate)) {
+        throw std::runtime_error("无法创建输出文件: " + outputPath);
+    }
+    outFile.writeAt(plain, plainSize, 0);
+    if (outputSize) *outputSize = plainSize;
+}
+
+// 文件加密实现：每个文件使用新的随机盐派生KEK
 bool CryptoEngine::encryptFile(const std::string& inputPath, 
                               const std::string& outputPath, 
                               const std::string& password,
-                              ProgressCallback callback) {
+                              ProgressCallback callback,
+                              uint64_t knownSize,
+                              uint64_t* outputSize,
+                              std::string* plainDigest) {
+    KeyEnvelope::Kek kek;
+    KeyEnvelope::newKek(password, kdfIterations(), kek);
+    return encryptFile(inputPath, outputPath, kek, callback, knownSize, outputSize, plainDigest);
+}
+
+bool CryptoEngine::encryptFile(const std::string& inputPath, 
+                              const std::string& outputPath, 
+                              const KeyEnvelope::Kek& kek,
+                              ProgressCallback callback,
+                              uint64_t knownSize,
+                              uint64_t* outputSize,
+                              std::string* plainDigest) {
     try {
-        // 检查输入文件
-        if (!fs::exists(inputPath)) {
-            throw std::runtime_error("输入文件不存在: " + inputPath);
+        // 小文件快速路径：一次打开、一次fstat、一次读、一次写
+        NativeFile inFile;
+        uint64_t smallSize = 0;
+        if (openSmallFile(inputPath, knownSize, inFile, smallSize)) {
+            encryptSmallFile(inFile, smallSize, outputPath, kek, outputSize,
+                             plainDigest);
+            if (callback) callback(100);
+            return true;
         }
         
-        // 获取文件大小
-        size_t fileSize = fs::file_size(inputPath);
+        // 打开输入文件（快速路径已打开时复用）并获取文件大小
+        if (!inFile.isOpen() && !inFile.open(inputPath, NativeFile::ReadOnly)) {
+            if (!fs::exists(inputPath)) {
+                throw std::runtime_error("输入文件不存在: " + inputPath);
+            }
+            throw std::runtime_error("无法打开输入文件: " + inputPath);
+        }
+        const uint64_t fileSize = inFile.size();
         if (fileSize == 0) {
             throw std::runtime_error("输入文件为空: " + inputPath);
         }
         
-        // 打开输入文件
-        std::ifstream inFile(inputPath, std::ios::binary);
-        if (!inFile) {
-            throw std::runtime_error("无法打开输入文件: " + inputPath);
+        // 稀疏文件路径：空洞总量达到SPARSE_MIN_HOLES时只加密有数据的区段
+        if (fileSize >= SMALL_FILE_THRESHOLD &&
+            inFile.allocatedSize() + SPARSE_MIN_HOLES <= fileSize) {
+            encryptSparseFile(inFile, fileSize, outputPath, kek, callback, outputSize,
+                              plainDigest);
+            if (callback) callback(100);
+            return true;
         }
         
         // 打开输出文件
-        std::ofstream outFile(outputPath, std::ios::binary);
-        if (!outFile) {
+        NativeFile outFile;
+        if (!outFile.open(outputPath, NativeFile::CreateTruncate)) {
             throw std::runtime_error("无法创建输出文件: " + outputPath);
         }
         
-        // 生成密钥材料
-        CryptoPP::byte key[CryptoPP::AES::DEFAULT_KEYLENGTH];
-        CryptoPP::byte salt[16];
-        deriveKey(password, key, sizeof(key), salt, sizeof(salt));
-
-        // 生成随机IV
-        CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE];
-        CryptoPP::AutoSeededRandomPool rng;
-        rng.GenerateBlock(iv, sizeof(iv));
-
-        // 写入文件头 (16字节salt + 16字节IV)
-        outFile.write(reinterpret_cast<const char*>(salt), sizeof(salt));
-        outFile.write(reinterpret_cast<const char*>(iv), sizeof(iv));
-        
-        // 设置加密器 - 使用PKCS填充
-        CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption encryptor;
-        encryptor.SetKeyWithIV(key, sizeof(key), iv);
-        
-        // 创建加密过滤器链
-        CryptoPP::StreamTransformationFilter stfEncryptor(
-            encryptor,
-            new CryptoPP::FileSink(outFile),
-            CryptoPP::BlockPaddingSchemeDef::PKCS_PADDING
-        );
-        
-        // 分块处理文件
-        const size_t bufferSize = 1 * 1024 * 1024; // 1MB
-        std::vector<char> buffer(bufferSize);
-        size_t totalBytes = 0;
+        // 逐段读入明文交给Encryptor：首段输出带v2文件头，摘要与加密共用同一次读取
+        Encryptor encryptor(kek);
+        CipherOutput output(outFile);
         int lastProgress = -1; // 跟踪上一次的进度值
-        
-        while (inFile.read(buffer.data(), bufferSize)) {
-            size_t bytesRead = static_cast<size_t>(inFile.gcount());
-            stfEncryptor.Put(
-                reinterpret_cast<const CryptoPP::byte*>(buffer.data()), 
-                bytesRead
-            );
-            
-            totalBytes += bytesRead;
-            if (callback) {
-                int newProgress = static_cast<int>((totalBytes * 100) / fileSize);
-                // 只有当进度变化时才调用回调
-                if (newProgress != lastProgress) {
-                    callback(newProgress);
-                    lastProgress = newProgress;
-                }
+        uint64_t offset = 0;
+        for (;;) {
+            const size_t got = inFile.readAt(output.input(), CIPHER_CHUNK_SIZE, offset);
+            if (got > 0) {
+                CryptoPP::byte* out = output.reserve(got + STREAM_OVERHEAD);
+                output.commit(encryptor.update(output.input(), got, out, output.room()));
+                offset += got;
+                reportProgress(callback, lastProgress, offset, fileSize);
             }
+            if (got < CIPHER_CHUNK_SIZE) break;
         }
         
-        // 处理最后一块数据并添加填充
-        size_t lastBytes = static_cast<size_t>(inFile.gcount());
-        if (lastBytes > 0) {
-            stfEncryptor.Put(
-                reinterpret_cast<const CryptoPP::byte*>(buffer.data()), 
-                lastBytes
-            );
-            totalBytes += lastBytes;
-        }
-        
-        // 完成加密并写入填充
-        stfEncryptor.MessageEnd();
-        
-        // 清理敏感数据
-        secureWipe(key, sizeof(key));
-        secureWipe(salt, sizeof(salt));
-        secureWipe(iv, sizeof(iv));
+        // 明文摘要附加在明文之后一并加密，最后写入填充
+        CryptoPP::byte* out = output.reserve(STREAM_OVERHEAD);
+        output.commit(encryptor.final(out, output.room(), plainDigest));
+        const uint64_t cipherEnd = output.flush();
         
+        if (outputSize) *outputSize = cipherEnd;
         return true;
     } catch (const std::exception& e) {
         std::cerr << "加密错误: " << e.what() << std::endl;
@@ -136,104 +943,111 @@ bool CryptoEngine::encryptFile(const std::string& inputPath,
 bool CryptoEngine::decryptFile(const std::string& inputPath, 
                               const std::string& outputPath, 
                               const std::string& password,
-                              ProgressCallback callback) {
+                              ProgressCallback callback,
+                              uint64_t knownSize,
+                              uint64_t* outputSize,
+                              std::string* plainDigest) {
     try {
-        // 检查输入文件
-        if (!fs::exists(inputPath)) {
-            throw std::runtime_error("输入文件不存在: " + inputPath);
+        // 小文件快速路径
+        NativeFile inFile;
+        uint64_t smallSize = 0;
+        if (openSmallFile(inputPath, knownSize, inFile, smallSize)) {
+            decryptSmallFile(inFile, smallSize, outputPath, password, outputSize,
+                             plainDigest);
+            if (callback) callback(100);
+            return true;
         }
         
-        // 获取文件大小
-        size_t fileSize = fs::file_size(inputPath);
-        if (fileSize <= 32) { // 文件头大小 (16字节salt + 16字节IV)
-            throw std::runtime_error("加密文件无效: " + inputPath);
-        }
-        
-        // 打开输入文件
-        std::ifstream inFile(inputPath, std::ios::binary);
-        if (!inFile) {
+        // 打开输入文件（快速路径已打开时复用）并获取文件大小
+        if (!inFile.isOpen() && !inFile.open(inputPath, NativeFile::ReadOnly)) {
+            if (!fs::exists(inputPath)) {
+                throw std::runtime_error("输入文件不存在: " + inputPath);
+            }
             throw std::runtime_error("无法打开输入文件: " + inputPath);
         }
-        
-        // 读取文件头（盐和IV）
-        char salt[16], iv[CryptoPP::AES::BLOCKSIZE];
-        if (!inFile.read(salt, sizeof(salt)) || 
-            !inFile.read(iv, sizeof(iv))) {
-            throw std::runtime_error("无法读取加密文件头");
+        const uint64_t fileSize = inFile.size();
+        if (fileSize <= LEGACY_HEADER_SIZE) {
+            throw std::runtime_error("加密文件无效: " + inputPath);
         }
         
-        // 派生密钥
-        CryptoPP::byte key[CryptoPP::AES::DEFAULT_KEYLENGTH];
-        CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf;
-        pbkdf.DeriveKey(key, sizeof(key), 0, 
-                       reinterpret_cast<const CryptoPP::byte*>(password.data()), 
-                       password.size(),
-                       reinterpret_cast<const CryptoPP::byte*>(salt), sizeof(salt), 10000);
-        
-        // 设置解密器 - 使用PKCS填充
-        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption decryptor;
-        decryptor.SetKeyWithIV(key, sizeof(key), reinterpret_cast<const CryptoPP::byte*>(iv));
+        // 逐段读入密文交给Decryptor，首段解析文件头并取得数据密钥；
+        // 文件头有效、长度合法时才创建输出文件，密码错误时不产生输出
+        Decryptor decryptor(password, nullptr, true);
+        MemoryBudget::Buffer buffer(2 * CIPHER_CHUNK_SIZE + STREAM_OVERHEAD); // 计入内存预算，析构时清零
+        CryptoPP::byte* const cipher = buffer.data();
+        CryptoPP::byte* const plain = buffer.data() + CIPHER_CHUNK_SIZE;
+        const size_t plainRoom = buffer.size() - CIPHER_CHUNK_SIZE;
         
-        // 打开输出文件
-        std::ofstream outFile(outputPath, std::ios::binary);
-        if (!outFile) {
-            throw std::runtime_error("无法创建输出文件: " + outputPath);
-        }
+        NativeFile outFile;
+        SparseDecoder decoder;
+        uint64_t outOffset = 0;
+        // 稀疏格式由decoder计算逻辑明文的摘要，零段在输出中跳过形成空洞
+        auto writePlain = [&](const CryptoPP::byte* data, size_t len) {
+            if (!decryptor.sparse()) {
+                outFile.writeAt(data, len, outOffset);
+                outOffset += len;
+                return;
+            }
+            decoder.update(data, len,
+                [&](uint64_t offset, const CryptoPP::byte* piece, size_t n) {
+                    outFile.writeAt(piece, n, offset);
+                });
+        };
         
-        // 创建解密过滤器链
-        CryptoPP::StreamTransformationFilter stfDecryptor(
-            decryptor,
-            new CryptoPP::FileSink(outFile),
-            CryptoPP::BlockPaddingSchemeDef::PKCS_PADDING
-        );
+        // 填充或明文摘要不符时删除已写出的明文
+        auto discardOutput = [&](const char* message) {
+            outFile.close();
+            std::error_code ec;
+            fs::remove(outputPath, ec);
+            throw std::runtime_error(message);
+        };
         
-        // 分块解密（跳过32字节文件头）
-        const size_t bufferSize = 1 * 1024 * 1024; // 1MB
-        std::vector<char> buffer(bufferSize);
-        size_t totalBytes = 0;
-        size_t encryptedSize = fileSize - sizeof(salt) - sizeof(iv);
         int lastProgress = -1; // 跟踪上一次的进度值
-        
-        while (inFile.read(buffer.data(), bufferSize)) {
-            size_t bytesRead = static_cast<size_t>(inFile.gcount());
-            stfDecryptor.Put(
-                reinterpret_cast<const CryptoPP::byte*>(buffer.data()), 
-                bytesRead
-            );
-            
-            totalBytes += bytesRead;
-            if (callback) {
-                int newProgress = static_cast<int>((totalBytes * 100) / encryptedSize);
-                // 只有当进度变化时才调用回调
-                if (newProgress != lastProgress) {
-                    callback(newProgress);
-                    lastProgress = newProgress;
+        for (uint64_t offset = 0; offset < fileSize;) {
+            const size_t len = static_cast<size_t>(std::min<uint64_t>(CIPHER_CHUNK_SIZE, fileSize - offset));
+            if (inFile.readAt(cipher, len, offset) != len) {
+                throw std::runtime_error("读取输入文件失败（文件大小已变化）");
+            }
+            const size_t plainLen = decryptor.update(cipher, len, plain, plainRoom);
+            offset += len;
+            if (!outFile.isOpen()) {
+                const size_t headerSize = decryptor.headerSize();
+                if (headerSize == 0 || fileSize <= headerSize ||
+                    (fileSize - headerSize) % CryptoPP::AES::BLOCKSIZE != 0) {
+                    throw std::runtime_error("加密文件无效: " + inputPath);
                 }
+                if (!outFile.open(outputPath, NativeFile::CreateTruncate)) {
+                    throw std::runtime_error("无法创建输出文件: " + outputPath);
+                }
+                if (decryptor.sparse()) markSparse(outFile, outputPath);
             }
+            writePlain(plain, plainLen);
+            reportProgress(callback, lastProgress, offset, fileSize);
         }
         
-        // 处理最后一块数据
-        size_t lastBytes = static_cast<size_t>(inFile.gcount());
-        if (lastBytes > 0) {
-            stfDecryptor.Put(
-                reinterpret_cast<const CryptoPP::byte*>(buffer.data()), 
-                lastBytes
-            );
+        // 最后校验填充和明文摘要（稀疏格式的摘要由decoder比对）
+        try {
+            const size_t plainLen = decryptor.final(plain, plainRoom,
+                                                    decryptor.sparse() ? nullptr : plainDigest);
+            writePlain(plain, plainLen);
+        } catch (const std::exception& e) {
+            discardOutput(e.what());
         }
-        
-        // 完成解密并移除填充
-        stfDecryptor.MessageEnd();
-        
-        // 清理敏感数据
-        secureWipe(key, sizeof(key));
-        
+        if (decryptor.sparse()) {
+            if (!decoder.finish(decryptor.storedDigest(), plainDigest)) {
+                discardOutput("明文摘要不符，文件已损坏或被篡改");
+            }
+            // 末尾的零段只推进了逻辑偏移，截断到逻辑大小补出结尾的空洞
+            outFile.truncate(decoder.size());
+            outOffset = decoder.size();
+        }
+        if (outputSize) *outputSize = outOffset;
         return true;
     } 
     catch (const CryptoPP::Exception& e) {
         // 精确的错误处理
         std::string error = e.what();
-        if (error.find("InvalidCiphertext") != std::string::npos ||
-            error.find("StreamTransformationFilter") != std::string::npos) {
+        if (error.find("InvalidCiphertext") != std::string::npos) {
             throw std::runtime_error("解密失败: 密码错误或文件已损坏");
         }
         throw std::runtime_error("解密错误: " + error);
@@ -244,14 +1058,802 @@ bool CryptoEngine::decryptFile(const std::string& inputPath,
     }
 }
 
+// 重新读取已写回的明文[0, plainEnd)，比对末尾的明文摘要（原地解密续做时使用，
+// 缓冲区已计入调用方的内存额度）
+static bool plainDigestMatches(const NativeFile& file, uint64_t plainEnd) {
+    if (plainEnd < PLAIN_DIGEST_SIZE) return false;
+    const uint64_t dataEnd = plainEnd - PLAIN_DIGEST_SIZE;
+    CryptoPP::SHA256 hash;
+    CryptoPP::SecByteBlock buffer(IN_PLACE_CHUNK_SIZE); // 析构时清零
+    for (uint64_t offset = 0; offset < dataEnd;) {
+        size_t len = static_cast<size_t>(std::min<uint64_t>(buffer.size(), dataEnd - offset));
+        if (file.readAt(buffer.data(), len, offset) != len) return false;
+        hash.Update(buffer.data(), len);
+        offset += len;
+    }
+    CryptoPP::SecByteBlock stored(PLAIN_DIGEST_SIZE);
+    if (file.readAt(stored.data(), PLAIN_DIGEST_SIZE, dataEnd) != PLAIN_DIGEST_SIZE) return false;
+    CryptoPP::byte digest[PLAIN_DIGEST_SIZE];
+    hash.Final(digest);
+    return std::memcmp(digest, stored.data(), PLAIN_DIGEST_SIZE) == 0;
+}
+
+// 解密单个密文块并检查PKCS填充，prev为前一密文块（或IV）
+static bool blockPaddingValid(const CryptoPP::byte* prev, const CryptoPP::byte* lastBlock,
+                              const CryptoPP::byte* key, size_t keySize) {
+    CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption decryptor;
+    CryptoPP::SecByteBlock plainBlock(CryptoPP::AES::BLOCKSIZE);
+    decryptor.SetKeyWithIV(key, keySize, prev);
+    decryptor.ProcessData(plainBlock.data(), lastBlock, CryptoPP::AES::BLOCKSIZE);
+    size_t pad = plainBlock[CryptoPP::AES::BLOCKSIZE - 1];
+    bool padOk = pad >= 1 && pad <= CryptoPP::AES::BLOCKSIZE;
+    for (size_t i = 0; padOk && i < pad; i++) {
+        padOk = plainBlock[CryptoPP::AES::BLOCKSIZE - 1 - i] == pad;
+    }
+    return padOk;
+}
+
+// 校验末块PKCS填充：只需解密最后一个密文块，前一块（或IV）作为链值
+bool CryptoEngine::finalPaddingValid(const NativeFile& file, uint64_t fileSize,
+                                     size_t headerSize, const CryptoPP::byte* iv,
+                                     const CryptoPP::byte* key, size_t keySize) {
+    const uint64_t payloadSize = fileSize - headerSize;
+    CryptoPP::byte tail[2 * CryptoPP::AES::BLOCKSIZE];
+    const CryptoPP::byte* prev = iv;
+    const CryptoPP::byte* lastBlock = tail + CryptoPP::AES::BLOCKSIZE;
+    if (payloadSize >= sizeof(tail)) {
+        if (file.readAt(tail, sizeof(tail), fileSize - sizeof(tail)) != sizeof(tail)) {
+            return false;
+        }
+        prev = tail;
+    } else if (file.readAt(tail + CryptoPP::AES::BLOCKSIZE, CryptoPP::AES::BLOCKSIZE,
+                           headerSize) != CryptoPP::AES::BLOCKSIZE) {
+        return false;
+    }
+    return blockPaddingValid(prev, lastBlock, key, keySize);
+}
+
+// 校验实现：通读全部密文（发现截断和不可读区域），再检查末块填充
+// 旧文件没有认证信息，正文任意字节都能解密，因此无需解密正文；
+// 带明文摘要的文件解密全部正文，与加密时记录的摘要比对
+bool CryptoEngine::verifyFile(const std::string& inputPath,
+                              const std::string& password,
+                              ProgressCallback callback,
+                              uint64_t knownSize,
+                              uint64_t* badOffset,
+                              const KeyEnvelope::Kek* kek) {
+    if (badOffset) *badOffset = UNKNOWN_SIZE;
+    try {
+        NativeFile file;
+        if (!file.open(inputPath, NativeFile::ReadOnly)) {
+            throw std::runtime_error("无法打开输入文件: " + inputPath);
+        }
+        // 大小取自打开后的句柄，不信任调用方可能已过时的knownSize
+        (void)knownSize;
+        const uint64_t fileSize = file.size();
+        if (fileSize < MIN_ENCRYPTED_SIZE) {
+            if (badOffset) *badOffset = 0;
+            throw std::runtime_error("文件过小，不是有效的加密文件");
+        }
+
+        // 先解析文件头：v2格式在此即可发现密码错误
+        CryptoPP::byte header[MAX_HEADER_SIZE];
+        size_t headerRead = static_cast<size_t>(std::min<uint64_t>(fileSize, MAX_HEADER_SIZE));
+        if (file.readAt(header, headerRead, 0) != headerRead) {
+            if (badOffset) *badOffset = 0;
+            throw std::runtime_error("无法读取加密文件头");
+        }
+        CryptoPP::byte key[CryptoPP::AES::DEFAULT_KEYLENGTH];
+        CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE];
+        uint32_t flags = 0;
+        const size_t headerSize = openHeader(password, header, headerRead, key, iv, &flags, kek);
+        const bool hasDigest = (flags & KeyEnvelope::FLAG_PLAIN_DIGEST) != 0;
+        const bool sparse = hasDigest && (flags & KeyEnvelope::FLAG_SPARSE) != 0;
+
+        const uint64_t payloadSize = fileSize - headerSize;
+        if (fileSize <= headerSize || payloadSize % CryptoPP::AES::BLOCKSIZE != 0) {
+            secureWipe(key, sizeof(key));
+            if (badOffset) *badOffset = fileSize - payloadSize % CryptoPP::AES::BLOCKSIZE;
+            throw std::runtime_error("密文长度不是块大小的整数倍，文件已截断或损坏");
+        }
+
+        MemoryBudget::Buffer buffer(IN_PLACE_CHUNK_SIZE);
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption decryptor;
+        if (hasDigest) decryptor.SetKeyWithIV(key, sizeof(key), iv);
+        PlainDigestTracker tracker(hasDigest ? PLAIN_DIGEST_SIZE : 0, hasDigest && !sparse);
+        SparseDecoder decoder;
+        int lastProgress = -1;
+        for (uint64_t offset = headerSize; offset < fileSize;) {
+            size_t len = static_cast<size_t>(std::min<uint64_t>(buffer.size(), fileSize - offset));
+            size_t got = 0;
+            try {
+                got = file.readAt(buffer.data(), len, offset);
+            } catch (...) {
+                secureWipe(key, sizeof(key));
+                if (badOffset) *badOffset = offset;
+                throw;
+            }
+            if (got != len) {
+                secureWipe(key, sizeof(key));
+                if (badOffset) *badOffset = offset + got;
+                throw std::runtime_error("文件已截断");
+            }
+            offset += len;
+            if (hasDigest) {
+                // CBC解密器在各块之间保持链值；末块去掉填充（填充由下方单独校验）
+                {
+                    PerfStats::Timer timer(PerfStats::Cipher, len);
+                    decryptor.ProcessData(buffer.data(), buffer.data(), len);
+                }
+                if (offset == fileSize) {
+                    size_t pad = buffer.data()[len - 1];
+                    len -= std::min<size_t>(len, (pad >= 1 && pad <= CryptoPP::AES::BLOCKSIZE) ? pad : 0);
+                }
+                tracker.update(buffer.data(), len, [&](const CryptoPP::byte* data, size_t n) {
+                    if (sparse) {
+                        decoder.update(data, n, [](uint64_t, const CryptoPP::byte*, size_t) {});
+                    }
+                });
+            }
+            reportProgress(callback, lastProgress, offset, fileSize);
+        }
+        secureWipe(buffer.data(), buffer.size());
+
+        bool padOk = finalPaddingValid(file, fileSize, headerSize, iv, key, sizeof(key));
+        secureWipe(key, sizeof(key));
+        if (!padOk) {
+            if (badOffset) *badOffset = fileSize - CryptoPP::AES::BLOCKSIZE;
+            throw std::runtime_error("密码错误或文件已损坏");
+        }
+        if (!(sparse ? decoder.finish(tracker, nullptr) : tracker.finish(nullptr))) {
+            throw std::runtime_error("明文摘要不符，文件已损坏或被篡改");
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "校验错误: " << e.what() << std::endl;
+        throw std::runtime_error(std::string("校验失败: ") + e.what());
+    }
+}
+
+// 更换密码实现：文件头小于一个扇区，单次写入后刷盘
+bool CryptoEngine::rekeyFile(const std::string& path,
+                             const std::string& oldPassword,
+                             const KeyEnvelope::Kek& newKek) {
+    try {
+        NativeFile file;
+        if (!file.open(path, NativeFile::ReadWrite)) {
+            throw std::runtime_error("无法打开文件: " + path);
+        }
+
+        CryptoPP::byte header[KeyEnvelope::HEADER_SIZE];
+        if (file.readAt(header, sizeof(header), 0) != sizeof(header) ||
+            !KeyEnvelope::isEnvelope(header, sizeof(header))) {
+            throw std::runtime_error("旧格式文件的密钥由密码直接派生，需重新加密才能更换密码");
+        }
+
+        // 已用新KEK包装（如上次更换中断后重试）时无需改写
+        if (KeyEnvelope::matches(header, newKek)) {
+            CryptoPP::byte probe[KeyEnvelope::DATA_KEY_SIZE];
+            bool done = KeyEnvelope::unwrap(header, newKek, probe);
+            secureWipe(probe, sizeof(probe));
+            if (done) return true;
+        }
+
+        KeyEnvelope::Kek oldKek;
+        KeyEnvelope::deriveKek(oldPassword, KeyEnvelope::salt(header),
+                               KeyEnvelope::iterations(header), oldKek);
+        CryptoPP::byte dataKey[KeyEnvelope::DATA_KEY_SIZE];
+        if (!KeyEnvelope::unwrap(header, oldKek, dataKey)) {
+            throw std::runtime_error("原密码错误或文件已损坏");
+        }
+        KeyEnvelope::rewrap(header, dataKey, newKek);
+        secureWipe(dataKey, sizeof(dataKey));
+
+        file.writeAt(header, sizeof(header), 0);
+        file.sync();
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "更换密码错误: " << e.what() << std::endl;
+        throw std::runtime_error(std::string("更换密码失败: ") + e.what());
+    }
+}
+
+// ==================== 原地加密/解密 ====================
+
+// 撤销日志槽位：记录某一步骤即将被覆盖的原始数据
+// 日志文件包含两个交替写入的槽位，写坏一个时另一个仍然有效
+struct InPlaceJournalSlot {
+    int version = 3;                     // 日志格式版本
+    char mode = 0;                       // 'E' 加密, 'D' 解密
+    uint64_t step = 0;                   // 当前步骤序号
+    uint64_t originalSize = 0;           // 变换前的文件大小
+    size_t headerSize = 0;               // 文件头长度
+    CryptoPP::byte header[MAX_HEADER_SIZE] = {}; // 文件头（v2信封或旧格式salt + IV）
+    CryptoPP::byte chain[CryptoPP::AES::BLOCKSIZE]; // 本步骤的CBC链值
+    CryptoPP::byte keyCheck[CryptoPP::SHA256::DIGESTSIZE] = {}; // 数据密钥校验值（v3）
+    std::vector<CryptoPP::byte> payload; // 本步骤变换前的数据块
+    std::vector<CryptoPP::byte> spill;   // 下一块中会被本步骤覆盖的前缀（仅加密）
+};
+
+// 槽位固定头: magic(8) mode(1) reserved(3) headerLen(4) step(8) chunk(8) size(8)
+//            payloadLen(8) spillLen(8) header(N) chain(16) keyCheck(32) digest(32)
+// v1日志只用于旧格式文件，header固定32字节且不记录headerLen；v2没有keyCheck；
+// 升级前中断的v1/v2日志仍按原布局续做
+struct JournalLayout {
+    const char* magic;
+    size_t headerField;
+    size_t keyCheckField;
+    size_t fixedSize;
+    size_t slotHeader;
+    size_t slotSize;
+};
+
+static JournalLayout journalLayout(int version) {
+    JournalLayout layout;
+    layout.magic = (version == 1) ? "SFMJRNL1" : (version == 2) ? "SFMJRNL2" : "SFMJRNL3";
+    layout.headerField = (version == 1) ? LEGACY_HEADER_SIZE : MAX_HEADER_SIZE;
+    layout.keyCheckField = (version >= 3) ? CryptoPP::SHA256::DIGESTSIZE : 0;
+    layout.fixedSize = 8 * 7 + layout.headerField + CryptoPP::AES::BLOCKSIZE + layout.keyCheckField;
+    layout.slotHeader = layout.fixedSize + CryptoPP::SHA256::DIGESTSIZE;
+    layout.slotSize = layout.slotHeader + IN_PLACE_CHUNK_SIZE + layout.headerField;
+    return layout;
+}
+
+static void putUint32(CryptoPP::byte* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<CryptoPP::byte>(v >> (8 * i));
+}
+
+static uint32_t getUint32(const CryptoPP::byte* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void putUint64(CryptoPP::byte* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = static_cast<CryptoPP::byte>(v >> (8 * i));
+}
+
+static uint64_t getUint64(const CryptoPP::byte* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void journalDigest(const std::vector<CryptoPP::byte>& slot, const JournalLayout& layout,
+                          CryptoPP::byte* digest) {
+    CryptoPP::SHA256 hash;
+    hash.Update(slot.data(), layout.fixedSize);
+    hash.Update(slot.data() + layout.slotHeader, slot.size() - layout.slotHeader);
+    hash.Final(digest);
+}
+
+// 写入日志槽位并刷盘，必须在覆盖对应数据之前完成
+static void writeJournalSlot(NativeFile& journal, const InPlaceJournalSlot& slot) {
+    const JournalLayout layout = journalLayout(slot.version);
+    std::vector<CryptoPP::byte> buf(layout.slotHeader + slot.payload.size() + slot.spill.size());
+    CryptoPP::byte* p = buf.data();
+    std::memcpy(p, layout.magic, 8);
+    p[8] = static_cast<CryptoPP::byte>(slot.mode);
+    if (slot.version != 1) {
+        putUint32(p + 12, static_cast<uint32_t>(slot.headerSize));
+    }
+    putUint64(p + 16, slot.step);
+    putUint64(p + 24, IN_PLACE_CHUNK_SIZE);
+    putUint64(p + 32, slot.originalSize);
+    putUint64(p + 40, slot.payload.size());
+    putUint64(p + 48, slot.spill.size());
+    std::memcpy(p + 56, slot.header, layout.headerField);
+    std::memcpy(p + 56 + layout.headerField, slot.chain, sizeof(slot.chain));
+    std::memcpy(p + 56 + layout.headerField + sizeof(slot.chain), slot.keyCheck, layout.keyCheckField);
+    std::copy(slot.payload.begin(), slot.payload.end(), p + layout.slotHeader);
+    std::copy(slot.spill.begin(), slot.spill.end(),
+              p + layout.slotHeader + slot.payload.size());
+    journalDigest(buf, layout, p + layout.fixedSize);
+
+    journal.writeAt(buf.data(), buf.size(), (slot.step % 2) * layout.slotSize);
+    journal.sync();
+}
+
+static bool readJournalSlot(const NativeFile& journal, int version, uint64_t offset,
+                            InPlaceJournalSlot& slot) {
+    const JournalLayout layout = journalLayout(version);
+    std::vector<CryptoPP::byte> buf(layout.slotHeader);
+    if (journal.readAt(buf.data(), buf.size(), offset) != buf.size()) return false;
+
+    const CryptoPP::byte* p = buf.data();
+    if (std::memcmp(p, layout.magic, 8) != 0) return false;
+    if (getUint64(p + 24) != IN_PLACE_CHUNK_SIZE) return false;
+    uint64_t headerSize = (version == 1) ? LEGACY_HEADER_SIZE : getUint32(p + 12);
+    uint64_t payloadLen = getUint64(p + 40);
+    uint64_t spillLen = getUint64(p + 48);
+    if (headerSize > layout.headerField || payloadLen > IN_PLACE_CHUNK_SIZE ||
+        spillLen > layout.headerField) {
+        return false;
+    }
+
+    buf.resize(layout.slotHeader + payloadLen + spillLen);
+    size_t bodyLen = static_cast<size_t>(payloadLen + spillLen);
+    if (journal.readAt(buf.data() + layout.slotHeader, bodyLen,
+                       offset + layout.slotHeader) != bodyLen) {
+        return false;
+    }
+
+    CryptoPP::byte digest[CryptoPP::SHA256::DIGESTSIZE];
+    journalDigest(buf, layout, digest);
+    p = buf.data();
+    if (std::memcmp(digest, p + layout.fixedSize, sizeof(digest)) != 0) return false;
+
+    slot.version = version;
+    slot.mode = static_cast<char>(p[8]);
+    slot.step = getUint64(p + 16);
+    slot.originalSize = getUint64(p + 32);
+    slot.headerSize = static_cast<size_t>(headerSize);
+    std::memcpy(slot.header, p + 56, layout.headerField);
+    std::memcpy(slot.chain, p + 56 + layout.headerField, sizeof(slot.chain));
+    std::memcpy(slot.keyCheck, p + 56 + layout.headerField + sizeof(slot.chain), layout.keyCheckField);
+    slot.payload.assign(p + layout.slotHeader, p + layout.slotHeader + payloadLen);
+    slot.spill.assign(p + layout.slotHeader + payloadLen, p + buf.size());
+    return true;
+}
+
+// 读取日志中最新的有效槽位，没有日志或日志无效时返回false
+static bool loadJournal(const std::string& journalPath, InPlaceJournalSlot& slot) {
+    if (!fs::exists(journalPath)) return false;
+
+    NativeFile journal;
+    if (!journal.open(journalPath, NativeFile::ReadOnly)) return false;
+
+    for (int version : {3, 2, 1}) {
+        const JournalLayout layout = journalLayout(version);
+        InPlaceJournalSlot slots[2];
+        bool valid[2] = {
+            readJournalSlot(journal, version, 0, slots[0]),
+            readJournalSlot(journal, version, layout.slotSize, slots[1])
+        };
+        if (!valid[0] && !valid[1]) continue;
+
+        int latest = (!valid[0] || (valid[1] && slots[1].step > slots[0].step)) ? 1 : 0;
+        slot = std::move(slots[latest]);
+        return true;
+    }
+    return false;
+}
+
+// 日志中的数据密钥校验值，不泄露密钥本身
+static void journalKeyCheck(const CryptoPP::byte* key, size_t keySize, CryptoPP::byte* check) {
+    static const char label[] = "SFM in-place journal key check";
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(key, keySize);
+    hmac.Update(reinterpret_cast<const CryptoPP::byte*>(label), sizeof(label) - 1);
+    hmac.Final(check);
+}
+
+// 续做前确认密码与日志一致，不一致时不得继续变换。
+// v3日志比对密钥校验值；信封文件头在解开数据密钥时已校验密码；
+// 更早日志中的旧格式文件头没有校验值，改为重做上一步并与已写回的数据比对，
+// 第0步的解密则检查仍未覆盖的末块填充。原地加密的第0步没有可比对的数据。
+// payload为本步骤日志中的数据块（调用方已从slot中取走）
+static bool journalKeyMatches(const NativeFile& journal, const NativeFile& file,
+                              const InPlaceJournalSlot& slot,
+                              const std::vector<CryptoPP::byte>& payload,
+                              const CryptoPP::byte* key, size_t keySize) {
+    if (slot.version >= 3) {
+        CryptoPP::byte check[sizeof(slot.keyCheck)];
+        journalKeyCheck(key, keySize, check);
+        return CryptoPP::VerifyBufsEqual(check, slot.keyCheck, sizeof(check));
+    }
+    if (KeyEnvelope::isEnvelope(slot.header, slot.headerSize)) return true;
+
+    if (slot.step == 0) {
+        if (slot.mode != 'D' || payload.size() < CryptoPP::AES::BLOCKSIZE) return true;
+        const uint64_t payloadSize = slot.originalSize - slot.headerSize;
+        if (payload.size() < payloadSize) {
+            // 多于一块时末尾两个密文块仍在文件中
+            CryptoPP::byte tail[2 * CryptoPP::AES::BLOCKSIZE];
+            if (file.readAt(tail, sizeof(tail), slot.originalSize - sizeof(tail)) != sizeof(tail)) {
+                return false;
+            }
+            return blockPaddingValid(tail, tail + CryptoPP::AES::BLOCKSIZE, key, keySize);
+        }
+        // 只有一块，末块密文就在日志中
+        const CryptoPP::byte* lastBlock = payload.data() + payload.size() - CryptoPP::AES::BLOCKSIZE;
+        const CryptoPP::byte* prev = (payload.size() >= 2 * CryptoPP::AES::BLOCKSIZE)
+                                   ? lastBlock - CryptoPP::AES::BLOCKSIZE : slot.chain;
+        return blockPaddingValid(prev, lastBlock, key, keySize);
+    }
+
+    const JournalLayout layout = journalLayout(slot.version);
+    InPlaceJournalSlot prev;
+    if (!readJournalSlot(journal, slot.version, ((slot.step - 1) % 2) * layout.slotSize, prev) ||
+        prev.step + 1 != slot.step || prev.payload.size() != IN_PLACE_CHUNK_SIZE) {
+        return true;
+    }
+    const uint64_t offset = (slot.step - 1) * IN_PLACE_CHUNK_SIZE;
+    CryptoPP::SecByteBlock written(prev.payload.size());
+    CryptoPP::SecByteBlock redone(prev.payload.size());
+    uint64_t writtenAt = (slot.mode == 'E') ? slot.headerSize + offset : offset;
+    bool match = file.readAt(written.data(), written.size(), writtenAt) == written.size();
+    if (match && slot.mode == 'E') {
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption encryptor;
+        encryptor.SetKeyWithIV(key, keySize, prev.chain);
+        encryptor.ProcessData(redone.data(), prev.payload.data(), prev.payload.size());
+    } else if (match) {
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption decryptor;
+        decryptor.SetKeyWithIV(key, keySize, prev.chain);
+        decryptor.ProcessData(redone.data(), prev.payload.data(), prev.payload.size());
+    }
+    match = match && CryptoPP::VerifyBufsEqual(redone.data(), written.data(), written.size());
+    CryptoPP::SecureWipeBuffer(prev.payload.data(), prev.payload.size());
+    return match;
+}
+
+// 打开日志；新建时同步父目录，确保覆盖数据之前日志的目录项已经落盘
+static void openJournal(NativeFile& journal, const std::string& journalPath, bool resuming) {
+    if (!journal.open(journalPath, resuming ? NativeFile::ReadWrite : NativeFile::CreateTruncate)) {
+        throw std::runtime_error("无法创建日志文件: " + journalPath);
+    }
+    if (!resuming) {
+        NativeFile::syncDirectory(fs::path(journalPath).parent_path().string());
+    }
+}
+
+// 完成原地处理：重命名并清除日志（日志中含有原始数据，需要安全擦除）
+static void finishInPlace(const std::string& path, const std::string& target,
+                          const std::string& journalPath) {
+    if (target != path) {
+        fs::rename(path, target);
+        NativeFile::syncDirectory(fs::path(target).parent_path().string());
+    }
+    FileProcessor::secureDelete(journalPath);
+}
+
+std::string CryptoEngine::inPlaceTargetPath(const std::string& path, bool encrypt) {
+    if (encrypt) return path + ".enc";
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".enc") == 0) {
+        return path.substr(0, path.size() - 4);
+    }
+    return path;
+}
+
+std::string CryptoEngine::inPlaceJournalPath(const std::string& path) {
+    return path + ".sfmjournal";
+}
+
+// 原地加密实现
+// 密文相对明文后移一个文件头长度：写第k块前必须先读入第k+1块，
+// 并把即将被覆盖的明文记入日志，崩溃后可从日志续做
+bool CryptoEngine::encryptFileInPlace(const std::string& path,
+                                      const std::string& password,
+                                      ProgressCallback callback) {
+    try {
+        const std::string journalPath = inPlaceJournalPath(path);
+        const std::string target = inPlaceTargetPath(path, true);
+        MemoryBudget::Lease memory(IN_PLACE_MEMORY);
+
+        InPlaceJournalSlot slot;
+        bool resuming = loadJournal(journalPath, slot);
+        if (resuming && slot.mode != 'E') {
+            throw std::runtime_error("存在未完成的原地解密日志: " + journalPath);
+        }
+        if (resuming && !fs::exists(path) && fs::exists(target)) {
+            // 上次已完成重命名，只剩日志未清理（擦除自行申请额度）
+            memory.release();
+            FileProcessor::secureDelete(journalPath);
+            return true;
+        }
+        if (!fs::exists(path)) {
+            throw std::runtime_error("输入文件不存在: " + path);
+        }
+        if (!resuming && fs::exists(target)) {
+            throw std::runtime_error("目标文件已存在: " + target);
+        }
+
+        NativeFile file;
+        if (!file.open(path, NativeFile::ReadWrite)) {
+            throw std::runtime_error("无法打开输入文件: " + path);
+        }
+
+        uint64_t plainSize = 0;
+        uint64_t step = 0;
+        std::vector<CryptoPP::byte> cur;
+        std::vector<CryptoPP::byte> resumeSpill;
+        if (resuming) {
+            plainSize = slot.originalSize;
+            step = slot.step;
+            cur = std::move(slot.payload);
+            resumeSpill = std::move(slot.spill);
+        } else {
+            plainSize = file.size();
+            if (plainSize == 0) {
+                throw std::runtime_error("输入文件为空: " + path);
+            }
+            slot.mode = 'E';
+            slot.originalSize = plainSize;
+
+            cur.resize(static_cast<size_t>(std::min<uint64_t>(IN_PLACE_CHUNK_SIZE, plainSize)));
+            if (file.readAt(cur.data(), cur.size(), 0) != cur.size()) {
+                throw std::runtime_error("读取输入文件失败: " + path);
+            }
+        }
+
+        // 新任务生成v2文件头；续做时从日志中的文件头恢复数据密钥
+        CryptoPP::byte key[CryptoPP::AES::DEFAULT_KEYLENGTH];
+        CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE];
+        if (resuming) {
+            openHeader(password, slot.header, slot.headerSize, key, iv);
+        } else {
+            // 续做时无法重建之前各步的哈希状态，原地加密不附加明文摘要
+            KeyEnvelope::Kek kek;
+            KeyEnvelope::newKek(password, kdfIterations(), kek);
+            slot.headerSize = createHeader(kek, slot.header, key, iv, 0);
+            std::memcpy(slot.chain, iv, sizeof(slot.chain));
+            journalKeyCheck(key, sizeof(key), slot.keyCheck);
+        }
+        const size_t headerSize = slot.headerSize;
+
+        NativeFile journal;
+        openJournal(journal, journalPath, resuming);
+        if (resuming && !journalKeyMatches(journal, file, slot, cur, key, sizeof(key))) {
+            secureWipe(key, sizeof(key));
+            throw std::runtime_error("密码与未完成的原地加密日志不符: " + journalPath);
+        }
+
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption encryptor;
+        std::vector<CryptoPP::byte> next;
+        int lastProgress = -1;
+
+        while (true) {
+            uint64_t offset = step * IN_PLACE_CHUNK_SIZE;
+            bool last = offset + cur.size() >= plainSize;
+
+            // 预读下一块：本步骤写入会覆盖其前headerSize字节
+            next.clear();
+            slot.spill.clear();
+            if (!last) {
+                uint64_t nextOffset = offset + IN_PLACE_CHUNK_SIZE;
+                size_t nextLen = static_cast<size_t>(
+                    std::min<uint64_t>(IN_PLACE_CHUNK_SIZE, plainSize - nextOffset));
+                size_t prefix = std::min(resumeSpill.size(), nextLen);
+                next.resize(nextLen);
+                std::copy(resumeSpill.begin(), resumeSpill.begin() + prefix, next.begin());
+                if (file.readAt(next.data() + prefix, nextLen - prefix, nextOffset + prefix)
+                        != nextLen - prefix) {
+                    throw std::runtime_error("读取输入文件失败: " + path);
+                }
+                slot.spill.assign(next.begin(), next.begin() + std::min(headerSize, nextLen));
+            }
+            resumeSpill.clear();
+
+            // 先落盘日志，再覆盖数据
+            slot.step = step;
+            slot.payload = cur;
+            writeJournalSlot(journal, slot);
+
+            if (last) {
+                // PKCS填充
+                size_t pad = CryptoPP::AES::BLOCKSIZE - (cur.size() % CryptoPP::AES::BLOCKSIZE);
+                cur.insert(cur.end(), pad, static_cast<CryptoPP::byte>(pad));
+            }
+
+            encryptor.SetKeyWithIV(key, sizeof(key), slot.chain);
+            {
+                PerfStats::Timer timer(PerfStats::Cipher, cur.size());
+                encryptor.ProcessData(cur.data(), cur.data(), cur.size());
+            }
+
+            if (step == 0) {
+                file.writeAt(slot.header, headerSize, 0);
+            }
+            file.writeAt(cur.data(), cur.size(), headerSize + offset);
+            file.sync();
+
+            std::memcpy(slot.chain, cur.data() + cur.size() - CryptoPP::AES::BLOCKSIZE,
+                        sizeof(slot.chain));
+            reportProgress(callback, lastProgress, offset + cur.size(), plainSize);
+
+            if (last) break;
+            secureWipe(cur.data(), cur.size());
+            cur.swap(next);
+            step++;
+        }
+
+        secureWipe(key, sizeof(key));
+        secureWipe(slot.payload.data(), slot.payload.size());
+        secureWipe(next.data(), next.size());
+        // 分块缓冲区不再使用，先归还额度再擦除日志（擦除自行申请额度）
+        std::vector<CryptoPP::byte>().swap(cur);
+        std::vector<CryptoPP::byte>().swap(next);
+        std::vector<CryptoPP::byte>().swap(slot.payload);
+        memory.release();
+
+        file.close();
+        journal.close();
+        finishInPlace(path, target, journalPath);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "原地加密错误: " << e.what() << std::endl;
+        throw std::runtime_error(std::string("原地加密失败: ") + e.what());
+    }
+}
+
+// 原地解密实现
+// 明文相对密文前移一个文件头长度，写第k块只会覆盖已读入的第k块密文
+bool CryptoEngine::decryptFileInPlace(const std::string& path,
+                                      const std::string& password,
+                                      ProgressCallback callback) {
+    try {
+        const std::string journalPath = inPlaceJournalPath(path);
+        const std::string target = inPlaceTargetPath(path, false);
+        MemoryBudget::Lease memory(IN_PLACE_MEMORY);
+
+        InPlaceJournalSlot slot;
+        bool resuming = loadJournal(journalPath, slot);
+        if (resuming && slot.mode != 'D') {
+            throw std::runtime_error("存在未完成的原地加密日志: " + journalPath);
+        }
+        if (resuming && !fs::exists(path) && fs::exists(target)) {
+            memory.release();
+            FileProcessor::secureDelete(journalPath);
+            return true;
+        }
+        if (!fs::exists(path)) {
+            throw std::runtime_error("输入文件不存在: " + path);
+        }
+        if (!resuming && target != path && fs::exists(target)) {
+            throw std::runtime_error("目标文件已存在: " + target);
+        }
+
+        NativeFile file;
+        if (!file.open(path, NativeFile::ReadWrite)) {
+            throw std::runtime_error("无法打开输入文件: " + path);
+        }
+
+        uint64_t step = 0;
+        std::vector<CryptoPP::byte> cur;
+        CryptoPP::byte key[CryptoPP::AES::DEFAULT_KEYLENGTH];
+        CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE];
+        uint32_t flags = 0;
+        if (resuming) {
+            step = slot.step;
+            cur = std::move(slot.payload);
+            openHeader(password, slot.header, slot.headerSize, key, iv, &flags);
+        } else {
+            slot.originalSize = file.size();
+            size_t headerRead = static_cast<size_t>(
+                std::min<uint64_t>(slot.originalSize, MAX_HEADER_SIZE));
+            if (file.readAt(slot.header, headerRead, 0) != headerRead) {
+                throw std::runtime_error("无法读取加密文件头");
+            }
+            slot.headerSize = openHeader(password, slot.header, headerRead, key, iv, &flags);
+            if (slot.originalSize <= slot.headerSize ||
+                (slot.originalSize - slot.headerSize) % CryptoPP::AES::BLOCKSIZE != 0 ||
+                ((flags & KeyEnvelope::FLAG_PLAIN_DIGEST) &&
+                 slot.originalSize - slot.headerSize < PLAIN_DIGEST_SIZE + CryptoPP::AES::BLOCKSIZE)) {
+                secureWipe(key, sizeof(key));
+                throw std::runtime_error("加密文件无效: " + path);
+            }
+            // 稀疏记录流展开后可能远大于密文，无法在原文件中逐块写回
+            if (flags & KeyEnvelope::FLAG_SPARSE) {
+                secureWipe(key, sizeof(key));
+                throw std::runtime_error("稀疏格式的加密文件不支持原地解密: " + path);
+            }
+            std::memcpy(slot.chain, iv, sizeof(slot.chain));
+            journalKeyCheck(key, sizeof(key), slot.keyCheck);
+            slot.mode = 'D';
+        }
+        const size_t headerSize = slot.headerSize;
+        const uint64_t payloadSize = slot.originalSize - headerSize;
+        const bool hasDigest = (flags & KeyEnvelope::FLAG_PLAIN_DIGEST) != 0;
+        // 从头开始时边解密边计算明文摘要；续做时之前的明文已写回文件，末步重新读取校验
+        PlainDigestTracker tracker(hasDigest ? PLAIN_DIGEST_SIZE : 0, hasDigest && !resuming);
+        bool digestOk = true;
+
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption decryptor;
+
+        if (!resuming) {
+            // 修改文件前先校验末块填充，密码错误时不破坏任何数据
+            if (!finalPaddingValid(file, slot.originalSize, headerSize, slot.chain,
+                                   key, sizeof(key))) {
+                secureWipe(key, sizeof(key));
+                throw std::runtime_error("解密失败: 密码错误或文件已损坏");
+            }
+        }
+
+        NativeFile journal;
+        openJournal(journal, journalPath, resuming);
+        if (resuming && !journalKeyMatches(journal, file, slot, cur, key, sizeof(key))) {
+            secureWipe(key, sizeof(key));
+            throw std::runtime_error("密码与未完成的原地解密日志不符: " + journalPath);
+        }
+
+        int lastProgress = -1;
+        bool haveCur = resuming;
+
+        while (true) {
+            uint64_t offset = step * IN_PLACE_CHUNK_SIZE;
+            size_t len = static_cast<size_t>(
+                std::min<uint64_t>(IN_PLACE_CHUNK_SIZE, payloadSize - offset));
+            bool last = offset + len >= payloadSize;
+
+            if (!haveCur) {
+                cur.resize(len);
+                if (file.readAt(cur.data(), len, headerSize + offset) != len) {
+                    throw std::runtime_error("读取输入文件失败: " + path);
+                }
+            }
+            haveCur = false;
+
+            slot.step = step;
+            slot.payload = cur;
+            writeJournalSlot(journal, slot);
+
+            CryptoPP::byte nextChain[CryptoPP::AES::BLOCKSIZE];
+            std::memcpy(nextChain, cur.data() + cur.size() - CryptoPP::AES::BLOCKSIZE,
+                        sizeof(nextChain));
+
+            decryptor.SetKeyWithIV(key, sizeof(key), slot.chain);
+            {
+                PerfStats::Timer timer(PerfStats::Cipher, cur.size());
+                decryptor.ProcessData(cur.data(), cur.data(), cur.size());
+            }
+
+            size_t outLen = cur.size();
+            if (last) {
+                size_t pad = cur.back();
+                if (pad < 1 || pad > CryptoPP::AES::BLOCKSIZE || pad > outLen) {
+                    throw std::runtime_error("解密失败: 密码错误或文件已损坏");
+                }
+                outLen -= pad;
+            }
+
+            if (hasDigest && !resuming) {
+                tracker.update(cur.data(), outLen, [](const CryptoPP::byte*, size_t) {});
+            }
+            file.writeAt(cur.data(), outLen, offset);
+            if (last) {
+                uint64_t plainEnd = offset + outLen;
+                if (hasDigest) {
+                    // 截断前比对，摘要尾部随截断移除
+                    digestOk = resuming ? plainDigestMatches(file, plainEnd) : tracker.finish(nullptr);
+                    plainEnd -= PLAIN_DIGEST_SIZE;
+                }
+                file.truncate(plainEnd);
+            }
+            file.sync();
+
+            std::memcpy(slot.chain, nextChain, sizeof(slot.chain));
+            reportProgress(callback, lastProgress, offset + len, payloadSize);
+
+            secureWipe(cur.data(), cur.size());
+            if (last) break;
+            step++;
+        }
+
+        secureWipe(key, sizeof(key));
+        secureWipe(slot.payload.data(), slot.payload.size());
+        std::vector<CryptoPP::byte>().swap(cur);
+        std::vector<CryptoPP::byte>().swap(slot.payload);
+        memory.release();
+
+        file.close();
+        journal.close();
+        finishInPlace(path, target, journalPath);
+        // 数据已全部写回，无法撤销，只能报告
+        if (!digestOk) {
+            throw std::runtime_error("明文摘要不符，解密结果已损坏或被篡改: " + target);
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "原地解密错误: " << e.what() << std::endl;
+        throw std::runtime_error(std::string("原地解密失败: ") + e.what());
+    }
+}
+
 // 检查是否为加密文件
 bool CryptoEngine::isEncryptedFile(const std::string& path) {
     try {
         if (!fs::exists(path)) return false;
         
-        // 加密文件最小大小 = salt(16) + IV(16) + 最小加密块(16)
-        size_t minEncSize = 16 + CryptoPP::AES::BLOCKSIZE + CryptoPP::AES::BLOCKSIZE;
-        if (fs::file_size(path) < minEncSize) return false;
+        if (fs::file_size(path) < MIN_ENCRYPTED_SIZE) return false;
         
         std::ifstream file(path, std::ios::binary);
         char header[32]; // 读取文件头
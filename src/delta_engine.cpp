@@ -0,0 +1,526 @@
+#include "../include/delta_engine.h"
+#include "../include/crypto_engine.h"
+#include "../include/memory_budget.h"
+#include "../include/native_file.h"
+#include "../include/perf_stats.h"
+#include "../include/session_key_cache.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <cryptopp/aes.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/gcm.h>
+#include <cryptopp/hex.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/misc.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/sha.h>
+
+namespace fs = std::filesystem;
+
+// 密文头: magic(8) chunkSize(4) iterations(4) plainSize(8) salt(16) keyCheck(16) state(4) generation(4)
+// iterations为0的旧密文按10000次迭代派生。
+// v2在最后一个记录之后附加尾部MAC，覆盖文件头和每个记录的nonce与GCM标签，
+// 块被替换为旧版本、截断后改写plainSize都无法通过校验；
+// 更新前先把state标记为更新中并落盘，全部写完后才恢复，更新未完成的密文拒绝解密。
+// v1没有state和尾部MAC，仍可解密，再次加密时整体重写为v2
+static const char CONTAINER_MAGIC[8] = {'S', 'F', 'M', 'D', 'E', 'L', 'T', '2'};
+static const char CONTAINER_MAGIC_V1[8] = {'S', 'F', 'M', 'D', 'E', 'L', 'T', '1'};
+static const size_t CONTAINER_HEADER_SIZE = 64;
+static const size_t STATE_OFFSET = 56;
+static const size_t GENERATION_OFFSET = 60;
+static const uint32_t STATE_CLEAN = 0;
+static const uint32_t STATE_UPDATING = 1;
+static const size_t TRAILER_SIZE = CryptoPP::SHA256::DIGESTSIZE;
+// 索引头: magic(8) clean(4) chunkSize(4) plainSize(8) count(8) salt(16) generation(4) 补齐到56字节
+// generation与密文头一致时才复用索引中的摘要
+static const char INDEX_MAGIC[8] = {'S', 'F', 'M', 'D', 'I', 'D', 'X', '2'};
+static const size_t INDEX_HEADER_SIZE = 56;
+
+static const size_t SALT_SIZE = 16;
+static const size_t KEY_CHECK_SIZE = 16;
+static const size_t NONCE_SIZE = 12;
+static const size_t TAG_SIZE = 16;
+static const size_t RECORD_OVERHEAD = NONCE_SIZE + TAG_SIZE;
+static const size_t DIGEST_SIZE = CryptoPP::SHA256::DIGESTSIZE;
+static const size_t ENC_KEY_SIZE = CryptoPP::AES::DEFAULT_KEYLENGTH;
+static const size_t MAC_KEY_SIZE = 32;
+
+// 派生的密钥材料：前16字节为加密密钥，后32字节为摘要密钥
+struct DeltaKeys {
+    CryptoPP::byte enc[ENC_KEY_SIZE];
+    CryptoPP::byte mac[MAC_KEY_SIZE];
+    CryptoPP::byte check[KEY_CHECK_SIZE];
+
+    ~DeltaKeys() {
+        volatile CryptoPP::byte* p = reinterpret_cast<volatile CryptoPP::byte*>(this);
+        for (size_t i = 0; i < sizeof(*this); i++) p[i] = 0;
+    }
+};
+
+static void putUint32(CryptoPP::byte* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<CryptoPP::byte>(v >> (8 * i));
+}
+
+static uint32_t getUint32(const CryptoPP::byte* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void putUint64(CryptoPP::byte* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = static_cast<CryptoPP::byte>(v >> (8 * i));
+}
+
+static uint64_t getUint64(const CryptoPP::byte* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void deriveKeys(const std::string& password, const CryptoPP::byte* salt,
+                       uint32_t iterations, DeltaKeys& keys) {
+    CryptoPP::byte material[ENC_KEY_SIZE + MAC_KEY_SIZE];
+    SessionKeyCache::derive(password, salt, SALT_SIZE, iterations, material, sizeof(material));
+    std::memcpy(keys.enc, material, ENC_KEY_SIZE);
+    std::memcpy(keys.mac, material + ENC_KEY_SIZE, MAC_KEY_SIZE);
+
+    // 密钥校验值：修改密文前先确认密码正确
+    static const char label[] = "SFMDELT1 key check";
+    CryptoPP::byte mac[DIGEST_SIZE];
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(keys.mac, MAC_KEY_SIZE);
+    hmac.CalculateDigest(mac, reinterpret_cast<const CryptoPP::byte*>(label), sizeof(label) - 1);
+    std::memcpy(keys.check, mac, KEY_CHECK_SIZE);
+
+    volatile CryptoPP::byte* p = material;
+    for (size_t i = 0; i < sizeof(material); i++) p[i] = 0;
+}
+
+static uint32_t headerIterations(const CryptoPP::byte* header) {
+    uint32_t iterations = getUint32(header + 12);
+    return iterations == 0 ? 10000 : iterations;
+}
+
+static uint64_t chunkCount(uint64_t plainSize) {
+    return (plainSize + DeltaEngine::CHUNK_SIZE - 1) / DeltaEngine::CHUNK_SIZE;
+}
+
+static uint64_t recordOffset(uint64_t index) {
+    return CONTAINER_HEADER_SIZE + index * (DeltaEngine::CHUNK_SIZE + RECORD_OVERHEAD);
+}
+
+static uint64_t containerSize(uint64_t plainSize) {
+    uint64_t count = chunkCount(plainSize);
+    if (count == 0) return CONTAINER_HEADER_SIZE;
+    uint64_t lastLen = plainSize - (count - 1) * DeltaEngine::CHUNK_SIZE;
+    return recordOffset(count - 1) + lastLen + RECORD_OVERHEAD;
+}
+
+// 读取第index个记录的nonce和GCM标签
+static bool readSeal(const NativeFile& file, uint64_t index, size_t len, CryptoPP::byte* seal) {
+    return file.readAt(seal, NONCE_SIZE, recordOffset(index)) == NONCE_SIZE &&
+           file.readAt(seal + NONCE_SIZE, TAG_SIZE, recordOffset(index) + NONCE_SIZE + len) == TAG_SIZE;
+}
+
+// 尾部MAC：HMAC(摘要密钥, 标签 | 文件头 | 各记录的nonce和标签)，文件头中state为完成
+static void containerMac(const DeltaKeys& keys, const CryptoPP::byte* header,
+                         const std::vector<CryptoPP::byte>& seals, CryptoPP::byte* mac) {
+    static const char label[] = "SFMDELT2 container mac";
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(keys.mac, MAC_KEY_SIZE);
+    hmac.Update(reinterpret_cast<const CryptoPP::byte*>(label), sizeof(label) - 1);
+    hmac.Update(header, CONTAINER_HEADER_SIZE);
+    hmac.Update(seals.data(), seals.size());
+    hmac.Final(mac);
+}
+
+static void reportProgress(DeltaEngine::ProgressCallback& callback, int& lastProgress,
+                           uint64_t done, uint64_t total) {
+    if (!callback || total == 0) return;
+    int newProgress = static_cast<int>((done * 100) / total);
+    if (newProgress != lastProgress) {
+        callback(newProgress);
+        lastProgress = newProgress;
+    }
+}
+
+std::string DeltaEngine::indexPath(const std::string& outputPath) {
+    return outputPath + ".sfmidx";
+}
+
+bool DeltaEngine::isDeltaFile(const std::string& path) {
+    NativeFile file;
+    if (!file.open(path, NativeFile::ReadOnly)) return false;
+    char magic[sizeof(CONTAINER_MAGIC)];
+    try {
+        if (file.readAt(magic, sizeof(magic), 0) != sizeof(magic)) return false;
+    } catch (...) {
+        return false;
+    }
+    return std::memcmp(magic, CONTAINER_MAGIC, sizeof(magic)) == 0 ||
+           std::memcmp(magic, CONTAINER_MAGIC_V1, sizeof(magic)) == 0;
+}
+
+// 分块加密实现
+bool DeltaEngine::encryptFile(const std::string& inputPath,
+                              const std::string& outputPath,
+                              const std::string& password,
+                              ProgressCallback callback,
+                              Stats* stats,
+                              std::string* plainDigest) {
+    try {
+        NativeFile inFile;
+        if (!inFile.open(inputPath, NativeFile::ReadOnly)) {
+            throw std::runtime_error("无法打开输入文件: " + inputPath);
+        }
+        const uint64_t plainSize = inFile.size();
+        if (plainSize == 0) {
+            throw std::runtime_error("输入文件为空: " + inputPath);
+        }
+        const uint64_t count = chunkCount(plainSize);
+
+        // 尝试复用已有密文：密码正确时沿用其salt和索引
+        CryptoPP::byte header[CONTAINER_HEADER_SIZE] = {};
+        DeltaKeys keys;
+        bool reuse = false;
+        std::vector<CryptoPP::byte> oldDigests;
+        const std::string idxPath = indexPath(outputPath);
+
+        // v1密文不复用，整体重写为v2
+        NativeFile outFile;
+        if (fs::exists(outputPath) && outFile.open(outputPath, NativeFile::ReadWrite)) {
+            if (outFile.readAt(header, sizeof(header), 0) == sizeof(header) &&
+                std::memcmp(header, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) == 0 &&
+                getUint32(header + 8) == CHUNK_SIZE) {
+                deriveKeys(password, header + 24, headerIterations(header), keys);
+                reuse = std::memcmp(keys.check, header + 24 + SALT_SIZE, KEY_CHECK_SIZE) == 0;
+            }
+        }
+
+        uint32_t generation = 1;
+        if (reuse) {
+            const uint64_t oldPlainSize = getUint64(header + 16);
+            const uint32_t oldGeneration = getUint32(header + GENERATION_OFFSET);
+            const bool wasClean = getUint32(header + STATE_OFFSET) == STATE_CLEAN;
+            generation = oldGeneration + 1;
+            NativeFile idxFile;
+            CryptoPP::byte idxHeader[INDEX_HEADER_SIZE];
+            if (idxFile.open(idxPath, NativeFile::ReadWrite) &&
+                idxFile.readAt(idxHeader, sizeof(idxHeader), 0) == sizeof(idxHeader) &&
+                std::memcmp(idxHeader, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+                getUint32(idxHeader + 8) == 1 &&
+                getUint32(idxHeader + 12) == CHUNK_SIZE &&
+                getUint64(idxHeader + 16) == oldPlainSize &&
+                getUint64(idxHeader + 24) == chunkCount(oldPlainSize) &&
+                std::memcmp(idxHeader + 32, header + 24, SALT_SIZE) == 0 &&
+                getUint32(idxHeader + 48) == oldGeneration && wasClean) {
+                oldDigests.resize(static_cast<size_t>(chunkCount(oldPlainSize) * DIGEST_SIZE));
+                if (idxFile.readAt(oldDigests.data(), oldDigests.size(), INDEX_HEADER_SIZE)
+                        != oldDigests.size()) {
+                    oldDigests.clear();
+                }
+                // 修改密文前先把索引标记为脏，崩溃后下次运行会全量重写
+                CryptoPP::byte dirty[4];
+                putUint32(dirty, 0);
+                idxFile.writeAt(dirty, sizeof(dirty), 8);
+                idxFile.sync();
+            }
+        } else {
+            if (!outFile.open(outputPath, NativeFile::CreateTruncate)) {
+                throw std::runtime_error("无法创建输出文件: " + outputPath);
+            }
+            std::memset(header, 0, sizeof(header));
+            std::memcpy(header, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+            putUint32(header + 8, CHUNK_SIZE);
+            putUint32(header + 12, CryptoEngine::kdfIterations());
+            CryptoPP::AutoSeededRandomPool rng;
+            rng.GenerateBlock(header + 24, SALT_SIZE);
+            deriveKeys(password, header + 24, headerIterations(header), keys);
+            std::memcpy(header + 24 + SALT_SIZE, keys.check, KEY_CHECK_SIZE);
+        }
+        const uint64_t oldCount = oldDigests.size() / DIGEST_SIZE;
+
+        // 修改任何记录之前先把密文头标记为更新中并落盘
+        putUint32(header + STATE_OFFSET, STATE_UPDATING);
+        putUint32(header + GENERATION_OFFSET, generation);
+        outFile.writeAt(header, sizeof(header), 0);
+        outFile.sync();
+
+        Stats local;
+        local.totalChunks = count;
+        // 分块缓冲区和新旧两份索引一起计入内存预算
+        MemoryBudget::Lease memory(2 * CHUNK_SIZE + RECORD_OVERHEAD +
+                                   static_cast<size_t>(count * (DIGEST_SIZE + RECORD_OVERHEAD)) +
+                                   oldDigests.size());
+        std::vector<CryptoPP::byte> newDigests(static_cast<size_t>(count * DIGEST_SIZE));
+        std::vector<CryptoPP::byte> seals(static_cast<size_t>(count * RECORD_OVERHEAD));
+        std::vector<CryptoPP::byte> plain(CHUNK_SIZE);
+        std::vector<CryptoPP::byte> record(CHUNK_SIZE + RECORD_OVERHEAD);
+        CryptoPP::HMAC<CryptoPP::SHA256> hmac(keys.mac, MAC_KEY_SIZE);
+        CryptoPP::SHA256 plainHash;
+        CryptoPP::GCM<CryptoPP::AES>::Encryption gcm;
+        CryptoPP::AutoSeededRandomPool rng;
+        int lastProgress = -1;
+
+        for (uint64_t i = 0; i < count; i++) {
+            size_t len = static_cast<size_t>(std::min<uint64_t>(CHUNK_SIZE, plainSize - i * CHUNK_SIZE));
+            if (inFile.readAt(plain.data(), len, i * CHUNK_SIZE) != len) {
+                throw std::runtime_error("读取输入文件失败（文件大小已变化）");
+            }
+
+            CryptoPP::byte* digest = newDigests.data() + i * DIGEST_SIZE;
+            {
+                PerfStats::Timer timer(PerfStats::Hash, len);
+                hmac.CalculateDigest(digest, plain.data(), len);
+                if (plainDigest) plainHash.Update(plain.data(), len);
+            }
+
+            // 摘要未变化的块保持原样，只读取其nonce和标签用于尾部MAC
+            CryptoPP::byte* seal = seals.data() + i * RECORD_OVERHEAD;
+            if (i < oldCount &&
+                std::memcmp(digest, oldDigests.data() + i * DIGEST_SIZE, DIGEST_SIZE) == 0 &&
+                readSeal(outFile, i, len, seal)) {
+                reportProgress(callback, lastProgress, i * CHUNK_SIZE + len, plainSize);
+                continue;
+            }
+
+            // 新块使用新的随机nonce，块序号作为附加认证数据防止块被调换
+            CryptoPP::byte aad[8];
+            putUint64(aad, i);
+            CryptoPP::byte* nonce = record.data();
+            rng.GenerateBlock(nonce, NONCE_SIZE);
+            {
+                PerfStats::Timer timer(PerfStats::Cipher, len);
+                gcm.SetKeyWithIV(keys.enc, ENC_KEY_SIZE, nonce, NONCE_SIZE);
+                gcm.EncryptAndAuthenticate(record.data() + NONCE_SIZE,
+                                           record.data() + NONCE_SIZE + len, TAG_SIZE,
+                                           nonce, NONCE_SIZE, aad, sizeof(aad),
+                                           plain.data(), len);
+            }
+            outFile.writeAt(record.data(), len + RECORD_OVERHEAD, recordOffset(i));
+            std::memcpy(seal, nonce, NONCE_SIZE);
+            std::memcpy(seal + NONCE_SIZE, record.data() + NONCE_SIZE + len, TAG_SIZE);
+
+            local.rewrittenChunks++;
+            local.bytesWritten += len + RECORD_OVERHEAD;
+            reportProgress(callback, lastProgress, i * CHUNK_SIZE + len, plainSize);
+        }
+
+        // 写入尾部MAC并截去多余的旧块，落盘后才把文件头恢复为完成状态
+        putUint64(header + 16, plainSize);
+        putUint32(header + STATE_OFFSET, STATE_CLEAN);
+        CryptoPP::byte mac[TRAILER_SIZE];
+        containerMac(keys, header, seals, mac);
+        outFile.writeAt(mac, sizeof(mac), containerSize(plainSize));
+        outFile.truncate(containerSize(plainSize) + TRAILER_SIZE);
+        outFile.sync();
+        outFile.writeAt(header, sizeof(header), 0);
+        outFile.sync();
+        local.bytesWritten += sizeof(header) + sizeof(mac);
+
+        // 写入新的索引（最后才标记为干净）
+        NativeFile idxFile;
+        if (!idxFile.open(idxPath, NativeFile::CreateTruncate)) {
+            throw std::runtime_error("无法创建索引文件: " + idxPath);
+        }
+        CryptoPP::byte idxHeader[INDEX_HEADER_SIZE] = {};
+        std::memcpy(idxHeader, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        putUint32(idxHeader + 8, 0);
+        putUint32(idxHeader + 12, CHUNK_SIZE);
+        putUint64(idxHeader + 16, plainSize);
+        putUint64(idxHeader + 24, count);
+        std::memcpy(idxHeader + 32, header + 24, SALT_SIZE);
+        putUint32(idxHeader + 48, generation);
+        idxFile.writeAt(idxHeader, sizeof(idxHeader), 0);
+        idxFile.writeAt(newDigests.data(), newDigests.size(), INDEX_HEADER_SIZE);
+        idxFile.sync();
+        CryptoPP::byte clean[4];
+        putUint32(clean, 1);
+        idxFile.writeAt(clean, sizeof(clean), 8);
+        idxFile.sync();
+
+        volatile CryptoPP::byte* p = plain.data();
+        for (size_t i = 0; i < plain.size(); i++) p[i] = 0;
+
+        if (plainDigest) {
+            CryptoPP::byte sha[DIGEST_SIZE];
+            plainHash.Final(sha);
+            plainDigest->clear();
+            CryptoPP::StringSource(sha, sizeof(sha), true,
+                new CryptoPP::HexEncoder(new CryptoPP::StringSink(*plainDigest), false));
+        }
+        if (stats) *stats = local;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "分块加密错误: " << e.what() << std::endl;
+        throw std::runtime_error(std::string("分块加密失败: ") + e.what());
+    }
+}
+
+// 逐块解密并校验GCM标签；outputPath为空时只校验不写出
+// v2密文先核对尾部MAC再写出明文，任一校验失败时删除已写出的部分
+// badOffset返回首个出错记录在密文中的偏移
+static void decryptContainer(const std::string& inputPath,
+                             const std::string& password,
+                             const std::string* outputPath,
+                             DeltaEngine::ProgressCallback& callback,
+                             uint64_t* badOffset) {
+    NativeFile inFile;
+    if (!inFile.open(inputPath, NativeFile::ReadOnly)) {
+        throw std::runtime_error("无法打开输入文件: " + inputPath);
+    }
+
+    CryptoPP::byte header[CONTAINER_HEADER_SIZE];
+    const bool headerRead = inFile.readAt(header, sizeof(header), 0) == sizeof(header);
+    const bool legacy = headerRead &&
+        std::memcmp(header, CONTAINER_MAGIC_V1, sizeof(CONTAINER_MAGIC_V1)) == 0;
+    if (!headerRead ||
+        (!legacy && std::memcmp(header, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0) ||
+        getUint32(header + 8) != DeltaEngine::CHUNK_SIZE) {
+        if (badOffset) *badOffset = 0;
+        throw std::runtime_error("分块加密文件无效: " + inputPath);
+    }
+    if (!legacy && getUint32(header + STATE_OFFSET) != STATE_CLEAN) {
+        if (badOffset) *badOffset = 0;
+        throw std::runtime_error("分块加密文件的上次更新未完成，内容不一致: " + inputPath);
+    }
+    const uint64_t plainSize = getUint64(header + 16);
+    const uint64_t recordsEnd = containerSize(plainSize);
+    const uint64_t expectedSize = legacy ? recordsEnd : recordsEnd + TRAILER_SIZE;
+    const uint64_t fileSize = inFile.size();
+    if (fileSize != expectedSize) {
+        if (badOffset) *badOffset = std::min(fileSize, expectedSize);
+        throw std::runtime_error("分块加密文件已截断或损坏: " + inputPath);
+    }
+
+    DeltaKeys keys;
+    deriveKeys(password, header + 24, headerIterations(header), keys);
+    if (std::memcmp(keys.check, header + 24 + SALT_SIZE, KEY_CHECK_SIZE) != 0) {
+        throw std::runtime_error("密码错误或文件已损坏");
+    }
+
+    const uint64_t count = chunkCount(plainSize);
+    MemoryBudget::Lease memory(2 * DeltaEngine::CHUNK_SIZE + RECORD_OVERHEAD +
+                               (legacy ? 0 : static_cast<size_t>(count * RECORD_OVERHEAD)));
+
+    // 收集各记录的nonce和标签核对尾部MAC：块被替换或文件头被改写时在写出任何明文之前失败
+    std::vector<CryptoPP::byte> seals;
+    if (!legacy) {
+        seals.resize(static_cast<size_t>(count * RECORD_OVERHEAD));
+        for (uint64_t i = 0; i < count; i++) {
+            size_t len = static_cast<size_t>(
+                std::min<uint64_t>(DeltaEngine::CHUNK_SIZE, plainSize - i * DeltaEngine::CHUNK_SIZE));
+            if (!readSeal(inFile, i, len, seals.data() + i * RECORD_OVERHEAD)) {
+                if (badOffset) *badOffset = recordOffset(i);
+                throw std::runtime_error("读取输入文件失败");
+            }
+        }
+        CryptoPP::byte mac[TRAILER_SIZE];
+        CryptoPP::byte stored[TRAILER_SIZE];
+        containerMac(keys, header, seals, mac);
+        if (inFile.readAt(stored, sizeof(stored), recordsEnd) != sizeof(stored) ||
+            !CryptoPP::VerifyBufsEqual(mac, stored, sizeof(mac))) {
+            if (badOffset) *badOffset = recordsEnd;
+            throw std::runtime_error("分块加密文件完整性校验失败（数据块被替换、截断或更新未完成）");
+        }
+    }
+
+    NativeFile outFile;
+    if (outputPath && !outFile.open(*outputPath, NativeFile::CreateTruncate)) {
+        throw std::runtime_error("无法创建输出文件: " + *outputPath);
+    }
+
+    std::vector<CryptoPP::byte> record(DeltaEngine::CHUNK_SIZE + RECORD_OVERHEAD);
+    std::vector<CryptoPP::byte> plain(DeltaEngine::CHUNK_SIZE);
+    CryptoPP::GCM<CryptoPP::AES>::Decryption gcm;
+    int lastProgress = -1;
+
+    try {
+        for (uint64_t i = 0; i < count; i++) {
+            size_t len = static_cast<size_t>(
+                std::min<uint64_t>(DeltaEngine::CHUNK_SIZE, plainSize - i * DeltaEngine::CHUNK_SIZE));
+            size_t got = 0;
+            try {
+                got = inFile.readAt(record.data(), len + RECORD_OVERHEAD, recordOffset(i));
+            } catch (...) {
+                if (badOffset) *badOffset = recordOffset(i);
+                throw;
+            }
+            if (got != len + RECORD_OVERHEAD) {
+                if (badOffset) *badOffset = recordOffset(i) + got;
+                throw std::runtime_error("读取输入文件失败");
+            }
+            // 记录必须与核对MAC时读到的一致
+            if (!legacy) {
+                const CryptoPP::byte* seal = seals.data() + i * RECORD_OVERHEAD;
+                if (std::memcmp(record.data(), seal, NONCE_SIZE) != 0 ||
+                    std::memcmp(record.data() + NONCE_SIZE + len, seal + NONCE_SIZE, TAG_SIZE) != 0) {
+                    if (badOffset) *badOffset = recordOffset(i);
+                    throw std::runtime_error("分块加密文件在解密期间被修改");
+                }
+            }
+
+            CryptoPP::byte aad[8];
+            putUint64(aad, i);
+            const CryptoPP::byte* nonce = record.data();
+            const uint64_t cipherStart = PerfStats::nowNs();
+            gcm.SetKeyWithIV(keys.enc, ENC_KEY_SIZE, nonce, NONCE_SIZE);
+            bool ok = gcm.DecryptAndVerify(plain.data(),
+                                           record.data() + NONCE_SIZE + len, TAG_SIZE,
+                                           nonce, NONCE_SIZE, aad, sizeof(aad),
+                                           record.data() + NONCE_SIZE, len);
+            PerfStats::record(PerfStats::Cipher, PerfStats::nowNs() - cipherStart, len);
+            if (!ok) {
+                if (badOffset) *badOffset = recordOffset(i);
+                throw std::runtime_error("数据块 " + std::to_string(i) + " 校验失败，文件已损坏");
+            }
+            if (outputPath) {
+                outFile.writeAt(plain.data(), len, i * DeltaEngine::CHUNK_SIZE);
+            }
+            reportProgress(callback, lastProgress, i * DeltaEngine::CHUNK_SIZE + len, plainSize);
+        }
+    } catch (...) {
+        volatile CryptoPP::byte* p = plain.data();
+        for (size_t i = 0; i < plain.size(); i++) p[i] = 0;
+        if (outputPath) {
+            outFile.close();
+            std::error_code ec;
+            fs::remove(*outputPath, ec);
+        }
+        throw;
+    }
+
+    volatile CryptoPP::byte* p = plain.data();
+    for (size_t i = 0; i < plain.size(); i++) p[i] = 0;
+}
+
+// 分块解密实现
+bool DeltaEngine::decryptFile(const std::string& inputPath,
+                              const std::string& outputPath,
+                              const std::string& password,
+                              ProgressCallback callback) {
+    try {
+        decryptContainer(inputPath, password, &outputPath, callback, nullptr);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "分块解密错误: " << e.what() << std::endl;
+        throw std::runtime_error(std::string("分块解密失败: ") + e.what());
+    }
+}
+
+// 分块校验实现：解密到空输出，每块都经过GCM认证
+bool DeltaEngine::verifyFile(const std::string& inputPath,
+                             const std::string& password,
+                             ProgressCallback callback,
+                             uint64_t* badOffset) {
+    if (badOffset) *badOffset = UINT64_MAX;
+    try {
+        decryptContainer(inputPath, password, nullptr, callback, badOffset);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "分块校验错误: " << e.what() << std::endl;
+        throw std::runtime_error(std::string("校验失败: ") + e.what());
+    }
+}
@@ -0,0 +1,614 @@
+#include "../include/encrypted_catalog.h"
+#include "../include/crypto_engine.h"
+#include "../include/output_committer.h"
+#include "../include/perf_stats.h"
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <cryptopp/aes.h>
+#include <cryptopp/gcm.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/sha.h>
+
+namespace fs = std::filesystem;
+
+const char* const EncryptedCatalog::FILE_NAME = ".sfm_catalog";
+
+static const char CATALOG_MAGIC[8] = {'S', 'F', 'M', 'C', 'A', 'T', 'L', '1'};
+static const uint32_t CATALOG_VERSION = 2;
+// v1的页索引不含页编号，保存时重写全部页
+static const uint32_t LEGACY_CATALOG_VERSION = 1;
+static const size_t HEADER_SIZE = 64;
+static const size_t DATA_OFFSET = HEADER_SIZE + KeyEnvelope::HEADER_SIZE;
+static const size_t NONCE_SIZE = 12;
+static const size_t TAG_SIZE = 16;
+static const size_t RECORD_OVERHEAD = NONCE_SIZE + TAG_SIZE;
+static const size_t OUTPUT_SLOT_SIZE = 16;
+// 每页明文的目标大小：查找一个条目只需解密这么多数据
+static const size_t PAGE_TARGET_SIZE = 64 * 1024;
+// 页索引记录的附加认证数据
+static const uint32_t INDEX_RECORD = 0xFFFFFFFFu;
+// 页编号达到该值后换用新的数据密钥重新编号
+static const uint32_t MAX_PAGE_ID = 0x80000000u;
+static const char INDEX_KEY_LABEL[] = "SFMCATL1 output index";
+
+static void putUint32(CryptoPP::byte* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<CryptoPP::byte>(v >> (8 * i));
+}
+
+static uint32_t getUint32(const CryptoPP::byte* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void putUint64(CryptoPP::byte* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = static_cast<CryptoPP::byte>(v >> (8 * i));
+}
+
+static uint64_t getUint64(const CryptoPP::byte* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void appendUint32(std::string& out, uint32_t v) {
+    CryptoPP::byte b[4];
+    putUint32(b, v);
+    out.append(reinterpret_cast<const char*>(b), sizeof(b));
+}
+
+static void appendUint64(std::string& out, uint64_t v) {
+    CryptoPP::byte b[8];
+    putUint64(b, v);
+    out.append(reinterpret_cast<const char*>(b), sizeof(b));
+}
+
+static void appendString(std::string& out, const std::string& s) {
+    appendUint32(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+static void appendEntry(std::string& out, const CatalogEntry& entry) {
+    appendString(out, entry.sourcePath);
+    appendString(out, entry.outputName);
+    appendUint64(out, entry.size);
+    appendUint64(out, static_cast<uint64_t>(entry.mtimeNs));
+    appendString(out, entry.plainDigest);
+}
+
+// 解析已认证的明文；长度不符说明格式错误
+class RecordReader {
+public:
+    explicit RecordReader(const std::string& data) : m_data(data), m_pos(0) {}
+
+    uint32_t u32() {
+        need(4);
+        uint32_t v = getUint32(bytes());
+        m_pos += 4;
+        return v;
+    }
+
+    uint64_t u64() {
+        need(8);
+        uint64_t v = getUint64(bytes());
+        m_pos += 8;
+        return v;
+    }
+
+    std::string str() {
+        const uint32_t len = u32();
+        need(len);
+        std::string s = m_data.substr(m_pos, len);
+        m_pos += len;
+        return s;
+    }
+
+    void entry(CatalogEntry& entry) {
+        entry.sourcePath = str();
+        entry.outputName = str();
+        entry.size = u64();
+        entry.mtimeNs = static_cast<int64_t>(u64());
+        entry.plainDigest = str();
+    }
+
+private:
+    void need(size_t len) const {
+        if (m_data.size() - m_pos < len) {
+            throw std::runtime_error("目录文件已损坏");
+        }
+    }
+
+    const CryptoPP::byte* bytes() const {
+        return reinterpret_cast<const CryptoPP::byte*>(m_data.data()) + m_pos;
+    }
+
+    const std::string& m_data;
+    size_t m_pos;
+};
+
+// 记录: nonce(12) 密文 tag(16)，记录号作为附加认证数据，防止页被调换
+static std::string sealRecord(const CryptoPP::byte* key, uint32_t recordNo, const std::string& plain,
+                              CryptoPP::RandomNumberGenerator& rng) {
+    std::string record(plain.size() + RECORD_OVERHEAD, '\0');
+    CryptoPP::byte* out = reinterpret_cast<CryptoPP::byte*>(&record[0]);
+    CryptoPP::byte aad[4];
+    putUint32(aad, recordNo);
+    rng.GenerateBlock(out, NONCE_SIZE);
+    PerfStats::Timer timer(PerfStats::Cipher, plain.size());
+    CryptoPP::GCM<CryptoPP::AES>::Encryption gcm;
+    gcm.SetKeyWithIV(key, KeyEnvelope::DATA_KEY_SIZE, out, NONCE_SIZE);
+    gcm.EncryptAndAuthenticate(out + NONCE_SIZE, out + NONCE_SIZE + plain.size(), TAG_SIZE,
+                               out, NONCE_SIZE, aad, sizeof(aad),
+                               reinterpret_cast<const CryptoPP::byte*>(plain.data()), plain.size());
+    return record;
+}
+
+static void openRecord(const CryptoPP::byte* key, uint32_t recordNo,
+                       const CryptoPP::byte* record, size_t len, std::string& plain) {
+    if (len < RECORD_OVERHEAD) {
+        throw std::runtime_error("目录文件已损坏");
+    }
+    const size_t plainLen = len - RECORD_OVERHEAD;
+    plain.assign(plainLen, '\0');
+    CryptoPP::byte aad[4];
+    putUint32(aad, recordNo);
+    PerfStats::Timer timer(PerfStats::Cipher, plainLen);
+    CryptoPP::GCM<CryptoPP::AES>::Decryption gcm;
+    gcm.SetKeyWithIV(key, KeyEnvelope::DATA_KEY_SIZE, record, NONCE_SIZE);
+    bool ok = gcm.DecryptAndVerify(reinterpret_cast<CryptoPP::byte*>(&plain[0]),
+                                   record + NONCE_SIZE + plainLen, TAG_SIZE,
+                                   record, NONCE_SIZE, aad, sizeof(aad),
+                                   record + NONCE_SIZE, plainLen);
+    if (!ok) {
+        throw std::runtime_error("目录文件已损坏或被篡改");
+    }
+}
+
+static void wipe(void* ptr, size_t size) {
+    volatile unsigned char* p = static_cast<volatile unsigned char*>(ptr);
+    while (size--) *p++ = 0;
+}
+
+static void wipeString(std::string& s) {
+    if (!s.empty()) wipe(&s[0], s.size());
+    s.clear();
+}
+
+// 输出名的带密钥哈希：索引中不出现明文文件名
+static uint64_t outputTagWithKey(const CryptoPP::byte* indexKey, const std::string& outputName) {
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(indexKey, 32);
+    CryptoPP::byte mac[CryptoPP::SHA256::DIGESTSIZE];
+    hmac.CalculateDigest(mac, reinterpret_cast<const CryptoPP::byte*>(outputName.data()),
+                         outputName.size());
+    return getUint64(mac);
+}
+
+static void deriveIndexKey(const CryptoPP::byte* dataKey, CryptoPP::byte* indexKey) {
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(dataKey, KeyEnvelope::DATA_KEY_SIZE);
+    hmac.CalculateDigest(indexKey, reinterpret_cast<const CryptoPP::byte*>(INDEX_KEY_LABEL),
+                         sizeof(INDEX_KEY_LABEL) - 1);
+}
+
+EncryptedCatalog::~EncryptedCatalog() {
+    wipe(m_dataKey, sizeof(m_dataKey));
+    wipe(m_indexKey, sizeof(m_indexKey));
+}
+
+bool EncryptedCatalog::exists(const std::string& outputDir) {
+    std::error_code ec;
+    return fs::is_regular_file(fs::path(outputDir) / FILE_NAME, ec);
+}
+
+void EncryptedCatalog::open(const std::string& outputDir, const std::string& password) {
+    m_open = false;
+    m_outputDir = outputDir;
+    m_map.unmap();
+    m_file.close();
+    m_pages.clear();
+    m_entryCount = 0;
+    m_outputOffset = 0;
+    m_version = 0;
+    m_nextPageId = 0;
+    m_added.clear();
+    m_addedOutputs.clear();
+    m_removed.clear();
+
+    const std::string path = (fs::path(outputDir) / FILE_NAME).string();
+    NativeFile file;
+    if (!file.open(path, NativeFile::ReadOnly)) {
+        // 新目录：第一次保存时创建
+        KeyEnvelope::newKek(password, CryptoEngine::kdfIterations(), m_kek);
+        m_open = true;
+        return;
+    }
+
+    CryptoPP::byte header[DATA_OFFSET];
+    if (file.readAt(header, sizeof(header), 0) != sizeof(header) ||
+        std::memcmp(header, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 ||
+        !KeyEnvelope::isEnvelope(header + HEADER_SIZE, KeyEnvelope::HEADER_SIZE)) {
+        throw std::runtime_error("不是有效的目录文件: " + path);
+    }
+    const uint32_t version = getUint32(header + 8);
+    if (version != CATALOG_VERSION && version != LEGACY_CATALOG_VERSION) {
+        throw std::runtime_error("不支持的目录文件版本: " + path);
+    }
+
+    // 唯一的一次密钥派生，之后的查找和保存都复用
+    const CryptoPP::byte* envelope = header + HEADER_SIZE;
+    KeyEnvelope::deriveKek(password, KeyEnvelope::salt(envelope),
+                           KeyEnvelope::iterations(envelope), m_kek);
+    if (!KeyEnvelope::unwrap(envelope, m_kek, m_dataKey)) {
+        throw std::runtime_error("密码错误或目录文件已损坏");
+    }
+    m_file = std::move(file);
+    load();
+    m_open = true;
+}
+
+// 映射文件并解密页索引
+void EncryptedCatalog::load() {
+    if (!m_map.map(m_file) || m_map.size() < DATA_OFFSET) {
+        throw std::runtime_error("无法映射目录文件");
+    }
+    const CryptoPP::byte* base = m_map.data();
+    const uint32_t version = getUint32(base + 8);
+    const uint32_t pageCount = getUint32(base + 12);
+    const uint64_t entryCount = getUint64(base + 16);
+    const uint64_t indexOffset = getUint64(base + 24);
+    const uint64_t indexLength = getUint64(base + 32);
+    const uint64_t outputOffset = getUint64(base + 40);
+    const uint64_t fileSize = m_map.size();
+    if (indexOffset < DATA_OFFSET || indexOffset > fileSize || indexLength > fileSize - indexOffset ||
+        outputOffset > fileSize || entryCount > (fileSize - outputOffset) / OUTPUT_SLOT_SIZE) {
+        throw std::runtime_error("目录文件已损坏");
+    }
+    deriveIndexKey(m_dataKey, m_indexKey);
+
+    std::string plain;
+    openRecord(m_dataKey, INDEX_RECORD, base + indexOffset, static_cast<size_t>(indexLength), plain);
+    RecordReader r(plain);
+    // 页数和条目数以认证过的页索引为准
+    if (r.u32() != pageCount || r.u64() != entryCount) {
+        throw std::runtime_error("目录文件已损坏");
+    }
+    std::vector<PageInfo> pages(pageCount);
+    uint64_t total = 0;
+    uint32_t nextPageId = 0;
+    for (uint32_t i = 0; i < pageCount; i++) {
+        PageInfo& page = pages[i];
+        page.offset = r.u64();
+        page.length = r.u32();
+        page.count = r.u32();
+        page.id = (version == LEGACY_CATALOG_VERSION) ? i : r.u32();
+        page.firstPath = r.str();
+        if (page.offset < DATA_OFFSET || page.offset > indexOffset ||
+            page.length > indexOffset - page.offset || page.id >= MAX_PAGE_ID) {
+            throw std::runtime_error("目录文件已损坏");
+        }
+        total += page.count;
+        nextPageId = std::max(nextPageId, page.id + 1);
+    }
+    wipeString(plain);
+    if (total != entryCount) {
+        throw std::runtime_error("目录文件已损坏");
+    }
+    m_pages.swap(pages);
+    m_entryCount = entryCount;
+    m_outputOffset = outputOffset;
+    m_version = version;
+    m_nextPageId = nextPageId;
+}
+
+void EncryptedCatalog::decryptPage(uint32_t page, std::vector<CatalogEntry>& entries) const {
+    const PageInfo& info = m_pages[page];
+    std::string plain;
+    openRecord(m_dataKey, info.id, m_map.data() + info.offset, info.length, plain);
+    RecordReader r(plain);
+    const uint32_t count = r.u32();
+    if (count != info.count) {
+        throw std::runtime_error("目录文件已损坏");
+    }
+    entries.resize(count);
+    for (CatalogEntry& entry : entries) {
+        r.entry(entry);
+    }
+    wipeString(plain);
+}
+
+uint64_t EncryptedCatalog::outputTag(const std::string& outputName) const {
+    return outputTagWithKey(m_indexKey, outputName);
+}
+
+bool EncryptedCatalog::find(const std::string& sourcePath, CatalogEntry& entry) const {
+    // 最后一个首路径不大于sourcePath的页
+    auto it = std::upper_bound(m_pages.begin(), m_pages.end(), sourcePath,
+        [](const std::string& path, const PageInfo& page) { return path < page.firstPath; });
+    if (it == m_pages.begin()) return false;
+    std::vector<CatalogEntry> entries;
+    decryptPage(static_cast<uint32_t>(it - m_pages.begin() - 1), entries);
+    auto found = std::lower_bound(entries.begin(), entries.end(), sourcePath,
+        [](const CatalogEntry& e, const std::string& path) { return e.sourcePath < path; });
+    if (found == entries.end() || found->sourcePath != sourcePath) return false;
+    entry = *found;
+    return true;
+}
+
+bool EncryptedCatalog::contains(const CatalogEntry& entry) const {
+    CatalogEntry stored;
+    return find(entry.sourcePath, stored) && stored.outputName == entry.outputName &&
+           stored.size == entry.size && stored.mtimeNs == entry.mtimeNs &&
+           stored.plainDigest == entry.plainDigest;
+}
+
+bool EncryptedCatalog::findOutput(const std::string& outputName, CatalogEntry& entry) const {
+    if (m_entryCount == 0) return false;
+    const uint64_t tag = outputTag(outputName);
+    const CryptoPP::byte* slots = m_map.data() + m_outputOffset;
+    // 在映射的索引上二分查找，不同输出名的tag可能相同，逐个比对
+    uint64_t lo = 0;
+    uint64_t hi = m_entryCount;
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (getUint64(slots + mid * OUTPUT_SLOT_SIZE) < tag) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    std::vector<CatalogEntry> entries;
+    uint32_t loaded = INDEX_RECORD;
+    for (; lo < m_entryCount && getUint64(slots + lo * OUTPUT_SLOT_SIZE) == tag; lo++) {
+        const CryptoPP::byte* slot = slots + lo * OUTPUT_SLOT_SIZE;
+        const uint32_t page = getUint32(slot + 8);
+        const uint32_t index = getUint32(slot + 12);
+        if (page >= m_pages.size()) continue;
+        if (page != loaded) {
+            decryptPage(page, entries);
+            loaded = page;
+        }
+        if (index < entries.size() && entries[index].outputName == outputName) {
+            entry = entries[index];
+            return true;
+        }
+    }
+    return false;
+}
+
+void EncryptedCatalog::list(const std::string& prefix, const EntryCallback& callback) const {
+    auto it = std::upper_bound(m_pages.begin(), m_pages.end(), prefix,
+        [](const std::string& path, const PageInfo& page) { return path < page.firstPath; });
+    size_t page = (it == m_pages.begin()) ? 0 : static_cast<size_t>(it - m_pages.begin() - 1);
+    std::vector<CatalogEntry> entries;
+    for (; page < m_pages.size(); page++) {
+        decryptPage(static_cast<uint32_t>(page), entries);
+        for (const CatalogEntry& entry : entries) {
+            if (entry.sourcePath < prefix) continue;
+            if (entry.sourcePath.compare(0, prefix.size(), prefix) != 0) return;
+            if (!callback(entry)) return;
+        }
+    }
+}
+
+void EncryptedCatalog::add(const CatalogEntry& entry) {
+    // 同一输出名只保留最后加入的源文件（同名文件覆盖了之前的密文）
+    auto output = m_addedOutputs.find(entry.outputName);
+    if (output != m_addedOutputs.end() && output->second != entry.sourcePath) {
+        m_added.erase(output->second);
+    }
+    auto previous = m_added.find(entry.sourcePath);
+    if (previous != m_added.end() && previous->second.outputName != entry.outputName) {
+        m_addedOutputs.erase(previous->second.outputName);
+    }
+    m_added[entry.sourcePath] = entry;
+    m_addedOutputs[entry.outputName] = entry.sourcePath;
+    m_removed.erase(entry.sourcePath);
+}
+
+void EncryptedCatalog::remove(const std::string& sourcePath) {
+    auto previous = m_added.find(sourcePath);
+    if (previous != m_added.end()) {
+        m_addedOutputs.erase(previous->second.outputName);
+        m_added.erase(previous);
+    }
+    m_removed.insert(sourcePath);
+}
+
+// 按源路径顺序合并旧条目和新条目，流式写出新文件。
+// 沿用数据密钥时，范围内没有修改的页连同其输出名索引原样复制，只有涉及修改的页重新加密；
+// 新目录、v1目录或页编号用尽时换用新的数据密钥并重写全部页
+void EncryptedCatalog::save() {
+    if (!m_open) {
+        throw std::runtime_error("目录未打开");
+    }
+    const std::string finalPath = (fs::path(m_outputDir) / FILE_NAME).string();
+    const std::string tempPath = OutputCommitter::stagingPath(finalPath);
+    NativeFile out;
+    if (!out.open(tempPath, NativeFile::CreateTruncate)) {
+        throw std::runtime_error("无法写入目录文件: " + tempPath);
+    }
+
+    try {
+        const bool reuse = m_version == CATALOG_VERSION && !m_pages.empty() &&
+                           m_nextPageId < MAX_PAGE_ID;
+        CryptoPP::byte header[DATA_OFFSET] = {};
+        CryptoPP::byte dataKey[KeyEnvelope::DATA_KEY_SIZE];
+        CryptoPP::byte indexKey[32];
+        if (reuse) {
+            std::memcpy(header + HEADER_SIZE, m_map.data() + HEADER_SIZE, KeyEnvelope::HEADER_SIZE);
+            std::memcpy(dataKey, m_dataKey, sizeof(dataKey));
+        } else {
+            KeyEnvelope::create(m_kek, 0, header + HEADER_SIZE, dataKey);
+        }
+        deriveIndexKey(dataKey, indexKey);
+        CryptoPP::AutoSeededRandomPool rng;
+
+        struct OutputSlot {
+            uint64_t tag;
+            uint32_t page;
+            uint32_t index;
+        };
+        std::vector<OutputSlot> outputs;
+        std::vector<PageInfo> pages;
+        std::string plain;
+        uint32_t pageEntries = 0;
+        uint64_t offset = DATA_OFFSET;
+        uint32_t nextPageId = reuse ? m_nextPageId : 0;
+
+        // 找出需要重写的页：新增或删除的源路径落在其范围内，或其中有条目的输出名被新条目占用
+        std::vector<bool> dirty(m_pages.size(), !reuse);
+        std::vector<std::vector<OutputSlot>> pageSlots(reuse ? m_pages.size() : 0);
+        if (reuse) {
+            auto pageFor = [this](const std::string& path) {
+                auto it = std::upper_bound(m_pages.begin(), m_pages.end(), path,
+                    [](const std::string& p, const PageInfo& page) { return p < page.firstPath; });
+                return (it == m_pages.begin()) ? size_t(0) : static_cast<size_t>(it - m_pages.begin() - 1);
+            };
+            for (const auto& added : m_added) dirty[pageFor(added.first)] = true;
+            for (const std::string& removed : m_removed) dirty[pageFor(removed)] = true;
+            std::set<uint64_t> addedTags;
+            for (const auto& output : m_addedOutputs) addedTags.insert(outputTag(output.first));
+            const CryptoPP::byte* slots = m_map.data() + m_outputOffset;
+            for (uint64_t i = 0; i < m_entryCount; i++) {
+                const CryptoPP::byte* slot = slots + i * OUTPUT_SLOT_SIZE;
+                const uint32_t page = getUint32(slot + 8);
+                if (page >= m_pages.size()) continue;
+                const uint64_t tag = getUint64(slot);
+                pageSlots[page].push_back({tag, page, getUint32(slot + 12)});
+                if (addedTags.count(tag)) dirty[page] = true;
+            }
+        }
+
+        auto flushPage = [&]() {
+            if (pageEntries == 0) return;
+            putUint32(reinterpret_cast<CryptoPP::byte*>(&plain[0]), pageEntries);
+            pages.back().id = nextPageId++;
+            const std::string record = sealRecord(dataKey, pages.back().id, plain, rng);
+            out.writeAt(record.data(), record.size(), offset);
+            pages.back().offset = offset;
+            pages.back().length = static_cast<uint32_t>(record.size());
+            pages.back().count = pageEntries;
+            offset += record.size();
+            wipeString(plain);
+            pageEntries = 0;
+        };
+        auto emit = [&](const CatalogEntry& entry) {
+            if (pageEntries == 0) {
+                pages.emplace_back();
+                pages.back().firstPath = entry.sourcePath;
+                appendUint32(plain, 0);
+            }
+            outputs.push_back({outputTagWithKey(indexKey, entry.outputName),
+                               static_cast<uint32_t>(pages.size() - 1), pageEntries});
+            appendEntry(plain, entry);
+            pageEntries++;
+            if (plain.size() >= PAGE_TARGET_SIZE) flushPage();
+        };
+
+        auto added = m_added.begin();
+        std::vector<CatalogEntry> entries;
+        for (uint32_t page = 0; page < m_pages.size(); page++) {
+            if (!dirty[page]) {
+                // 排在该页之前的新条目先写出，再原样复制该页
+                const PageInfo& info = m_pages[page];
+                for (; added != m_added.end() && added->first < info.firstPath; ++added) {
+                    emit(added->second);
+                }
+                flushPage();
+                out.writeAt(m_map.data() + info.offset, info.length, offset);
+                pages.push_back(info);
+                pages.back().offset = offset;
+                offset += info.length;
+                for (OutputSlot slot : pageSlots[page]) {
+                    slot.page = static_cast<uint32_t>(pages.size() - 1);
+                    outputs.push_back(slot);
+                }
+                continue;
+            }
+            decryptPage(page, entries);
+            for (const CatalogEntry& entry : entries) {
+                for (; added != m_added.end() && added->first < entry.sourcePath; ++added) {
+                    emit(added->second);
+                }
+                if (m_removed.count(entry.sourcePath) || m_added.count(entry.sourcePath) ||
+                    m_addedOutputs.count(entry.outputName)) {
+                    continue;
+                }
+                emit(entry);
+            }
+        }
+        for (; added != m_added.end(); ++added) {
+            emit(added->second);
+        }
+        flushPage();
+
+        // 页索引
+        std::string index;
+        appendUint32(index, static_cast<uint32_t>(pages.size()));
+        appendUint64(index, outputs.size());
+        for (const PageInfo& page : pages) {
+            appendUint64(index, page.offset);
+            appendUint32(index, page.length);
+            appendUint32(index, page.count);
+            appendUint32(index, page.id);
+            appendString(index, page.firstPath);
+        }
+        const std::string indexRecord = sealRecord(dataKey, INDEX_RECORD, index, rng);
+        wipeString(index);
+        const uint64_t indexOffset = offset;
+        out.writeAt(indexRecord.data(), indexRecord.size(), offset);
+        offset += indexRecord.size();
+
+        // 输出名索引
+        std::sort(outputs.begin(), outputs.end(),
+                  [](const OutputSlot& a, const OutputSlot& b) { return a.tag < b.tag; });
+        const uint64_t outputOffset = offset;
+        std::vector<CryptoPP::byte> slots(outputs.size() * OUTPUT_SLOT_SIZE);
+        for (size_t i = 0; i < outputs.size(); i++) {
+            CryptoPP::byte* slot = slots.data() + i * OUTPUT_SLOT_SIZE;
+            putUint64(slot, outputs[i].tag);
+            putUint32(slot + 8, outputs[i].page);
+            putUint32(slot + 12, outputs[i].index);
+        }
+        if (!slots.empty()) {
+            out.writeAt(slots.data(), slots.size(), offset);
+        }
+
+        std::memcpy(header, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+        putUint32(header + 8, CATALOG_VERSION);
+        putUint32(header + 12, static_cast<uint32_t>(pages.size()));
+        putUint64(header + 16, outputs.size());
+        putUint64(header + 24, indexOffset);
+        putUint64(header + 32, indexRecord.size());
+        putUint64(header + 40, outputOffset);
+        out.writeAt(header, sizeof(header), 0);
+        out.sync();
+        out.close();
+
+        // Windows上不能替换仍被映射的文件
+        m_map.unmap();
+        m_file.close();
+        fs::rename(tempPath, finalPath);
+        NativeFile::syncDirectory(m_outputDir);
+
+        std::memcpy(m_dataKey, dataKey, sizeof(dataKey));
+        wipe(dataKey, sizeof(dataKey));
+        wipe(indexKey, sizeof(indexKey));
+    } catch (...) {
+        out.close();
+        OutputCommitter::discard(tempPath);
+        throw;
+    }
+
+    m_added.clear();
+    m_addedOutputs.clear();
+    m_removed.clear();
+    if (!m_file.open(finalPath, NativeFile::ReadOnly)) {
+        throw std::runtime_error("无法打开目录文件: " + finalPath);
+    }
+    load();
+}
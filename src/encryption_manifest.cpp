@@ -0,0 +1,292 @@
+#include "../include/encryption_manifest.h"
+#include "../include/native_file.h"
+#include "../include/output_committer.h"
+#include "../include/perf_stats.h"
+#include "../include/session_key_cache.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <cryptopp/files.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/hex.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/sha.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+const char* const EncryptionManifest::FILE_NAME = ".sfm_manifest";
+
+static const char* const MANIFEST_HEADER = "# SecureFileManager manifest v2";
+// v1清单的摘要直接对文件内容计算，与v2的算法不同，载入时丢弃
+static const char* const MANIFEST_HEADER_V1 = "# SecureFileManager manifest v1";
+static const char* const KEY_CHECK_LABEL = "SecureFileManager manifest key check";
+
+static std::string toHex(const unsigned char* data, size_t len) {
+    std::string hex;
+    CryptoPP::StringSource(data, len, true,
+        new CryptoPP::HexEncoder(new CryptoPP::StringSink(hex)));
+    return hex;
+}
+
+static std::vector<unsigned char> fromHex(const std::string& hex) {
+    std::string raw;
+    CryptoPP::StringSource(hex, true,
+        new CryptoPP::HexDecoder(new CryptoPP::StringSink(raw)));
+    return std::vector<unsigned char>(raw.begin(), raw.end());
+}
+
+// 路径中的制表符、换行符和反斜杠需要转义
+static std::string escapeField(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '\t') out += "\\t";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
+}
+
+static std::string unescapeField(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '\\' && i + 1 < s.size()) {
+            char c = s[++i];
+            out += (c == 't') ? '\t' : (c == 'n') ? '\n' : c;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+static std::string keyCheckValue(const std::vector<unsigned char>& key) {
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(key.data(), key.size());
+    unsigned char mac[CryptoPP::SHA256::DIGESTSIZE];
+    hmac.CalculateDigest(mac, reinterpret_cast<const unsigned char*>(KEY_CHECK_LABEL),
+                         std::char_traits<char>::length(KEY_CHECK_LABEL));
+    return toHex(mac, sizeof(mac));
+}
+
+bool EncryptionManifest::load(const std::string& outputDir, const std::string& password) {
+    m_outputDir = outputDir;
+    m_entries.clear();
+    m_seen.clear();
+    m_saltHex.clear();
+
+    std::string storedCheck;
+    std::map<std::string, ManifestEntry> entries;
+    bool legacyDigests = false;
+    std::ifstream in(fs::path(outputDir) / FILE_NAME, std::ios::binary);
+    if (in) {
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line == MANIFEST_HEADER_V1) legacyDigests = true;
+            if (line.empty() || line[0] == '#') continue;
+            if (line.compare(0, 5, "salt ") == 0) {
+                m_saltHex = line.substr(5);
+                continue;
+            }
+            if (line.compare(0, 6, "check ") == 0) {
+                storedCheck = line.substr(6);
+                continue;
+            }
+
+            // size \t mtime \t inode \t digest \t output \t source
+            std::vector<std::string> fields;
+            std::stringstream ss(line);
+            std::string field;
+            while (std::getline(ss, field, '\t')) fields.push_back(field);
+            if (fields.size() != 6) continue;
+
+            try {
+                ManifestEntry entry;
+                entry.stamp.size = std::stoull(fields[0]);
+                entry.stamp.mtimeNs = std::stoll(fields[1]);
+                entry.stamp.inode = std::stoull(fields[2]);
+                if (!legacyDigests) entry.digest = fields[3];
+                entry.outputName = unescapeField(fields[4]);
+                entries[unescapeField(fields[5])] = entry;
+            } catch (const std::exception&) {
+                // 忽略损坏的行
+            }
+        }
+    }
+
+    // 新清单生成随机盐
+    std::vector<unsigned char> salt;
+    if (!m_saltHex.empty()) salt = fromHex(m_saltHex);
+    if (salt.size() != 16) {
+        salt.resize(16);
+        CryptoPP::AutoSeededRandomPool rng;
+        rng.GenerateBlock(salt.data(), salt.size());
+        m_saltHex = toHex(salt.data(), salt.size());
+    }
+
+    m_key.assign(CryptoPP::SHA256::DIGESTSIZE, 0);
+    SessionKeyCache::derive(password, salt.data(), salt.size(), 10000, m_key.data(), m_key.size());
+    m_keyCheck = keyCheckValue(m_key);
+
+    // 密码变化时旧记录全部作废
+    if (!storedCheck.empty() && storedCheck != m_keyCheck) {
+        return false;
+    }
+    m_entries.swap(entries);
+    return true;
+}
+
+void EncryptionManifest::save() const {
+    const std::string finalPath = (fs::path(m_outputDir) / FILE_NAME).string();
+    const std::string tempPath = OutputCommitter::stagingPath(finalPath);
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("无法写入清单文件: " + tempPath);
+        }
+        out << MANIFEST_HEADER << "\n";
+        out << "salt " << m_saltHex << "\n";
+        out << "check " << m_keyCheck << "\n";
+        for (const auto& item : m_entries) {
+            const ManifestEntry& e = item.second;
+            out << e.stamp.size << '\t' << e.stamp.mtimeNs << '\t' << e.stamp.inode << '\t'
+                << e.digest << '\t' << escapeField(e.outputName) << '\t'
+                << escapeField(item.first) << "\n";
+        }
+        if (!out.flush()) {
+            throw std::runtime_error("无法写入清单文件: " + tempPath);
+        }
+    }
+
+    NativeFile file;
+    if (file.open(tempPath, NativeFile::ReadWrite)) {
+        file.sync();
+        file.close();
+    }
+    fs::rename(tempPath, finalPath);
+    NativeFile::syncDirectory(m_outputDir);
+}
+
+bool EncryptionManifest::stamp(const std::string& path, FileStamp& out) {
+#ifdef _WIN32
+    std::error_code ec;
+    out.size = fs::file_size(path, ec);
+    if (ec) return false;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) return false;
+    out.mtimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        mtime.time_since_epoch()).count();
+    out.inode = 0;
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return false;
+    out.size = static_cast<uint64_t>(st.st_size);
+#if defined(__APPLE__)
+    out.mtimeNs = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    out.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    out.inode = static_cast<uint64_t>(st.st_ino);
+#endif
+    return true;
+}
+
+const ManifestEntry* EncryptionManifest::find(const std::string& sourcePath) const {
+    auto it = m_entries.find(sourcePath);
+    return it == m_entries.end() ? nullptr : &it->second;
+}
+
+bool EncryptionManifest::isUnchanged(const std::string& sourcePath, const FileStamp& stamp) const {
+    const ManifestEntry* entry = find(sourcePath);
+    if (!entry) return false;
+    if (entry->stamp.size != stamp.size || entry->stamp.mtimeNs != stamp.mtimeNs ||
+        entry->stamp.inode != stamp.inode) {
+        return false;
+    }
+    std::error_code ec;
+    return fs::exists(outputPath(*entry), ec);
+}
+
+std::string EncryptionManifest::contentDigest(const std::string& sourcePath) const {
+    std::string plainDigest;
+    {
+        PerfStats::Timer timer(PerfStats::Hash);
+        CryptoPP::SHA256 hash;
+        CryptoPP::FileSource file(sourcePath.c_str(), true,
+            new CryptoPP::HashFilter(hash,
+                new CryptoPP::HexEncoder(
+                    new CryptoPP::StringSink(plainDigest)
+                )
+            ));
+    }
+    return keyedDigest(plainDigest);
+}
+
+std::string EncryptionManifest::keyedDigest(const std::string& plainDigest) const {
+    const std::vector<unsigned char> raw = fromHex(plainDigest);
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(m_key.data(), m_key.size());
+    unsigned char mac[CryptoPP::SHA256::DIGESTSIZE];
+    hmac.CalculateDigest(mac, raw.data(), raw.size());
+    return toHex(mac, sizeof(mac));
+}
+
+void EncryptionManifest::update(const std::string& sourcePath, const ManifestEntry& entry) {
+    m_entries[sourcePath] = entry;
+    m_seen.insert(sourcePath);
+}
+
+void EncryptionManifest::markSeen(const std::string& sourcePath) {
+    m_seen.insert(sourcePath);
+}
+
+std::vector<std::string> EncryptionManifest::pruneMissing(const std::vector<std::string>& roots) {
+    std::vector<std::string> removed;
+
+    auto underRoot = [&roots](const std::string& path) {
+        for (const std::string& root : roots) {
+            if (path == root) return true;
+            if (path.size() > root.size() && path.compare(0, root.size(), root) == 0 &&
+                (path[root.size()] == '/' || path[root.size()] == '\\')) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        std::error_code ec;
+        if (m_seen.count(it->first) || !underRoot(it->first) || fs::exists(it->first, ec)) {
+            ++it;
+            continue;
+        }
+
+        std::string output = it->second.outputName;
+        it = m_entries.erase(it);
+
+        // 其他条目仍引用同名输出时保留输出文件
+        bool shared = false;
+        for (const auto& other : m_entries) {
+            if (other.second.outputName == output) {
+                shared = true;
+                break;
+            }
+        }
+        if (!shared) {
+            std::string path = (fs::path(m_outputDir) / output).string();
+            if (fs::remove(path, ec)) {
+                removed.push_back(path);
+            }
+        }
+    }
+    return removed;
+}
+
+std::string EncryptionManifest::outputPath(const ManifestEntry& entry) const {
+    return (fs::path(m_outputDir) / entry.outputName).string();
+}
@@ -0,0 +1,246 @@
+#include "../include/folder_watcher.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t monotonicNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+FolderWatcher::FolderWatcher() : FolderWatcher(Options()) {}
+
+FolderWatcher::FolderWatcher(const Options& options) : m_options(options) {
+#ifdef __linux__
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+}
+
+FolderWatcher::~FolderWatcher() {
+#ifdef __linux__
+    if (m_inotifyFd >= 0) ::close(m_inotifyFd);
+    if (m_wakeFd >= 0) ::close(m_wakeFd);
+#endif
+}
+
+#ifdef __linux__
+
+// 监视的事件：写完关闭、移入，以及用于维护目录树和待处理列表的创建/删除/移出
+static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE |
+                                   IN_MOVED_FROM | IN_DELETE_SELF | IN_ONLYDIR;
+
+static bool ignoredName(const char* name) {
+    return name[0] == '.';
+}
+
+static bool statFile(const std::string& path, uint64_t& size, int64_t& mtimeNs) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    size = static_cast<uint64_t>(st.st_size);
+    mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+void FolderWatcher::addPath(const std::string& dirPath) {
+    if (m_inotifyFd < 0 || m_wakeFd < 0) {
+        throw std::runtime_error(std::string("无法初始化目录监视: ") + std::strerror(errno));
+    }
+    struct stat st;
+    if (::stat(dirPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        throw std::runtime_error("监视目录不存在: " + dirPath);
+    }
+    watchTree(dirPath, m_options.includeExisting);
+}
+
+// 先添加监视再枚举内容，枚举期间新写完的文件不会漏掉（可能重复登记，按路径去重）
+void FolderWatcher::watchTree(const std::string& dirPath, bool existingAreNew) {
+    int wd = inotify_add_watch(m_inotifyFd, dirPath.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        throw std::runtime_error("无法监视目录: " + dirPath + " (" + std::strerror(errno) + ")");
+    }
+    m_dirs[wd] = dirPath;
+
+    DIR* dir = ::opendir(dirPath.c_str());
+    if (!dir) return;
+    std::vector<std::string> subdirs;
+    while (struct dirent* entry = ::readdir(dir)) {
+        if (ignoredName(entry->d_name)) continue;
+        const std::string path = dirPath + "/" + entry->d_name;
+        struct stat st;
+        if (::lstat(path.c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            subdirs.push_back(path);
+        } else if (S_ISREG(st.st_mode) && existingAreNew) {
+            touch(path);
+        }
+    }
+    ::closedir(dir);
+
+    for (const std::string& subdir : subdirs) {
+        try {
+            watchTree(subdir, existingAreNew);
+        } catch (const std::exception& e) {
+            std::cerr << "目录监视错误: " << e.what() << std::endl;
+        }
+    }
+}
+
+// 登记或推迟一个文件的就绪时间
+void FolderWatcher::touch(const std::string& path) {
+    Pending& pending = m_pending[path];
+    pending.readyNs = monotonicNs() + static_cast<uint64_t>(m_options.debounceMs) * 1000000;
+    if (!statFile(path, pending.size, pending.mtimeNs)) {
+        m_pending.erase(path);
+    }
+}
+
+void FolderWatcher::readEvents() {
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t len = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            if (len < 0 && errno == EINTR) continue;
+            return; // EAGAIN：已读完
+        }
+        for (char* p = buffer; p < buffer + len;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                std::cerr << "目录监视事件队列溢出，部分文件可能需要重新投递" << std::endl;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                m_dirs.erase(event->wd);
+                continue;
+            }
+            auto dir = m_dirs.find(event->wd);
+            if (dir == m_dirs.end() || event->len == 0 || ignoredName(event->name)) continue;
+            const std::string path = dir->second + "/" + event->name;
+
+            if (event->mask & IN_ISDIR) {
+                // 新建或移入的子目录：加入监视，其中已有的文件视为新投递
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    try {
+                        watchTree(path, true);
+                    } catch (const std::exception& e) {
+                        std::cerr << "目录监视错误: " << e.what() << std::endl;
+                    }
+                }
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                touch(path);
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                m_pending.erase(path);
+            }
+        }
+    }
+}
+
+// 取出已到期且大小、修改时间在静默期内未变化的文件
+std::vector<std::string> FolderWatcher::takeReady() {
+    std::vector<std::string> ready;
+    const uint64_t now = monotonicNs();
+    for (auto it = m_pending.begin(); it != m_pending.end() && ready.size() < m_options.maxBatch;) {
+        Pending& pending = it->second;
+        if (pending.readyNs > now) {
+            ++it;
+            continue;
+        }
+        uint64_t size = 0;
+        int64_t mtimeNs = 0;
+        if (!statFile(it->first, size, mtimeNs)) {
+            it = m_pending.erase(it);
+            continue;
+        }
+        if (size != pending.size || mtimeNs != pending.mtimeNs) {
+            // 仍在写入（例如没有产生关闭事件的写入方式）
+            pending.size = size;
+            pending.mtimeNs = mtimeNs;
+            pending.readyNs = now + static_cast<uint64_t>(m_options.debounceMs) * 1000000;
+            ++it;
+            continue;
+        }
+        ready.push_back(it->first);
+        it = m_pending.erase(it);
+    }
+    return ready;
+}
+
+void FolderWatcher::run(BatchCallback callback) {
+    if (m_inotifyFd < 0 || m_wakeFd < 0) {
+        throw std::runtime_error("目录监视未初始化");
+    }
+    for (;;) {
+        // 没有待处理的文件时无限期等待事件，否则等到最早的就绪时间
+        int timeoutMs = -1;
+        if (!m_pending.empty()) {
+            uint64_t earliest = UINT64_MAX;
+            for (const auto& entry : m_pending) {
+                earliest = std::min(earliest, entry.second.readyNs);
+            }
+            const uint64_t now = monotonicNs();
+            timeoutMs = earliest <= now ? 0
+                      : static_cast<int>(std::min<uint64_t>((earliest - now + 999999) / 1000000, 60000));
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = m_inotifyFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = m_wakeFd;
+        fds[1].events = POLLIN;
+        int rc = ::poll(fds, 2, timeoutMs);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("等待目录事件失败: ") + std::strerror(errno));
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t value = 0;
+            ssize_t ignored = ::read(m_wakeFd, &value, sizeof(value));
+            (void)ignored;
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            readEvents();
+        }
+
+        std::vector<std::string> ready = takeReady();
+        if (!ready.empty() && callback) {
+            callback(ready);
+        }
+    }
+}
+
+void FolderWatcher::stop() {
+    if (m_wakeFd >= 0) {
+        const uint64_t one = 1;
+        ssize_t ignored = ::write(m_wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+#else
+
+void FolderWatcher::addPath(const std::string& dirPath) {
+    throw std::runtime_error("目录监视仅支持Linux: " + dirPath);
+}
+
+void FolderWatcher::run(BatchCallback) {
+    throw std::runtime_error("目录监视仅支持Linux");
+}
+
+void FolderWatcher::stop() {}
+
+#endif
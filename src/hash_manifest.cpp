@@ -0,0 +1,509 @@
+#include "../include/hash_manifest.h"
+#include "../include/encryption_manifest.h"
+#include "../include/multi_hasher.h"
+#include "../include/native_file.h"
+#include "../include/output_committer.h"
+#include "../include/parallel_for.h"
+#include "../include/trace_recorder.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+static std::string toLower(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+static bool isHexDigest(const std::string& s) {
+    if (s.size() != 64) return false;
+    for (char c : s) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+// ==================== JSON读写 ====================
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char ch : s) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c == '"') out += "\\\"";
+        else if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else if (c == '\r') out += "\\r";
+        else if (c == '\t') out += "\\t";
+        else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += ch;
+        }
+    }
+    return out;
+}
+
+// 只需支持清单用到的JSON子集；数字保留原文，避免纳秒时间戳丢失精度
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    std::string text; // 字符串内容或数字原文
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* member(const std::string& key) const {
+        for (const auto& m : members) {
+            if (m.first == key) return &m.second;
+        }
+        return nullptr;
+    }
+};
+
+class JsonReader {
+public:
+    explicit JsonReader(const std::string& text) : m_text(text), m_pos(0) {}
+
+    JsonValue parseDocument() {
+        JsonValue value = parseValue();
+        skipSpace();
+        if (m_pos != m_text.size()) fail();
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail() const {
+        throw std::runtime_error("JSON格式错误 (位置 " + std::to_string(m_pos) + ")");
+    }
+
+    void skipSpace() {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) {
+            m_pos++;
+        }
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == c) {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) fail();
+    }
+
+    JsonValue parseValue() {
+        skipSpace();
+        if (m_pos >= m_text.size()) fail();
+        JsonValue value;
+        char c = m_text[m_pos];
+        if (c == '{') {
+            m_pos++;
+            value.type = JsonValue::Object;
+            if (consume('}')) return value;
+            do {
+                skipSpace();
+                std::string key = parseString();
+                expect(':');
+                value.members.emplace_back(key, parseValue());
+            } while (consume(','));
+            expect('}');
+        } else if (c == '[') {
+            m_pos++;
+            value.type = JsonValue::Array;
+            if (consume(']')) return value;
+            do {
+                value.items.push_back(parseValue());
+            } while (consume(','));
+            expect(']');
+        } else if (c == '"') {
+            value.type = JsonValue::String;
+            value.text = parseString();
+        } else if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) {
+            value.type = JsonValue::Number;
+            size_t start = m_pos;
+            while (m_pos < m_text.size() &&
+                   (std::isdigit(static_cast<unsigned char>(m_text[m_pos])) ||
+                    (m_text[m_pos] != '\0' && std::strchr("+-.eE", m_text[m_pos])))) {
+                m_pos++;
+            }
+            value.text = m_text.substr(start, m_pos - start);
+        } else if (m_text.compare(m_pos, 4, "true") == 0) {
+            m_pos += 4;
+            value.type = JsonValue::Bool;
+            value.text = "true";
+        } else if (m_text.compare(m_pos, 5, "false") == 0) {
+            m_pos += 5;
+            value.type = JsonValue::Bool;
+            value.text = "false";
+        } else if (m_text.compare(m_pos, 4, "null") == 0) {
+            m_pos += 4;
+        } else {
+            fail();
+        }
+        return value;
+    }
+
+    std::string parseString() {
+        if (m_pos >= m_text.size() || m_text[m_pos] != '"') fail();
+        m_pos++;
+        std::string out;
+        while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+            char c = m_text[m_pos++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (m_pos >= m_text.size()) fail();
+            char e = m_text[m_pos++];
+            switch (e) {
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': appendUtf8(out, parseCodePoint()); break;
+            default: out += e; break;
+            }
+        }
+        if (m_pos >= m_text.size()) fail();
+        m_pos++;
+        return out;
+    }
+
+    unsigned parseHex4() {
+        if (m_pos + 4 > m_text.size()) fail();
+        unsigned value = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = m_text[m_pos++];
+            if (!std::isxdigit(static_cast<unsigned char>(c))) fail();
+            value = value * 16 + static_cast<unsigned>(std::isdigit(static_cast<unsigned char>(c))
+                                                       ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+        return value;
+    }
+
+    unsigned parseCodePoint() {
+        unsigned cp = parseHex4();
+        // 代理对
+        if (cp >= 0xD800 && cp <= 0xDBFF && m_text.compare(m_pos, 2, "\\u") == 0) {
+            m_pos += 2;
+            unsigned low = parseHex4();
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        }
+        return cp;
+    }
+
+    static void appendUtf8(std::string& out, unsigned cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    const std::string& m_text;
+    size_t m_pos;
+};
+
+// ==================== sha256sum格式 ====================
+
+// 文件名含反斜杠或换行时，sha256sum在行首加反斜杠并转义文件名
+static std::string sumLine(const HashEntry& entry) {
+    if (entry.path.find_first_of("\\\n") == std::string::npos) {
+        return entry.sha256 + "  " + entry.path + "\n";
+    }
+    std::string escaped;
+    for (char c : entry.path) {
+        if (c == '\\') escaped += "\\\\";
+        else if (c == '\n') escaped += "\\n";
+        else escaped += c;
+    }
+    return "\\" + entry.sha256 + "  " + escaped + "\n";
+}
+
+static bool parseSumLine(std::string line, HashEntry& entry) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    bool escaped = false;
+    if (!line.empty() && line[0] == '\\') {
+        escaped = true;
+        line.erase(0, 1);
+    }
+
+    // BSD风格: SHA256 (文件名) = 摘要
+    if (line.compare(0, 8, "SHA256 (") == 0) {
+        size_t sep = line.rfind(") = ");
+        if (sep == std::string::npos || sep < 8) return false;
+        entry.path = line.substr(8, sep - 8);
+        entry.sha256 = line.substr(sep + 4);
+    } else {
+        // GNU风格: 摘要, 空格, 空格或'*', 文件名
+        if (line.size() < 67 || line[64] != ' ' || (line[65] != ' ' && line[65] != '*')) {
+            return false;
+        }
+        entry.sha256 = line.substr(0, 64);
+        entry.path = line.substr(66);
+    }
+    if (!isHexDigest(entry.sha256) || entry.path.empty()) return false;
+    entry.sha256 = toLower(entry.sha256);
+
+    if (escaped) {
+        std::string path;
+        for (size_t i = 0; i < entry.path.size(); i++) {
+            if (entry.path[i] == '\\' && i + 1 < entry.path.size()) {
+                char c = entry.path[++i];
+                path += (c == 'n') ? '\n' : (c == 'r') ? '\r' : c;
+            } else {
+                path += entry.path[i];
+            }
+        }
+        entry.path = path;
+    }
+    return true;
+}
+
+// ==================== HashManifest ====================
+
+bool HashManifest::isJsonPath(const std::string& manifestPath) {
+    return toLower(fs::path(manifestPath).extension().string()) == ".json";
+}
+
+HashEntry HashManifest::makeEntry(const std::string& filePath, const std::string& sha256Hex,
+                                  const std::string& manifestDir) {
+    HashEntry entry;
+    std::error_code ec;
+    fs::path file = fs::absolute(filePath, ec);
+    fs::path base = fs::absolute(manifestDir.empty() ? "." : manifestDir, ec);
+    fs::path relative = file.lexically_relative(base);
+    // 跨盘符等无法表示为相对路径时保留绝对路径
+    entry.path = (relative.empty() ? file : relative).generic_string();
+    entry.sha256 = toLower(sha256Hex);
+
+    FileStamp stamp;
+    if (EncryptionManifest::stamp(filePath, stamp)) {
+        entry.size = stamp.size;
+        entry.mtimeNs = stamp.mtimeNs;
+    }
+    return entry;
+}
+
+void HashManifest::save(const std::string& manifestPath, const std::vector<HashEntry>& entries) {
+    std::string tempPath = OutputCommitter::stagingPath(manifestPath);
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("无法写入哈希清单: " + tempPath);
+        }
+        if (isJsonPath(manifestPath)) {
+            out << "{\n  \"version\": 1,\n  \"algorithm\": \"SHA-256\",\n  \"files\": [";
+            for (size_t i = 0; i < entries.size(); i++) {
+                const HashEntry& e = entries[i];
+                out << (i ? ",\n" : "\n") << "    {\"path\": \"" << jsonEscape(e.path)
+                    << "\", \"sha256\": \"" << e.sha256 << "\"";
+                if (e.size != UINT64_MAX) {
+                    out << ", \"size\": " << e.size << ", \"mtime_ns\": " << e.mtimeNs;
+                }
+                out << "}";
+            }
+            out << (entries.empty() ? "]\n}\n" : "\n  ]\n}\n");
+        } else {
+            for (const HashEntry& e : entries) {
+                out << sumLine(e);
+            }
+        }
+        if (!out.flush()) {
+            OutputCommitter::discard(tempPath);
+            throw std::runtime_error("无法写入哈希清单: " + tempPath);
+        }
+    }
+
+    NativeFile file;
+    if (file.open(tempPath, NativeFile::ReadWrite)) {
+        file.sync();
+        file.close();
+    }
+    std::error_code ec;
+    fs::rename(tempPath, manifestPath, ec);
+    if (ec) {
+        OutputCommitter::discard(tempPath);
+        throw std::runtime_error("无法写入哈希清单: " + ec.message());
+    }
+    NativeFile::syncDirectory(fs::path(manifestPath).parent_path().string());
+}
+
+std::vector<HashEntry> HashManifest::load(const std::string& manifestPath) {
+    std::ifstream in(manifestPath, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("无法打开哈希清单: " + manifestPath);
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string text = buffer.str();
+
+    std::vector<HashEntry> entries;
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first != std::string::npos && text[first] == '{') {
+        JsonValue root = JsonReader(text).parseDocument();
+        const JsonValue* files = root.member("files");
+        if (!files || files->type != JsonValue::Array) {
+            throw std::runtime_error("哈希清单缺少files数组");
+        }
+        for (const JsonValue& item : files->items) {
+            const JsonValue* path = item.member("path");
+            const JsonValue* digest = item.member("sha256");
+            if (!path || !digest || path->type != JsonValue::String ||
+                digest->type != JsonValue::String || !isHexDigest(digest->text)) {
+                throw std::runtime_error("哈希清单条目格式错误");
+            }
+            HashEntry entry;
+            entry.path = path->text;
+            entry.sha256 = toLower(digest->text);
+            const JsonValue* size = item.member("size");
+            const JsonValue* mtime = item.member("mtime_ns");
+            try {
+                if (size && size->type == JsonValue::Number) entry.size = std::stoull(size->text);
+                if (mtime && mtime->type == JsonValue::Number) entry.mtimeNs = std::stoll(mtime->text);
+            } catch (const std::exception&) {
+                throw std::runtime_error("哈希清单条目格式错误: " + entry.path);
+            }
+            entries.push_back(entry);
+        }
+        return entries;
+    }
+
+    std::stringstream lines(text);
+    std::string line;
+    size_t lineNo = 0;
+    while (std::getline(lines, line)) {
+        lineNo++;
+        if (line.empty() || line == "\r") continue;
+        HashEntry entry;
+        if (!parseSumLine(line, entry)) {
+            throw std::runtime_error("哈希清单第 " + std::to_string(lineNo) + " 行格式错误");
+        }
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+HashManifest::CheckSummary HashManifest::check(const std::string& manifestPath, unsigned threads,
+                                               ProgressCallback callback,
+                                               const std::atomic<bool>* cancel) {
+    const std::vector<HashEntry> entries = load(manifestPath);
+    const fs::path baseDir = fs::path(manifestPath).parent_path();
+    const size_t total = entries.size();
+
+    std::vector<CheckResult> results(total);
+    std::vector<char> finished(total, 0);
+    std::atomic<size_t> doneCount(0);
+
+    auto finish = [&](size_t i, Status status, const std::string& detail) {
+        results[i].status = status;
+        results[i].detail = detail;
+        finished[i] = 1;
+        size_t done = ++doneCount;
+        if (callback) callback(done, total);
+    };
+
+    auto verify = [&](size_t i, uint64_t actualSize) {
+        const HashEntry& entry = entries[i];
+        if (entry.size != UINT64_MAX && entry.size != actualSize) {
+            finish(i, Changed, "大小不符: 清单 " + std::to_string(entry.size) +
+                               ", 实际 " + std::to_string(actualSize));
+            return;
+        }
+        try {
+            TraceRecorder::Span span("file", results[i].path);
+            std::string digest = toLower(
+                MultiHasher::hashFile(results[i].path, MultiHasher::SHA256).front().second);
+            if (digest == entry.sha256) {
+                finish(i, Ok, "");
+            } else {
+                finish(i, Changed, "摘要不符: " + digest);
+            }
+        } catch (const std::exception& e) {
+            finish(i, Failed, e.what());
+        }
+    };
+
+    // 按当前大小分类：缺失的直接记录，小文件组批，大文件单独排队
+    std::vector<uint64_t> sizes(total, 0);
+    std::vector<std::vector<size_t>> batches;
+    std::vector<size_t> large;
+    std::vector<size_t> batch;
+    uint64_t batchBytes = 0;
+    for (size_t i = 0; i < total; i++) {
+        fs::path path(entries[i].path);
+        results[i].path = (path.is_absolute() ? path : baseDir / path).string();
+
+        std::error_code ec;
+        fs::file_status status = fs::status(results[i].path, ec);
+        if (ec || !fs::exists(status)) {
+            finish(i, Missing, "文件不存在");
+            continue;
+        }
+        if (!fs::is_regular_file(status)) {
+            finish(i, Failed, "不是普通文件");
+            continue;
+        }
+        sizes[i] = fs::file_size(results[i].path, ec);
+        if (sizes[i] >= LARGE_FILE_THRESHOLD) {
+            large.push_back(i);
+            continue;
+        }
+        batch.push_back(i);
+        batchBytes += sizes[i];
+        if (batch.size() >= BATCH_FILES || batchBytes >= BATCH_BYTES) {
+            batches.push_back(std::move(batch));
+            batch.clear();
+            batchBytes = 0;
+        }
+    }
+    if (!batch.empty()) batches.push_back(std::move(batch));
+
+    parallelForEach(batches.size(), threads, [&](size_t b) {
+        for (size_t i : batches[b]) {
+            if (cancel && *cancel) return;
+            verify(i, sizes[i]);
+        }
+    });
+    for (size_t i : large) {
+        if (cancel && *cancel) break;
+        verify(i, sizes[i]);
+    }
+
+    CheckSummary summary;
+    for (size_t i = 0; i < total; i++) {
+        if (!finished[i]) continue;
+        switch (results[i].status) {
+        case Ok: summary.ok++; continue;
+        case Changed: summary.changed++; break;
+        case Missing: summary.missing++; break;
+        case Failed: summary.failed++; break;
+        }
+        summary.problems.push_back(results[i]);
+    }
+    std::sort(summary.problems.begin(), summary.problems.end(),
+              [](const CheckResult& a, const CheckResult& b) { return a.path < b.path; });
+    return summary;
+}
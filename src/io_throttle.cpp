@@ -0,0 +1,219 @@
+#include "../include/io_throttle.h"
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+// 令牌桶容量（秒）：空闲后最多允许这么长时间的突发
+static const double BURST_SECONDS = 0.25;
+// 后台优先级提高的nice值
+static const int BACKGROUND_NICE = 10;
+
+#ifdef __linux__
+// <linux/ioprio.h>中的定义，glibc没有封装
+static const int IOPRIO_WHO_PROCESS = 1;
+static const int IOPRIO_CLASS_SHIFT = 13;
+static const int IOPRIO_CLASS_BE = 2;
+static const int IOPRIO_CLASS_IDLE = 3;
+#endif
+
+static std::atomic<IoThrottle*> s_default{nullptr};
+static std::atomic<bool> s_adjustNice{false};
+
+// 每个线程的节流器绑定和已应用的系统优先级
+struct ThreadIoState {
+    IoThrottle* throttle = nullptr;
+    IoThrottle::Priority applied = IoThrottle::Normal;
+    bool saved = false;
+    int savedIoprio = -1;
+    int savedNice = 0;
+};
+
+static thread_local ThreadIoState t_state;
+
+static uint64_t steadyNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// 按优先级调整当前线程的I/O和CPU调度，失败时忽略（节流仍然有效）
+static void applyThreadPriority(IoThrottle::Priority priority) {
+    ThreadIoState& state = t_state;
+    if (priority == state.applied) return;
+#ifdef _WIN32
+    // 后台模式同时降低线程的CPU、I/O和内存优先级
+    if (priority == IoThrottle::Background) {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+    } else if (state.applied == IoThrottle::Background) {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+    }
+#else
+#ifdef __linux__
+    // Linux上who为0时作用于调用线程
+    const id_t self = static_cast<id_t>(::syscall(SYS_gettid));
+#else
+    const id_t self = 0;
+#endif
+    if (!state.saved) {
+#ifdef __linux__
+        state.savedIoprio = static_cast<int>(::syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0));
+#endif
+        errno = 0;
+        const int nice = ::getpriority(PRIO_PROCESS, self);
+        state.savedNice = (errno == 0) ? nice : 0;
+        state.saved = true;
+    }
+#ifdef __linux__
+    int ioprio = state.savedIoprio;
+    if (priority == IoThrottle::Interactive) {
+        ioprio = (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 0;
+    } else if (priority == IoThrottle::Background) {
+        ioprio = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+    }
+    if (ioprio >= 0) {
+        ::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio);
+    }
+#endif
+    if (priority == IoThrottle::Background && s_adjustNice.load(std::memory_order_relaxed)) {
+        ::setpriority(PRIO_PROCESS, self, std::max(state.savedNice, BACKGROUND_NICE));
+    } else if (state.applied == IoThrottle::Background) {
+        // 没有权限降低nice值时保持不变
+        ::setpriority(PRIO_PROCESS, self, state.savedNice);
+    }
+#endif
+    state.applied = priority;
+}
+
+void IoThrottle::Bucket::refill(uint64_t now) {
+    if (rate <= 0) {
+        tokens = 0;
+    } else if (lastNs != 0 && now > lastNs) {
+        tokens = std::min(rate * BURST_SECONDS, tokens + (now - lastNs) * 1e-9 * rate);
+    }
+    lastNs = now;
+}
+
+double IoThrottle::Bucket::waitSeconds() const {
+    return (rate > 0 && tokens < 0) ? -tokens / rate : 0;
+}
+
+void IoThrottle::Bucket::take(double amount) {
+    if (rate > 0) tokens -= amount;
+}
+
+IoThrottle::IoThrottle() : m_priority(Normal), m_generation(0), m_limited(false) {}
+
+void IoThrottle::setLimits(const Limits& limits) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint64_t now = steadyNs();
+        m_read.refill(now);
+        m_write.refill(now);
+        m_ops.refill(now);
+        m_read.rate = static_cast<double>(limits.readBytesPerSec);
+        m_write.rate = static_cast<double>(limits.writeBytesPerSec);
+        m_ops.rate = static_cast<double>(limits.iops);
+        m_limited = limits.readBytesPerSec || limits.writeBytesPerSec || limits.iops;
+        m_generation++;
+    }
+    // 限额放宽时让等待中的线程重新计算
+    m_cond.notify_all();
+}
+
+IoThrottle::Limits IoThrottle::limits() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Limits limits;
+    limits.readBytesPerSec = static_cast<uint64_t>(m_read.rate);
+    limits.writeBytesPerSec = static_cast<uint64_t>(m_write.rate);
+    limits.iops = static_cast<uint64_t>(m_ops.rate);
+    return limits;
+}
+
+void IoThrottle::setPriority(Priority priority) {
+    m_priority = priority;
+    m_generation++;
+}
+
+void IoThrottle::acquire(Direction direction, uint64_t bytes) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Bucket& bucket = (direction == Write) ? m_write : m_read;
+    for (;;) {
+        const uint64_t now = steadyNs();
+        bucket.refill(now);
+        m_ops.refill(now);
+        const double wait = std::max(bucket.waitSeconds(), m_ops.waitSeconds());
+        if (wait <= 0) {
+            bucket.take(static_cast<double>(bytes));
+            m_ops.take(1);
+            return;
+        }
+        // 分段等待，限额修改后及时重新计算
+        m_cond.wait_for(lock, std::chrono::duration<double>(std::min(wait, 0.1)));
+    }
+}
+
+void IoThrottle::charge(Direction direction, uint64_t bytes) {
+    IoThrottle* throttle = t_state.throttle;
+    if (!throttle) {
+        throttle = s_default.load(std::memory_order_acquire);
+        if (!throttle) return;
+    }
+    const Priority priority = throttle->priority();
+    if (priority != t_state.applied) {
+        applyThreadPriority(priority);
+    }
+    if (throttle->m_limited.load(std::memory_order_relaxed)) {
+        throttle->acquire(direction, bytes);
+    }
+}
+
+IoThrottle::Scope::Scope(IoThrottle* throttle, bool processDefault)
+    : m_previous(t_state.throttle), m_previousDefault(nullptr), m_processDefault(processDefault) {
+    t_state.throttle = throttle;
+    if (processDefault) {
+        m_previousDefault = s_default.exchange(throttle);
+    }
+}
+
+IoThrottle::Scope::~Scope() {
+    t_state.throttle = m_previous;
+    if (m_processDefault) {
+        s_default = m_previousDefault;
+    }
+    // 外层绑定的优先级在下一次读写时重新应用
+    applyThreadPriority(Normal);
+}
+
+void IoThrottle::setAdjustNice(bool enabled) {
+    s_adjustNice = enabled;
+}
+
+bool IoThrottle::parsePriority(const std::string& name, Priority& priority) {
+    if (name == "interactive") {
+        priority = Interactive;
+    } else if (name == "normal") {
+        priority = Normal;
+    } else if (name == "background") {
+        priority = Background;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* IoThrottle::priorityName(Priority priority) {
+    switch (priority) {
+    case Interactive: return "interactive";
+    case Background: return "background";
+    default: return "normal";
+    }
+}
@@ -0,0 +1,116 @@
+#include "../include/job_client.h"
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+
+namespace {
+// 连接句柄，离开作用域时关闭
+struct Connection {
+    int fd;
+    explicit Connection(int f) : fd(f) {}
+    ~Connection() { ::close(fd); }
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+};
+}
+
+JobProtocol::JobResult JobClient::run(const std::string& socketPath,
+                                      const JobProtocol::JobRequest& request,
+                                      FileCallback onFile,
+                                      const std::atomic<bool>* cancel,
+                                      const IoThrottle* throttle) {
+    uint64_t throttleGeneration = throttle ? throttle->generation() : 0;
+    Connection conn(JobProtocol::connectTo(socketPath));
+    JobProtocol::sendFrame(conn.fd, JobProtocol::Submit, JobProtocol::encode(request));
+
+    uint32_t jobId = 0;
+    bool accepted = false;
+    bool cancelSent = false;
+    for (;;) {
+        // 定时醒来检查取消标志
+        struct pollfd pfd;
+        pfd.fd = conn.fd;
+        pfd.events = POLLIN;
+        int rc = ::poll(&pfd, 1, 200);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("等待服务响应失败: ") + std::strerror(errno));
+        }
+        if (accepted && !cancelSent && cancel && *cancel) {
+            JobProtocol::Writer w;
+            w.u32(jobId);
+            JobProtocol::sendFrame(conn.fd, JobProtocol::Cancel, w.data());
+            cancelSent = true;
+        }
+        if (accepted && throttle && throttle->generation() != throttleGeneration) {
+            throttleGeneration = throttle->generation();
+            JobProtocol::ThrottleUpdate update;
+            update.jobId = jobId;
+            update.priority = throttle->priority();
+            update.limits = throttle->limits();
+            JobProtocol::sendFrame(conn.fd, JobProtocol::SetLimits, JobProtocol::encode(update));
+        }
+        if (rc == 0) continue;
+
+        uint8_t type = 0;
+        std::string payload;
+        if (!JobProtocol::recvFrame(conn.fd, type, payload)) {
+            throw std::runtime_error("服务连接已断开");
+        }
+        switch (type) {
+        case JobProtocol::Accepted: {
+            JobProtocol::Reader r(payload);
+            jobId = r.u32();
+            accepted = true;
+            break;
+        }
+        case JobProtocol::FileDone:
+            if (onFile) onFile(JobProtocol::decodeFileResult(payload));
+            break;
+        case JobProtocol::Completed:
+            return JobProtocol::decodeJobResult(payload);
+        case JobProtocol::Updated:
+            break;
+        case JobProtocol::Error:
+            throw std::runtime_error("服务拒绝任务: " + payload);
+        default:
+            throw std::runtime_error("未知的服务消息类型");
+        }
+    }
+}
+
+uint32_t JobClient::updateThrottle(const std::string& socketPath,
+                                   const JobProtocol::ThrottleUpdate& update) {
+    Connection conn(JobProtocol::connectTo(socketPath));
+    JobProtocol::sendFrame(conn.fd, JobProtocol::SetLimits, JobProtocol::encode(update));
+    uint8_t type = 0;
+    std::string payload;
+    if (!JobProtocol::recvFrame(conn.fd, type, payload)) {
+        throw std::runtime_error("服务连接已断开");
+    }
+    if (type != JobProtocol::Updated) {
+        throw std::runtime_error("服务拒绝修改: " + payload);
+    }
+    JobProtocol::Reader r(payload);
+    return r.u32();
+}
+
+#else
+
+JobProtocol::JobResult JobClient::run(const std::string&, const JobProtocol::JobRequest&,
+                                      FileCallback, const std::atomic<bool>*, const IoThrottle*) {
+    throw std::runtime_error("后台服务仅支持Unix系统");
+}
+
+uint32_t JobClient::updateThrottle(const std::string&, const JobProtocol::ThrottleUpdate&) {
+    throw std::runtime_error("后台服务仅支持Unix系统");
+}
+
+#endif
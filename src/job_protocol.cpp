@@ -0,0 +1,349 @@
+#include "../include/job_protocol.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+void JobProtocol::Writer::u32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        m_data.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void JobProtocol::Writer::u64(uint64_t value) {
+    u32(static_cast<uint32_t>(value));
+    u32(static_cast<uint32_t>(value >> 32));
+}
+
+void JobProtocol::Writer::str(const std::string& value) {
+    u32(static_cast<uint32_t>(value.size()));
+    m_data.append(value);
+}
+
+void JobProtocol::Reader::need(size_t len) const {
+    if (m_data.size() - m_pos < len) {
+        throw std::runtime_error("协议数据不完整");
+    }
+}
+
+uint8_t JobProtocol::Reader::u8() {
+    need(1);
+    return static_cast<uint8_t>(m_data[m_pos++]);
+}
+
+uint32_t JobProtocol::Reader::u32() {
+    need(4);
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(m_data[m_pos++])) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t JobProtocol::Reader::u64() {
+    const uint64_t low = u32();
+    return low | (static_cast<uint64_t>(u32()) << 32);
+}
+
+std::string JobProtocol::Reader::str() {
+    const uint32_t len = u32();
+    need(len);
+    std::string value = m_data.substr(m_pos, len);
+    m_pos += len;
+    return value;
+}
+
+static void writeThrottle(JobProtocol::Writer& w, IoThrottle::Priority priority,
+                          const IoThrottle::Limits& limits) {
+    w.u8(priority);
+    w.u64(limits.readBytesPerSec);
+    w.u64(limits.writeBytesPerSec);
+    w.u64(limits.iops);
+}
+
+static void readThrottle(JobProtocol::Reader& r, IoThrottle::Priority& priority,
+                         IoThrottle::Limits& limits) {
+    const uint8_t value = r.u8();
+    if (value > IoThrottle::Background) {
+        throw std::runtime_error("未知的优先级");
+    }
+    priority = static_cast<IoThrottle::Priority>(value);
+    limits.readBytesPerSec = r.u64();
+    limits.writeBytesPerSec = r.u64();
+    limits.iops = r.u64();
+}
+
+std::string JobProtocol::encode(const JobRequest& request) {
+    Writer w;
+    w.u32(VERSION);
+    w.u8(request.op);
+    w.str(request.password);
+    w.str(request.outputDir);
+    w.u32(request.hashAlgorithms);
+    w.u32(static_cast<uint32_t>(request.paths.size()));
+    for (const std::string& path : request.paths) {
+        w.str(path);
+    }
+    writeThrottle(w, request.priority, request.limits);
+    return w.data();
+}
+
+std::string JobProtocol::encode(const FileResult& result) {
+    Writer w;
+    w.u32(result.jobId);
+    w.u32(result.done);
+    w.u32(result.total);
+    w.u8(result.success ? 1 : 0);
+    w.str(result.path);
+    w.str(result.detail);
+    return w.data();
+}
+
+std::string JobProtocol::encode(const JobResult& result) {
+    Writer w;
+    w.u32(result.jobId);
+    w.u32(result.succeeded);
+    w.u32(result.failed);
+    w.u8(result.cancelled ? 1 : 0);
+    w.str(result.message);
+    return w.data();
+}
+
+std::string JobProtocol::encode(const ThrottleUpdate& update) {
+    Writer w;
+    w.u32(update.jobId);
+    writeThrottle(w, update.priority, update.limits);
+    return w.data();
+}
+
+JobProtocol::JobRequest JobProtocol::decodeRequest(const std::string& payload) {
+    Reader r(payload);
+    if (r.u32() != VERSION) {
+        throw std::runtime_error("协议版本不匹配");
+    }
+    JobRequest request;
+    const uint8_t op = r.u8();
+    if (op > Wipe) {
+        throw std::runtime_error("未知的操作类型");
+    }
+    request.op = static_cast<Operation>(op);
+    request.password = r.str();
+    request.outputDir = r.str();
+    request.hashAlgorithms = r.u32();
+    const uint32_t count = r.u32();
+    for (uint32_t i = 0; i < count; i++) {
+        request.paths.push_back(r.str());
+    }
+    readThrottle(r, request.priority, request.limits);
+    return request;
+}
+
+JobProtocol::FileResult JobProtocol::decodeFileResult(const std::string& payload) {
+    Reader r(payload);
+    FileResult result;
+    result.jobId = r.u32();
+    result.done = r.u32();
+    result.total = r.u32();
+    result.success = r.u8() != 0;
+    result.path = r.str();
+    result.detail = r.str();
+    return result;
+}
+
+JobProtocol::JobResult JobProtocol::decodeJobResult(const std::string& payload) {
+    Reader r(payload);
+    JobResult result;
+    result.jobId = r.u32();
+    result.succeeded = r.u32();
+    result.failed = r.u32();
+    result.cancelled = r.u8() != 0;
+    result.message = r.str();
+    return result;
+}
+
+JobProtocol::ThrottleUpdate JobProtocol::decodeThrottleUpdate(const std::string& payload) {
+    Reader r(payload);
+    ThrottleUpdate update;
+    update.jobId = r.u32();
+    readThrottle(r, update.priority, update.limits);
+    return update;
+}
+
+#ifndef _WIN32
+
+static void writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("发送失败: ") + std::strerror(errno));
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+// 返回false表示对端在帧开始前关闭
+static bool readAll(int fd, char* data, size_t len, bool frameStart) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = ::recv(fd, data + got, len - got, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("接收失败: ") + std::strerror(errno));
+        }
+        if (n == 0) {
+            if (frameStart && got == 0) return false;
+            throw std::runtime_error("连接在帧中途关闭");
+        }
+        got += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void JobProtocol::sendFrame(int fd, uint8_t type, const std::string& payload) {
+    Writer w;
+    w.u32(static_cast<uint32_t>(payload.size() + 1));
+    w.u8(type);
+    std::string frame = w.data();
+    frame.append(payload);
+    writeAll(fd, frame.data(), frame.size());
+}
+
+bool JobProtocol::recvFrame(int fd, uint8_t& type, std::string& payload) {
+    char header[5];
+    if (!readAll(fd, header, sizeof(header), true)) return false;
+    const std::string head(header, sizeof(header));
+    Reader r(head);
+    const uint32_t len = r.u32();
+    if (len == 0 || len > MAX_FRAME_SIZE) {
+        throw std::runtime_error("帧长度无效");
+    }
+    type = r.u8();
+    payload.resize(len - 1);
+    if (!payload.empty()) {
+        readAll(fd, &payload[0], payload.size(), false);
+    }
+    return true;
+}
+
+// 没有XDG_RUNTIME_DIR时使用的私有目录
+static std::string fallbackDirectory() {
+    return "/tmp/securefilemanager-" + std::to_string(::getuid());
+}
+
+std::string JobProtocol::defaultSocketPath() {
+    const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir && *runtimeDir) {
+        return std::string(runtimeDir) + "/securefilemanager.sock";
+    }
+    return fallbackDirectory() + "/service.sock";
+}
+
+void JobProtocol::prepareSocketDirectory(const std::string& socketPath) {
+    const size_t slash = socketPath.rfind('/');
+    const std::string dir = (slash == std::string::npos) ? "." :
+                            (slash == 0) ? "/" : socketPath.substr(0, slash);
+    const uid_t uid = ::getuid();
+    struct stat st;
+    if (dir == fallbackDirectory()) {
+        // 私有目录可能被其他用户抢先创建：不跟随符号链接，要求属于当前用户且权限为0700
+        if (::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+            throw std::runtime_error("无法创建套接字目录 " + dir + ": " + std::strerror(errno));
+        }
+        if (::lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) ||
+            st.st_uid != uid || (st.st_mode & 077) != 0) {
+            throw std::runtime_error("套接字目录不属于当前用户或可被其他用户访问: " + dir);
+        }
+        return;
+    }
+    if (::stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        throw std::runtime_error("套接字目录不存在: " + dir);
+    }
+    if ((st.st_uid != uid && st.st_uid != 0) ||
+        ((st.st_mode & 022) != 0 && (st.st_mode & S_ISVTX) == 0)) {
+        throw std::runtime_error("套接字目录可被其他用户修改: " + dir);
+    }
+}
+
+bool JobProtocol::peerIsCurrentUser(int fd) {
+#if defined(__linux__)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == ::getuid();
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+    uid_t uid = 0;
+    gid_t gid = 0;
+    return ::getpeereid(fd, &uid, &gid) == 0 && uid == ::getuid();
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+int JobProtocol::connectTo(const std::string& socketPath) {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("套接字路径过长: " + socketPath);
+    }
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("无法创建套接字: ") + std::strerror(errno));
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+        const int err = errno;
+        ::close(fd);
+        throw std::runtime_error("无法连接服务 " + socketPath + ": " + std::strerror(err));
+    }
+    // 套接字路径可能被其他用户抢先占用，密码只发给当前用户的服务进程
+    if (!peerIsCurrentUser(fd)) {
+        ::close(fd);
+        throw std::runtime_error("服务进程不属于当前用户，拒绝连接: " + socketPath);
+    }
+    return fd;
+}
+
+#else
+
+void JobProtocol::sendFrame(int, uint8_t, const std::string&) {
+    throw std::runtime_error("后台服务仅支持Unix系统");
+}
+
+bool JobProtocol::recvFrame(int, uint8_t&, std::string&) {
+    throw std::runtime_error("后台服务仅支持Unix系统");
+}
+
+std::string JobProtocol::defaultSocketPath() {
+    return std::string();
+}
+
+void JobProtocol::prepareSocketDirectory(const std::string&) {
+    throw std::runtime_error("后台服务仅支持Unix系统");
+}
+
+bool JobProtocol::peerIsCurrentUser(int) {
+    return false;
+}
+
+int JobProtocol::connectTo(const std::string&) {
+    throw std::runtime_error("后台服务仅支持Unix系统");
+}
+
+#endif
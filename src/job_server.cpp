@@ -0,0 +1,628 @@
+#include "../include/job_server.h"
+#include "../include/crypto_engine.h"
+#include "../include/delta_engine.h"
+#include "../include/encrypted_catalog.h"
+#include "../include/encryption_manifest.h"
+#include "../include/key_envelope.h"
+#include "../include/multi_hasher.h"
+#include "../include/native_file.h"
+#include "../include/output_committer.h"
+#include "../include/wipe_scheduler.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// 一个客户端连接：发送由多个工作线程共享，需加锁
+struct JobServer::Client {
+    int fd = -1;
+    std::thread thread;
+    std::atomic<bool> done{false};
+    std::mutex sendMutex;
+    std::atomic<bool> alive{true};
+
+    // 客户端已断开时静默丢弃
+    void send(uint8_t type, const std::string& payload) {
+        if (!alive) return;
+        std::lock_guard<std::mutex> lock(sendMutex);
+        try {
+            JobProtocol::sendFrame(fd, type, payload);
+        } catch (const std::exception&) {
+            alive = false;
+        }
+    }
+};
+
+struct JobServer::Job {
+    uint32_t id = 0;
+    JobProtocol::JobRequest request;
+    std::shared_ptr<Client> client;
+    std::vector<std::string> files;
+    std::vector<std::string> names;       // 与files对应的输出相对路径，目录展开时保留相对路径
+    KeyEnvelope::Kek kek;                 // 加密任务整批共用，只派生一次
+    OutputCommitter committer;
+    IoThrottle throttle;                  // 本任务的优先级和读写限额，可在运行中修改
+
+    // 以下由m_mutex保护
+    size_t next = 0;                      // 下一个待领取的文件
+    size_t active = 0;                    // 正在处理的文件数
+    bool finishing = false;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint32_t> done{0};
+    std::atomic<uint32_t> succeeded{0};
+    std::atomic<uint32_t> failed{0};
+
+    std::mutex dirsMutex;
+    std::set<std::string> wipedDirs;      // 擦除任务结束时统一刷写目录项
+
+    std::mutex catalogMutex;
+    std::vector<CatalogEntry> catalog;    // 加密成功的文件，任务结束时写入加密目录
+    std::vector<std::string> publishFailed; // 自动提交中发布失败的输出，任务结束时汇总
+
+    // 登记临时文件；自动提交中发布失败的输出留待finishJob扣除
+    void complete(const std::string& tempPath, const std::string& outputPath) {
+        const std::vector<std::string> failedPaths = committer.complete(tempPath, outputPath);
+        if (failedPaths.empty()) return;
+        std::lock_guard<std::mutex> lock(catalogMutex);
+        publishFailed.insert(publishFailed.end(), failedPaths.begin(), failedPaths.end());
+    }
+};
+
+JobServer::JobServer(const Options& options) : m_options(options) {
+    if (m_options.socketPath.empty()) {
+        m_options.socketPath = JobProtocol::defaultSocketPath();
+    }
+#ifndef _WIN32
+    if (::pipe(m_wakePipe) != 0) {
+        m_wakePipe[0] = m_wakePipe[1] = -1;
+    }
+#endif
+}
+
+JobServer::~JobServer() {
+    stop();
+#ifndef _WIN32
+    for (int fd : m_wakePipe) {
+        if (fd >= 0) ::close(fd);
+    }
+#endif
+}
+
+// 展开目录（递归，只取普通文件），保持请求中的顺序；
+// 目录中的文件以"目录名/相对路径"命名输出，单个文件只取文件名
+static void expandPaths(const std::vector<std::string>& paths, std::vector<std::string>& files,
+                        std::vector<std::string>& names) {
+    for (const std::string& path : paths) {
+        std::error_code ec;
+        if (fs::is_directory(path, ec)) {
+            fs::path root = fs::absolute(path).lexically_normal();
+            if (root.filename().empty()) root = root.parent_path();
+            std::vector<fs::path> found;
+            for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+                if (it->is_regular_file(ec)) {
+                    found.push_back(it->path());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            for (const fs::path& file : found) {
+                files.push_back(file.string());
+                names.push_back((root.filename() / file.lexically_relative(root)).generic_string());
+            }
+        } else {
+            files.push_back(fs::absolute(path).string());
+            names.push_back(fs::path(path).filename().string());
+        }
+    }
+}
+
+// 解密时跳过的附属文件
+static bool skipForDecrypt(const std::string& fileName) {
+    return (fileName.size() > 7 && fileName.compare(fileName.size() - 7, 7, ".sfmidx") == 0) ||
+           fileName == EncryptedCatalog::FILE_NAME;
+}
+
+// 输出文件相对输出目录的路径
+static std::string outputName(JobProtocol::Operation op, const std::string& name) {
+    const fs::path rel(name);
+    std::string fileName = rel.filename().string();
+    if (op == JobProtocol::Encrypt) {
+        fileName += ".enc";
+    } else {
+        if (fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".enc") == 0) {
+            fileName.resize(fileName.size() - 4);
+        }
+        fileName = "decrypted_" + fileName;
+    }
+    return (rel.parent_path() / fileName).generic_string();
+}
+
+// 多个输入映射到同一输出时会共用临时文件并互相覆盖，受理前拒绝
+static void checkOutputNames(JobProtocol::Operation op, const std::vector<std::string>& files,
+                             const std::vector<std::string>& names) {
+    std::set<std::string> seen;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (op == JobProtocol::Decrypt && skipForDecrypt(fs::path(names[i]).filename().string())) {
+            continue;
+        }
+        if (!seen.insert(outputName(op, names[i])).second) {
+            throw std::runtime_error("多个输入文件对应同一输出文件: " + outputName(op, names[i]) +
+                                     "（" + files[i] + "）");
+        }
+    }
+}
+
+void JobServer::submit(const std::shared_ptr<Client>& client, const std::string& payload) {
+    auto job = std::make_shared<Job>();
+    try {
+        job->request = JobProtocol::decodeRequest(payload);
+        const JobProtocol::Operation op = job->request.op;
+        if ((op == JobProtocol::Encrypt || op == JobProtocol::Decrypt ||
+             op == JobProtocol::Verify) && job->request.password.empty()) {
+            throw std::runtime_error("未提供密码");
+        }
+        if (op == JobProtocol::Encrypt || op == JobProtocol::Decrypt) {
+            if (job->request.outputDir.empty() || !fs::is_directory(job->request.outputDir)) {
+                throw std::runtime_error("输出目录不存在: " + job->request.outputDir);
+            }
+        }
+        if (op == JobProtocol::Encrypt) {
+            KeyEnvelope::newKek(job->request.password, CryptoEngine::kdfIterations(), job->kek);
+        }
+        expandPaths(job->request.paths, job->files, job->names);
+        if (op == JobProtocol::Encrypt || op == JobProtocol::Decrypt) {
+            checkOutputNames(op, job->files, job->names);
+        }
+    } catch (const std::exception& e) {
+        client->send(JobProtocol::Error, e.what());
+        return;
+    }
+    job->client = client;
+    job->throttle.setPriority(job->request.priority);
+    job->throttle.setLimits(job->request.limits);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job->id = m_nextJobId++;
+    }
+    // 受理消息先于任何文件结果
+    JobProtocol::Writer w;
+    w.u32(job->id);
+    w.u32(static_cast<uint32_t>(job->files.size()));
+    client->send(JobProtocol::Accepted, w.data());
+
+    bool finish = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(job);
+        finish = takeFinishedLocked(job);
+    }
+    m_cond.notify_all();
+    if (finish) finishJob(job);
+}
+
+uint32_t JobServer::updateThrottle(const JobProtocol::ThrottleUpdate& update) {
+    uint32_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& job : m_jobs) {
+            if (update.jobId != 0 && job->id != update.jobId) continue;
+            job->throttle.setPriority(update.priority);
+            job->throttle.setLimits(update.limits);
+            count++;
+        }
+    }
+    // 优先级变化会影响下一次调度
+    m_cond.notify_all();
+    return count;
+}
+
+void JobServer::cancelJobs(const std::shared_ptr<Client>& client, uint32_t jobId, bool all) {
+    std::vector<std::shared_ptr<Job>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& job : std::vector<std::shared_ptr<Job>>(m_jobs)) {
+            if (job->client != client || (!all && job->id != jobId)) continue;
+            job->cancelled = true;
+            if (takeFinishedLocked(job)) finished.push_back(job);
+        }
+    }
+    for (const auto& job : finished) finishJob(job);
+}
+
+// 任务不再有待处理的文件且没有文件在处理中时，从调度列表中取出（只取出一次）
+bool JobServer::takeFinishedLocked(const std::shared_ptr<Job>& job) {
+    if (job->finishing || job->active > 0) return false;
+    if (!job->cancelled && job->next < job->files.size()) return false;
+    job->finishing = true;
+    m_jobs.erase(std::remove(m_jobs.begin(), m_jobs.end(), job), m_jobs.end());
+    return true;
+}
+
+// 每次领取一个文件：先选优先级最高的一类任务，同类任务之间轮转。
+// 后台任务只在没有其他待处理文件时调度
+std::shared_ptr<JobServer::Job> JobServer::nextTask(size_t& index) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        if (m_stopping) return nullptr;
+        const size_t count = m_jobs.size();
+        std::shared_ptr<Job> best;
+        size_t bestSlot = 0;
+        for (size_t k = 0; k < count; k++) {
+            const size_t slot = (m_nextJob + k) % count;
+            const std::shared_ptr<Job>& job = m_jobs[slot];
+            if (job->cancelled || job->next >= job->files.size()) continue;
+            if (!best || job->throttle.priority() < best->throttle.priority()) {
+                best = job;
+                bestSlot = slot;
+            }
+        }
+        if (best) {
+            m_nextJob = bestSlot + 1;
+            index = best->next++;
+            best->active++;
+            return best;
+        }
+        m_cond.wait(lock);
+    }
+}
+
+void JobServer::workerLoop() {
+    for (;;) {
+        size_t index = 0;
+        std::shared_ptr<Job> job = nextTask(index);
+        if (!job) return;
+
+        JobProtocol::FileResult result;
+        {
+            IoThrottle::Scope throttle(&job->throttle);
+            processFile(*job, index, result);
+        }
+        (result.success ? job->succeeded : job->failed)++;
+        result.jobId = job->id;
+        result.done = ++job->done;
+        result.total = static_cast<uint32_t>(job->files.size());
+        // 先推送本文件结果再减少计数，保证完成消息在所有文件结果之后
+        job->client->send(JobProtocol::FileDone, JobProtocol::encode(result));
+
+        bool finish = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            job->active--;
+            finish = takeFinishedLocked(job);
+        }
+        if (finish) finishJob(job);
+    }
+}
+
+void JobServer::processFile(Job& job, size_t index, JobProtocol::FileResult& result) {
+    const std::string& path = job.files[index];
+    const std::string& password = job.request.password;
+    const std::string fileName = fs::path(path).filename().string();
+    result.path = path;
+    try {
+        switch (job.request.op) {
+        case JobProtocol::Encrypt: {
+            const std::string name = outputName(job.request.op, job.names[index]);
+            const fs::path output = fs::path(job.request.outputDir) / name;
+            fs::create_directories(output.parent_path());
+            const std::string outputPath = output.string();
+            const std::string tempPath = OutputCommitter::stagingPath(outputPath);
+            // 加密前记录元数据
+            CatalogEntry entry;
+            FileStamp stamp;
+            if (EncryptionManifest::stamp(path, stamp)) {
+                entry.size = stamp.size;
+                entry.mtimeNs = stamp.mtimeNs;
+            }
+            try {
+                CryptoEngine::encryptFile(path, tempPath, job.kek, nullptr, CryptoEngine::UNKNOWN_SIZE,
+                                          nullptr, &entry.plainDigest);
+            } catch (...) {
+                OutputCommitter::discard(tempPath);
+                throw;
+            }
+            // 发布失败在任务结束时汇总
+            job.complete(tempPath, outputPath);
+            result.detail = outputPath;
+            entry.sourcePath = path;
+            entry.outputName = name;
+            std::lock_guard<std::mutex> lock(job.catalogMutex);
+            job.catalog.push_back(entry);
+            break;
+        }
+        case JobProtocol::Decrypt: {
+            if (skipForDecrypt(fileName)) {
+                result.detail = fileName == EncryptedCatalog::FILE_NAME ? "跳过加密目录文件"
+                                                                         : "跳过分块索引文件";
+                break;
+            }
+            const fs::path output =
+                fs::path(job.request.outputDir) / outputName(job.request.op, job.names[index]);
+            fs::create_directories(output.parent_path());
+            const std::string outputPath = output.string();
+            const std::string tempPath = OutputCommitter::stagingPath(outputPath);
+            try {
+                if (DeltaEngine::isDeltaFile(path)) {
+                    DeltaEngine::decryptFile(path, tempPath, password);
+                } else {
+                    CryptoEngine::decryptFile(path, tempPath, password);
+                }
+            } catch (...) {
+                OutputCommitter::discard(tempPath);
+                throw;
+            }
+            job.complete(tempPath, outputPath);
+            result.detail = outputPath;
+            break;
+        }
+        case JobProtocol::Verify:
+            if (fileName == EncryptedCatalog::FILE_NAME) {
+                // 目录文件：解密全部页即完成认证
+                EncryptedCatalog catalog;
+                catalog.open(fs::path(path).parent_path().string(), password);
+                catalog.list(std::string(), [](const CatalogEntry&) { return true; });
+                result.detail = "加密目录校验通过: " + std::to_string(catalog.size()) + " 个条目";
+                break;
+            }
+            if (DeltaEngine::isDeltaFile(path)) {
+                DeltaEngine::verifyFile(path, password);
+            } else {
+                CryptoEngine::verifyFile(path, password);
+            }
+            result.detail = "校验通过";
+            break;
+        case JobProtocol::Hash: {
+            const unsigned algorithms = job.request.hashAlgorithms ? job.request.hashAlgorithms
+                                                                   : MultiHasher::SHA256;
+            for (const auto& digest : MultiHasher::hashFile(path, algorithms)) {
+                if (!result.detail.empty()) result.detail += " ";
+                result.detail += std::string(MultiHasher::algorithmName(digest.first)) + "=" +
+                                 digest.second;
+            }
+            break;
+        }
+        case JobProtocol::Wipe: {
+            uint64_t overwritten = 0;
+            uint64_t discarded = 0;
+            WipeScheduler::overwrite(path, WipeScheduler::Options(), overwritten, discarded);
+            fs::remove(path);
+            std::lock_guard<std::mutex> lock(job.dirsMutex);
+            job.wipedDirs.insert(fs::path(path).parent_path().string());
+            break;
+        }
+        }
+        result.success = true;
+    } catch (const std::exception& e) {
+        result.success = false;
+        result.detail = e.what();
+    }
+}
+
+// 发布剩余输出、刷写目录项，并发送完成消息
+void JobServer::finishJob(const std::shared_ptr<Job>& job) {
+    JobProtocol::JobResult result;
+    result.jobId = job->id;
+    result.cancelled = job->cancelled;
+
+    // 自动提交和最终提交的发布失败一并从成功数和加密目录中扣除
+    std::vector<std::string> publishFailed = job->committer.commit();
+    publishFailed.insert(publishFailed.end(), job->publishFailed.begin(), job->publishFailed.end());
+    for (const std::string& dir : job->wipedDirs) {
+        try {
+            NativeFile::syncDirectory(dir);
+        } catch (const std::exception&) {
+        }
+    }
+
+    result.failed = job->failed + static_cast<uint32_t>(publishFailed.size());
+    result.succeeded = job->succeeded - std::min<uint32_t>(job->succeeded,
+                                                           static_cast<uint32_t>(publishFailed.size()));
+    result.message = result.cancelled ? "任务已取消" : "任务完成";
+    for (const std::string& path : publishFailed) {
+        result.message += "; 输出文件发布失败: " + path;
+    }
+    if (!job->catalog.empty()) {
+        result.message += "; " + updateCatalog(*job, publishFailed);
+    }
+    job->client->send(JobProtocol::Completed, JobProtocol::encode(result));
+}
+
+// 同一输出目录可能同时有多个任务，加密目录的读取-合并-写回需串行
+std::string JobServer::updateCatalog(Job& job, const std::vector<std::string>& publishFailed) {
+    const std::set<std::string> failed(publishFailed.begin(), publishFailed.end());
+    try {
+        std::lock_guard<std::mutex> lock(m_catalogMutex);
+        EncryptedCatalog catalog;
+        catalog.open(job.request.outputDir, job.request.password);
+        for (const CatalogEntry& entry : job.catalog) {
+            if (!failed.count((fs::path(job.request.outputDir) / entry.outputName).string()) &&
+                !catalog.contains(entry)) {
+                catalog.add(entry);
+            }
+        }
+        if (!catalog.hasChanges()) {
+            return "加密目录无变化: " + std::to_string(catalog.size()) + " 个条目";
+        }
+        catalog.save();
+        return "加密目录已更新: " + std::to_string(catalog.size()) + " 个条目";
+    } catch (const std::exception& e) {
+        return std::string("更新加密目录失败: ") + e.what();
+    }
+}
+
+#ifndef _WIN32
+
+void JobServer::serveClient(std::shared_ptr<Client> client) {
+    try {
+        uint8_t type = 0;
+        std::string payload;
+        while (JobProtocol::recvFrame(client->fd, type, payload)) {
+            if (type == JobProtocol::Submit) {
+                submit(client, payload);
+            } else if (type == JobProtocol::Cancel) {
+                JobProtocol::Reader r(payload);
+                cancelJobs(client, r.u32(), false);
+            } else if (type == JobProtocol::SetLimits) {
+                // 同一用户的任何连接都可以调整任务（例如命令行调整界面提交的任务）
+                JobProtocol::Writer w;
+                w.u32(updateThrottle(JobProtocol::decodeThrottleUpdate(payload)));
+                client->send(JobProtocol::Updated, w.data());
+            } else {
+                client->send(JobProtocol::Error, "未知的消息类型");
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "客户端连接错误: " << e.what() << std::endl;
+    }
+    // 客户端断开后取消它提交的全部任务
+    client->alive = false;
+    cancelJobs(client, 0, true);
+    client->done = true;
+}
+
+void JobServer::run() {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (m_options.socketPath.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("套接字路径过长: " + m_options.socketPath);
+    }
+    std::memcpy(addr.sun_path, m_options.socketPath.c_str(), m_options.socketPath.size() + 1);
+
+    if (m_wakePipe[0] < 0) {
+        throw std::runtime_error("无法创建管道");
+    }
+    JobProtocol::prepareSocketDirectory(m_options.socketPath);
+    // 已有服务在运行时不抢占；只删除当前用户残留的套接字文件，
+    // 普通文件或其他用户的套接字保持原样并报错
+    bool running = false;
+    try {
+        ::close(JobProtocol::connectTo(m_options.socketPath));
+        running = true;
+    } catch (const std::exception&) {
+        struct stat st;
+        if (::lstat(m_options.socketPath.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode) || st.st_uid != ::getuid()) {
+                throw std::runtime_error("套接字路径已被占用: " + m_options.socketPath);
+            }
+            ::unlink(m_options.socketPath.c_str());
+        }
+    }
+    if (running) {
+        throw std::runtime_error("服务已在运行: " + m_options.socketPath);
+    }
+
+    m_listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listenFd < 0) {
+        throw std::runtime_error(std::string("无法创建套接字: ") + std::strerror(errno));
+    }
+    ::fcntl(m_listenFd, F_SETFD, FD_CLOEXEC);
+    // 套接字文件只允许当前用户访问（密码经由套接字传递）
+    const mode_t oldMask = ::umask(0177);
+    const int bound = ::bind(m_listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    ::umask(oldMask);
+    if (bound != 0 || ::listen(m_listenFd, 16) != 0) {
+        const int err = errno;
+        ::close(m_listenFd);
+        m_listenFd = -1;
+        throw std::runtime_error("无法监听 " + m_options.socketPath + ": " + std::strerror(err));
+    }
+
+    unsigned threads = m_options.threads ? m_options.threads
+                                         : std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; i++) {
+        m_workers.emplace_back(&JobServer::workerLoop, this);
+    }
+
+    for (;;) {
+        struct pollfd fds[2];
+        fds[0].fd = m_listenFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = m_wakePipe[0];
+        fds[1].events = POLLIN;
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int fd = ::accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0) continue;
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        if (!JobProtocol::peerIsCurrentUser(fd)) {
+            ::close(fd);
+            continue;
+        }
+        // 回收已断开的连接
+        for (auto it = m_clients.begin(); it != m_clients.end();) {
+            if ((*it)->done) {
+                (*it)->thread.join();
+                ::close((*it)->fd);
+                it = m_clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto client = std::make_shared<Client>();
+        client->fd = fd;
+        client->thread = std::thread(&JobServer::serveClient, this, client);
+        m_clients.push_back(client);
+    }
+
+    // 停止：不再领取新文件，等待处理中的文件结束，断开所有客户端
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cond.notify_all();
+    for (std::thread& worker : m_workers) worker.join();
+    m_workers.clear();
+    for (const auto& client : m_clients) {
+        ::shutdown(client->fd, SHUT_RDWR);
+    }
+    for (const auto& client : m_clients) {
+        client->thread.join();
+        ::close(client->fd);
+    }
+    m_clients.clear();
+    ::close(m_listenFd);
+    m_listenFd = -1;
+    ::unlink(m_options.socketPath.c_str());
+}
+
+void JobServer::stop() {
+    if (m_wakePipe[1] >= 0) {
+        const char byte = 1;
+        ssize_t ignored = ::write(m_wakePipe[1], &byte, 1);
+        (void)ignored;
+    }
+}
+
+#else
+
+void JobServer::serveClient(std::shared_ptr<Client>) {}
+
+void JobServer::run() {
+    throw std::runtime_error("后台服务仅支持Unix系统");
+}
+
+void JobServer::stop() {}
+
+#endif
@@ -0,0 +1,44 @@
+#include "../include/kdf_calibrator.h"
+#include <algorithm>
+#include <chrono>
+#include <cryptopp/pwdbased.h>
+#include <cryptopp/sha.h>
+
+// 校准时的最短测量时间，太短时计时误差较大
+static const double MIN_SAMPLE_MS = 25.0;
+
+double KdfCalibrator::measure(uint32_t iterations) {
+    static const char password[] = "SecureFileManager calibration";
+    static const CryptoPP::byte salt[16] = {0};
+    CryptoPP::byte key[32];
+
+    auto start = std::chrono::steady_clock::now();
+    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf;
+    pbkdf.DeriveKey(key, sizeof(key), 0,
+                    reinterpret_cast<const CryptoPP::byte*>(password), sizeof(password) - 1,
+                    salt, sizeof(salt), iterations);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+KdfCalibrator::Result KdfCalibrator::calibrate(double targetMs) {
+    // 逐步加倍迭代次数，直到单次测量足够长
+    uint32_t probe = MIN_ITERATIONS;
+    double elapsed = measure(probe);
+    while (elapsed < MIN_SAMPLE_MS && probe < MAX_ITERATIONS / 2) {
+        probe *= 2;
+        elapsed = measure(probe);
+    }
+
+    Result result;
+    result.targetMs = targetMs;
+    result.iterationsPerMs = probe / std::max(elapsed, 0.001);
+
+    // 取整到千次
+    double wanted = result.iterationsPerMs * targetMs;
+    wanted = std::min<double>(std::max<double>(wanted, MIN_ITERATIONS), MAX_ITERATIONS);
+    result.iterations = std::max(MIN_ITERATIONS,
+                                 static_cast<uint32_t>(wanted / 1000.0 + 0.5) * 1000);
+    result.expectedMs = result.iterations / result.iterationsPerMs;
+    return result;
+}
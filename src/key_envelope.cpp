@@ -0,0 +1,118 @@
+#include "../include/key_envelope.h"
+#include "../include/session_key_cache.h"
+#include <cstring>
+#include <cryptopp/aes.h>
+#include <cryptopp/gcm.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/sha.h>
+
+static const char ENVELOPE_MAGIC[8] = {'S', 'F', 'M', 'E', 'N', 'V', '0', '2'};
+static const size_t AAD_SIZE = 48;
+static const size_t NONCE_OFFSET = 48;
+static const size_t NONCE_SIZE = 12;
+static const size_t WRAPPED_OFFSET = NONCE_OFFSET + NONCE_SIZE;
+static const size_t TAG_OFFSET = WRAPPED_OFFSET + KeyEnvelope::DATA_KEY_SIZE;
+static const size_t TAG_SIZE = 16;
+
+static void putUint32(CryptoPP::byte* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<CryptoPP::byte>(v >> (8 * i));
+}
+
+static uint32_t getUint32(const CryptoPP::byte* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+static void wipe(void* ptr, size_t size) {
+    volatile unsigned char* p = static_cast<volatile unsigned char*>(ptr);
+    while (size--) *p++ = 0;
+}
+
+KeyEnvelope::Kek::~Kek() {
+    wipe(key, sizeof(key));
+}
+
+void KeyEnvelope::deriveKek(const std::string& password, const CryptoPP::byte* salt,
+                            uint32_t iterations, Kek& kek) {
+    std::memcpy(kek.salt, salt, SALT_SIZE);
+    kek.iterations = iterations;
+    SessionKeyCache::derive(password, salt, SALT_SIZE, iterations, kek.key, sizeof(kek.key));
+}
+
+void KeyEnvelope::newKek(const std::string& password, uint32_t iterations, Kek& kek) {
+    CryptoPP::byte salt[SALT_SIZE];
+    CryptoPP::AutoSeededRandomPool rng;
+    rng.GenerateBlock(salt, sizeof(salt));
+    deriveKek(password, salt, iterations, kek);
+}
+
+bool KeyEnvelope::isEnvelope(const CryptoPP::byte* data, size_t len) {
+    return len >= sizeof(ENVELOPE_MAGIC) &&
+           std::memcmp(data, ENVELOPE_MAGIC, sizeof(ENVELOPE_MAGIC)) == 0;
+}
+
+uint32_t KeyEnvelope::flags(const CryptoPP::byte* header) {
+    return getUint32(header + 8);
+}
+
+uint32_t KeyEnvelope::iterations(const CryptoPP::byte* header) {
+    return getUint32(header + 12);
+}
+
+const CryptoPP::byte* KeyEnvelope::salt(const CryptoPP::byte* header) {
+    return header + 16;
+}
+
+const CryptoPP::byte* KeyEnvelope::iv(const CryptoPP::byte* header) {
+    return header + 32;
+}
+
+bool KeyEnvelope::matches(const CryptoPP::byte* header, const Kek& kek) {
+    return iterations(header) == kek.iterations &&
+           std::memcmp(salt(header), kek.salt, SALT_SIZE) == 0;
+}
+
+// 写入KEK参数并用新nonce包装数据密钥
+static void wrapKey(CryptoPP::byte* header, const CryptoPP::byte* dataKey,
+                    const KeyEnvelope::Kek& kek) {
+    putUint32(header + 12, kek.iterations);
+    std::memcpy(header + 16, kek.salt, KeyEnvelope::SALT_SIZE);
+
+    CryptoPP::AutoSeededRandomPool rng;
+    CryptoPP::byte* nonce = header + NONCE_OFFSET;
+    rng.GenerateBlock(nonce, NONCE_SIZE);
+
+    CryptoPP::GCM<CryptoPP::AES>::Encryption gcm;
+    gcm.SetKeyWithIV(kek.key, sizeof(kek.key), nonce, NONCE_SIZE);
+    gcm.EncryptAndAuthenticate(header + WRAPPED_OFFSET, header + TAG_OFFSET, TAG_SIZE,
+                               nonce, NONCE_SIZE, header, AAD_SIZE,
+                               dataKey, KeyEnvelope::DATA_KEY_SIZE);
+}
+
+void KeyEnvelope::create(const Kek& kek, uint32_t flags,
+                         CryptoPP::byte* header, CryptoPP::byte* dataKey) {
+    std::memset(header, 0, HEADER_SIZE);
+    std::memcpy(header, ENVELOPE_MAGIC, sizeof(ENVELOPE_MAGIC));
+    putUint32(header + 8, flags);
+
+    CryptoPP::AutoSeededRandomPool rng;
+    rng.GenerateBlock(dataKey, DATA_KEY_SIZE);
+    rng.GenerateBlock(header + 32, IV_SIZE);
+    wrapKey(header, dataKey, kek);
+}
+
+bool KeyEnvelope::unwrap(const CryptoPP::byte* header, const Kek& kek, CryptoPP::byte* dataKey) {
+    const CryptoPP::byte* nonce = header + NONCE_OFFSET;
+    CryptoPP::GCM<CryptoPP::AES>::Decryption gcm;
+    gcm.SetKeyWithIV(kek.key, sizeof(kek.key), nonce, NONCE_SIZE);
+    bool ok = gcm.DecryptAndVerify(dataKey, header + TAG_OFFSET, TAG_SIZE,
+                                   nonce, NONCE_SIZE, header, AAD_SIZE,
+                                   header + WRAPPED_OFFSET, DATA_KEY_SIZE);
+    if (!ok) wipe(dataKey, DATA_KEY_SIZE);
+    return ok;
+}
+
+void KeyEnvelope::rewrap(CryptoPP::byte* header, const CryptoPP::byte* dataKey, const Kek& kek) {
+    wrapKey(header, dataKey, kek);
+}
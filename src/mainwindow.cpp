@@ -3,6 +3,7 @@
 #include "../include/file_processor.h"
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QInputDialog>
 #include <QStandardPaths>
 #include <QDateTime>
 #include <QTextCursor>
@@ -15,6 +16,10 @@
 #include <QStyle>
 #include <QApplication>
 #include <QFileInfoList>
+#include <QtConcurrent/QtConcurrentRun>
+#include "../include/job_protocol.h"
+#include "../include/memory_budget.h"
+#include "../include/session_key_cache.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -42,6 +47,23 @@ MainWindow::MainWindow(QWidget *parent)
     // 设置密码输入框
     ui->passwordLineEdit->setEchoMode(QLineEdit::Password);
     
+    // 按本机速度校准密钥派生成本：测量在线程池中进行，不阻塞界面；
+    // 连续调整目标耗时时只在停止输入后校准一次
+    kdfCalibration = new QFutureWatcher<KdfCalibrator::Result>(this);
+    connect(kdfCalibration, &QFutureWatcher<KdfCalibrator::Result>::finished,
+            this, &MainWindow::applyKdfCalibration);
+    kdfCalibrationTimer = new QTimer(this);
+    kdfCalibrationTimer->setSingleShot(true);
+    kdfCalibrationTimer->setInterval(500);
+    connect(kdfCalibrationTimer, &QTimer::timeout, this, &MainWindow::calibrateKdf);
+    calibrateKdf();
+    
+    // 会话密钥缓存：定时清零到期的密钥
+    configureKeyCache();
+    keyCacheTimer = new QTimer(this);
+    connect(keyCacheTimer, &QTimer::timeout, this, [] { SessionKeyCache::purgeExpired(); });
+    keyCacheTimer->start(30 * 1000);
+    
     // 创建并连接工作线程
     workerThread = new WorkerThread(this);
     connect(workerThread, &WorkerThread::progressChanged, 
@@ -66,6 +88,8 @@ MainWindow::~MainWindow()
         workerThread->quit();
         workerThread->wait();
     }
+    // 释放锁定内存前清零全部密钥
+    SessionKeyCache::configure(0);
     delete ui;
 }
 
@@ -141,12 +165,16 @@ void MainWindow::on_encryptButton_clicked()
         return;
     }
     
-    // 获取输出目录
-    QString outputDir = QFileDialog::getExistingDirectory(this, "选择输出目录", lastOutputDir);
-    if (outputDir.isEmpty()) return;
-    
-    // 保存最后使用的目录
-    lastOutputDir = outputDir;
+    // 获取输出目录（原地加密时无需输出目录）
+    bool inPlace = ui->inPlaceCheckBox->isChecked();
+    QString outputDir;
+    if (!inPlace) {
+        outputDir = QFileDialog::getExistingDirectory(this, "选择输出目录", lastOutputDir);
+        if (outputDir.isEmpty()) return;
+        
+        // 保存最后使用的目录
+        lastOutputDir = outputDir;
+    }
     
     // 准备文件列表
     QList<QString> files = collectSelectedFiles();
@@ -155,9 +183,15 @@ void MainWindow::on_encryptButton_clicked()
         return;
     }
     
+    if (inPlace && !confirmInPlace("加密", files.size())) return;
+    
     // 开始加密操作
     updateControlsState(false);
-    logMessage(QString("开始加密操作 (%1 个项目)...").arg(files.size()));
+    logMessage(QString("开始%1加密操作 (%2 个项目)...")
+               .arg(inPlace ? "原地" : "").arg(files.size()));
+    workerThread->setInPlace(inPlace);
+    workerThread->setIncremental(!inPlace && ui->incrementalCheckBox->isChecked());
+    workerThread->setDelta(!inPlace && ui->deltaCheckBox->isChecked());
     workerThread->processFiles(WorkerThread::Encrypt, files, password, outputDir);
 }
 
@@ -174,12 +208,16 @@ void MainWindow::on_decryptButton_clicked()
         return;
     }
     
-    // 获取输出目录
-    QString outputDir = QFileDialog::getExistingDirectory(this, "选择输出目录", lastOutputDir);
-    if (outputDir.isEmpty()) return;
-    
-    // 保存最后使用的目录
-    lastOutputDir = outputDir;
+    // 获取输出目录（原地解密时无需输出目录）
+    bool inPlace = ui->inPlaceCheckBox->isChecked();
+    QString outputDir;
+    if (!inPlace) {
+        outputDir = QFileDialog::getExistingDirectory(this, "选择输出目录", lastOutputDir);
+        if (outputDir.isEmpty()) return;
+        
+        // 保存最后使用的目录
+        lastOutputDir = outputDir;
+    }
     
     // 准备文件列表
     QList<QString> files = collectSelectedFiles();
@@ -188,11 +226,78 @@ void MainWindow::on_decryptButton_clicked()
         return;
     }
     
+    if (inPlace && !confirmInPlace("解密", files.size())) return;
+    
     updateControlsState(false);
-    logMessage(QString("开始解密操作 (%1 个项目)...").arg(files.size()));
+    logMessage(QString("开始%1解密操作 (%2 个项目)...")
+               .arg(inPlace ? "原地" : "").arg(files.size()));
+    workerThread->setInPlace(inPlace);
     workerThread->processFiles(WorkerThread::Decrypt, files, password, outputDir);
 }
 
+void MainWindow::on_verifyButton_clicked()
+{
+    if (ui->fileTreeWidget->topLevelItemCount() == 0) {
+        logMessage("请先添加文件或目录", true);
+        return;
+    }
+    
+    QString password = ui->passwordLineEdit->text();
+    if (password.isEmpty()) {
+        logMessage("请输入密码", true);
+        return;
+    }
+    
+    QList<QString> files = collectSelectedFiles();
+    if (files.isEmpty()) {
+        logMessage("没有选中的文件", true);
+        return;
+    }
+    
+    // 校验不写出任何文件，无需输出目录
+    updateControlsState(false);
+    logMessage(QString("开始校验操作 (%1 个项目)...").arg(files.size()));
+    workerThread->processFiles(WorkerThread::Verify, files, password);
+}
+
+void MainWindow::on_rekeyButton_clicked()
+{
+    if (ui->fileTreeWidget->topLevelItemCount() == 0) {
+        logMessage("请先添加文件或目录", true);
+        return;
+    }
+    
+    QString password = ui->passwordLineEdit->text();
+    if (password.isEmpty()) {
+        logMessage("请在密码框中输入原密码", true);
+        return;
+    }
+    
+    QList<QString> files = collectSelectedFiles();
+    if (files.isEmpty()) {
+        logMessage("没有选中的文件", true);
+        return;
+    }
+    
+    bool ok = false;
+    QString newPassword = QInputDialog::getText(this, "更换密码", "请输入新密码:",
+                                                QLineEdit::Password, "", &ok);
+    if (!ok || newPassword.isEmpty()) return;
+    QString confirm = QInputDialog::getText(this, "更换密码", "请再次输入新密码:",
+                                            QLineEdit::Password, "", &ok);
+    if (!ok) return;
+    if (confirm != newPassword) {
+        logMessage("两次输入的新密码不一致", true);
+        return;
+    }
+    
+    // 只改写文件头中包装的数据密钥，不重新加密数据
+    updateControlsState(false);
+    logMessage(QString("开始更换密码 (%1 个项目)...").arg(files.size()));
+    workerThread->setNewPassword(newPassword);
+    workerThread->processFiles(WorkerThread::Rekey, files, password);
+}
+
 void MainWindow::on_wipeButton_clicked()
 {
     if (ui->fileTreeWidget->topLevelItemCount() == 0) {
@@ -219,11 +324,35 @@ void MainWindow::on_wipeButton_clicked()
         return;
     }
 
+    WipeScheduler::Options wipeOptions;
+    wipeOptions.ioDepth = static_cast<unsigned>(ui->wipeDepthSpinBox->value());
+    wipeOptions.discard = ui->wipeDiscardCheckBox->isChecked();
+    wipeOptions.trim = wipeOptions.discard;
+    
     updateControlsState(false);
-    logMessage(QString("开始安全擦除操作 (%1 个文件)...").arg(files.size()));
+    logMessage(QString("开始安全擦除操作 (%1 个文件, 并发 %2)...")
+               .arg(files.size()).arg(wipeOptions.ioDepth));
+    workerThread->setWipeOptions(wipeOptions);
     workerThread->processFiles(WorkerThread::Wipe, files, "");
 }
 
+// 原地处理会直接改写原文件，执行前需要确认
+bool MainWindow::confirmInPlace(const QString &action, int fileCount)
+{
+    QMessageBox::StandardButton reply;
+    reply = QMessageBox::question(this, "原地处理确认",
+                                QString("将直接在原文件上%1 %2 个文件，不保留副本。\n"
+                                        "中断后再次执行同一操作即可从日志恢复。\n确定要继续吗？")
+                                .arg(action).arg(fileCount),
+                                QMessageBox::Yes | QMessageBox::No);
+    
+    if (reply != QMessageBox::Yes) {
+        logMessage(QString("原地%1操作已取消").arg(action));
+        return false;
+    }
+    return true;
+}
+
 // ==================== 工具功能 ====================
 
 void MainWindow::on_calculateHashButton_clicked()
@@ -239,11 +368,192 @@ void MainWindow::on_calculateHashButton_clicked()
         return;
     }
     
+    unsigned algorithms = 0;
+    if (ui->hashSha256CheckBox->isChecked()) algorithms |= MultiHasher::SHA256;
+    if (ui->hashSha1CheckBox->isChecked()) algorithms |= MultiHasher::SHA1;
+    if (ui->hashBlake2bCheckBox->isChecked()) algorithms |= MultiHasher::BLAKE2b;
+    if (ui->hashCrc32cCheckBox->isChecked()) algorithms |= MultiHasher::CRC32C;
+    if (algorithms == 0) {
+        logMessage("请至少选择一种哈希算法", true);
+        return;
+    }
+    
+    // 导出清单需要SHA-256
+    QString manifestPath;
+    if (ui->hashManifestCheckBox->isChecked()) {
+        manifestPath = QFileDialog::getSaveFileName(this, "保存哈希清单",
+                                                    lastOutputDir + "/SHA256SUMS",
+                                                    "sha256sum 清单 (*);;JSON 清单 (*.json)");
+        if (manifestPath.isEmpty()) {
+            logMessage("未选择清单文件，操作已取消", true);
+            return;
+        }
+        algorithms |= MultiHasher::SHA256;
+    }
+    
     updateControlsState(false);
     logMessage(QString("开始计算文件哈希值 (%1 个文件)...").arg(files.size()));
+    workerThread->setHashAlgorithms(algorithms);
+    workerThread->setHashManifest(manifestPath);
     workerThread->processFiles(WorkerThread::CalculateHash, files, "");
 }
 
+void MainWindow::on_checkManifestButton_clicked()
+{
+    QString manifestPath = QFileDialog::getOpenFileName(this, "选择哈希清单", lastOutputDir,
+                                                        "哈希清单 (*.sha256 *.json SHA256SUMS);;所有文件 (*)");
+    if (manifestPath.isEmpty()) {
+        return;
+    }
+    
+    updateControlsState(false);
+    logMessage(QString("开始按清单校验: %1").arg(manifestPath));
+    workerThread->processFiles(WorkerThread::Check, {manifestPath}, "");
+}
+
+// 在后台校准PBKDF2迭代次数，结果用于之后加密的文件
+// 已有校准在进行时等它完成后再按最新目标重新校准
+void MainWindow::calibrateKdf()
+{
+    if (kdfCalibration->isRunning()) return;
+    const int targetMs = ui->kdfTargetSpinBox->value();
+    ui->kdfInfoLabel->setText(QString("正在校准密钥派生 (目标 %1 ms)...").arg(targetMs));
+    kdfCalibration->setFuture(QtConcurrent::run([targetMs] {
+        return KdfCalibrator::calibrate(targetMs);
+    }));
+}
+
+// 界面线程中应用校准结果；目标耗时在校准期间被修改时丢弃结果重新校准
+void MainWindow::applyKdfCalibration()
+{
+    const KdfCalibrator::Result result = kdfCalibration->result();
+    if (static_cast<int>(result.targetMs) != ui->kdfTargetSpinBox->value()) {
+        calibrateKdf();
+        return;
+    }
+    CryptoEngine::setKdfIterations(result.iterations);
+    
+    QString info = QString("PBKDF2-SHA256 %1 次迭代 (约 %2 ms, 本机 %3 次/ms)")
+                   .arg(result.iterations)
+                   .arg(result.expectedMs, 0, 'f', 1)
+                   .arg(result.iterationsPerMs, 0, 'f', 0);
+    ui->kdfInfoLabel->setText(info);
+    logMessage("密钥派生校准: " + info);
+}
+
+void MainWindow::on_kdfTargetSpinBox_valueChanged(int)
+{
+    kdfCalibrationTimer->start();
+}
+
+// 按界面设置重建密钥缓存（已缓存的密钥被清零）
+void MainWindow::configureKeyCache()
+{
+    const int minutes = ui->keyCacheTtlSpinBox->value();
+    if (!SessionKeyCache::configure(static_cast<unsigned>(minutes) * 60,
+                                    static_cast<size_t>(ui->keyCacheSizeSpinBox->value()))) {
+        logMessage("无法锁定密钥缓存所需的内存（检查RLIMIT_MEMLOCK），密钥缓存未启用", true);
+    } else if (minutes > 0) {
+        logMessage(QString("密钥缓存: 保留 %1 分钟, 最多 %2 个")
+                   .arg(minutes).arg(ui->keyCacheSizeSpinBox->value()));
+    }
+}
+
+void MainWindow::on_keyCacheTtlSpinBox_valueChanged(int)
+{
+    configureKeyCache();
+}
+
+void MainWindow::on_keyCacheSizeSpinBox_valueChanged(int)
+{
+    configureKeyCache();
+}
+
+void MainWindow::on_lockKeysButton_clicked()
+{
+    SessionKeyCache::clear();
+    ui->passwordLineEdit->clear();
+    logMessage("已锁定: 缓存的密钥已清零");
+}
+
+// 选择性能统计的导出目录（如node_exporter的textfile目录）
+void MainWindow::on_statsExportCheckBox_toggled(bool checked)
+{
+    QString dir;
+    if (checked) {
+        dir = QFileDialog::getExistingDirectory(this, "选择性能统计导出目录", lastOutputDir);
+        if (dir.isEmpty()) {
+            ui->statsExportCheckBox->setChecked(false);
+            return;
+        }
+    }
+    ui->statsDirLabel->setText(dir);
+    workerThread->setStatsDirectory(dir);
+}
+
+// 选择时间线文件，可用chrome://tracing或Perfetto打开
+void MainWindow::on_traceCheckBox_toggled(bool checked)
+{
+    QString path;
+    if (checked) {
+        path = QFileDialog::getSaveFileName(this, "保存时间线", lastOutputDir + "/trace.json",
+                                            "Chrome trace (*.json)");
+        if (path.isEmpty()) {
+            ui->traceCheckBox->setChecked(false);
+            return;
+        }
+    }
+    workerThread->setTracePath(path);
+}
+
+// 任务交给本机常驻服务执行（默认套接字路径）
+void MainWindow::on_serviceCheckBox_toggled(bool checked)
+{
+    const QString socketPath = QString::fromStdString(JobProtocol::defaultSocketPath());
+    if (checked && socketPath.isEmpty()) {
+        QMessageBox::warning(this, "不支持", "后台服务仅支持Unix系统");
+        ui->serviceCheckBox->setChecked(false);
+        return;
+    }
+    workerThread->setServiceSocket(checked ? socketPath : QString());
+}
+
+// I/O优先级和限额不随操作锁定，处理过程中修改即时生效
+void MainWindow::on_ioPriorityComboBox_currentIndexChanged(int index)
+{
+    workerThread->setIoPriority(static_cast<IoThrottle::Priority>(index));
+}
+
+void MainWindow::on_readLimitSpinBox_valueChanged(int)
+{
+    applyIoLimits();
+}
+
+void MainWindow::on_writeLimitSpinBox_valueChanged(int)
+{
+    applyIoLimits();
+}
+
+void MainWindow::on_iopsLimitSpinBox_valueChanged(int)
+{
+    applyIoLimits();
+}
+
+// 内存预算对所有线程生效，调低后新的缓冲区申请等待已有缓冲区释放
+void MainWindow::on_memLimitSpinBox_valueChanged(int value)
+{
+    MemoryBudget::setLimit(static_cast<uint64_t>(value) * 1024 * 1024);
+}
+
+void MainWindow::applyIoLimits()
+{
+    IoThrottle::Limits limits;
+    limits.readBytesPerSec = static_cast<uint64_t>(ui->readLimitSpinBox->value()) * 1024 * 1024;
+    limits.writeBytesPerSec = static_cast<uint64_t>(ui->writeLimitSpinBox->value()) * 1024 * 1024;
+    limits.iops = static_cast<uint64_t>(ui->iopsLimitSpinBox->value());
+    workerThread->setIoLimits(limits);
+}
+
 void MainWindow::on_showPasswordCheckBox_stateChanged(int state)
 {
     ui->passwordLineEdit->setEchoMode(state == Qt::Checked ? 
@@ -304,10 +614,16 @@ void MainWindow::handleCompleted(bool success, const QString &message)
             detailMessage = "加密操作完成！所有文件已成功加密";
         } else if (op == WorkerThread::Decrypt) {
             detailMessage = "解密操作完成！所有文件已成功解密";
+        } else if (op == WorkerThread::Verify) {
+            detailMessage = "校验完成！所有文件均可用当前密码正确解密";
+        } else if (op == WorkerThread::Rekey) {
+            detailMessage = "更换密码完成！请使用新密码解密这些文件";
         } else if (op == WorkerThread::Wipe) {
             detailMessage = "安全擦除完成！所有文件已永久删除";
         } else if (op == WorkerThread::CalculateHash) {
             detailMessage = "哈希计算完成！结果已显示在日志中";
+        } else if (op == WorkerThread::Check) {
+            detailMessage = "清单校验完成！所有文件均与清单一致";
         }
         
         QMessageBox::information(this, "操作完成", detailMessage);
@@ -358,10 +674,29 @@ void MainWindow::updateControlsState(bool enabled)
     ui->clearListButton->setEnabled(enabled);
     ui->encryptButton->setEnabled(enabled);
     ui->decryptButton->setEnabled(enabled);
+    ui->verifyButton->setEnabled(enabled);
+    ui->rekeyButton->setEnabled(enabled);
     ui->wipeButton->setEnabled(enabled);
     ui->calculateHashButton->setEnabled(enabled);
     ui->passwordLineEdit->setEnabled(enabled);
     ui->showPasswordCheckBox->setEnabled(enabled);
+    ui->inPlaceCheckBox->setEnabled(enabled);
+    ui->incrementalCheckBox->setEnabled(enabled);
+    ui->deltaCheckBox->setEnabled(enabled);
+    ui->kdfTargetSpinBox->setEnabled(enabled);
+    ui->keyCacheTtlSpinBox->setEnabled(enabled);
+    ui->keyCacheSizeSpinBox->setEnabled(enabled);
+    ui->wipeDepthSpinBox->setEnabled(enabled);
+    ui->wipeDiscardCheckBox->setEnabled(enabled);
+    ui->hashSha256CheckBox->setEnabled(enabled);
+    ui->hashSha1CheckBox->setEnabled(enabled);
+    ui->hashBlake2bCheckBox->setEnabled(enabled);
+    ui->hashCrc32cCheckBox->setEnabled(enabled);
+    ui->hashManifestCheckBox->setEnabled(enabled);
+    ui->statsExportCheckBox->setEnabled(enabled);
+    ui->traceCheckBox->setEnabled(enabled);
+    ui->serviceCheckBox->setEnabled(enabled);
+    ui->checkManifestButton->setEnabled(enabled);
     
     ui->cancelButton->setEnabled(!enabled);
     
@@ -484,237 +819,3 @@ void MainWindow::collectFilesFromItem(QTreeWidgetItem *item, QList<QString> &fil
         }
     }
 }
-
-// ==================== WorkerThread 实现 ====================
-
-WorkerThread::WorkerThread(QObject *parent) 
-    : QThread(parent), m_cancel(false) 
-{
-}
-
-void WorkerThread::processFiles(Operation op, const QList<QString> &files, 
-                               const QString &pwd, const QString &outDir)
-{
-    currentOp = op;
-    fileList = files;
-    password = pwd;
-    outputDirectory = outDir;
-    start();
-}
-
-void WorkerThread::run()
-{
-    m_cancel = false;
-    int successCount = 0; // 成功计数
-    int failCount = 0;    // 失败计数
-    
-    try {
-        if (m_cancel) {
-            emit operationCompleted(false, "操作已取消");
-            return;
-        }
-        
-        const int totalFiles = fileList.size();
-        int processedFiles = 0;
-        
-        foreach (const QString &path, fileList) {
-            if (m_cancel) {
-                break; // 取消操作，跳出循环
-            }
-            
-            QFileInfo info(path);
-            bool result = false;
-            if (info.isDir()) {
-                result = processDirectory(currentOp, path);
-            } else {
-                result = processSingleFile(currentOp, path);
-            }
-            
-            if (result) {
-                successCount++;
-            } else {
-                failCount++;
-            }
-            
-            processedFiles++;
-            int progress = static_cast<int>((processedFiles * 100) / totalFiles);
-            emit progressChanged(progress, 
-                QString("已完成 %1/%2").arg(processedFiles).arg(totalFiles));
-        }
-        
-        // 根据成功和失败的数量生成结果消息
-        QString resultMsg;
-        bool overallSuccess = false;
-        
-        if (m_cancel) {
-            resultMsg = QString("操作已取消 (成功: %1, 失败: %2)").arg(successCount).arg(failCount);
-        } else if (failCount == 0) {
-            resultMsg = QString("所有操作成功完成 (共 %1 个文件)").arg(successCount);
-            overallSuccess = true;
-        } else if (successCount == 0) {
-            resultMsg = QString("所有操作失败 (共 %1 个文件)").arg(failCount);
-        } else {
-            resultMsg = QString("操作部分完成 (成功: %1, 失败: %2)").arg(successCount).arg(failCount);
-        }
-        
-        emit operationCompleted(overallSuccess, resultMsg);
-    } catch (const std::exception &e) {
-        emit operationCompleted(false, QString("操作失败: %1").arg(e.what()));
-    }
-}
-
-// 修改函数签名，返回操作是否成功
-bool WorkerThread::processDirectory(Operation op, const QString &dirPath)
-{
-    QDir dir(dirPath);
-    if (!dir.exists()) {
-        emit logMessageRequested(QString("目录不存在: %1").arg(dirPath), true);
-        return false;
-    }
-    
-    // 获取目录下所有文件和子目录
-    QFileInfoList entries = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
-    int totalEntries = entries.size();
-    int processed = 0;
-    bool allSuccess = true; // 跟踪目录内所有操作是否成功
-    
-    for (const QFileInfo &entry : entries) {
-        if (m_cancel) return false;
-        
-        processed++;
-        int progress = static_cast<int>((processed * 100) / totalEntries);
-        emit progressChanged(progress, QString("处理目录: %1 (%2/%3)")
-                                .arg(dir.dirName())
-                                .arg(processed)
-                                .arg(totalEntries));
-        
-        bool result = false;
-        if (entry.isFile()) {
-            result = processSingleFile(op, entry.absoluteFilePath());
-        } else if (entry.isDir()) {
-            result = processDirectory(op, entry.absoluteFilePath());
-        }
-        
-        if (!result) {
-            allSuccess = false;
-        }
-    }
-    
-    return allSuccess;
-}
-
-// 修改函数签名，返回操作是否成功
-bool WorkerThread::processSingleFile(Operation op, const QString &filePath)
-{
-    QFileInfo fileInfo(filePath);
-    QString outputPath;
-    
-    // 更新处理状态
-    emit progressChanged(0, QString("正在处理: %1").arg(fileInfo.fileName()));
-    
-    try {
-        // 定义进度回调
-        auto progressCallback = [this, fileInfo](int progress) {
-            QString msg = QString("处理 %1: %2%")
-                         .arg(fileInfo.fileName())
-                         .arg(progress);
-            emit progressChanged(progress, msg);
-        };
-        
-        if (op == Encrypt) {
-            // 确定输出路径
-            outputPath = outputDirectory + "/" + fileInfo.fileName() + ".enc";
-            
-            CryptoEngine::encryptFile(
-                filePath.toStdString(), 
-                outputPath.toStdString(), 
-                password.toStdString(),
-                progressCallback
-            );
-            
-            // 添加详细的加密成功日志
-            QFileInfo outInfo(outputPath);
-            QString successMsg = QString("加密成功! 输出文件: %1 (大小: %2 字节)")
-                                .arg(outInfo.absoluteFilePath())
-                                .arg(outInfo.size());
-            emit logMessageRequested(successMsg);
-            
-            // 标记文件已处理
-            emit fileProcessed(filePath);
-            
-            return true;
-        } 
-        else if (op == Decrypt) {
-            // 解密前的文件验证
-            if (!CryptoEngine::isEncryptedFile(filePath.toStdString())) {
-                QString errorMsg = QString("'%1' 不是有效的加密文件，跳过")
-                                    .arg(fileInfo.fileName());
-                emit logMessageRequested(errorMsg, true);
-                return false;
-            }
-            
-            // 确定输出路径
-            QString baseName = fileInfo.fileName();
-            if (baseName.endsWith(".enc")) {
-                baseName.chop(4);
-            }
-            outputPath = outputDirectory + "/decrypted_" + baseName;
-            
-            CryptoEngine::decryptFile(
-                filePath.toStdString(), 
-                outputPath.toStdString(), 
-                password.toStdString(),
-                progressCallback
-            );
-            
-            // 添加详细的解密成功日志
-            QFileInfo outInfo(outputPath);
-            QString successMsg = QString("解密成功! 输出文件: %1 (大小: %2 字节)")
-                                .arg(outInfo.absoluteFilePath())
-                                .arg(outInfo.size());
-            emit logMessageRequested(successMsg);
-            
-            // 标记文件已处理
-            emit fileProcessed(filePath);
-            
-            return true;
-        }
-        else if (op == Wipe) {
-            bool success = FileProcessor::secureDelete(filePath.toStdString());
-            if (!success) {
-                throw std::runtime_error("安全擦除操作失败");
-            }
-            
-            // 添加详细的擦除确认
-            QString successMsg = QString("已安全擦除: %1 (永久删除)")
-                                .arg(fileInfo.absoluteFilePath());
-            emit logMessageRequested(successMsg);
-            
-            // 标记文件已处理
-            emit fileProcessed(filePath);
-            
-            return true;
-        }
-        else if (op == CalculateHash) {
-            std::string hashValue = FileProcessor::calculateSHA256(filePath.toStdString());
-            QString result = QString("%1 的 SHA-256: %2")
-                .arg(fileInfo.fileName(), QString::fromStdString(hashValue));
-            
-            emit logMessageRequested(result);
-            
-            // 标记文件已处理
-            emit fileProcessed(filePath);
-            
-            return true;
-        }
-        
-        return false; // 未知操作类型
-    } 
-    catch (const std::exception &e) {
-        // 处理异常
-        QString errorMsg = QString("处理文件 %1 时出错: %2")
-            .arg(fileInfo.fileName(), e.what());
-        emit logMessageRequested(errorMsg, true);
-        return false;
-    }
-}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "../include/memory_budget.h"
+#include "../include/perf_stats.h"
+#include <cctype>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+static std::mutex g_mutex;
+static std::condition_variable g_released;
+static MemoryBudget::Stats g_stats;
+// 当前线程已持有的额度：持有额度的线程再申请时不等待，避免等待自己或与其他线程互相等待
+static thread_local uint64_t t_held = 0;
+
+MemoryBudget::Lease::Lease(size_t bytes) : m_bytes(bytes) {
+    if (bytes == 0) return;
+    std::unique_lock<std::mutex> lock(g_mutex);
+    auto mustWait = [bytes] {
+        return t_held == 0 && g_stats.limit != 0 && g_stats.inUse != 0 &&
+               g_stats.inUse + bytes > g_stats.limit;
+    };
+    if (mustWait()) {
+        // 只有真正阻塞时才计时，未受限的申请不产生记录
+        const uint64_t start = PerfStats::nowNs();
+        g_stats.waits++;
+        g_released.wait(lock, [&] { return !mustWait(); });
+        const uint64_t waited = PerfStats::nowNs() - start;
+        g_stats.waitNs += waited;
+        PerfStats::record(PerfStats::MemWait, waited, bytes);
+    }
+    g_stats.inUse += bytes;
+    if (g_stats.inUse > g_stats.peak) g_stats.peak = g_stats.inUse;
+    t_held += bytes;
+}
+
+MemoryBudget::Lease& MemoryBudget::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_bytes = other.m_bytes;
+        other.m_bytes = 0;
+    }
+    return *this;
+}
+
+void MemoryBudget::Lease::release() {
+    if (m_bytes == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stats.inUse -= m_bytes;
+    }
+    t_held -= m_bytes;
+    m_bytes = 0;
+    g_released.notify_all();
+}
+
+void MemoryBudget::setLimit(uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_stats.limit = bytes;
+    }
+    g_released.notify_all();
+}
+
+uint64_t MemoryBudget::limit() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_stats.limit;
+}
+
+MemoryBudget::Stats MemoryBudget::stats() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_stats;
+}
+
+void MemoryBudget::resetPeak() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_stats.peak = g_stats.inUse;
+    g_stats.waits = 0;
+    g_stats.waitNs = 0;
+}
+
+uint64_t MemoryBudget::parseSize(const std::string& text) {
+    size_t pos = 0;
+    uint64_t value = 0;
+    while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+        const uint64_t digit = static_cast<uint64_t>(text[pos] - '0');
+        if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+            throw std::runtime_error("内存大小超出范围: " + text);
+        }
+        value = value * 10 + digit;
+        pos++;
+    }
+    if (pos == 0) {
+        throw std::runtime_error("无效的内存大小: " + text);
+    }
+
+    unsigned shift = 0;
+    if (pos < text.size()) {
+        switch (std::toupper(static_cast<unsigned char>(text[pos]))) {
+        case 'K': shift = 10; break;
+        case 'M': shift = 20; break;
+        case 'G': shift = 30; break;
+        case 'B': break;
+        default: throw std::runtime_error("无效的内存大小: " + text);
+        }
+        pos++;
+        // 允许"512MB"、"512MiB"的写法
+        if (shift != 0 && pos < text.size() && (text[pos] == 'i' || text[pos] == 'I')) pos++;
+        if (shift != 0 && pos < text.size() && std::toupper(static_cast<unsigned char>(text[pos])) == 'B') pos++;
+    }
+    if (pos != text.size()) {
+        throw std::runtime_error("无效的内存大小: " + text);
+    }
+    if (shift != 0 && value > (std::numeric_limits<uint64_t>::max() >> shift)) {
+        throw std::runtime_error("内存大小超出范围: " + text);
+    }
+    return value << shift;
+}
@@ -0,0 +1,272 @@
+#include "../include/multi_hasher.h"
+#include "../include/memory_budget.h"
+#include "../include/native_file.h"
+#include "../include/perf_stats.h"
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <cryptopp/blake2.h>
+#include <cryptopp/crc.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/hex.h>
+#include <cryptopp/sha.h>
+
+// 流水线中循环使用的缓冲区个数
+static const size_t PIPELINE_SLOTS = 4;
+
+static std::unique_ptr<CryptoPP::HashTransformation> createHash(MultiHasher::Algorithm algorithm) {
+    switch (algorithm) {
+    case MultiHasher::SHA256:
+        return std::unique_ptr<CryptoPP::HashTransformation>(new CryptoPP::SHA256);
+    case MultiHasher::SHA1:
+        return std::unique_ptr<CryptoPP::HashTransformation>(new CryptoPP::SHA1);
+    case MultiHasher::BLAKE2b:
+        return std::unique_ptr<CryptoPP::HashTransformation>(new CryptoPP::BLAKE2b);
+    case MultiHasher::CRC32C:
+        return std::unique_ptr<CryptoPP::HashTransformation>(new CryptoPP::CRC32C);
+    }
+    throw std::runtime_error("未知的哈希算法");
+}
+
+static std::string finalDigest(MultiHasher::Algorithm algorithm, CryptoPP::HashTransformation& hash) {
+    std::vector<CryptoPP::byte> digest(hash.DigestSize());
+    hash.Final(digest.data());
+    // Crypto++按寄存器字节序输出CRC，反转为常见的大端表示
+    if (algorithm == MultiHasher::CRC32C) {
+        std::reverse(digest.begin(), digest.end());
+    }
+    std::string hex;
+    CryptoPP::StringSource(digest.data(), digest.size(), true,
+        new CryptoPP::HexEncoder(new CryptoPP::StringSink(hex)));
+    return hex;
+}
+
+// 稀疏文件读取：空洞部分直接填零，只对有数据的区段发起读盘
+class SparseReader {
+public:
+    SparseReader(const NativeFile& file, uint64_t size)
+        : m_file(file), m_size(size), m_sparse(file.allocatedSize() < size) {}
+
+    size_t read(CryptoPP::byte* buffer, size_t len, uint64_t offset) {
+        if (!m_sparse) return m_file.readAt(buffer, len, offset);
+        if (offset >= m_size) return 0;
+        len = static_cast<size_t>(std::min<uint64_t>(len, m_size - offset));
+        size_t done = 0;
+        while (done < len) {
+            const uint64_t pos = offset + done;
+            if (pos >= m_dataEnd) {
+                // 之后没有数据时余下部分全是空洞
+                if (!m_file.nextData(pos, m_dataStart, m_dataEnd) || m_dataEnd <= pos) {
+                    m_dataStart = m_dataEnd = m_size;
+                }
+                m_dataEnd = std::min(m_dataEnd, m_size);
+            }
+            if (pos < m_dataStart) {
+                const size_t n = static_cast<size_t>(std::min<uint64_t>(len - done, m_dataStart - pos));
+                std::memset(buffer + done, 0, n);
+                done += n;
+                continue;
+            }
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(len - done, m_dataEnd - pos));
+            const size_t got = m_file.readAt(buffer + done, n, pos);
+            done += got;
+            if (got < n) break; // 文件被截短
+        }
+        return done;
+    }
+
+private:
+    const NativeFile& m_file;
+    uint64_t m_size;
+    bool m_sparse;
+    uint64_t m_dataStart = 0;
+    uint64_t m_dataEnd = 0;
+};
+
+// 读取线程与各算法线程共享的缓冲区环
+struct HashPipeline {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::vector<CryptoPP::byte>> slots;
+    size_t lengths[PIPELINE_SLOTS] = {};
+    size_t pending[PIPELINE_SLOTS] = {}; // 尚未处理该缓冲区的算法数
+    uint64_t produced = 0;               // 已读入的块数
+    bool eof = false;
+};
+
+MultiHasher::Digests MultiHasher::hashFile(const std::string& path, unsigned algorithmMask,
+                                           ProgressCallback callback) {
+    const std::vector<Algorithm> selected = algorithms(algorithmMask);
+    if (selected.empty()) {
+        throw std::runtime_error("未选择哈希算法");
+    }
+
+    try {
+        NativeFile file;
+        if (!file.open(path, NativeFile::ReadOnly)) {
+            throw std::runtime_error("无法打开文件: " + path);
+        }
+        const uint64_t size = file.size();
+        SparseReader reader(file, size);
+
+        std::vector<std::unique_ptr<CryptoPP::HashTransformation>> hashes;
+        for (Algorithm algorithm : selected) {
+            hashes.push_back(createHash(algorithm));
+        }
+
+        uint64_t offset = 0;
+        int lastProgress = -1;
+        auto reportProgress = [&]() {
+            if (!callback || size == 0) return;
+            int progress = static_cast<int>(std::min<uint64_t>(offset, size) * 100 / size);
+            if (progress != lastProgress) {
+                lastProgress = progress;
+                callback(progress);
+            }
+        };
+
+        if (size < PARALLEL_THRESHOLD) {
+            // 小文件：单线程依次送入每种算法
+            MemoryBudget::Buffer buffer(static_cast<size_t>(
+                std::max<uint64_t>(1, std::min<uint64_t>(size, BUFFER_SIZE))));
+            for (;;) {
+                size_t n = reader.read(buffer.data(), buffer.size(), offset);
+                if (n == 0) break;
+                PerfStats::Timer timer(PerfStats::Hash, n);
+                for (auto& hash : hashes) {
+                    hash->Update(buffer.data(), n);
+                }
+                offset += n;
+                reportProgress();
+            }
+        } else {
+            // 大文件：每种算法一个线程，读取与计算重叠
+            MemoryBudget::Lease memory(PIPELINE_SLOTS * BUFFER_SIZE);
+            HashPipeline pipe;
+            pipe.slots.assign(PIPELINE_SLOTS, std::vector<CryptoPP::byte>(BUFFER_SIZE));
+
+            std::vector<std::thread> workers;
+            for (auto& hash : hashes) {
+                CryptoPP::HashTransformation* h = hash.get();
+                workers.emplace_back([&pipe, h]() {
+                    for (uint64_t next = 0;; next++) {
+                        const size_t slot = static_cast<size_t>(next % PIPELINE_SLOTS);
+                        size_t len = 0;
+                        {
+                            // 等待读取线程送来下一块
+                            PerfStats::Timer wait(PerfStats::QueueWait);
+                            std::unique_lock<std::mutex> lock(pipe.mutex);
+                            pipe.cv.wait(lock, [&]() { return pipe.produced > next || pipe.eof; });
+                            if (pipe.produced <= next) break;
+                            len = pipe.lengths[slot];
+                        }
+                        {
+                            PerfStats::Timer timer(PerfStats::Hash, len);
+                            h->Update(pipe.slots[slot].data(), len);
+                        }
+                        std::lock_guard<std::mutex> lock(pipe.mutex);
+                        if (--pipe.pending[slot] == 0) {
+                            pipe.cv.notify_all();
+                        }
+                    }
+                });
+            }
+
+            auto finishWorkers = [&]() {
+                {
+                    std::lock_guard<std::mutex> lock(pipe.mutex);
+                    pipe.eof = true;
+                }
+                pipe.cv.notify_all();
+                for (std::thread& t : workers) t.join();
+            };
+
+            try {
+                for (;;) {
+                    const size_t slot = static_cast<size_t>(pipe.produced % PIPELINE_SLOTS);
+                    {
+                        // 等待所有算法处理完该缓冲区的上一块
+                        PerfStats::Timer wait(PerfStats::QueueWait);
+                        std::unique_lock<std::mutex> lock(pipe.mutex);
+                        pipe.cv.wait(lock, [&]() { return pipe.pending[slot] == 0; });
+                    }
+                    size_t n = reader.read(pipe.slots[slot].data(), BUFFER_SIZE, offset);
+                    if (n == 0) break;
+                    {
+                        std::lock_guard<std::mutex> lock(pipe.mutex);
+                        pipe.lengths[slot] = n;
+                        pipe.pending[slot] = hashes.size();
+                        pipe.produced++;
+                    }
+                    pipe.cv.notify_all();
+                    offset += n;
+                    reportProgress();
+                }
+            } catch (...) {
+                finishWorkers();
+                throw;
+            }
+            finishWorkers();
+        }
+
+        Digests digests;
+        for (size_t i = 0; i < selected.size(); i++) {
+            digests.emplace_back(selected[i], finalDigest(selected[i], *hashes[i]));
+        }
+        return digests;
+    } catch (const std::exception& e) {
+        throw std::runtime_error("计算哈希失败: " + std::string(e.what()));
+    }
+}
+
+const char* MultiHasher::algorithmName(Algorithm algorithm) {
+    switch (algorithm) {
+    case SHA256: return "SHA-256";
+    case SHA1: return "SHA-1";
+    case BLAKE2b: return "BLAKE2b";
+    case CRC32C: return "CRC32C";
+    }
+    return "未知";
+}
+
+unsigned MultiHasher::parseAlgorithms(const std::string& list) {
+    unsigned mask = 0;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        std::string name;
+        for (char c : item) {
+            if (c == '-' || std::isspace(static_cast<unsigned char>(c))) continue;
+            name += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        if (name.empty()) continue;
+        if (name == "sha256") {
+            mask |= SHA256;
+        } else if (name == "sha1") {
+            mask |= SHA1;
+        } else if (name == "blake2b") {
+            mask |= BLAKE2b;
+        } else if (name == "crc32c") {
+            mask |= CRC32C;
+        } else if (name == "all") {
+            mask |= ALL_ALGORITHMS;
+        } else {
+            throw std::runtime_error("未知的哈希算法: " + item);
+        }
+    }
+    return mask;
+}
+
+std::vector<MultiHasher::Algorithm> MultiHasher::algorithms(unsigned mask) {
+    std::vector<Algorithm> result;
+    for (Algorithm algorithm : {SHA256, SHA1, BLAKE2b, CRC32C}) {
+        if (mask & algorithm) result.push_back(algorithm);
+    }
+    return result;
+}
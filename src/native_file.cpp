@@ -0,0 +1,385 @@
+#include "../include/native_file.h"
+#include "../include/io_throttle.h"
+#include "../include/perf_stats.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/falloc.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#ifdef _WIN32
+// UTF-8路径转换为宽字符路径
+static std::wstring toWidePath(const std::string& path) {
+    int len = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    std::wstring wide(len > 0 ? len - 1 : 0, L'\0');
+    if (len > 1) {
+        MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], len);
+    }
+    return wide;
+}
+#endif
+
+NativeFile::~NativeFile() {
+    close();
+}
+
+NativeFile::NativeFile(NativeFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+NativeFile& NativeFile::operator=(NativeFile&& other) noexcept {
+    if (this != &other) {
+        close();
+#ifdef _WIN32
+        m_handle = other.m_handle;
+        other.m_handle = nullptr;
+#else
+        m_fd = other.m_fd;
+        other.m_fd = -1;
+#endif
+    }
+    return *this;
+}
+
+bool NativeFile::open(const std::string& path, OpenMode mode) {
+    close();
+    PerfStats::Timer timer(PerfStats::OpenStat);
+#ifdef _WIN32
+    DWORD access = (mode == ReadOnly) ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE);
+    DWORD disposition = (mode == CreateTruncate) ? CREATE_ALWAYS : OPEN_EXISTING;
+    HANDLE h = CreateFileW(toWidePath(path).c_str(), access,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, disposition, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    m_handle = h;
+#else
+    int flags = O_CLOEXEC;
+    if (mode == ReadOnly) {
+        flags |= O_RDONLY;
+    } else if (mode == ReadWrite) {
+        flags |= O_RDWR;
+    } else {
+        flags |= O_RDWR | O_CREAT | O_TRUNC;
+    }
+    // 创建的文件（临时输出、原地处理日志等）可能含有明文，只允许所有者访问；
+    // 清空已有文件时同样去掉组和其他用户的权限
+    do {
+        m_fd = ::open(path.c_str(), flags, 0600);
+    } while (m_fd < 0 && errno == EINTR);
+    if (m_fd < 0) return false;
+    if (mode == CreateTruncate) {
+        struct stat st;
+        if (fstat(m_fd, &st) == 0 && S_ISREG(st.st_mode) && (st.st_mode & 077) != 0) {
+            ::fchmod(m_fd, st.st_mode & 0700);
+        }
+    }
+#endif
+    return true;
+}
+
+void NativeFile::close() {
+#ifdef _WIN32
+    if (m_handle) {
+        CloseHandle(static_cast<HANDLE>(m_handle));
+        m_handle = nullptr;
+    }
+#else
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+#endif
+}
+
+bool NativeFile::isOpen() const {
+#ifdef _WIN32
+    return m_handle != nullptr;
+#else
+    return m_fd >= 0;
+#endif
+}
+
+uint64_t NativeFile::size() const {
+    PerfStats::Timer timer(PerfStats::OpenStat);
+#ifdef _WIN32
+    LARGE_INTEGER li;
+    if (!GetFileSizeEx(static_cast<HANDLE>(m_handle), &li)) {
+        throw std::runtime_error("无法获取文件大小");
+    }
+    return static_cast<uint64_t>(li.QuadPart);
+#else
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) {
+        throw std::runtime_error(std::string("无法获取文件大小: ") + std::strerror(errno));
+    }
+#ifdef __linux__
+    // 块设备的st_size为0，需查询设备容量
+    if (S_ISBLK(st.st_mode)) {
+        uint64_t bytes = 0;
+        if (::ioctl(m_fd, BLKGETSIZE64, &bytes) != 0) {
+            throw std::runtime_error(std::string("无法获取设备容量: ") + std::strerror(errno));
+        }
+        return bytes;
+    }
+#endif
+    return static_cast<uint64_t>(st.st_size);
+#endif
+}
+
+uint64_t NativeFile::allocatedSize() const {
+#ifdef _WIN32
+    FILE_STANDARD_INFO info;
+    if (GetFileInformationByHandleEx(static_cast<HANDLE>(m_handle), FileStandardInfo,
+                                     &info, sizeof(info))) {
+        return static_cast<uint64_t>(info.AllocationSize.QuadPart);
+    }
+    return size();
+#else
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return size();
+    }
+    return static_cast<uint64_t>(st.st_blocks) * 512;
+#endif
+}
+
+bool NativeFile::nextData(uint64_t offset, uint64_t& start, uint64_t& end) const {
+    PerfStats::Timer timer(PerfStats::OpenStat);
+#ifdef _WIN32
+    const uint64_t total = size();
+    if (offset >= total) return false;
+    FILE_ALLOCATED_RANGE_BUFFER query;
+    FILE_ALLOCATED_RANGE_BUFFER range;
+    query.FileOffset.QuadPart = static_cast<LONGLONG>(offset);
+    query.Length.QuadPart = static_cast<LONGLONG>(total - offset);
+    DWORD bytes = 0;
+    // 只取第一个区间，更多区间时返回ERROR_MORE_DATA
+    if (DeviceIoControl(static_cast<HANDLE>(m_handle), FSCTL_QUERY_ALLOCATED_RANGES,
+                        &query, sizeof(query), &range, sizeof(range), &bytes, nullptr) ||
+        GetLastError() == ERROR_MORE_DATA) {
+        if (bytes < sizeof(range)) return false;
+        start = std::max<uint64_t>(offset, static_cast<uint64_t>(range.FileOffset.QuadPart));
+        end = std::min<uint64_t>(total, static_cast<uint64_t>(range.FileOffset.QuadPart) +
+                                        static_cast<uint64_t>(range.Length.QuadPart));
+        return start < end;
+    }
+    start = offset;
+    end = total;
+    return true;
+#else
+#ifdef SEEK_DATA
+    const off_t data = ::lseek(m_fd, static_cast<off_t>(offset), SEEK_DATA);
+    if (data >= 0) {
+        const off_t hole = ::lseek(m_fd, data, SEEK_HOLE);
+        if (hole > data) {
+            start = static_cast<uint64_t>(data);
+            end = static_cast<uint64_t>(hole);
+            return true;
+        }
+    } else if (errno == ENXIO) {
+        return false; // offset之后全是空洞
+    }
+#endif
+    const uint64_t total = size();
+    if (offset >= total) return false;
+    start = offset;
+    end = total;
+    return true;
+#endif
+}
+
+size_t NativeFile::readAt(void* buffer, size_t len, uint64_t offset) const {
+    char* out = static_cast<char*>(buffer);
+    size_t total = 0;
+    IoThrottle::charge(IoThrottle::Read, len);
+    PerfStats::Timer timer(PerfStats::Read);
+    while (total < len) {
+#ifdef _WIN32
+        OVERLAPPED ov = {};
+        uint64_t pos = offset + total;
+        ov.Offset = static_cast<DWORD>(pos & 0xFFFFFFFFu);
+        ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(len - total, 0x40000000u));
+        DWORD got = 0;
+        if (!ReadFile(static_cast<HANDLE>(m_handle), out + total, chunk, &got, &ov)) {
+            if (GetLastError() == ERROR_HANDLE_EOF) break;
+            throw std::runtime_error("读取文件失败");
+        }
+        if (got == 0) break;
+        total += got;
+#else
+        ssize_t got = ::pread(m_fd, out + total, len - total,
+                              static_cast<off_t>(offset + total));
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("读取文件失败: ") + std::strerror(errno));
+        }
+        if (got == 0) break;
+        total += static_cast<size_t>(got);
+#endif
+    }
+    timer.setBytes(total);
+    return total;
+}
+
+void NativeFile::writeAt(const void* buffer, size_t len, uint64_t offset) {
+    const char* in = static_cast<const char*>(buffer);
+    size_t total = 0;
+    IoThrottle::charge(IoThrottle::Write, len);
+    PerfStats::Timer timer(PerfStats::Write, len);
+    while (total < len) {
+#ifdef _WIN32
+        OVERLAPPED ov = {};
+        uint64_t pos = offset + total;
+        ov.Offset = static_cast<DWORD>(pos & 0xFFFFFFFFu);
+        ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(len - total, 0x40000000u));
+        DWORD written = 0;
+        if (!WriteFile(static_cast<HANDLE>(m_handle), in + total, chunk, &written, &ov)) {
+            throw std::runtime_error("写入文件失败");
+        }
+        total += written;
+#else
+        ssize_t written = ::pwrite(m_fd, in + total, len - total,
+                                   static_cast<off_t>(offset + total));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("写入文件失败: ") + std::strerror(errno));
+        }
+        total += static_cast<size_t>(written);
+#endif
+    }
+}
+
+void NativeFile::truncate(uint64_t newSize) {
+#ifdef _WIN32
+    FILE_END_OF_FILE_INFO info;
+    info.EndOfFile.QuadPart = static_cast<LONGLONG>(newSize);
+    if (!SetFileInformationByHandle(static_cast<HANDLE>(m_handle), FileEndOfFileInfo,
+                                    &info, sizeof(info))) {
+        throw std::runtime_error("截断文件失败");
+    }
+#else
+    if (::ftruncate(m_fd, static_cast<off_t>(newSize)) != 0) {
+        throw std::runtime_error(std::string("截断文件失败: ") + std::strerror(errno));
+    }
+#endif
+}
+
+bool NativeFile::setSparse() {
+#ifdef _WIN32
+    DWORD returned = 0;
+    return DeviceIoControl(static_cast<HANDLE>(m_handle), FSCTL_SET_SPARSE, nullptr, 0,
+                           nullptr, 0, &returned, nullptr) != 0;
+#else
+    return true;
+#endif
+}
+
+bool NativeFile::discard(uint64_t offset, uint64_t len) {
+    if (len == 0) return true;
+#ifdef __linux__
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) return false;
+    if (S_ISBLK(st.st_mode)) {
+        uint64_t range[2] = {offset, len};
+        return ::ioctl(m_fd, BLKDISCARD, &range) == 0;
+    }
+    int rc;
+    do {
+        rc = ::fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                         static_cast<off_t>(offset), static_cast<off_t>(len));
+    } while (rc != 0 && errno == EINTR);
+    return rc == 0;
+#else
+    (void)offset;
+    return false;
+#endif
+}
+
+void NativeFile::sync() {
+    PerfStats::Timer timer(PerfStats::Fsync);
+#ifdef _WIN32
+    if (!FlushFileBuffers(static_cast<HANDLE>(m_handle))) {
+        throw std::runtime_error("刷写文件失败");
+    }
+#else
+#if defined(__APPLE__)
+    int rc = ::fsync(m_fd);
+#else
+    int rc = ::fdatasync(m_fd);
+#endif
+    if (rc != 0) {
+        throw std::runtime_error(std::string("刷写文件失败: ") + std::strerror(errno));
+    }
+#endif
+}
+
+void NativeFile::syncDirectory(const std::string& dirPath) {
+#ifdef _WIN32
+    // Windows上重命名由文件系统日志保证，无需单独刷写目录
+    (void)dirPath;
+#else
+    int fd = ::open(dirPath.empty() ? "." : dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    PerfStats::Timer timer(PerfStats::Fsync);
+    ::fsync(fd);
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+bool MappedFile::map(const NativeFile& file) {
+    unmap();
+    const uint64_t size = file.size();
+    if (size == 0 || size > static_cast<uint64_t>(SIZE_MAX)) return false;
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingW(static_cast<HANDLE>(file.m_handle), nullptr,
+                                        PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+#else
+    void* view = ::mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, file.m_fd, 0);
+    if (view == MAP_FAILED) return false;
+#endif
+    m_data = static_cast<const unsigned char*>(view);
+    m_size = size;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (!m_data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+    m_mapping = nullptr;
+#else
+    ::munmap(const_cast<unsigned char*>(m_data), static_cast<size_t>(m_size));
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -0,0 +1,162 @@
+#include "../include/output_committer.h"
+#include "../include/native_file.h"
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// 批量达到该数量时改用syncfs一次刷写整个文件系统
+static const size_t SYNCFS_THRESHOLD = 8;
+
+OutputCommitter::OutputCommitter(size_t batchSize)
+    : m_batchSize(batchSize == 0 ? 1 : batchSize) {
+}
+
+OutputCommitter::~OutputCommitter() {
+    try {
+        commit();
+    } catch (...) {
+    }
+}
+
+std::string OutputCommitter::stagingPath(const std::string& finalPath) {
+    fs::path p(finalPath);
+    return (p.parent_path() / ("." + p.filename().string() + ".sfmtmp")).string();
+}
+
+std::vector<std::string> OutputCommitter::complete(const std::string& tempPath,
+                                                   const std::string& finalPath,
+                                                   std::vector<std::string>* published) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.emplace_back(tempPath, finalPath);
+    if (m_pending.size() >= m_batchSize) {
+        return commitLocked(published);
+    }
+    return {};
+}
+
+void OutputCommitter::discard(const std::string& tempPath) {
+    std::error_code ec;
+    fs::remove(tempPath, ec);
+}
+
+bool OutputCommitter::cloneExisting(const std::string& finalPath, const std::string& tempPath) {
+    std::error_code ec;
+    fs::remove(tempPath, ec);
+#ifdef __linux__
+    // 同一文件系统上克隆：副本与原文件共享数据块，只有被改写的块另行分配
+    int src = ::open(finalPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src < 0) return false;
+    int dst = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    const bool cloned = dst >= 0 && ::ioctl(dst, FICLONE, src) == 0;
+    if (dst >= 0) ::close(dst);
+    ::close(src);
+    if (!cloned) fs::remove(tempPath, ec);
+    return cloned;
+#else
+    (void)finalPath;
+    return false;
+#endif
+}
+
+bool OutputCommitter::stageExisting(const std::string& finalPath, const std::string& tempPath) {
+    std::error_code ec;
+    if (!fs::exists(finalPath, ec)) {
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    if (cloneExisting(finalPath, tempPath)) return true;
+    fs::copy_file(finalPath, tempPath, fs::copy_options::overwrite_existing);
+    return true;
+}
+
+std::vector<std::string> OutputCommitter::commit(std::vector<std::string>* published) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return commitLocked(published);
+}
+
+std::vector<std::string> OutputCommitter::commitLocked(std::vector<std::string>* published) {
+    std::vector<std::string> failed;
+    if (m_pending.empty()) return failed;
+
+    std::vector<std::pair<std::string, std::string>> batch;
+    batch.swap(m_pending);
+
+    // 第一步：数据落盘
+    std::set<std::string> synced;
+#ifdef __linux__
+    if (batch.size() >= SYNCFS_THRESHOLD) {
+        // 每个文件系统只需一次syncfs
+        std::set<dev_t> devices;
+        for (const auto& item : batch) {
+            int fd = ::open(item.first.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            struct stat st;
+            if (fstat(fd, &st) == 0) {
+                if (!devices.count(st.st_dev) && ::syncfs(fd) == 0) {
+                    devices.insert(st.st_dev);
+                }
+                if (devices.count(st.st_dev)) {
+                    synced.insert(item.first);
+                }
+            }
+            ::close(fd);
+        }
+    }
+#endif
+    for (const auto& item : batch) {
+        if (synced.count(item.first)) continue;
+        NativeFile file;
+        try {
+            if (!file.open(item.first, NativeFile::ReadWrite)) {
+                throw std::runtime_error("无法打开临时文件");
+            }
+            file.sync();
+            synced.insert(item.first);
+        } catch (const std::exception& e) {
+            std::cerr << "刷写输出失败: " << item.first << ": " << e.what() << std::endl;
+        }
+    }
+
+    // 第二步：原子重命名发布
+    std::set<std::string> dirs;
+    for (const auto& item : batch) {
+        std::error_code ec;
+        if (!synced.count(item.first)) {
+            fs::remove(item.first, ec);
+            failed.push_back(item.second);
+            continue;
+        }
+        fs::rename(item.first, item.second, ec);
+        if (ec) {
+            std::cerr << "发布输出失败: " << item.second << ": " << ec.message() << std::endl;
+            fs::remove(item.first, ec);
+            failed.push_back(item.second);
+            continue;
+        }
+        dirs.insert(fs::path(item.second).parent_path().string());
+    }
+
+    // 第三步：目录项落盘，每个目录一次
+    for (const std::string& dir : dirs) {
+        NativeFile::syncDirectory(dir);
+    }
+    if (published) {
+        std::set<std::string> failedSet(failed.begin(), failed.end());
+        for (const auto& item : batch) {
+            if (!failedSet.count(item.second)) published->push_back(item.second);
+        }
+    }
+    return failed;
+}
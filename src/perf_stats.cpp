@@ -0,0 +1,298 @@
+#include "../include/perf_stats.h"
+#include "../include/memory_budget.h"
+#include "../include/native_file.h"
+#include "../include/output_committer.h"
+#include "../include/trace_recorder.h"
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <locale>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// 单个线程的计数块：只有所属线程写入，其他线程只读
+struct ThreadCounters {
+    struct Counters {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> totalNs{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> buckets[PerfStats::BUCKET_COUNT] = {};
+    };
+    Counters stages[PerfStats::STAGE_COUNT];
+};
+
+// 所有线程的计数块；线程退出后计数块留给后来的线程复用，已有计数不丢失
+struct PerfRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadCounters>> blocks;
+    std::vector<ThreadCounters*> spare;
+    PerfStats::Snapshot baseline;
+    uint64_t baselineNs = PerfStats::nowNs();
+};
+
+// 不析构：线程局部对象在退出时仍会访问
+static PerfRegistry& registry() {
+    static PerfRegistry* instance = new PerfRegistry;
+    return *instance;
+}
+
+struct ThreadSlot {
+    ThreadCounters* counters = nullptr;
+    ~ThreadSlot() {
+        if (!counters) return;
+        PerfRegistry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.spare.push_back(counters);
+    }
+};
+
+static ThreadCounters& localCounters() {
+    thread_local ThreadSlot slot;
+    if (!slot.counters) {
+        PerfRegistry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.spare.empty()) {
+            slot.counters = r.spare.back();
+            r.spare.pop_back();
+        } else {
+            r.blocks.emplace_back(new ThreadCounters());
+            slot.counters = r.blocks.back().get();
+        }
+    }
+    return *slot.counters;
+}
+
+// 单写者累加，不需要原子读改写指令
+static inline void add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static size_t bucketIndex(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    size_t index = 0;
+    while (us > 0 && index < PerfStats::BUCKET_COUNT - 1) {
+        us >>= 1;
+        index++;
+    }
+    return index;
+}
+
+// 桶上界，单位纳秒
+static uint64_t bucketBoundNs(size_t index) {
+    return (1ull << index) * 1000;
+}
+
+void PerfStats::record(Stage stage, uint64_t ns, uint64_t bytes) {
+    ThreadCounters::Counters& c = localCounters().stages[stage];
+    add(c.count, 1);
+    add(c.totalNs, ns);
+    if (bytes) add(c.bytes, bytes);
+    add(c.buckets[bucketIndex(ns)], 1);
+    // 开启时间线记录时同时记录为一个区间
+    if (TraceRecorder::enabled()) {
+        const uint64_t end = nowNs();
+        TraceRecorder::complete(stageName(stage), end - ns, end, bytes);
+    }
+}
+
+static PerfStats::Snapshot mergeLocked(const PerfRegistry& r) {
+    PerfStats::Snapshot s;
+    for (const auto& block : r.blocks) {
+        for (size_t i = 0; i < PerfStats::STAGE_COUNT; i++) {
+            const ThreadCounters::Counters& c = block->stages[i];
+            PerfStats::StageStats& out = s.stages[i];
+            out.count += c.count.load(std::memory_order_relaxed);
+            out.totalNs += c.totalNs.load(std::memory_order_relaxed);
+            out.bytes += c.bytes.load(std::memory_order_relaxed);
+            for (size_t b = 0; b < PerfStats::BUCKET_COUNT; b++) {
+                out.buckets[b] += c.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return s;
+}
+
+PerfStats::Snapshot PerfStats::snapshot() {
+    PerfRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    Snapshot s = mergeLocked(r);
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        StageStats& out = s.stages[i];
+        const StageStats& base = r.baseline.stages[i];
+        out.count -= base.count;
+        out.totalNs -= base.totalNs;
+        out.bytes -= base.bytes;
+        for (size_t b = 0; b < BUCKET_COUNT; b++) {
+            out.buckets[b] -= base.buckets[b];
+        }
+    }
+    s.wallNs = nowNs() - r.baselineNs;
+    const MemoryBudget::Stats memory = MemoryBudget::stats();
+    s.memoryLimit = memory.limit;
+    s.memoryPeak = memory.peak;
+    return s;
+}
+
+void PerfStats::reset() {
+    PerfRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.baseline = mergeLocked(r);
+    r.baselineNs = nowNs();
+    MemoryBudget::resetPeak();
+}
+
+uint64_t PerfStats::StageStats::percentileNs(double q) const {
+    if (count == 0) return 0;
+    const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < BUCKET_COUNT - 1; b++) {
+        seen += buckets[b];
+        if (seen >= target) return bucketBoundNs(b);
+    }
+    return bucketBoundNs(BUCKET_COUNT - 1);
+}
+
+const char* PerfStats::stageName(Stage stage) {
+    switch (stage) {
+    case OpenStat: return "open_stat";
+    case Read: return "read";
+    case Kdf: return "kdf";
+    case Cipher: return "cipher";
+    case Hash: return "hash";
+    case Write: return "write";
+    case Fsync: return "fsync";
+    case QueueWait: return "queue_wait";
+    case MemWait: return "mem_wait";
+    case STAGE_COUNT: break;
+    }
+    return "unknown";
+}
+
+const char* PerfStats::stageLabel(Stage stage) {
+    switch (stage) {
+    case OpenStat: return "打开/stat";
+    case Read: return "读取";
+    case Kdf: return "密钥派生";
+    case Cipher: return "加解密";
+    case Hash: return "哈希";
+    case Write: return "写入";
+    case Fsync: return "刷盘";
+    case QueueWait: return "排队等待";
+    case MemWait: return "内存等待";
+    case STAGE_COUNT: break;
+    }
+    return "未知";
+}
+
+// 数值一律使用C区域格式，不受界面语言设置影响
+static std::ostringstream numericStream() {
+    std::ostringstream out;
+    out.imbue(std::locale::classic());
+    out << std::setprecision(10);
+    return out;
+}
+
+std::string PerfStats::toPrometheus(const Snapshot& s) {
+    std::ostringstream out = numericStream();
+    out << "# HELP sfm_stage_duration_seconds Time spent in each processing stage.\n"
+        << "# TYPE sfm_stage_duration_seconds histogram\n";
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        const StageStats& st = s.stages[i];
+        const char* name = stageName(static_cast<Stage>(i));
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < BUCKET_COUNT - 1; b++) {
+            cumulative += st.buckets[b];
+            out << "sfm_stage_duration_seconds_bucket{stage=\"" << name << "\",le=\""
+                << static_cast<double>(bucketBoundNs(b)) / 1e9 << "\"} " << cumulative << "\n";
+        }
+        out << "sfm_stage_duration_seconds_bucket{stage=\"" << name << "\",le=\"+Inf\"} "
+            << st.count << "\n"
+            << "sfm_stage_duration_seconds_sum{stage=\"" << name << "\"} "
+            << static_cast<double>(st.totalNs) / 1e9 << "\n"
+            << "sfm_stage_duration_seconds_count{stage=\"" << name << "\"} " << st.count << "\n";
+    }
+    out << "# HELP sfm_stage_bytes_total Bytes processed in each stage.\n"
+        << "# TYPE sfm_stage_bytes_total counter\n";
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        out << "sfm_stage_bytes_total{stage=\"" << stageName(static_cast<Stage>(i)) << "\"} "
+            << s.stages[i].bytes << "\n";
+    }
+    out << "# HELP sfm_run_duration_seconds Wall time of the last run.\n"
+        << "# TYPE sfm_run_duration_seconds gauge\n"
+        << "sfm_run_duration_seconds " << static_cast<double>(s.wallNs) / 1e9 << "\n"
+        << "# HELP sfm_run_timestamp_seconds Unix time the last run finished.\n"
+        << "# TYPE sfm_run_timestamp_seconds gauge\n"
+        << "sfm_run_timestamp_seconds " << static_cast<long long>(std::time(nullptr)) << "\n"
+        << "# HELP sfm_memory_limit_bytes Memory budget for buffers, 0 if unlimited.\n"
+        << "# TYPE sfm_memory_limit_bytes gauge\n"
+        << "sfm_memory_limit_bytes " << s.memoryLimit << "\n"
+        << "# HELP sfm_memory_peak_bytes Peak buffer memory held during the last run.\n"
+        << "# TYPE sfm_memory_peak_bytes gauge\n"
+        << "sfm_memory_peak_bytes " << s.memoryPeak << "\n";
+    return out.str();
+}
+
+std::string PerfStats::toJson(const Snapshot& s) {
+    std::ostringstream out = numericStream();
+    out << "{\n  \"wall_seconds\": " << static_cast<double>(s.wallNs) / 1e9
+        << ",\n  \"memory_limit_bytes\": " << s.memoryLimit
+        << ",\n  \"memory_peak_bytes\": " << s.memoryPeak
+        << ",\n  \"stages\": [";
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        const StageStats& st = s.stages[i];
+        const double seconds = static_cast<double>(st.totalNs) / 1e9;
+        out << (i ? ",\n" : "\n") << "    {\"stage\": \"" << stageName(static_cast<Stage>(i))
+            << "\", \"count\": " << st.count
+            << ", \"seconds\": " << seconds
+            << ", \"bytes\": " << st.bytes
+            << ", \"busy_mb_per_s\": " << (seconds > 0 ? st.bytes / seconds / 1e6 : 0.0)
+            << ", \"p50_ms\": " << st.percentileNs(0.5) / 1e6
+            << ", \"p99_ms\": " << st.percentileNs(0.99) / 1e6 << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+static void writeAtomically(const std::string& path, const std::string& content) {
+    std::string tempPath = OutputCommitter::stagingPath(path);
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out || !out.write(content.data(), static_cast<std::streamsize>(content.size())).flush()) {
+            OutputCommitter::discard(tempPath);
+            throw std::runtime_error("无法写入统计文件: " + tempPath);
+        }
+    }
+    NativeFile file;
+    if (file.open(tempPath, NativeFile::ReadWrite)) {
+        file.sync();
+        file.close();
+    }
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        OutputCommitter::discard(tempPath);
+        throw std::runtime_error("无法写入统计文件: " + ec.message());
+    }
+}
+
+void PerfStats::writePrometheus(const std::string& path, const Snapshot& snapshot) {
+    writeAtomically(path, toPrometheus(snapshot));
+}
+
+void PerfStats::writeJson(const std::string& path, const Snapshot& snapshot) {
+    writeAtomically(path, toJson(snapshot));
+}
+
+void PerfStats::exportTo(const std::string& dir, const Snapshot& snapshot) {
+    writePrometheus((fs::path(dir) / "securefilemanager.prom").string(), snapshot);
+    writeJson((fs::path(dir) / "securefilemanager_stats.json").string(), snapshot);
+}
@@ -0,0 +1,253 @@
+#include "../include/session_key_cache.h"
+#include "../include/perf_stats.h"
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <cryptopp/hmac.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/pwdbased.h>
+#include <cryptopp/sha.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// 缓存条目，keySize为0表示空闲
+struct CacheSlot {
+    CryptoPP::byte tag[CryptoPP::SHA256::DIGESTSIZE];
+    CryptoPP::byte key[SessionKeyCache::MAX_KEY_SIZE];
+    uint64_t expiresNs;
+    uint64_t lastUsedNs;
+    uint32_t keySize;
+};
+
+// 锁定内存区域的开头存放计算查找键用的进程随机密钥，之后是条目数组
+static const size_t SECRET_SIZE = 32;
+static const size_t SLOTS_OFFSET = 64;
+
+static std::mutex g_mutex;
+static void* g_region = nullptr;
+static size_t g_regionSize = 0;
+static CryptoPP::byte* g_secret = nullptr;
+static CacheSlot* g_slots = nullptr;
+static size_t g_slotCount = 0;
+static uint64_t g_ttlNs = 0;
+static uint64_t g_generation = 0; // 每次configure()递增，派生期间设置变化时不存入
+static SessionKeyCache::Stats g_stats;
+
+static void wipe(void* ptr, size_t size) {
+    volatile unsigned char* p = static_cast<volatile unsigned char*>(ptr);
+    while (size--) *p++ = 0;
+}
+
+static uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static size_t pageSize() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    const long size = ::sysconf(_SC_PAGESIZE);
+    return size > 0 ? static_cast<size_t>(size) : 4096;
+#endif
+}
+
+// 分配整页并锁定在内存中，锁定失败时释放并返回nullptr
+static void* allocateLocked(size_t size) {
+#ifdef _WIN32
+    void* region = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!region) return nullptr;
+    if (!VirtualLock(region, size)) {
+        VirtualFree(region, 0, MEM_RELEASE);
+        return nullptr;
+    }
+#else
+    void* region = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) return nullptr;
+    if (::mlock(region, size) != 0) {
+        ::munmap(region, size);
+        return nullptr;
+    }
+#ifdef MADV_DONTDUMP
+    ::madvise(region, size, MADV_DONTDUMP);
+#endif
+#endif
+    std::memset(region, 0, size);
+    return region;
+}
+
+static void releaseLocked() {
+    if (!g_region) return;
+    wipe(g_region, g_regionSize);
+#ifdef _WIN32
+    VirtualUnlock(g_region, g_regionSize);
+    VirtualFree(g_region, 0, MEM_RELEASE);
+#else
+    ::munlock(g_region, g_regionSize);
+    ::munmap(g_region, g_regionSize);
+#endif
+    g_region = nullptr;
+    g_regionSize = 0;
+    g_secret = nullptr;
+    g_slots = nullptr;
+    g_slotCount = 0;
+}
+
+static void freeSlot(CacheSlot& slot) {
+    wipe(&slot, sizeof(slot));
+}
+
+static void purgeLocked(uint64_t now) {
+    for (size_t i = 0; i < g_slotCount; i++) {
+        if (g_slots[i].keySize != 0 && g_slots[i].expiresNs <= now) {
+            freeSlot(g_slots[i]);
+        }
+    }
+}
+
+static void putUint32(CryptoPP::HMAC<CryptoPP::SHA256>& hmac, uint32_t value) {
+    CryptoPP::byte data[4];
+    for (int i = 0; i < 4; i++) data[i] = static_cast<CryptoPP::byte>(value >> (8 * i));
+    hmac.Update(data, sizeof(data));
+}
+
+// 查找键：HMAC(进程密钥, 密码 | 盐 | 迭代次数 | 密钥长度)，各字段带长度前缀
+static void computeTag(const std::string& password, const CryptoPP::byte* salt, size_t saltSize,
+                       uint32_t iterations, size_t keySize, CryptoPP::byte* tag) {
+    CryptoPP::HMAC<CryptoPP::SHA256> hmac(g_secret, SECRET_SIZE);
+    putUint32(hmac, static_cast<uint32_t>(password.size()));
+    hmac.Update(reinterpret_cast<const CryptoPP::byte*>(password.data()), password.size());
+    putUint32(hmac, static_cast<uint32_t>(saltSize));
+    hmac.Update(salt, saltSize);
+    putUint32(hmac, iterations);
+    putUint32(hmac, static_cast<uint32_t>(keySize));
+    hmac.Final(tag);
+}
+
+static CacheSlot* findLocked(const CryptoPP::byte* tag) {
+    for (size_t i = 0; i < g_slotCount; i++) {
+        if (g_slots[i].keySize != 0 &&
+            std::memcmp(g_slots[i].tag, tag, sizeof(g_slots[i].tag)) == 0) {
+            return &g_slots[i];
+        }
+    }
+    return nullptr;
+}
+
+// 已有相同条目时覆盖，否则使用空闲条目，没有空闲时淘汰最久未使用的条目
+static void storeLocked(const CryptoPP::byte* tag, const CryptoPP::byte* key, size_t keySize,
+                        uint64_t now) {
+    CacheSlot* slot = findLocked(tag);
+    for (size_t i = 0; !slot && i < g_slotCount; i++) {
+        if (g_slots[i].keySize == 0) slot = &g_slots[i];
+    }
+    if (!slot) {
+        slot = &g_slots[0];
+        for (size_t i = 1; i < g_slotCount; i++) {
+            if (g_slots[i].lastUsedNs < slot->lastUsedNs) slot = &g_slots[i];
+        }
+        freeSlot(*slot);
+    }
+    std::memcpy(slot->tag, tag, sizeof(slot->tag));
+    std::memcpy(slot->key, key, keySize);
+    slot->keySize = static_cast<uint32_t>(keySize);
+    slot->expiresNs = now + g_ttlNs;
+    slot->lastUsedNs = now;
+}
+
+bool SessionKeyCache::configure(unsigned ttlSeconds, size_t maxEntries) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    releaseLocked();
+    g_generation++;
+    g_ttlNs = static_cast<uint64_t>(ttlSeconds) * 1000000000ull;
+    if (ttlSeconds == 0 || maxEntries == 0) return true;
+
+    const size_t page = pageSize();
+    const size_t size = (SLOTS_OFFSET + maxEntries * sizeof(CacheSlot) + page - 1) / page * page;
+    void* region = allocateLocked(size);
+    if (!region) return false;
+    g_region = region;
+    g_regionSize = size;
+    g_secret = static_cast<CryptoPP::byte*>(region);
+    g_slots = reinterpret_cast<CacheSlot*>(static_cast<CryptoPP::byte*>(region) + SLOTS_OFFSET);
+    g_slotCount = maxEntries;
+    CryptoPP::AutoSeededRandomPool rng;
+    rng.GenerateBlock(g_secret, SECRET_SIZE);
+    return true;
+}
+
+bool SessionKeyCache::enabled() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_slotCount > 0;
+}
+
+void SessionKeyCache::derive(const std::string& password, const CryptoPP::byte* salt,
+                             size_t saltSize, uint32_t iterations,
+                             CryptoPP::byte* key, size_t keySize) {
+    CryptoPP::byte tag[CryptoPP::SHA256::DIGESTSIZE];
+    uint64_t generation = 0;
+    bool cacheable = false;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_slotCount > 0 && keySize <= MAX_KEY_SIZE) {
+            const uint64_t now = nowNs();
+            purgeLocked(now);
+            computeTag(password, salt, saltSize, iterations, keySize, tag);
+            if (CacheSlot* slot = findLocked(tag)) {
+                std::memcpy(key, slot->key, keySize);
+                slot->lastUsedNs = now;
+                g_stats.hits++;
+                return;
+            }
+            g_stats.misses++;
+            generation = g_generation;
+            cacheable = true;
+        }
+    }
+
+    // 派生期间不持有锁，多个线程可以同时派生不同的密钥
+    {
+        PerfStats::Timer timer(PerfStats::Kdf);
+        CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA256> pbkdf;
+        pbkdf.DeriveKey(key, keySize, 0,
+                        reinterpret_cast<const CryptoPP::byte*>(password.data()), password.size(),
+                        salt, saltSize, iterations);
+    }
+
+    if (cacheable) {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_generation == generation && g_slotCount > 0) {
+            storeLocked(tag, key, keySize, nowNs());
+        }
+    }
+    wipe(tag, sizeof(tag));
+}
+
+void SessionKeyCache::purgeExpired() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    purgeLocked(nowNs());
+}
+
+void SessionKeyCache::clear() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (size_t i = 0; i < g_slotCount; i++) {
+        if (g_slots[i].keySize != 0) freeSlot(g_slots[i]);
+    }
+}
+
+SessionKeyCache::Stats SessionKeyCache::stats() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    Stats stats = g_stats;
+    stats.entries = 0;
+    for (size_t i = 0; i < g_slotCount; i++) {
+        if (g_slots[i].keySize != 0) stats.entries++;
+    }
+    return stats;
+}
@@ -0,0 +1,236 @@
+#include "../include/trace_recorder.h"
+#include "../include/output_committer.h"
+#include "../include/perf_stats.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <locale>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+std::atomic<bool> TraceRecorder::s_enabled(false);
+
+// 每块容纳的事件数；写满后追加新块，已写的事件不再移动
+static const size_t BLOCK_EVENTS = 4096;
+
+struct TraceEvent {
+    const char* name = nullptr;
+    uint64_t startNs = 0;
+    uint64_t endNs = 0;
+    uint64_t bytes = 0;
+    std::string detail;
+};
+
+struct TraceBlock {
+    TraceEvent events[BLOCK_EVENTS];
+    std::atomic<size_t> count{0};
+    std::atomic<TraceBlock*> next{nullptr};
+};
+
+// 单个线程的事件缓冲：只有所属线程追加，导出时按count读取已发布的事件
+struct ThreadTrace {
+    int tid = 0;
+    TraceBlock* tail = nullptr;
+    size_t total = 0;
+    std::atomic<size_t> dropped{0};
+    std::unique_ptr<TraceBlock> head;
+
+    ~ThreadTrace() {
+        TraceBlock* block = head.release();
+        while (block) {
+            TraceBlock* next = block->next.load(std::memory_order_relaxed);
+            delete block;
+            block = next;
+        }
+    }
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadTrace>> threads;
+    std::atomic<uint64_t> generation{1};
+    uint64_t baseNs = 0;
+    int nextTid = 1;
+};
+
+static TraceRegistry& registry() {
+    static TraceRegistry* instance = new TraceRegistry;
+    return *instance;
+}
+
+// 线程首次记录（或start()清空之后）时登记新的缓冲区
+static ThreadTrace& localTrace() {
+    thread_local ThreadTrace* trace = nullptr;
+    thread_local uint64_t generation = 0;
+    TraceRegistry& r = registry();
+    const uint64_t current = r.generation.load(std::memory_order_acquire);
+    if (!trace || generation != current) {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.emplace_back(new ThreadTrace);
+        trace = r.threads.back().get();
+        trace->tid = r.nextTid++;
+        trace->head.reset(new TraceBlock);
+        trace->tail = trace->head.get();
+        generation = current;
+    }
+    return *trace;
+}
+
+void TraceRecorder::start() {
+    TraceRegistry& r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.clear();
+        r.nextTid = 1;
+        r.baseNs = PerfStats::nowNs();
+        r.generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+    s_enabled.store(true, std::memory_order_release);
+}
+
+void TraceRecorder::stop() {
+    s_enabled.store(false, std::memory_order_release);
+}
+
+void TraceRecorder::complete(const char* name, uint64_t startNs, uint64_t endNs,
+                             uint64_t bytes, const std::string& detail) {
+    if (!enabled()) return;
+    ThreadTrace& t = localTrace();
+    if (t.total >= MAX_EVENTS_PER_THREAD) {
+        t.dropped.store(t.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    TraceBlock* block = t.tail;
+    size_t index = block->count.load(std::memory_order_relaxed);
+    if (index == BLOCK_EVENTS) {
+        TraceBlock* fresh = new TraceBlock;
+        block->next.store(fresh, std::memory_order_release);
+        t.tail = block = fresh;
+        index = 0;
+    }
+    TraceEvent& e = block->events[index];
+    e.name = name;
+    e.startNs = startNs;
+    e.endNs = endNs;
+    e.bytes = bytes;
+    e.detail = detail;
+    // 事件写完后再发布
+    block->count.store(index + 1, std::memory_order_release);
+    t.total++;
+}
+
+TraceRecorder::Span::Span(const char* name, const std::string& detail)
+    : m_name(name), m_start(0) {
+    if (enabled()) {
+        m_detail = detail;
+        m_start = PerfStats::nowNs();
+    }
+}
+
+TraceRecorder::Span::~Span() {
+    if (m_start) {
+        complete(m_name, m_start, PerfStats::nowNs(), 0, m_detail);
+    }
+}
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+size_t TraceRecorder::eventCount() {
+    TraceRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    size_t count = 0;
+    for (const auto& t : r.threads) {
+        for (const TraceBlock* b = t->head.get(); b; b = b->next.load(std::memory_order_acquire)) {
+            count += b->count.load(std::memory_order_acquire);
+        }
+    }
+    return count;
+}
+
+size_t TraceRecorder::droppedCount() {
+    TraceRegistry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    size_t count = 0;
+    for (const auto& t : r.threads) {
+        count += t->dropped.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void TraceRecorder::write(const std::string& path) {
+    TraceRegistry& r = registry();
+    std::string tempPath = OutputCommitter::stagingPath(path);
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("无法写入时间线文件: " + tempPath);
+        }
+        out.imbue(std::locale::classic());
+        out << std::fixed << std::setprecision(3);
+
+        std::lock_guard<std::mutex> lock(r.mutex);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+            << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, "
+            << "\"args\": {\"name\": \"SecureFileManager\"}}";
+        for (const auto& t : r.threads) {
+            out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t->tid
+                << ", \"args\": {\"name\": \"线程 " << t->tid << "\"}}";
+            for (const TraceBlock* b = t->head.get(); b; b = b->next.load(std::memory_order_acquire)) {
+                const size_t count = b->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; i++) {
+                    const TraceEvent& e = b->events[i];
+                    // 时间戳和持续时间以微秒为单位
+                    const double ts = (e.startNs >= r.baseNs ? e.startNs - r.baseNs : 0) / 1000.0;
+                    const double dur = (e.endNs - e.startNs) / 1000.0;
+                    out << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                        << t->tid << ", \"ts\": " << ts << ", \"dur\": " << dur;
+                    if (e.bytes || !e.detail.empty()) {
+                        out << ", \"args\": {";
+                        if (e.bytes) out << "\"bytes\": " << e.bytes;
+                        if (!e.detail.empty()) {
+                            out << (e.bytes ? ", " : "") << "\"file\": \"" << jsonEscape(e.detail) << "\"";
+                        }
+                        out << "}";
+                    }
+                    out << "}";
+                }
+            }
+        }
+        out << "\n]}\n";
+        if (!out.flush()) {
+            OutputCommitter::discard(tempPath);
+            throw std::runtime_error("无法写入时间线文件: " + tempPath);
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        OutputCommitter::discard(tempPath);
+        throw std::runtime_error("无法写入时间线文件: " + ec.message());
+    }
+}
@@ -0,0 +1,257 @@
+#include "../include/wipe_scheduler.h"
+#include "../include/memory_budget.h"
+#include "../include/native_file.h"
+#include "../include/parallel_for.h"
+#include "../include/trace_recorder.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <climits>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef __linux__
+// 每个文件系统执行一次FITRIM，返回回收的字节数；无权限或不支持时跳过
+static uint64_t trimFilesystems(const std::set<std::string>& dirs) {
+    uint64_t trimmed = 0;
+    std::set<dev_t> devices;
+    for (const std::string& dir : dirs) {
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) continue;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && devices.insert(st.st_dev).second) {
+            struct fstrim_range range;
+            range.start = 0;
+            range.len = ULLONG_MAX;
+            range.minlen = 0;
+            if (::ioctl(fd, FITRIM, &range) == 0) {
+                trimmed += range.len;
+            } else {
+                std::cerr << "FITRIM失败: " << dir << ": " << std::strerror(errno) << std::endl;
+            }
+        }
+        ::close(fd);
+    }
+    return trimmed;
+}
+#endif
+
+WipeScheduler::WipeScheduler()
+    : WipeScheduler(Options()) {
+}
+
+WipeScheduler::WipeScheduler(const Options& options)
+    : m_options(options), m_files(0), m_failed(0) {
+    if (m_options.ioDepth == 0) m_options.ioDepth = 1;
+    if (m_options.passes < 1) m_options.passes = 1;
+    if (m_options.unlinkBatch == 0) m_options.unlinkBatch = 1;
+}
+
+void WipeScheduler::overwrite(const std::string& path, const Options& options,
+                              uint64_t& bytesOverwritten, uint64_t& bytesDiscarded) {
+    bytesOverwritten = 0;
+    bytesDiscarded = 0;
+
+    NativeFile file;
+    if (!file.open(path, NativeFile::ReadWrite)) {
+        throw std::runtime_error("无法打开文件");
+    }
+    const uint64_t size = file.size();
+    if (size == 0) return;
+
+    // 稀疏文件只覆盖有数据的区段：空洞没有占用磁盘块，写入反而会为其分配新块
+    std::vector<std::pair<uint64_t, uint64_t>> extents;
+    if (file.allocatedSize() < size) {
+        uint64_t start = 0;
+        uint64_t end = 0;
+        for (uint64_t pos = 0; pos < size && file.nextData(pos, start, end) && end > pos;) {
+            end = std::min(end, size);
+            if (start < end) extents.emplace_back(start, end);
+            pos = end;
+        }
+    } else {
+        extents.emplace_back(0, size);
+    }
+
+    // 固定大小的缓冲区，内存占用与文件大小无关，并计入内存预算
+    const size_t bufferSize = static_cast<size_t>(std::min<uint64_t>(size, CHUNK_SIZE));
+    MemoryBudget::Lease memory(bufferSize);
+    std::vector<unsigned char> buffer(bufferSize);
+    std::random_device rd;
+    std::mt19937_64 gen((static_cast<uint64_t>(rd()) << 32) | rd());
+
+    const int passes = std::max(1, options.passes);
+    for (int pass = 0; pass < passes; pass++) {
+        const bool random = (pass == passes - 1);
+        if (!random) {
+            // 固定模式交替使用0xFF和0x00
+            std::fill(buffer.begin(), buffer.end(),
+                      static_cast<unsigned char>(pass % 2 == 0 ? 0xFF : 0x00));
+        }
+        for (const auto& extent : extents) {
+            for (uint64_t offset = extent.first; offset < extent.second; offset += buffer.size()) {
+                const size_t len = static_cast<size_t>(
+                    std::min<uint64_t>(buffer.size(), extent.second - offset));
+                if (random) {
+                    for (size_t i = 0; i < len; i += sizeof(uint64_t)) {
+                        uint64_t r = gen();
+                        std::memcpy(&buffer[i], &r, std::min(sizeof(r), len - i));
+                    }
+                }
+                file.writeAt(buffer.data(), len, offset);
+            }
+        }
+        // 每遍都要落盘，否则多遍覆盖会在页缓存中合并成一次写入
+        file.sync();
+    }
+    for (const auto& extent : extents) {
+        bytesOverwritten += extent.second - extent.first;
+    }
+
+    if (options.discard && file.discard(0, size)) {
+        bytesDiscarded = size;
+    }
+}
+
+WipeScheduler::Stats WipeScheduler::run(const std::vector<std::string>& paths,
+                                        FileCallback callback,
+                                        const std::atomic<bool>* cancel) {
+    m_callback = callback;
+    m_pending.clear();
+    m_dirs.clear();
+    m_files = 0;
+    m_failed = 0;
+    std::atomic<uint64_t> overwritten(0);
+    std::atomic<uint64_t> discarded(0);
+
+    parallelForEach(paths.size(), m_options.ioDepth, [&](size_t i) {
+        if (cancel && *cancel) return;
+        const std::string& path = paths[i];
+        TraceRecorder::Span span("file", path);
+        try {
+            std::error_code ec;
+            fs::file_status status = fs::status(path, ec);
+            if (ec || !fs::exists(status)) {
+                throw std::runtime_error("文件不存在");
+            }
+
+            uint64_t written = 0;
+            uint64_t freed = 0;
+            overwrite(path, m_options, written, freed);
+            overwritten += written;
+            discarded += freed;
+
+            if (fs::is_block_file(status)) {
+                report(path, true, "");
+            } else {
+                queueUnlink(path);
+            }
+        } catch (const std::exception& e) {
+            report(path, false, e.what());
+        }
+    });
+
+    // 已覆盖的文件即使被取消也要删除
+    flushUnlinks();
+
+    Stats stats;
+    stats.files = m_files;
+    stats.failed = m_failed;
+    stats.bytesOverwritten = overwritten;
+    stats.bytesDiscarded = discarded;
+#ifdef __linux__
+    if (m_options.trim && !m_dirs.empty()) {
+        stats.bytesTrimmed = trimFilesystems(m_dirs);
+    }
+#endif
+    m_callback = nullptr;
+    return stats;
+}
+
+void WipeScheduler::queueUnlink(const std::string& path) {
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(path);
+        full = (m_pending.size() >= m_options.unlinkBatch);
+    }
+    if (full) {
+        flushUnlinks();
+    }
+}
+
+void WipeScheduler::flushUnlinks() {
+    std::lock_guard<std::mutex> unlinkLock(m_unlinkMutex);
+    std::vector<std::string> batch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        batch.swap(m_pending);
+    }
+    if (batch.empty()) return;
+
+    // 按所在目录分组，每个目录打开一次
+    std::map<std::string, std::vector<std::string>> byDir;
+    for (const std::string& path : batch) {
+        byDir[fs::path(path).parent_path().string()].push_back(path);
+    }
+
+    for (const auto& group : byDir) {
+        const std::string dir = group.first.empty() ? "." : group.first;
+        m_dirs.insert(dir);
+#ifdef _WIN32
+        for (const std::string& path : group.second) {
+            std::error_code ec;
+            bool removed = fs::remove(path, ec);
+            report(path, removed, ec ? ec.message() : (removed ? "" : "删除文件失败"));
+        }
+#else
+        int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        const std::string openError = (dirFd < 0) ? std::strerror(errno) : "";
+        for (const std::string& path : group.second) {
+            if (dirFd < 0) {
+                report(path, false, "无法打开目录: " + openError);
+                continue;
+            }
+            const std::string name = fs::path(path).filename().string();
+            if (::unlinkat(dirFd, name.c_str(), 0) != 0) {
+                report(path, false, std::string("删除文件失败: ") + std::strerror(errno));
+            } else {
+                report(path, true, "");
+            }
+        }
+        if (dirFd >= 0) {
+            // 整批删除后只刷写一次目录项
+            ::fsync(dirFd);
+            ::close(dirFd);
+        }
+#endif
+    }
+}
+
+void WipeScheduler::report(const std::string& path, bool success, const std::string& error) {
+    if (success) {
+        m_files++;
+    } else {
+        m_failed++;
+    }
+    if (m_callback) {
+        m_callback(path, success, error);
+    }
+}
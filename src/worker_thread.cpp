@@ -0,0 +1,944 @@
+#include "../include/worker_thread.h"
+#include <QFileInfoList>
+#include <algorithm>
+#include <mutex>
+#include "../include/job_client.h"
+#include "../include/parallel_for.h"
+#include "../include/session_key_cache.h"
+
+// ==================== WorkerThread 实现 ====================
+
+WorkerThread::WorkerThread(QObject *parent) 
+    : QThread(parent), m_cancel(false), m_inPlace(false), m_currentItem(0),
+      m_incremental(false), m_skippedCount(0), m_delta(false),
+      m_hashAlgorithms(MultiHasher::SHA256), m_threadCount(0)
+{
+}
+
+void WorkerThread::processFiles(Operation op, const QList<QString> &files, 
+                               const QString &pwd, const QString &outDir)
+{
+    currentOp = op;
+    fileList = files;
+    password = pwd;
+    outputDirectory = outDir;
+    start();
+}
+
+// 覆盖后清空，避免密码在批次结束后继续留在内存中
+static void wipePassword(QString &password)
+{
+    password.fill(QChar(0));
+    password.clear();
+}
+
+void WorkerThread::run()
+{
+    // 无论以何种方式结束，都清除本批次的密码和KEK；再次处理同一批文件时由密钥缓存免去派生
+    struct PasswordWiper {
+        QString &password;
+        QString &newPassword;
+        std::unique_ptr<KeyEnvelope::Kek> &kek;
+        ~PasswordWiper() {
+            wipePassword(password);
+            wipePassword(newPassword);
+            kek.reset();
+        }
+    } passwordWiper{password, newPassword, m_kek};
+    
+    m_cancel = false;
+    m_pendingOutputs.clear();
+    m_failedItems.clear();
+    m_currentItem = 0;
+    m_skippedCount = 0;
+    m_hashEntries.clear();
+    m_catalogEntries.clear();
+    
+    // 交给后台服务执行；服务不支持的选项（原地、增量、分块、清单等）仍在本地处理
+    if (!m_serviceSocket.isEmpty()) {
+        const bool remote = (currentOp == Encrypt && !m_inPlace && !m_incremental && !m_delta) ||
+                            (currentOp == Decrypt && !m_inPlace) ||
+                            currentOp == Verify || currentOp == Wipe ||
+                            (currentOp == CalculateHash && m_hashManifestPath.isEmpty());
+        if (remote) {
+            runRemote();
+            return;
+        }
+        emit logMessageRequested("后台服务不支持当前操作或选项，改为本地执行");
+    }
+    
+    // 本批次的所有读写（包括并行处理创建的线程）都按当前限额节流
+    IoThrottle::Scope throttle(&m_throttle, true);
+    PerfStats::reset();
+    const SessionKeyCache::Stats keyCacheBefore = SessionKeyCache::stats();
+    if (!m_tracePath.isEmpty()) {
+        TraceRecorder::start();
+    }
+    int successCount = 0; // 成功计数
+    int failCount = 0;    // 失败计数
+    std::vector<bool> itemResults; // 各顶层条目的处理结果
+    
+    const bool incremental = (currentOp == Encrypt && m_incremental && !m_inPlace);
+    
+    try {
+        if (incremental &&
+            !m_manifest.load(outputDirectory.toStdString(), password.toStdString())) {
+            emit logMessageRequested("密码与增量清单不匹配，将重新加密全部文件", true);
+        }
+        
+        // 普通加密整批共用一个KEK，只派生一次，每个文件仍有独立的随机数据密钥；
+        // 原地加密中断后要凭密码恢复，分块密文沿用已有密文中的盐，这两种仍按文件派生
+        if (currentOp == Encrypt && !m_inPlace && !m_delta) {
+            m_kek.reset(new KeyEnvelope::Kek);
+            KeyEnvelope::newKek(password.toStdString(), CryptoEngine::kdfIterations(), *m_kek);
+        }
+        
+        if (m_cancel) {
+            emit operationCompleted(false, "操作已取消");
+            return;
+        }
+        
+        const int totalFiles = fileList.size();
+        int processedFiles = 0;
+        
+        if (currentOp == Verify || currentOp == Rekey) {
+            processFilesParallel(currentOp, successCount, failCount);
+        } else if (currentOp == Wipe) {
+            wipeFiles(successCount, failCount);
+        } else if (currentOp == Check) {
+            checkManifest(successCount, failCount);
+        } else {
+            foreach (const QString &path, fileList) {
+                if (m_cancel) {
+                    break; // 取消操作，跳出循环
+                }
+                
+                m_currentItem = processedFiles;
+                QFileInfo info(path);
+                bool result = false;
+                if (info.isDir()) {
+                    result = processDirectory(currentOp, path);
+                } else {
+                    result = processSingleFile(currentOp, info);
+                }
+                
+                itemResults.push_back(result);
+                if (result) {
+                    successCount++;
+                } else {
+                    failCount++;
+                }
+                
+                processedFiles++;
+                int progress = static_cast<int>((processedFiles * 100) / totalFiles);
+                emit progressChanged(progress, 
+                    QString("已完成 %1/%2").arg(processedFiles).arg(totalFiles));
+            }
+        }
+        
+        // 发布剩余的输出文件（成批刷盘后重命名），有输出未能发布的条目改记为失败
+        commitOutputs();
+        for (int item : m_failedItems) {
+            if (item < static_cast<int>(itemResults.size()) && itemResults[item]) {
+                successCount--;
+                failCount++;
+            }
+        }
+        
+        if (incremental) {
+            finishIncremental();
+        }
+        
+        if (!m_catalogEntries.empty()) {
+            updateCatalog();
+        }
+        
+        if (currentOp == CalculateHash && !m_hashManifestPath.isEmpty()) {
+            saveHashManifest();
+        }
+        
+        // 根据成功和失败的数量生成结果消息
+        QString resultMsg;
+        bool overallSuccess = false;
+        
+        if (m_cancel) {
+            resultMsg = QString("操作已取消 (成功: %1, 失败: %2)").arg(successCount).arg(failCount);
+        } else if (failCount == 0) {
+            resultMsg = QString("所有操作成功完成 (共 %1 个文件)").arg(successCount);
+            overallSuccess = true;
+        } else if (successCount == 0) {
+            resultMsg = QString("所有操作失败 (共 %1 个文件)").arg(failCount);
+        } else {
+            resultMsg = QString("操作部分完成 (成功: %1, 失败: %2)").arg(successCount).arg(failCount);
+        }
+        
+        const SessionKeyCache::Stats keyCache = SessionKeyCache::stats();
+        if (keyCache.hits > keyCacheBefore.hits) {
+            emit logMessageRequested(QString("密钥缓存: 命中 %1 次, 派生 %2 次")
+                                     .arg(keyCache.hits - keyCacheBefore.hits)
+                                     .arg(keyCache.misses - keyCacheBefore.misses));
+        }
+        
+        reportPerfStats();
+        saveTrace();
+        emit operationCompleted(overallSuccess, resultMsg);
+    } catch (const std::exception &e) {
+        commitOutputs();
+        reportPerfStats();
+        saveTrace();
+        emit operationCompleted(false, QString("操作失败: %1").arg(e.what()));
+    }
+}
+
+// 提交到后台服务，逐个文件转发结果；取消时由服务停止领取新文件
+void WorkerThread::runRemote()
+{
+    JobProtocol::JobRequest request;
+    switch (currentOp) {
+    case Encrypt: request.op = JobProtocol::Encrypt; break;
+    case Decrypt: request.op = JobProtocol::Decrypt; break;
+    case Verify: request.op = JobProtocol::Verify; break;
+    case Wipe: request.op = JobProtocol::Wipe; break;
+    default: request.op = JobProtocol::Hash; break;
+    }
+    request.password = password.toStdString();
+    request.outputDir = outputDirectory.toStdString();
+    request.hashAlgorithms = m_hashAlgorithms;
+    request.priority = m_throttle.priority();
+    request.limits = m_throttle.limits();
+    for (const QString &path : fileList) {
+        request.paths.push_back(QFileInfo(path).absoluteFilePath().toStdString());
+    }
+    
+    emit logMessageRequested(QString("提交到后台服务: %1").arg(m_serviceSocket));
+    try {
+        JobProtocol::JobResult result = JobClient::run(m_serviceSocket.toStdString(), request,
+            [this](const JobProtocol::FileResult &file) {
+                const QString path = QString::fromStdString(file.path);
+                const QString detail = QString::fromStdString(file.detail);
+                if (file.success) {
+                    emit fileProcessed(path);
+                    if (!detail.isEmpty()) {
+                        emit logMessageRequested(QString("%1: %2").arg(QFileInfo(path).fileName(), detail));
+                    }
+                } else {
+                    emit logMessageRequested(QString("处理失败: %1 - %2").arg(path, detail), true);
+                }
+                if (file.total > 0) {
+                    emit progressChanged(static_cast<int>(file.done * 100ULL / file.total),
+                                         QString("已完成 %1/%2").arg(file.done).arg(file.total));
+                }
+            }, &m_cancel, &m_throttle);
+        
+        QString resultMsg;
+        if (result.cancelled) {
+            resultMsg = QString("操作已取消 (成功: %1, 失败: %2)").arg(result.succeeded).arg(result.failed);
+        } else if (result.failed == 0) {
+            resultMsg = QString("所有操作成功完成 (共 %1 个文件)").arg(result.succeeded);
+        } else if (result.succeeded == 0) {
+            resultMsg = QString("所有操作失败 (共 %1 个文件)").arg(result.failed);
+        } else {
+            resultMsg = QString("操作部分完成 (成功: %1, 失败: %2)").arg(result.succeeded).arg(result.failed);
+        }
+        emit operationCompleted(!result.cancelled && result.failed == 0, resultMsg);
+    } catch (const std::exception &e) {
+        emit operationCompleted(false, QString("操作失败: %1").arg(e.what()));
+    }
+}
+
+// 各阶段耗时分解写入日志，并按需导出Prometheus文本和JSON摘要
+void WorkerThread::reportPerfStats()
+{
+    const PerfStats::Snapshot snapshot = PerfStats::snapshot();
+    uint64_t busyNs = 0;
+    for (const PerfStats::StageStats &stage : snapshot.stages) {
+        busyNs += stage.totalNs;
+    }
+    if (busyNs == 0) return;
+    
+    // 多线程时各阶段累计耗时可能超过总耗时
+    emit logMessageRequested(QString("性能统计: 总耗时 %1 s, 各阶段累计 %2 s")
+                             .arg(snapshot.wallNs / 1e9, 0, 'f', 2)
+                             .arg(busyNs / 1e9, 0, 'f', 2));
+    for (size_t i = 0; i < PerfStats::STAGE_COUNT; i++) {
+        const PerfStats::StageStats &stage = snapshot.stages[i];
+        if (stage.count == 0) continue;
+        QString line = QString("  %1: %2 次, %3 s (%4%), p99 %5 ms")
+            .arg(QString::fromUtf8(PerfStats::stageLabel(static_cast<PerfStats::Stage>(i))))
+            .arg(stage.count)
+            .arg(stage.totalNs / 1e9, 0, 'f', 3)
+            .arg(stage.totalNs * 100.0 / busyNs, 0, 'f', 1)
+            .arg(stage.percentileNs(0.99) / 1e6, 0, 'f', 2);
+        if (stage.bytes > 0 && stage.totalNs > 0) {
+            line += QString(", %1 MB/s").arg(stage.bytes * 1e3 / stage.totalNs, 0, 'f', 1);
+        }
+        emit logMessageRequested(line);
+    }
+    if (snapshot.memoryPeak > 0) {
+        const PerfStats::StageStats &wait = snapshot.stages[PerfStats::MemWait];
+        emit logMessageRequested(QString("  缓冲区内存: 峰值 %1 MB, 上限 %2, 等待 %3 次")
+                                 .arg(snapshot.memoryPeak / (1024.0 * 1024.0), 0, 'f', 1)
+                                 .arg(snapshot.memoryLimit
+                                      ? QString("%1 MB").arg(snapshot.memoryLimit / (1024.0 * 1024.0), 0, 'f', 0)
+                                      : QString("不限"))
+                                 .arg(wait.count));
+    }
+    
+    if (!m_statsDirectory.isEmpty()) {
+        try {
+            PerfStats::exportTo(m_statsDirectory.toStdString(), snapshot);
+            emit logMessageRequested(QString("性能统计已导出: %1").arg(m_statsDirectory));
+        } catch (const std::exception &e) {
+            emit logMessageRequested(QString("导出性能统计失败: %1").arg(e.what()), true);
+        }
+    }
+}
+
+// 停止记录并写出时间线（此时各并行任务均已结束）
+void WorkerThread::saveTrace()
+{
+    if (!TraceRecorder::enabled()) return;
+    TraceRecorder::stop();
+    try {
+        TraceRecorder::write(m_tracePath.toStdString());
+        QString msg = QString("时间线已保存: %1 (%2 个事件)")
+                      .arg(m_tracePath).arg(TraceRecorder::eventCount());
+        if (size_t dropped = TraceRecorder::droppedCount()) {
+            msg += QString(", 丢弃 %1 个").arg(dropped);
+        }
+        emit logMessageRequested(msg);
+    } catch (const std::exception &e) {
+        emit logMessageRequested(QString("保存时间线失败: %1").arg(e.what()), true);
+    }
+}
+
+// 增量加密收尾：清理已删除源文件的输出并写回清单
+void WorkerThread::finishIncremental()
+{
+    try {
+        if (!m_cancel) {
+            std::vector<std::string> roots;
+            for (const QString &path : fileList) {
+                roots.push_back(QFileInfo(path).absoluteFilePath().toStdString());
+            }
+            std::vector<std::string> removed = m_manifest.pruneMissing(roots);
+            for (const std::string &path : removed) {
+                emit logMessageRequested(QString("源文件已删除，清理输出: %1")
+                                         .arg(QString::fromStdString(path)));
+            }
+        }
+        m_manifest.save();
+        emit logMessageRequested(QString("增量加密: 跳过 %1 个未变化的文件").arg(m_skippedCount));
+    } catch (const std::exception &e) {
+        emit logMessageRequested(QString("保存增量清单失败: %1").arg(e.what()), true);
+    }
+}
+
+// 使用枚举时缓存的stat信息，不再重复stat
+CatalogEntry WorkerThread::makeCatalogEntry(const QFileInfo &fileInfo, const std::string &outputName,
+                                            const std::string &plainDigest)
+{
+    CatalogEntry entry;
+    entry.sourcePath = fileInfo.absoluteFilePath().toStdString();
+    entry.outputName = outputName;
+    entry.size = static_cast<uint64_t>(fileInfo.size());
+    entry.mtimeNs = fileInfo.lastModified().toMSecsSinceEpoch() * 1000000LL;
+    entry.plainDigest = plainDigest;
+    return entry;
+}
+
+// 把本批次的输出登记到输出目录的加密目录（源路径、大小、修改时间、明文摘要），
+// 每次运行结束时写一次；与已保存内容相同的条目不计为修改，没有修改时不重写
+void WorkerThread::updateCatalog()
+{
+    try {
+        EncryptedCatalog catalog;
+        catalog.open(outputDirectory.toStdString(), password.toStdString());
+        for (const CatalogEntry &entry : m_catalogEntries) {
+            if (!catalog.contains(entry)) {
+                catalog.add(entry);
+            }
+        }
+        if (!catalog.hasChanges()) {
+            return;
+        }
+        catalog.save();
+        emit logMessageRequested(QString("加密目录已更新: %1 个条目").arg(catalog.size()));
+    } catch (const std::exception &e) {
+        emit logMessageRequested(QString("更新加密目录失败: %1").arg(e.what()), true);
+    }
+}
+
+// 登记已写完的临时输出，由发布器成批刷盘并重命名
+// pending为空的输出（如分块索引）不计入处理结果
+void WorkerThread::publishOutput(const QString &tempPath, const QString &finalPath,
+                                 const PendingOutput *pending)
+{
+    if (pending) {
+        m_pendingOutputs[finalPath.toStdString()] = *pending;
+    }
+    std::vector<std::string> published;
+    const std::vector<std::string> failed =
+        m_committer.complete(tempPath.toStdString(), finalPath.toStdString(), &published);
+    handlePublished(published, failed);
+}
+
+void WorkerThread::commitOutputs()
+{
+    std::vector<std::string> published;
+    const std::vector<std::string> failed = m_committer.commit(&published);
+    handlePublished(published, failed);
+}
+
+// 重命名确认后才记录成功：写日志、标记文件已处理、更新增量清单和加密目录；
+// 发布失败的输出只记录所属条目，清单和加密目录保持原样
+void WorkerThread::handlePublished(const std::vector<std::string> &published,
+                                   const std::vector<std::string> &failed)
+{
+    for (const std::string &path : published) {
+        auto it = m_pendingOutputs.find(path);
+        if (it == m_pendingOutputs.end()) continue;
+        const PendingOutput &pending = it->second;
+        emit logMessageRequested(pending.message);
+        if (!pending.manifestSource.empty()) {
+            m_manifest.update(pending.manifestSource, pending.manifestEntry);
+        }
+        if (pending.hasCatalogEntry) {
+            m_catalogEntries.push_back(pending.catalogEntry);
+        }
+        emit fileProcessed(pending.sourcePath);
+        m_pendingOutputs.erase(it);
+    }
+    for (const std::string &path : failed) {
+        // 分块索引与密文的世代号不一致时下次全量重写，不计为失败
+        if (QString::fromStdString(path).endsWith(".sfmidx")) {
+            emit logMessageRequested(QString("分块索引发布失败，下次将全量重写: %1")
+                                     .arg(QString::fromStdString(path)), true);
+            continue;
+        }
+        emit logMessageRequested(QString("输出文件发布失败: %1")
+                                 .arg(QString::fromStdString(path)), true);
+        auto it = m_pendingOutputs.find(path);
+        if (it != m_pendingOutputs.end()) {
+            m_failedItems.insert(it->second.item);
+            m_pendingOutputs.erase(it);
+        }
+    }
+}
+
+// 递归收集目录下的所有文件
+void WorkerThread::collectFiles(const QString &dirPath, QFileInfoList &files)
+{
+    QDir dir(dirPath);
+    const QFileInfoList entries = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    for (const QFileInfo &entry : entries) {
+        if (entry.isFile()) {
+            files.append(entry);
+        } else if (entry.isDir()) {
+            collectFiles(entry.absoluteFilePath(), files);
+        }
+    }
+}
+
+// 校验和更换密码：先收集全部文件，再按文件并行处理
+// 校验解密到空输出，不写出任何文件；更换密码只改写文件头
+void WorkerThread::processFilesParallel(Operation op, int &successCount, int &failCount)
+{
+    QFileInfoList files;
+    for (const QString &path : fileList) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            collectFiles(info.absoluteFilePath(), files);
+        } else {
+            files.append(info);
+        }
+    }
+    
+    struct FileFailure {
+        QString path;
+        QString error;
+        uint64_t offset;
+    };
+    std::vector<FileFailure> failures;
+    std::mutex failuresMutex;
+    std::atomic<int> okCount(0);
+    std::atomic<int> doneCount(0);
+    const int total = files.size();
+    const std::string pwd = password.toStdString();
+    
+    // 新密码的KEK整批共用，只派生一次
+    KeyEnvelope::Kek newKek;
+    if (op == Rekey) {
+        KeyEnvelope::newKek(newPassword.toStdString(), CryptoEngine::kdfIterations(), newKek);
+    }
+    
+    parallelForEach(static_cast<size_t>(total), m_threadCount, [&](size_t i) {
+        if (m_cancel) return;
+        const QFileInfo &info = files[static_cast<int>(i)];
+        const std::string path = info.absoluteFilePath().toStdString();
+        
+        // 分块密文的旁路索引和加密目录不是独立的加密文件
+        if (info.fileName().endsWith(".sfmidx") || info.fileName() == EncryptedCatalog::FILE_NAME) {
+            doneCount++;
+            return;
+        }
+        
+        uint64_t badOffset = CryptoEngine::UNKNOWN_SIZE;
+        TraceRecorder::Span span("file", path);
+        try {
+            if (op == Rekey) {
+                if (DeltaEngine::isDeltaFile(path)) {
+                    throw std::runtime_error("分块加密文件不支持只改写文件头的密码更换");
+                }
+                CryptoEngine::rekeyFile(path, pwd, newKek);
+            } else if (DeltaEngine::isDeltaFile(path)) {
+                DeltaEngine::verifyFile(path, pwd, nullptr, &badOffset);
+            } else {
+                CryptoEngine::verifyFile(path, pwd, nullptr,
+                                         static_cast<uint64_t>(info.size()), &badOffset);
+            }
+            okCount++;
+        } catch (const std::exception &e) {
+            std::lock_guard<std::mutex> lock(failuresMutex);
+            failures.push_back({info.absoluteFilePath(), QString::fromUtf8(e.what()), badOffset});
+        }
+        
+        int done = ++doneCount;
+        emit progressChanged(done * 100 / total, QString("%1 %2/%3")
+                             .arg(op == Rekey ? "已更换密码" : "已校验").arg(done).arg(total));
+    });
+    
+    // 汇总报告：按路径排序列出每个失败的文件
+    std::sort(failures.begin(), failures.end(),
+              [](const FileFailure &a, const FileFailure &b) { return a.path < b.path; });
+    const QString opName = (op == Rekey) ? "更换密码" : "校验";
+    for (const FileFailure &f : failures) {
+        QString msg = (f.offset == CryptoEngine::UNKNOWN_SIZE)
+            ? QString("%1失败: %2 - %3").arg(opName, f.path, f.error)
+            : QString("%1失败: %2 (偏移 %3) - %4").arg(opName, f.path).arg(f.offset).arg(f.error);
+        emit logMessageRequested(msg, true);
+    }
+    emit logMessageRequested(QString("%1完成: 成功 %2 个, 失败 %3 个")
+                             .arg(opName).arg(okCount.load()).arg(failures.size()));
+    
+    successCount = okCount;
+    failCount = static_cast<int>(failures.size());
+}
+
+// 安全擦除：收集全部文件后交给擦除调度器，多个文件并发覆盖、按目录成批删除
+void WorkerThread::wipeFiles(int &successCount, int &failCount)
+{
+    std::vector<std::string> paths;
+    for (const QString &path : fileList) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QFileInfoList files;
+            collectFiles(info.absoluteFilePath(), files);
+            for (const QFileInfo &file : files) {
+                paths.push_back(file.absoluteFilePath().toStdString());
+            }
+        } else {
+            paths.push_back(info.absoluteFilePath().toStdString());
+        }
+    }
+    
+    const int total = static_cast<int>(paths.size());
+    std::atomic<int> doneCount(0);
+    WipeScheduler scheduler(m_wipeOptions);
+    WipeScheduler::Stats stats = scheduler.run(paths,
+        [&](const std::string &path, bool success, const std::string &error) {
+            const QString filePath = QString::fromStdString(path);
+            if (success) {
+                emit logMessageRequested(QString("已安全擦除: %1 (永久删除)").arg(filePath));
+                emit fileProcessed(filePath);
+            } else {
+                emit logMessageRequested(QString("安全擦除失败: %1 - %2")
+                                         .arg(filePath, QString::fromStdString(error)), true);
+            }
+            int done = ++doneCount;
+            emit progressChanged(done * 100 / total,
+                                 QString("已擦除 %1/%2").arg(done).arg(total));
+        }, &m_cancel);
+    
+    QString summary = QString("安全擦除完成: 覆盖 %1 字节, 释放 %2 字节")
+                      .arg(stats.bytesOverwritten).arg(stats.bytesDiscarded);
+    if (m_wipeOptions.trim) {
+        summary += QString(", TRIM回收 %1 字节").arg(stats.bytesTrimmed);
+    }
+    emit logMessageRequested(summary);
+    
+    successCount = static_cast<int>(stats.files);
+    failCount = static_cast<int>(stats.failed);
+}
+
+// 写出本次计算的SHA-256清单
+void WorkerThread::saveHashManifest()
+{
+    try {
+        std::sort(m_hashEntries.begin(), m_hashEntries.end(),
+                  [](const HashEntry &a, const HashEntry &b) { return a.path < b.path; });
+        HashManifest::save(m_hashManifestPath.toStdString(), m_hashEntries);
+        emit logMessageRequested(QString("哈希清单已保存: %1 (%2 个条目)")
+                                 .arg(m_hashManifestPath).arg(m_hashEntries.size()));
+    } catch (const std::exception &e) {
+        emit logMessageRequested(QString("保存哈希清单失败: %1").arg(e.what()), true);
+    }
+}
+
+// 按清单校验：小文件成批并行，大文件顺序读取
+void WorkerThread::checkManifest(int &successCount, int &failCount)
+{
+    const QString manifestPath = fileList.isEmpty() ? QString() : fileList.first();
+    HashManifest::CheckSummary summary = HashManifest::check(manifestPath.toStdString(), m_threadCount,
+        [this](size_t done, size_t total) {
+            emit progressChanged(static_cast<int>(done * 100 / total),
+                                 QString("已校验 %1/%2").arg(done).arg(total));
+        }, &m_cancel);
+    
+    for (const HashManifest::CheckResult &r : summary.problems) {
+        const QString path = QString::fromStdString(r.path);
+        QString label = (r.status == HashManifest::Missing) ? "缺失"
+                      : (r.status == HashManifest::Changed) ? "已变化" : "校验失败";
+        emit logMessageRequested(QString("%1: %2 - %3")
+                                 .arg(label, path, QString::fromStdString(r.detail)), true);
+    }
+    emit logMessageRequested(QString("清单校验完成: 正常 %1 个, 已变化 %2 个, 缺失 %3 个, 失败 %4 个")
+                             .arg(summary.ok).arg(summary.changed)
+                             .arg(summary.missing).arg(summary.failed));
+    
+    successCount = static_cast<int>(summary.ok);
+    failCount = static_cast<int>(summary.changed + summary.missing + summary.failed);
+}
+
+// 修改函数签名，返回操作是否成功
+bool WorkerThread::processDirectory(Operation op, const QString &dirPath)
+{
+    QDir dir(dirPath);
+    if (!dir.exists()) {
+        emit logMessageRequested(QString("目录不存在: %1").arg(dirPath), true);
+        return false;
+    }
+    
+    // 获取目录下所有文件和子目录
+    QFileInfoList entries = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    int totalEntries = entries.size();
+    int processed = 0;
+    bool allSuccess = true; // 跟踪目录内所有操作是否成功
+    
+    for (const QFileInfo &entry : entries) {
+        if (m_cancel) return false;
+        
+        processed++;
+        int progress = static_cast<int>((processed * 100) / totalEntries);
+        emit progressChanged(progress, QString("处理目录: %1 (%2/%3)")
+                                .arg(dir.dirName())
+                                .arg(processed)
+                                .arg(totalEntries));
+        
+        bool result = false;
+        if (entry.isFile()) {
+            result = processSingleFile(op, entry);
+        } else if (entry.isDir()) {
+            result = processDirectory(op, entry.absoluteFilePath());
+        }
+        
+        if (!result) {
+            allSuccess = false;
+        }
+    }
+    
+    return allSuccess;
+}
+
+// 修改函数签名，返回操作是否成功
+// fileInfo 来自目录枚举，复用其中缓存的stat信息
+bool WorkerThread::processSingleFile(Operation op, const QFileInfo &fileInfo)
+{
+    const QString filePath = fileInfo.absoluteFilePath();
+    QString outputPath;
+    TraceRecorder::Span span("file", filePath.toStdString());
+    
+    // 更新处理状态
+    emit progressChanged(0, QString("正在处理: %1").arg(fileInfo.fileName()));
+    
+    try {
+        // 定义进度回调
+        auto progressCallback = [this, fileInfo](int progress) {
+            QString msg = QString("处理 %1: %2%")
+                         .arg(fileInfo.fileName())
+                         .arg(progress);
+            emit progressChanged(progress, msg);
+        };
+        
+        if (op == Encrypt && m_inPlace) {
+            CryptoEngine::encryptFileInPlace(
+                filePath.toStdString(),
+                password.toStdString(),
+                progressCallback
+            );
+            
+            outputPath = QString::fromStdString(
+                CryptoEngine::inPlaceTargetPath(filePath.toStdString(), true));
+            emit logMessageRequested(QString("原地加密成功! 文件: %1").arg(outputPath));
+            
+            // 标记文件已处理
+            emit fileProcessed(filePath);
+            
+            return true;
+        }
+        else if (op == Decrypt && m_inPlace) {
+            CryptoEngine::decryptFileInPlace(
+                filePath.toStdString(),
+                password.toStdString(),
+                progressCallback
+            );
+            
+            outputPath = QString::fromStdString(
+                CryptoEngine::inPlaceTargetPath(filePath.toStdString(), false));
+            emit logMessageRequested(QString("原地解密成功! 文件: %1").arg(outputPath));
+            
+            // 标记文件已处理
+            emit fileProcessed(filePath);
+            
+            return true;
+        }
+        else if (op == Encrypt) {
+            // 确定输出路径（先写入临时文件，完成后再发布）
+            outputPath = outputDirectory + "/" + fileInfo.fileName() + ".enc";
+            QString tempPath = QString::fromStdString(
+                OutputCommitter::stagingPath(outputPath.toStdString()));
+            
+            // 增量模式：在加密前记录元数据，加密期间被修改的文件下次会再次处理；
+            // 清单中的内容摘要取自加密时读入的数据，与密文对应同一份内容
+            const std::string sourcePath = filePath.toStdString();
+            ManifestEntry manifestEntry;
+            manifestEntry.outputName = (fileInfo.fileName() + ".enc").toStdString();
+            bool haveStamp = false;
+            if (m_incremental) {
+                haveStamp = EncryptionManifest::stamp(sourcePath, manifestEntry.stamp);
+                m_manifest.markSeen(sourcePath);
+                
+                if (haveStamp && m_manifest.isUnchanged(sourcePath, manifestEntry.stamp)) {
+                    m_skippedCount++;
+                    emit logMessageRequested(QString("未变化，跳过: %1").arg(fileInfo.fileName()));
+                    emit fileProcessed(filePath);
+                    return true;
+                }
+                
+                // 元数据变化但内容未变（如仅更新了时间戳）时只更新清单
+                const ManifestEntry *previous = m_manifest.find(sourcePath);
+                if (haveStamp && previous && previous->stamp.size == manifestEntry.stamp.size &&
+                    previous->outputName == manifestEntry.outputName &&
+                    QFileInfo::exists(outputPath)) {
+                    const std::string digest = m_manifest.contentDigest(sourcePath);
+                    if (!previous->digest.empty() && digest == previous->digest) {
+                        manifestEntry.digest = digest;
+                        m_manifest.update(sourcePath, manifestEntry);
+                        m_skippedCount++;
+                        emit logMessageRequested(QString("内容未变化，跳过: %1").arg(fileInfo.fileName()));
+                        emit fileProcessed(filePath);
+                        return true;
+                    }
+                }
+            }
+            
+            if (m_delta) {
+                // 分块模式在已有密文的reflink副本上只重写变化的块，索引随密文一起经发布器原子替换。
+                // 文件系统不支持reflink（如ext4、NTFS）时不做整份复制，直接更新已有密文：
+                // 密文头先标记为更新中并落盘，尾部MAC和世代号写完才恢复，
+                // 中途崩溃的密文拒绝解密，下次运行全量重写
+                const std::string finalPath = outputPath.toStdString();
+                const std::string indexPath = DeltaEngine::indexPath(finalPath);
+                // cloneExisting同时清除上次遗留的临时文件
+                const bool inPlace = !OutputCommitter::cloneExisting(finalPath, tempPath.toStdString()) &&
+                                     QFileInfo::exists(outputPath);
+                const std::string deltaTemp = inPlace ? finalPath : tempPath.toStdString();
+                const std::string indexTemp = DeltaEngine::indexPath(deltaTemp);
+                DeltaEngine::Stats stats;
+                std::string plainDigest;
+                try {
+                    if (!inPlace) {
+                        OutputCommitter::stageExisting(indexPath, indexTemp);
+                    }
+                    DeltaEngine::encryptFile(
+                        sourcePath,
+                        deltaTemp,
+                        password.toStdString(),
+                        progressCallback,
+                        &stats,
+                        &plainDigest
+                    );
+                } catch (...) {
+                    if (!inPlace) {
+                        OutputCommitter::discard(deltaTemp);
+                        OutputCommitter::discard(indexTemp);
+                    }
+                    throw;
+                }
+                
+                PendingOutput pending;
+                pending.item = m_currentItem;
+                pending.sourcePath = filePath;
+                pending.message = QString("分块加密成功! 输出文件: %1 (重写 %2/%3 块, 写入 %4 字节%5)")
+                                  .arg(outputPath)
+                                  .arg(stats.rewrittenChunks)
+                                  .arg(stats.totalChunks)
+                                  .arg(stats.bytesWritten)
+                                  .arg(inPlace ? QString(", 原地更新") : QString());
+                if (m_incremental && haveStamp) {
+                    manifestEntry.digest = m_manifest.keyedDigest(plainDigest);
+                    pending.manifestSource = sourcePath;
+                    pending.manifestEntry = manifestEntry;
+                }
+                pending.hasCatalogEntry = true;
+                pending.catalogEntry = makeCatalogEntry(fileInfo, manifestEntry.outputName, plainDigest);
+                if (inPlace) {
+                    // 原地更新已由DeltaEngine落盘，无需经发布器重命名
+                    m_pendingOutputs[finalPath] = pending;
+                    handlePublished({finalPath}, {});
+                    return true;
+                }
+                publishOutput(QString::fromStdString(indexTemp), QString::fromStdString(indexPath));
+                publishOutput(tempPath, outputPath, &pending);
+                return true;
+            }
+            
+            uint64_t outputSize = 0;
+            std::string plainDigest;
+            try {
+                CryptoEngine::encryptFile(
+                    filePath.toStdString(), 
+                    tempPath.toStdString(), 
+                    *m_kek,
+                    progressCallback,
+                    static_cast<uint64_t>(fileInfo.size()),
+                    &outputSize,
+                    &plainDigest
+                );
+            } catch (...) {
+                OutputCommitter::discard(tempPath.toStdString());
+                throw;
+            }
+            
+            // 详细的加密成功日志在输出发布后写入
+            PendingOutput pending;
+            pending.item = m_currentItem;
+            pending.sourcePath = filePath;
+            pending.message = QString("加密成功! 输出文件: %1 (大小: %2 字节, 明文SHA-256: %3)")
+                              .arg(outputPath)
+                              .arg(outputSize)
+                              .arg(QString::fromStdString(plainDigest));
+            pending.hasCatalogEntry = true;
+            pending.catalogEntry = makeCatalogEntry(fileInfo, manifestEntry.outputName, plainDigest);
+            if (m_incremental && haveStamp) {
+                manifestEntry.digest = m_manifest.keyedDigest(plainDigest);
+                pending.manifestSource = sourcePath;
+                pending.manifestEntry = manifestEntry;
+            }
+            publishOutput(tempPath, outputPath, &pending);
+            
+            return true;
+        } 
+        else if (op == Decrypt) {
+            // 分块密文的旁路索引不是独立的加密文件
+            if (fileInfo.fileName().endsWith(".sfmidx")) {
+                emit logMessageRequested(QString("跳过分块索引文件: %1").arg(fileInfo.fileName()));
+                return true;
+            }
+            if (fileInfo.fileName() == EncryptedCatalog::FILE_NAME) {
+                emit logMessageRequested(QString("跳过加密目录文件: %1").arg(fileInfo.fileName()));
+                return true;
+            }
+            
+            // 解密前的文件验证（使用枚举时已获得的大小，不再重复stat）
+            if (static_cast<uint64_t>(fileInfo.size()) < CryptoEngine::MIN_ENCRYPTED_SIZE) {
+                QString errorMsg = QString("'%1' 不是有效的加密文件，跳过")
+                                    .arg(fileInfo.fileName());
+                emit logMessageRequested(errorMsg, true);
+                return false;
+            }
+            
+            // 确定输出路径
+            QString baseName = fileInfo.fileName();
+            if (baseName.endsWith(".enc")) {
+                baseName.chop(4);
+            }
+            outputPath = outputDirectory + "/decrypted_" + baseName;
+            QString tempPath = QString::fromStdString(
+                OutputCommitter::stagingPath(outputPath.toStdString()));
+            
+            uint64_t outputSize = 0;
+            std::string plainDigest;
+            try {
+                if (DeltaEngine::isDeltaFile(filePath.toStdString())) {
+                    DeltaEngine::decryptFile(
+                        filePath.toStdString(),
+                        tempPath.toStdString(),
+                        password.toStdString(),
+                        progressCallback
+                    );
+                    outputSize = static_cast<uint64_t>(QFileInfo(tempPath).size());
+                } else {
+                    CryptoEngine::decryptFile(
+                        filePath.toStdString(), 
+                        tempPath.toStdString(), 
+                        password.toStdString(),
+                        progressCallback,
+                        static_cast<uint64_t>(fileInfo.size()),
+                        &outputSize,
+                        &plainDigest
+                    );
+                }
+            } catch (...) {
+                OutputCommitter::discard(tempPath.toStdString());
+                throw;
+            }
+            
+            // 详细的解密成功日志在输出发布后写入
+            PendingOutput pending;
+            pending.item = m_currentItem;
+            pending.sourcePath = filePath;
+            pending.message = QString("解密成功! 输出文件: %1 (大小: %2 字节)")
+                              .arg(outputPath)
+                              .arg(outputSize);
+            if (!plainDigest.empty()) {
+                pending.message += QString(" 明文SHA-256: %1").arg(QString::fromStdString(plainDigest));
+            }
+            publishOutput(tempPath, outputPath, &pending);
+            
+            return true;
+        }
+        else if (op == CalculateHash) {
+            // 所有选中的算法共用一次读取
+            MultiHasher::Digests digests =
+                MultiHasher::hashFile(filePath.toStdString(), m_hashAlgorithms);
+            for (const auto &digest : digests) {
+                QString result = QString("%1 的 %2: %3")
+                    .arg(fileInfo.fileName(),
+                         QString::fromUtf8(MultiHasher::algorithmName(digest.first)),
+                         QString::fromStdString(digest.second));
+                emit logMessageRequested(result);
+                
+                if (digest.first == MultiHasher::SHA256 && !m_hashManifestPath.isEmpty()) {
+                    m_hashEntries.push_back(HashManifest::makeEntry(
+                        filePath.toStdString(), digest.second,
+                        QFileInfo(m_hashManifestPath).absolutePath().toStdString()));
+                }
+            }
+            
+            // 标记文件已处理
+            emit fileProcessed(filePath);
+            
+            return true;
+        }
+        
+        return false; // 未知操作类型
+    } 
+    catch (const std::exception &e) {
+        // 处理异常
+        QString errorMsg = QString("处理文件 %1 时出错: %2")
+            .arg(fileInfo.fileName(), e.what());
+        emit logMessageRequested(errorMsg, true);
+        return false;
+    }
+}
\ No newline at end of file